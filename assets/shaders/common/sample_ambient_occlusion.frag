@@ -2,7 +2,75 @@
 
 #include "srgb.frag"
 
-uniform sampler3D ambient_occlusion_sampler;
+uniform usampler3D ambient_occlusion_indirection_sampler;
+uniform sampler3D ambient_occlusion_brick_pool_sampler;
+
+// This is only set for sector faces, when the level has a surface atlas
+uniform bool samples_ao_surface_atlas;
+uniform sampler2D ambient_occlusion_surface_atlas_sampler;
+uniform usampler2DArray ambient_occlusion_wall_tile_sampler;
+
+// These should be in sync with the same constants in `ambient_occlusion.h` and `ambient_occlusion.c`
+const uint ao_brick_size = 8u, ao_padded_brick_size = ao_brick_size + 1u, uniform_ao_brick_flag = 1u << 31u;
+const float ao_surface_atlas_texels_per_unit = 2.0f;
+
+/* This mirrors `sample_ao_brick_volume` in `ambient_occlusion.c`, so see there for more info. The position is in
+voxels, in the AO map's axis order. The brick pool has no mipmaps, so this always reads from its first level. */
+float sample_ao_brick_volume(vec3 pos) {
+	ivec3 num_bricks = textureSize(ambient_occlusion_indirection_sampler, 0);
+	pos = clamp(pos, vec3(0.5f), vec3(num_bricks * int(ao_brick_size)) - 0.5f);
+
+	ivec3 brick = ivec3(pos - 0.5f) / int(ao_brick_size);
+	uint entry = texelFetch(ambient_occlusion_indirection_sampler, brick, 0).r;
+	if ((entry & uniform_ao_brick_flag) != 0u) return float(entry & 255u) / 255.0f;
+
+	//////////
+
+	ivec3 pool_size = textureSize(ambient_occlusion_brick_pool_sampler, 0);
+	uint num_pool_bricks_across = uint(pool_size.x) / ao_padded_brick_size;
+
+	uvec3 slot = uvec3(entry, entry / num_pool_bricks_across, entry / (num_pool_bricks_across * num_pool_bricks_across));
+	slot.xy %= num_pool_bricks_across;
+
+	vec3 pool_pos = vec3(slot * ao_padded_brick_size) + (pos - vec3(brick * int(ao_brick_size)));
+	return textureLod(ambient_occlusion_brick_pool_sampler, pool_pos / vec3(pool_size), 0.0f).r;
+}
+
+/* This looks up the AO for a sector face in the surface atlas (see `ambient_occlusion.c`), from the tile of the column
+top or the wall that the fragment is on. It gives back a negative value for walls with no tile, which are the walls
+of coarse levels of detail that don't line up with the heightmap's walls. */
+float sample_ao_surface_atlas(const vec3 pos, const vec3 normal) {
+	vec2 tile_start, tile_size = vec2(ao_surface_atlas_texels_per_unit), pos_in_tile;
+
+	if (normal.y > 0.5f) {
+		vec2 column = floor(pos.xz);
+		tile_start = column * ao_surface_atlas_texels_per_unit;
+		pos_in_tile = (pos.xz - column) * ao_surface_atlas_texels_per_unit;
+	}
+	else {
+		// Walls facing along x are indexed by the x of their edge, and walls facing along z by the z of theirs
+		bool faces_along_x = abs(normal.x) > 0.5f;
+
+		ivec3 entry_pos = faces_along_x
+			? ivec3(round(pos.x), floor(pos.z), 0)
+			: ivec3(floor(pos.x), round(pos.z), 1);
+
+		uvec4 entry = texelFetch(ambient_occlusion_wall_tile_sampler, entry_pos, 0);
+		if (entry.w == 0u) return -1.0f;
+
+		tile_start = vec2(entry.xy);
+		tile_size.y = float(entry.w);
+
+		pos_in_tile = vec2(fract(faces_along_x ? pos.z : pos.x), pos.y - float(entry.z))
+			* ao_surface_atlas_texels_per_unit;
+	}
+
+	// Clamping to the outer texel centers keeps linear filtering from reading other tiles
+	pos_in_tile = clamp(pos_in_tile, vec2(0.5f), tile_size - 0.5f);
+
+	vec2 atlas_size = vec2(textureSize(ambient_occlusion_surface_atlas_sampler, 0));
+	return textureLod(ambient_occlusion_surface_atlas_sampler, (tile_start + pos_in_tile) / atlas_size, 0.0f).r;
+}
 
 /* The tricubic filtering code is based on the bicubic filtering code from here:
 https://stackoverflow.com/questions/13501081/efficient-bicubic-filtering-code-in-glsl. */
@@ -18,11 +86,10 @@ vec4 cubic(const float v) {
 	return vec4(s.x, b, a, 6.0f - s.x - a - b) / 6.0f;
 }
 
-// Tricubic filtering reads some values under the heightmap, which makes it a bit darker.
-float texture_tricubic_single_channel(const sampler3D texture_sampler, const vec3 fragment_pos_world_space) {
-	vec3
-		texel_size = 1.0f / textureSize(texture_sampler, 0),
-		UV = fragment_pos_world_space.xzy;
+/* Tricubic filtering reads some values under the heightmap, which makes it a bit darker.
+The sample positions here are in voxels, since the AO map's bricks are looked up per sample. */
+float sample_ao_tricubic(const vec3 fragment_pos_world_space) {
+	vec3 UV = fragment_pos_world_space.xzy;
 
 	vec3 UV_fraction = fract(UV);
 	UV -= UV_fraction; // Flooring it
@@ -42,14 +109,14 @@ float texture_tricubic_single_channel(const sampler3D texture_sampler, const vec
 	//////////
 
 	vec4 s = vec4(x_cubic.xy + x_cubic.zw, y_cubic.xy + y_cubic.zw);
-	vec4 sample_offset = (c + vec4(x_cubic.zw, y_cubic.zw) / s) * texel_size.xxyy;
+	vec4 sample_offset = c + vec4(x_cubic.zw, y_cubic.zw) / s;
 
 	vec2 s_extra = z_cubic.xy + z_cubic.zw;
-	vec2 sample_offset_extra = (c_extra + vec2(z_cubic.zw) / s_extra) * texel_size.z;
+	vec2 sample_offset_extra = c_extra + vec2(z_cubic.zw) / s_extra;
 
 	//////////
 
-	#define SAMPLE(gh, i) texture(texture_sampler, vec3(sample_offset.gh, sample_offset_extra.i)).r
+	#define SAMPLE(gh, i) sample_ao_brick_volume(vec3(sample_offset.gh, sample_offset_extra.i))
 
 	vec4 lerped_x = mix(
 		vec4(SAMPLE(yw, x), SAMPLE(yw, y), SAMPLE(yz, x), SAMPLE(yz, y)),
@@ -63,8 +130,11 @@ float texture_tricubic_single_channel(const sampler3D texture_sampler, const vec
 	return mix(lerped_y.y, lerped_y.x, s_extra.x / (s_extra.x + s_extra.y));
 }
 
-float get_ambient_strength(const vec3 fragment_pos_world_space) {
-	float ao_strength = ambient_occlusion.strength * texture_tricubic_single_channel(ambient_occlusion_sampler, fragment_pos_world_space);
+float get_ambient_strength(const vec3 fragment_pos_world_space, const vec3 normal) {
+	float ao = samples_ao_surface_atlas ? sample_ao_surface_atlas(fragment_pos_world_space, normal) : -1.0f;
+	if (ao < 0.0f) ao = sample_ao_tricubic(fragment_pos_world_space);
+
+	float ao_strength = ambient_occlusion.strength * ao;
 
 	/* This conversion is done manually because there are no sRGB formats
 	for 8-bit textures. TODO: move this calculation to the CPU. */
@@ -0,0 +1,41 @@
+#version 400 core
+
+/* Sector faces are stored as one record per face, which takes up two texels in `faces_sampler`:
+(near x, top y, near z, face info bits), and then (size 0, size 1, 0, 0). Six vertices are drawn per face,
+so `gl_VertexID` gives both the face index and the face corner; and from that, a vertex is made. */
+
+#define VERTICES_PER_FACE 6
+
+uniform usamplerBuffer faces_sampler;
+
+/* These are the face corners in triangle order, as (u, v) pairs. `u` goes along size 0, and
+`v` goes along size 1 (towards the far Z for flat faces, and downwards for vertical faces).
+The first six are for faces with an ID of 0, 2, or 3, and the last six are for ones with an ID of 1 or 4. */
+const uvec2 face_corners[VERTICES_PER_FACE * 2] = uvec2[](
+	uvec2(0u, 1u), uvec2(1u, 0u), uvec2(0u, 0u), uvec2(0u, 1u), uvec2(1u, 1u), uvec2(1u, 0u),
+	uvec2(0u, 0u), uvec2(1u, 0u), uvec2(0u, 1u), uvec2(1u, 0u), uvec2(1u, 1u), uvec2(0u, 1u)
+);
+
+ivec3 get_sector_face_vertex(out uint face_info_bits) {
+	int face_index = gl_VertexID / VERTICES_PER_FACE;
+	uvec4 origin_and_face_info = texelFetch(faces_sampler, face_index * 2);
+	uvec2 face_size = texelFetch(faces_sampler, face_index * 2 + 1).xy;
+
+	face_info_bits = origin_and_face_info.w;
+	uint face_id = face_info_bits & 7u; // Extracting the first 3 bits
+
+	uint corner_index = uint(gl_VertexID % VERTICES_PER_FACE);
+	if (face_id == 1u || face_id == 4u) corner_index += uint(VERTICES_PER_FACE);
+
+	ivec2 corner_offset = ivec2(face_corners[corner_index] * face_size);
+	ivec3 vertex_pos_world_space = ivec3(origin_and_face_info.xyz);
+
+	if (face_id == 0u) vertex_pos_world_space.xz += corner_offset; // Flat
+	else {
+		vertex_pos_world_space.y -= corner_offset.y;
+		if ((face_id & 1u) == 1u) vertex_pos_world_space.z += corner_offset.x; // NS (right or left)
+		else vertex_pos_world_space.x += corner_offset.x; // EW (bottom or top)
+	}
+
+	return vertex_pos_world_space;
+}
@@ -40,7 +40,7 @@ void main(void) {
 		get_csm_shadow_and_volumetric_light(fragment_pos_world_space),
 		lighting_properties, light_color, dir_to_light, albedo_color,
 
-		get_ambient_strength(fragment_pos_world_space),
+		get_ambient_strength(fragment_pos_world_space, fragment_tbn[2]),
 		tone_mapping_max_white, noise_granularity, noise_seed
 	);
 }
@@ -0,0 +1,27 @@
+#version 400 core
+
+// The weights are packed into vec4s. This must equal `max_gpu_blur_kernel_length` in `normal_map_generation.c`.
+#define MAX_BLUR_KERNEL_LENGTH 512
+
+out uint blurred_height;
+
+uniform int blur_radius;
+uniform ivec2 blur_direction; // This is (1, 0) for the horizontal pass, and (0, 1) for the vertical one
+uniform vec4 blur_weights[MAX_BLUR_KERNEL_LENGTH / 4];
+uniform usampler2D heightmap_sampler;
+
+void main(void) {
+	ivec2 center = ivec2(gl_FragCoord.xy), max_pos = textureSize(heightmap_sampler, 0) - 1;
+	uint sum = 0u;
+
+	// Like on the CPU, each weighted height is truncated before being summed up, and the taps are clamped to the edges
+	for (int i = -blur_radius; i <= blur_radius; i++) {
+		int weight_index = i + blur_radius;
+		float weight = blur_weights[weight_index >> 2][weight_index & 3];
+
+		uint height = texelFetch(heightmap_sampler, clamp(center + i * blur_direction, ivec2(0), max_pos), 0).r;
+		sum += uint(float(height) * weight);
+	}
+
+	blurred_height = sum & 255u; // The CPU stores this in a byte
+}
@@ -0,0 +1,9 @@
+#version 400 core
+
+#include "../common/quad_utils.vert"
+
+// Each normal map pass covers its whole output texture, and reads its input with `gl_FragCoord`
+
+void main(void) {
+	gl_Position = vec4(quad_corners[gl_VertexID], 0.0f, 1.0f);
+}
@@ -0,0 +1,16 @@
+#version 400 core
+
+/* The passes here match the CPU normal map generator's math, so that the GPU makes the
+same normal maps. The heights are the average of each albedo pixel's color channels. */
+
+out uint height;
+
+uniform int albedo_layer;
+uniform float heightmap_scale;
+uniform usampler2DArray albedo_sampler; // This has the albedo bytes, unfiltered
+
+void main(void) {
+	uvec3 albedo = texelFetch(albedo_sampler, ivec3(gl_FragCoord.xy, albedo_layer), 0).rgb;
+	uint average = (albedo.r + albedo.g + albedo.b) / 3u;
+	height = uint(min(float(average) * heightmap_scale, 255.0f));
+}
@@ -0,0 +1,41 @@
+#version 400 core
+
+/* This is the Sobel operator, like in `get_normal_map_pixel` on the CPU. The float math is `precise`
+so that it isn't fused into different operations than the CPU's, which matters for the truncation at the end. */
+
+out vec4 normal_map_pixel;
+
+uniform usampler2D heightmap_sampler;
+
+int get_height(ivec2 offset) {
+	ivec2 max_pos = textureSize(heightmap_sampler, 0) - 1;
+	return int(texelFetch(heightmap_sampler, clamp(ivec2(gl_FragCoord.xy) + offset, ivec2(0), max_pos), 0).r);
+}
+
+void main(void) {
+	const float max_byte_value = 255.0f, one_over_max_byte_value = 1.0f / 255.0f, half_max_byte_value = 127.5f;
+
+	int // The top row is the one above in the texture, like on the CPU
+		tl = get_height(ivec2(-1, -1)), tm = get_height(ivec2(0, -1)), tr = get_height(ivec2(1, -1)),
+		ml = get_height(ivec2(-1, 0)), mm = get_height(ivec2(0, 0)), mr = get_height(ivec2(1, 0)),
+		bl = get_height(ivec2(-1, 1)), bm = get_height(ivec2(0, 1)), br = get_height(ivec2(1, 1));
+
+	precise vec3 normal = vec3(
+		(-bl - (ml << 1) - tl) + (tr + (mr << 1) + br),
+		(-tr - (tm << 1) - tl) + (bl + (bm << 1) + br),
+		0.0f
+	);
+
+	precise float
+		gx = normal.x * one_over_max_byte_value,
+		gy = normal.y * one_over_max_byte_value;
+
+	normal.z = sqrt(abs(1.0f - (gx * gx + gy * gy))) * max_byte_value;
+
+	// This normalizes the same way as `glm_vec3_normalize`
+	precise float one_over_length = 1.0f / sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+	normal = normal * one_over_length * half_max_byte_value + half_max_byte_value;
+
+	// The inverse height value goes in the alpha channel, for parallax mapping
+	normal_map_pixel = vec4(uvec4(uvec3(normal), 255 - mm)) / max_byte_value;
+}
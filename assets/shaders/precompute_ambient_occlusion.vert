@@ -4,6 +4,7 @@
 
 // TODO: make this an input in some type of file like `num_cascades.glsl`
 const uint max_num_trace_iters = 2048u;
+const uint max_num_max_height_levels = 9u; // This should be in sync with the same constant in `ambient_occlusion.c`
 
 ////////// Outputs
 
@@ -12,7 +13,7 @@ out int num_collisions;
 ////////// Uniforms
 
 layout(packed) uniform RandDirs {
-	vec3 rand_dirs[max_num_trace_iters];
+	vec3 rand_dirs[max_num_trace_iters]; // These are cosine-weighted around +z
 };
 
 uniform uint
@@ -21,7 +22,10 @@ uniform uint
 
 uniform float float_epsilon;
 
+uniform uint max_height_level_offsets[max_num_max_height_levels], max_height_level_widths[max_num_max_height_levels];
+
 uniform usampler2DRect heightmap_sampler; // Note: other buffer types are too small for all the data needed.
+uniform usamplerBuffer max_heights_sampler; // Each level of the max height pyramid comes one after another in this
 
 /* Current scheme: casting the same rays per each position, with many positions per ray. A lot of branch divergence.
 Alternate scheme: loop through positions in the shader, casting the same ray. That would require less repeated calculations. */
@@ -73,6 +77,55 @@ NormalData compute_normal_data(const uvec3 origin) {
 	return normal_data;
 }
 
+////////// Ray dir code
+
+// This mirrors `get_ao_dir_basis` and `get_world_space_ao_dir` in `ambient_occlusion.c`, so see there for more info
+
+void get_ao_dir_basis(const vec3 normal, out vec3 tangent, out vec3 bitangent) {
+	float normal_sign = (normal.z < 0.0f) ? -1.0f : 1.0f, a = -1.0f / (normal_sign + normal.z), b = normal.x * normal.y * a;
+
+	tangent = vec3(1.0f + normal_sign * normal.x * normal.x * a, normal_sign * b, -normal_sign * normal.x);
+	bitangent = vec3(b, normal_sign + normal.y * normal.y * a, -normal.y);
+}
+
+vec3 get_world_space_ao_dir(const vec3 local_dir, const bool has_valid_normal,
+	const vec3 normal, const vec3 tangent, const vec3 bitangent) {
+
+	float twice_z = 2.0f * local_dir.z;
+
+	vec3 world_space_dir = has_valid_normal
+		? (local_dir.x * tangent + local_dir.y * bitangent + local_dir.z * normal)
+		: vec3(twice_z * local_dir.x, twice_z * local_dir.z - 1.0f, twice_z * local_dir.y);
+
+	// This is to avoid any divisions by zero
+	return mix(world_space_dir, vec3(float_epsilon), equal(world_space_dir, vec3(0.0f)));
+}
+
+////////// Max height code
+
+/* This gives the max height in an area, where the area's bounds are inclusive. It mirrors
+`get_max_height_in_area` in `ambient_occlusion.c`, so see there for more info. */
+int get_max_height_in_area(ivec2 area_start, ivec2 area_end, const ivec2 map_size) {
+	area_start = max(area_start, ivec2(0));
+	area_end = min(area_end, map_size - 1);
+	if (any(greaterThan(area_start, area_end))) return 0;
+
+	ivec2 area_extent = area_end - area_start;
+	int level = findMSB(max(area_extent.x, area_extent.y)) + 1; // The first level where a block is wider than the extent
+
+	ivec2 block_start = area_start >> level, block_end = area_end >> level;
+	int level_offset = int(max_height_level_offsets[level]), level_width = int(max_height_level_widths[level]);
+
+	#define MAX_HEIGHT_AT(x, z) int(texelFetch(max_heights_sampler, level_offset + (z) * level_width + (x)).r)
+
+	return max(
+		max(MAX_HEIGHT_AT(block_start.x, block_start.y), MAX_HEIGHT_AT(block_end.x, block_start.y)),
+		max(MAX_HEIGHT_AT(block_start.x, block_end.y), MAX_HEIGHT_AT(block_end.x, block_end.y))
+	);
+
+	#undef MAX_HEIGHT_AT
+}
+
 ////////// Collision code
 
 bool ray_collides_with_heightmap(const vec3 dir, const uvec3 origin,
@@ -102,6 +155,15 @@ bool ray_collides_with_heightmap(const vec3 dir, const uvec3 origin,
 	ivec3 map_upper_bound = ivec3(map_size);
 	map_upper_bound.xz--;
 
+	////////// Exiting early if the ray starts out above every height that it can reach
+
+	int num_steps = int(max_num_ray_steps);
+	ivec2 reach_end = curr_tile.xz + step_signs.xz * num_steps;
+	int lowest_reachable_y = curr_tile.y - ((step_signs.y == 1) ? 0 : num_steps);
+
+	if (lowest_reachable_y >= get_max_height_in_area(min(curr_tile.xz, reach_end),
+		max(curr_tile.xz, reach_end), map_upper_bound.xz + 1)) return false;
+
 	//////////
 
 	/* Note: for loop unrolling to work, it must be checked if
@@ -145,22 +207,30 @@ void main(void) {
 		return;
 	}
 
+	////////// Exiting early if the point is above every height that any of its rays can reach
+
+	int reach = int(max_num_ray_steps);
+	ivec2 signed_origin_xz = ivec2(origin.xz);
+
+	num_collisions = 0;
+
+	if (int(origin.y) - reach >= get_max_height_in_area(signed_origin_xz - reach - 1,
+		signed_origin_xz + reach, ivec2(map_size.xz))) return;
+
 	bool
 		has_valid_normal = (normal_data.location_status == NORMAL_IS_ON_MAP),
 		is_dual_normal = (normal_data.location_status == NORMAL_IS_DUAL);
 
+	vec3 tangent, bitangent;
+	if (has_valid_normal) get_ao_dir_basis(normal_data.normal, tangent, bitangent);
+
 	////////// Counting the number of collisions
 
 	uint buffer_start = (gl_VertexID % workload_split_factor) * num_traces_per_thread;
 	uint buffer_end = buffer_start + num_traces_per_thread;
 
-	num_collisions = 0;
-
 	for (uint i = buffer_start; i < buffer_end; i++) {
-		vec3 rand_dir = rand_dirs[i]; // This is within a unit circle
-
-		if (has_valid_normal && dot(normal_data.normal, rand_dir) < 0.0f)
-			rand_dir = -rand_dir;
+		vec3 rand_dir = get_world_space_ao_dir(rand_dirs[i], has_valid_normal, normal_data.normal, tangent, bitangent);
 
 		num_collisions += int(ray_collides_with_heightmap(rand_dir, origin, map_size, normal_data.flow, is_dual_normal));
 	}
@@ -1,9 +1,7 @@
 #version 400 core
 
 #include "common/world_shading.vert"
-
-layout(location = 0) in ivec3 vertex_pos_world_space;
-layout(location = 1) in uint face_info_bits;
+#include "common/sector_face.vert"
 
 const struct FaceAttribute {
 	vec3 tangent, normal;
@@ -18,6 +16,9 @@ const struct FaceAttribute {
 void main(void) {
 	////////// Setting `material_index`, `bilinear_percents_index`, `UV`, and the common outputs
 
+	uint face_info_bits;
+	ivec3 vertex_pos_world_space = get_sector_face_vertex(face_info_bits);
+
 	uint face_id = face_info_bits & 7u; // Extracting the first 3 bits
 	FaceAttribute face_attribute = face_attributes[face_id];
 
@@ -1,9 +1,9 @@
 #version 400 core
 
 #include "common/shared_params.glsl"
-
-layout(location = 0) in ivec3 vertex_pos_world_space;
+#include "common/sector_face.vert"
 
 void main(void) {
-	gl_Position = view_projection * vec4(vertex_pos_world_space, 1.0f);
+	uint face_info_bits;
+	gl_Position = view_projection * vec4(get_sector_face_vertex(face_info_bits), 1.0f);
 }
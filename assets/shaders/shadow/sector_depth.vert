@@ -1,7 +1,13 @@
 #version 400 core
 
-layout(location = 0) in ivec3 vertex_pos_world_space;
+#include "../common/shared_params.glsl"
+#include "../common/sector_face.vert"
+
+/* Sector faces are culled for each cascade on the CPU, and then drawn into that
+cascade's depth layer alone; so there's no geometry shader that copies them into each layer. */
+uniform uint cascade_index;
 
 void main(void) {
-	gl_Position = vec4(vertex_pos_world_space, 1.0f);
+	uint face_info_bits;
+	gl_Position = light_view_projection_matrices[cascade_index] * vec4(get_sector_face_vertex(face_info_bits), 1.0f);
 }
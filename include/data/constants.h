@@ -30,13 +30,18 @@ static const GLfloat
 
 // #define TRACK_MEMORY
 // #define DEBUG_AO_MAP_GENERATION
+// #define DEBUG_NORMAL_MAP_GENERATION
 // #define PRINT_SHADER_VALIDATION_LOG
+// #define PRINT_SECTOR_MESHING_STATS
+// #define PRINT_SECTOR_OVERDRAW
+// #define BENCHMARK_SECTOR_REMESHING
+// #define BENCHMARK_AO_BAKING
+// #define BENCHMARK_NORMAL_MAP_GENERATION
 
 //////////
 
 enum { // `enum` is used to make these values compile-time constants
-	components_per_face_vertex_pos = 3,
-	components_per_face_vertex = 4,
+	components_per_face = 8,
 	vertices_per_face = 6,
 
 	vertices_per_triangle = 3,
@@ -3,9 +3,57 @@
 
 #include "rendering/ambient_occlusion.h" // For `AmbientOcclusionMap`
 #include "utils/typedefs.h" // For `Heightmap`
+#include "utils/list.h" // For `List`
+#include "rendering/entities/sector.h" // For `SectorGeometryKey`
+#include "utils/content_hash.h" // For `content_hash_t`
+#include "utils/mapped_file.h" // For `MappedFile`
+
+/* The cache file is a container of sections. It starts with a header, which has a magic number, a format version,
+an endianness marker, and the number of sections; and that's followed by a table of contents, which has each
+section's type, key, offset, size, and content hash. After that comes the data of each section, where each section
+starts on a page boundary.
+
+The sector geometry is compressed with whichever codec in `compression.h` makes it the smallest, or it's left
+uncompressed if none of them make it at least a quarter smaller. The AO map is always left uncompressed, in a form
+that has the same data as its textures. The file is mapped into memory rather than read, so the AO map's textures are
+uploaded straight from its pages, and an uncompressed sector geometry is used from them as is; while a compressed one
+is decompressed from them, without the file being copied onto the heap first. The mapping is kept until
+`deinit_level_cache_file`, and the file is only ever replaced through a rename, so the mapping stays valid even if
+the file is rewritten before that.
+
+A section's key hashes everything that its data depends on (like the level's maps, and the settings that the data is
+made with), so the cache stays valid if the level file is only touched, or if unrelated parts of it change. A section
+is only used if its key matches the expected one, and if its data matches its content hash; any other section is
+rebuilt on its own, while the valid ones are kept. If the header doesn't match (like for a file from an older
+version, or from a machine with a different byte order), every section is rebuilt.
+
+There are two sections: the ambient occlusion data, and the sector geometry. The sector geometry is empty if the
+cache doesn't have a valid copy of it, and in that case, it can be saved with `save_sector_geometry_in_level_cache`
+after meshing. If the ambient occlusion data is missing or invalid, the AO map is baked progressively over the next
+frames instead, and the cache is pending until then. The cache file is only written once the AO map is complete,
+through `update_pending_level_cache`, which should be called once per frame; and any sector geometry that's
+saved (or read from the cache) before that is kept in memory, to be written along with it. */
+
+typedef enum {
+	LevelCacheSectionAmbientOcclusion,
+	LevelCacheSectionSectorGeometry,
+	num_level_cache_section_types
+} LevelCacheSectionType;
+
+typedef struct {
+	ProgressiveAOBake ao_bake;
+	char* const cache_path;
+	const content_hash_t section_keys[num_level_cache_section_types];
+	List sector_geometry; // This is empty until there's sector geometry to save
+} PendingLevelCache;
 
 typedef struct {
 	AmbientOcclusionMap ao_map;
+	// This points into the mapped file, or into its decompressed data; so it's read-only, and valid until `deinit_level_cache_file`
+	List sector_geometry;
+	void* decompressed_sector_geometry; // This is `NULL` if the sector geometry isn't compressed
+	MappedFile mapped_file;
+	PendingLevelCache* pending; // This is `NULL` if the cache was complete, and else, it should be freed with `deinit_pending_level_cache`
 } LevelCache;
 
 typedef struct {
@@ -14,11 +62,19 @@ typedef struct {
 		const map_pos_component_t max_y;
 		const AmbientOcclusionComputeConfig* const compute_config;
 	} ambient_occlusion;
+
+	// The sector geometry is also made from the heightmap above
+	const struct {
+		const SectorGeometryKey key;
+		const map_texture_id_t* const texture_id_map_data;
+	} sector_geometry;
 } LevelCacheConfig;
 
 /* Excluded:
-get_cache_path_from_level_path, get_last_file_modification_time,
-create_cache, fail_for_cache_operation, parse_cache */
+get_cache_path_from_level_path, fail_for_cache_operation, get_level_cache_section_keys, init_byte_list_copy,
+find_level_cache_section, find_level_cache_sections, decompress_level_cache_section,
+compress_level_cache_section, align_level_cache_offset, write_zeroes_to_cache,
+write_level_cache_sections, init_pending_level_cache */
 
 /* TODO:
 - Should the input be a `GLchar`?
@@ -27,4 +83,15 @@ create_cache, fail_for_cache_operation, parse_cache */
 
 LevelCache get_level_cache(const char* const level_path_unprefixed, const LevelCacheConfig* const config);
 
+// If the cache is pending, this keeps a copy of the sector geometry, which is written once the cache is complete
+void save_sector_geometry_in_level_cache(const char* const level_path_unprefixed,
+	const LevelCacheConfig* const config, PendingLevelCache* const pending_cache, const List* const sector_geometry);
+
+// This unmaps the cache file, and frees its decompressed data; after this, the cache's sector geometry can't be used
+void deinit_level_cache_file(const LevelCache* const cache);
+
+// This returns true once the AO map is complete, and the cache file is written
+bool update_pending_level_cache(PendingLevelCache* const pending_cache, const AmbientOcclusionMap* const ao_map);
+void deinit_pending_level_cache(PendingLevelCache* const pending_cache);
+
 #endif
@@ -12,6 +12,7 @@
 #include "rendering/dynamic_light.h" // For `DynamicLight`
 #include "rendering/shadow.h" // For `CascadedShadowContext`
 #include "rendering/ambient_occlusion.h" // For `AmbientOcclusionMap`
+#include "level_cache.h" // For `PendingLevelCache`
 #include "rendering/entities/skybox.h" // For `Skybox`
 #include "rendering/entities/title_screen.h" // For `TitleScreen`
 #include "audio.h" // For `AudioContext`
@@ -57,17 +58,20 @@ typedef struct {
 	const MaterialsTexture materials_texture;
 
 	WeaponSprite weapon_sprite;
-	const SectorContext sector_context;
+	SectorContext sector_context;
 	BillboardContext billboard_context;
 
 	DynamicLight dynamic_light;
 	CascadedShadowContext shadow_context;
 	const AmbientOcclusionMap ao_map;
+	PendingLevelCache* pending_level_cache; // This is `NULL` once the AO map is fully baked
 
 	const Skybox skybox;
 	TitleScreen title_screen;
 
+	// These are kept for remeshing sectors after edits to the maps
 	const Heightmap heightmap;
+	const map_texture_id_t* const texture_id_map_data;
 } LevelContext;
 
 // This state persists across levels
@@ -5,7 +5,11 @@
 in the heightmap (from the lowest to the highest point) intersect with any level geometry. */
 
 #include "glad/glad.h" // For OpenGL defs
+#include "cglm/cglm.h" // For `vec3`
 #include "utils/typedefs.h" // For various typedefs
+#include "utils/uniform_buffer.h" // For `UniformBuffer`
+#include "utils/content_hash.h" // For `content_hash_t`
+#include "data/constants.h" // For `BENCHMARK_AO_BAKING`
 
 //////////
 
@@ -41,17 +45,143 @@ typedef struct {
 	const workload_split_factor_t workload_split_factor;
 	const trace_count_t num_trace_iters;
 	const ray_step_count_t max_num_ray_steps;
+
+	/* This bakes on the CPU instead, over all cores; that doesn't need a GPU. With `DEBUG_AO_MAP_GENERATION`,
+	both backends bake identical data for the shipped levels and a 255x255 test map on Mesa's llvmpipe. Other
+	drivers don't have to do the shader's divisions and `normalize` exactly, so a ray can hit on one backend and
+	miss on the other; that changes a value by 255 / `num_trace_iters` per ray. The workload split factor only
+	applies to the GPU. */
+	const bool bake_on_cpu;
+
+	/* This caps the size of the buffer that the GPU writes its results to, which it does in chunks of rows;
+	if one row's results don't fit in it, the chunks have one row each. Each chunk is also capped by its number of
+	rays, which keeps its buffer at 16 MB at most, so this only has an effect below 16. */
+	const uint16_t max_gpu_chunk_megabytes;
+
+	// This also bakes a surface atlas for sector faces (see `ambient_occlusion.c`), which is always baked on the CPU
+	const bool bake_surface_atlas;
 } AmbientOcclusionComputeConfig;
 
 //////////
 
+/* The AO map is stored sparsely, as bricks of 8x8x8 voxels. An indirection texture has an entry for each brick,
+which is either the value of a brick that only has one value (like the ones under the map, or far enough above it
+that no ray can reach the map), or the index of the brick's slot in a brick pool texture. Each brick in the pool also
+holds the first voxels of the bricks after it on each axis, so that linear filtering never reads across bricks.
+Both textures use the AO map's axis order, which is x, z, and then y. */
+
+enum {
+	ao_brick_size = 8,
+	ao_padded_brick_size = ao_brick_size + 1,
+	num_ao_pool_bricks_across = 16 // The pool is this many bricks across its width and height, and it grows in depth
+};
+
+typedef uint32_t ao_brick_entry_t;
+
 typedef struct {
-	GLuint texture;
+	GLuint indirection_texture, brick_pool_texture;
+	GLuint surface_atlas_texture, wall_tile_texture; // These are 0 if the level has no surface atlas
 } AmbientOcclusionMap;
 
-/* Excluded: generate_rand_dir, get_ao_term_from_collision_count, ray_collides_with_heightmap,
-sign_between_map_values, clamp_signed_byte_to_directional_range, get_normal_data, transform_feedback_hook,
-set_unpack_alignment, save_and_set_unpack_alignment, init_ao_map_texture */
+// This holds the same data as the AO map's textures, for writing to them, and for testing lookups without a GPU
+typedef struct {
+	const buffer_size_t size[3], num_bricks[3]; // In voxels and in bricks, in the AO map's axis order
+	ao_brick_entry_t* const indirection;
+
+	ao_value_t* brick_pool; // This has the same layout as the brick pool texture
+	buffer_size_t num_pool_slabs, num_pool_slots_used; // A slab is one layer of bricks along the pool's depth
+} AOBrickVolume;
+
+// See `ambient_occlusion.c` for more info on the surface atlas
+enum {ao_surface_atlas_texels_per_unit = 2};
+
+// An atlas position, the bottom height of a wall, and its height in texels (which is 0 if there's no wall there)
+typedef uint16_t ao_wall_tile_entry_t[4];
+
+typedef struct {
+	const map_pos_xz_t map_size;
+	const buffer_size_t size[2]; // In texels
+	ao_wall_tile_entry_t* const wall_tile_entries;
+
+	/* For each cell of the atlas (one unit squared), this is the index of the wall tile entry that it's in, in
+	row-major order. Cells in top tiles or in no tile have no owner, which is marked with the max owner value. */
+	buffer_size_t* const cell_owners;
+} AOSurfaceAtlasLayout;
+
+// See `ambient_occlusion.c` for more info on this
+enum {max_num_max_height_levels = 9}; // A 255x255 heightmap goes down to 1x1 in 8 halvings
+
+typedef struct {
+	map_pos_component_t* data; // The levels come one after another, each one in row-major order
+	buffer_size_t level_offsets[max_num_max_height_levels];
+	map_pos_xz_t level_sizes[max_num_max_height_levels];
+	byte num_levels;
+} MaxHeightPyramid;
+
+typedef struct {
+	const GLuint
+		shader, vertex_spec, heightmap_texture,
+		max_height_buffer, max_height_texture, transform_feedback_buffer;
+
+	const UniformBuffer rand_dirs_ubo;
+} GPUAOBakingContext;
+
+/* A progressive AO bake spreads the baking of an AO map over many frames, so that a level can start before its
+AO map is done. The AO map starts out flat (unoccluded over the map, and black under it), and each frame, a chunk
+of rows along x of the AO volume is baked, and the bricks that it touched are rewritten in the AO map. On the GPU,
+one chunk is in flight at a time, and a fence for it is polled each frame, so no frame waits on the GPU; and on the
+CPU, rows are baked on the worker pool until the frame's time budget runs out. */
+typedef struct {
+	const Heightmap heightmap;
+	const map_pos_component_t max_y;
+	const AmbientOcclusionComputeConfig compute_config;
+
+	vec3* const rand_dirs;
+	const MaxHeightPyramid max_height_pyramid;
+	ao_value_t* const ao_data; // Chunks are written to this as they finish, so it's complete once the bake is
+	AOBrickVolume brick_volume; // The bricks that the finished chunks touch are rebuilt from `ao_data`
+
+	// The surface atlas is baked after the volume, and it's written to the AO map all at once when it's done
+	const AOSurfaceAtlasLayout surface_atlas_layout;
+	buffer_size_t next_surface_atlas_job;
+
+	const buffer_size_t num_rows, num_rows_per_gpu_chunk;
+	buffer_size_t next_row, first_row_in_flight;
+
+	const GPUAOBakingContext gpu_context; // This is only used when baking on the GPU
+	GLsync chunk_in_flight_fence; // This is `NULL` when no chunk is in flight
+} ProgressiveAOBake;
+
+/* Excluded: hash_ao_sampling_seed, get_cosine_weighted_dir, get_cosine_weighted_sobol_dir,
+get_ao_term_from_collision_count, get_num_ao_volume_values, sign_between_map_values,
+clamp_signed_byte_to_directional_range, get_normal_data, get_ao_dir_basis, get_world_space_ao_dir,
+init_max_height_pyramid, deinit_max_height_pyramid, get_max_height_in_area, init_ao_ray_lane_from_floating_origin,
+init_ao_ray_lane, count_ao_ray_lane_collisions, bake_ao_value_on_cpu, cpu_ao_baking_job, bake_ao_map_on_cpu,
+transform_feedback_hook, set_unpack_alignment, save_and_set_unpack_alignment, get_num_rows_per_gpu_chunk,
+init_gpu_ao_baking_context, deinit_gpu_ao_baking_context, dispatch_gpu_ao_baking_chunk, read_gpu_ao_baking_chunk,
+bake_ao_map_on_gpu, init_rand_dirs, print_ao_map_differences, init_independent_rand_dirs, print_ao_sampling_errors,
+get_ao_brick_index, get_ao_brick_pool_voxel, write_ao_brick, write_ao_brick_layers, get_ao_brick_volume_size,
+upload_ao_brick_pool, init_ao_map_from_brick_volume, upload_ao_brick_layers, get_ao_wall_tile_entry_index,
+compare_ao_wall_tiles_to_pack, get_num_ao_surface_atlas_spans_per_row, get_num_ao_surface_atlas_jobs,
+bake_ao_surface_value_on_cpu, bake_ao_surface_atlas_cell, ao_surface_atlas_baking_job, bake_ao_surface_atlas_on_cpu,
+upload_ao_surface_atlas, init_ao_surface_atlas_textures, write_ao_map_slices,
+run_jobs_on_worker_pool_within_frame_budget, update_progressive_ao_volume_bake,
+update_progressive_ao_surface_atlas_bake, get_num_ao_surface_atlas_bytes */
+
+/* The AO data has the AO volume, and then the surface atlas's texels if it's baked. The functions below that take
+a surface atlas layout take `NULL` for it if the atlas isn't baked, so that a caller only has to make it once. */
+
+// This is the number of values in the AO data
+buffer_size_t get_num_ao_values(const Heightmap heightmap, const map_pos_component_t max_y,
+	const AOSurfaceAtlasLayout* const surface_atlas_layout);
+
+// This hashes everything that the AO data depends on, so that cached AO data can be checked against it
+content_hash_t get_ao_data_key(const Heightmap heightmap, const map_pos_component_t max_y,
+	const AmbientOcclusionComputeConfig* const compute_config);
+
+// This only bakes the AO data, without making a texture. The data should be freed with `dealloc`.
+ao_value_t* bake_ao_map_data(const Heightmap heightmap, const map_pos_component_t max_y,
+	const AmbientOcclusionComputeConfig* const compute_config, const AOSurfaceAtlasLayout* const surface_atlas_layout);
 
 AmbientOcclusionMap init_ao_map_with_copy_on_cpu(
 	const Heightmap heightmap, const map_pos_component_t max_y,
@@ -61,8 +191,49 @@ AmbientOcclusionMap init_ao_map_with_copy_on_cpu(
 AmbientOcclusionMap init_ao_map_from_cpu_copy(
 	const Heightmap heightmap,
 	const map_pos_component_t max_y,
+	const AOSurfaceAtlasLayout* const surface_atlas_layout,
 	const ao_value_t* const cpu_data);
 
 void deinit_ao_map(const AmbientOcclusionMap* const ao_map);
 
+// `ao_data` is in the same layout as the data from `bake_ao_map_data`
+AOBrickVolume init_ao_brick_volume(const Heightmap heightmap,
+	const map_pos_component_t max_y, const ao_value_t* const ao_data);
+
+void deinit_ao_brick_volume(const AOBrickVolume* const volume);
+
+// These are lookups that mirror the shader's, where positions are in the AO map's axis order
+ao_value_t fetch_from_ao_brick_volume(const AOBrickVolume* const volume, const buffer_size_t pos[3]);
+GLfloat sample_ao_brick_volume(const AOBrickVolume* const volume, const vec3 pos);
+
+AOSurfaceAtlasLayout init_ao_surface_atlas_layout(const Heightmap heightmap);
+void deinit_ao_surface_atlas_layout(const AOSurfaceAtlasLayout* const layout);
+
+// This makes the flat AO map that the bake writes to. The bake should be freed with `deinit_progressive_ao_bake`.
+ProgressiveAOBake init_progressive_ao_bake(const Heightmap heightmap, const map_pos_component_t max_y,
+	const AmbientOcclusionComputeConfig* const compute_config, AmbientOcclusionMap* const flat_ao_map);
+
+// This should be called once per frame, and it returns true once the whole AO map is baked
+bool update_progressive_ao_bake(ProgressiveAOBake* const bake, const AmbientOcclusionMap* const ao_map);
+void deinit_progressive_ao_bake(const ProgressiveAOBake* const bake);
+
+/* This gives back a finished bake's AO map in the form that it's cached in, which has the same data as the AO map's
+textures (see `ambient_occlusion.c`). It should be freed with `dealloc`. */
+byte* init_cached_form_of_ao_bake(const ProgressiveAOBake* const bake, size_t* const num_bytes);
+
+/* This makes an AO map by uploading its textures straight from the cached form, which should start at an address aligned
+for `ao_brick_entry_t`. If the cached form doesn't fit the map, this returns false without making any textures. */
+bool init_ao_map_from_cached_form(const Heightmap heightmap, const map_pos_component_t max_y,
+	const AOSurfaceAtlasLayout* const surface_atlas_layout, const byte* const cached_form,
+	const size_t num_bytes, AmbientOcclusionMap* const ao_map);
+
+#ifdef DEBUG_AO_MAP_GENERATION
+void check_gpu_ao_chunking(void);
+#endif
+
+#ifdef BENCHMARK_AO_BAKING
+void benchmark_ao_baking(const Heightmap heightmap, const map_pos_component_t max_y,
+	const AmbientOcclusionComputeConfig* const compute_config);
+#endif
+
 #endif
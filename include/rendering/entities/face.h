@@ -17,4 +17,6 @@ but in the case of shadow-casting sectors, the map edges should cast shadows. So
 another mesh for just the map edges that will provide correct map-edge shadows for the level. */
 List init_map_edge_mesh(const Heightmap heightmap);
 
+void get_face_aabb(const face_mesh_t face, vec3 aabb[2]);
+
 #endif
@@ -0,0 +1,62 @@
+#ifndef METASECTOR_TREE_H
+#define METASECTOR_TREE_H
+
+#include "glad/glad.h" // For OpenGL defs
+#include "cglm/cglm.h" // For `vec3`, and `vec4`
+#include "utils/typedefs.h" // For `buffer_size_t`, and `map_pos_xz_t`
+#include "utils/list.h" // For `List`
+#include "utils/bitarray.h" // For `BitArray`
+
+/* A metasector is a bounding box over a group of nearby sectors. The metasector tree is a binary r-tree of these,
+built by splitting each group in half along the longer axis of its bounds. Culling with it accepts a whole
+subtree if its box is fully in the view frustum, and rejects a whole subtree if its box is fully outside of it.
+
+The sectors of a subtree are usually not neighbors in the sector list, so culling marks visible sectors in
+a bitarray, and then walks that bitarray in sector list order to find the runs of visible sectors. That keeps
+the same order as before (which the overdraw ordering relies on), and each run can be copied with one `memcpy`.
+
+The nodes are allocated from one pool, in pre-order; a node's left child directly follows it, and
+`right_child_index` says where its right child is. Leaves have a right child index of 0. Each node
+owns a range of `sector_indices`, which maps from tree order to sector list order.
+
+Remeshing can change sectors after the tree is built. Changed sectors keep their place in the list, and the
+tree's boxes are refit to them; and sectors that are added are put after the ones in the tree, as loose
+sectors that culling tests one by one. There can be up to `max_num_loose_sectors` of those. */
+
+typedef struct {
+	vec3 aabb[2];
+	buffer_size_t first_index, num_sectors, right_child_index;
+} Metasector;
+
+typedef struct {
+	Metasector* const nodes;
+	buffer_size_t* const sector_indices;
+	const BitArray visible_sectors;
+	const buffer_size_t num_nodes, num_sectors, max_num_loose_sectors;
+} MetasectorTree;
+
+/* This is called with the index of the first sector in a run of visible sectors,
+and how many there are. Runs are always given in sector list order. */
+typedef void (*visible_sector_run_callback_t) (void* const callback_data,
+	const buffer_size_t first_sector_index, const buffer_size_t num_sectors);
+
+/* Excluded: get_aabb_frustum_overlap, sector_is_empty, get_sector_aabb, compare_sector_centers,
+build_metasector_subtree, metasector_overlaps_area, refit_metasector_subtree, mark_visible_sectors_in_subtree,
+mark_visible_loose_sectors, give_visible_sector_runs_to_callback */
+
+MetasectorTree init_metasector_tree(const List* const sectors, const buffer_size_t max_num_loose_sectors);
+
+/* This makes a tree out of the nodes and sector indices of one that was built before (which is for loading one from
+the level cache). It takes ownership of both arrays, and `sector_indices` must have room for `num_sectors + 1` indices. */
+MetasectorTree init_metasector_tree_from_nodes(Metasector* const nodes, const buffer_size_t num_nodes,
+	buffer_size_t* const sector_indices, const buffer_size_t num_sectors, const buffer_size_t max_num_loose_sectors);
+void deinit_metasector_tree(const MetasectorTree* const metasector_tree);
+
+void refit_metasector_tree(const MetasectorTree* const metasector_tree, const List* const sectors,
+	const map_pos_xz_t area_start, const map_pos_xz_t area_end);
+
+void for_each_visible_sector_run(const MetasectorTree* const metasector_tree,
+	const List* const sectors, const vec4* const frustum_planes,
+	const visible_sector_run_callback_t callback, void* const callback_data);
+
+#endif
@@ -9,12 +9,18 @@
 #include "level_config.h" // For `MaterialPropertiesPerObjectType`
 #include "utils/normal_map_generation.h" // For `NormalMapCreator`
 #include "rendering/dynamic_light.h" // For `DynamicLightConfig`
+#include "rendering/entities/metasector_tree.h" // For `MetasectorTree`
+#include "rendering/entities/sector_lod.h" // For `SectorLOD`
+#include "utils/bitarray.h" // For `BitArray`
+#include "rendering/shadow.h" // For `CascadedShadowContext`
+#include "data/constants.h" // For `BENCHMARK_SECTOR_REMESHING`
 
 //////////
 
-// These definitions are in the header so that `face.c` can use them too
-typedef map_pos_component_t face_vertex_t[components_per_face_vertex];
-typedef face_vertex_t face_mesh_t[vertices_per_face];
+/* This definition is in the header so that `face.c` can use it too. A face is one compact record of
+{near x, top y, near z, face info bits, size 0, size 1, 0, 0}, and the sector vertex shaders expand it
+into `vertices_per_face` vertices by fetching it from a buffer texture via `gl_VertexID`. */
+typedef map_pos_component_t face_mesh_t[components_per_face];
 
 typedef struct {
 	const map_pos_xz_t origin;
@@ -24,36 +30,139 @@ typedef struct {
 	struct {buffer_size_t start, length;} face_range; // Face domain that defines sector's faces; used for batching
 } Sector;
 
+/* Visible sectors are drawn front to back, so that the depth prepass can reject as much as possible.
+For that, sectors are kept in two orders, one sorted on the x axis first, and one sorted on the z axis first;
+and each order has its own metasector tree, since culling gives back runs of sectors in list order.
+
+Each ordering has its own section of the face mesh, starting at `face_section.start`. The faces past the first
+`face_section.num_used` in it are spare room for the faces of remeshed sectors. */
+typedef struct {
+	List sectors;
+	MetasectorTree metasector_tree;
+	struct {buffer_size_t start, num_used;} face_section;
+} SectorOrdering;
+
+/* The shadow mesh is split into chunks of nearby faces, so that each shadow cascade only draws the chunks in its bounds.
+Each chunk has room for `max_num_faces` faces, so that remeshing can rewrite a chunk without moving the others. */
+typedef struct {
+	vec3 aabb[2];
+	buffer_size_t first_face, num_faces, max_num_faces;
+} ShadowMeshChunk;
+
+/* The sector geometry in the level cache is only used if its key matches this, since the geometry depends on
+these settings, along with the level's maps (which the level cache hashes alongside this). */
+typedef struct {
+	byte format_version, try_both_axes, tile_size, trimmed_face_ids;
+	map_pos_xz_t map_size;
+} SectorGeometryKey;
+
 typedef struct {
 	const Drawable drawable;
+	const GLuint face_buffer_texture; // This views the drawable's vertex buffer
 
-	/* There's info on why there's a separate vertex buffer + spec in the
+	/* There's info on why there's a separate face buffer in the
 	comment above `init_trimmed_face_mesh_for_shadow_mapping`. */
 	const struct {
-		const GLsizei num_vertices;
-		const GLuint vertex_buffer, vertex_spec, depth_shader;
+		const GLuint face_buffer, face_buffer_texture, depth_shader;
+		const struct {const GLint cascade_index;} depth_uniform_ids;
+
+		const byte trimmed_face_ids; // Bit `i` is set if faces with a face id of `i` are kept in the shadow mesh
+
+		const buffer_size_t num_chunks;
+		ShadowMeshChunk* const chunks;
+
+		// Culling for each cascade fills these in with the vertex ranges of runs of chunks, for `glMultiDrawArrays`
+		GLint* const run_first_vertices;
+		GLsizei* const run_vertex_counts;
 	} shadow_mapping;
 
 	const GLuint depth_prepass_shader;
 
-	const List mesh_cpu, sectors;
+	/* The face mesh has a section of faces for each sector ordering, one after the other, and both sections
+	are the same size. Remeshing patches the face mesh and the orderings; and when they run out of spare room,
+	they're rebuilt from the maps. */
+	List mesh_cpu;
+	SectorOrdering sector_orderings[2]; // Indexed by the major axis of the ordering (0 = x, and 1 = z)
+
+	// A nonzero tile size keeps sectors from crossing the borders of square tiles with sides that long
+	struct {const bool try_both_axes; const map_pos_component_t tile_size; byte major_axis;} meshing;
+
+	/* If this is enabled, the whole face mesh lives on the GPU, and culling only fills in
+	these arrays with the vertex ranges of visible sector runs, for `glMultiDrawArrays`. */
+	struct {
+		const bool enabled;
+		GLint* run_first_vertices;
+		GLsizei* run_vertex_counts;
+	} static_mesh_draw_list;
+
+	/* If this is enabled, the tiles that are far enough from the camera are drawn with
+	their coarser meshes from `tiles`, rather than as sectors. This only affects the main
+	view; the shadow mesh always has every sector's faces, so that shadows don't shift. */
+	struct {
+		const bool enabled;
+		SectorLOD tiles;
+		const GLuint face_buffer_texture; // This views the tiles' face buffer
+	} lod;
 } SectorContext;
 
 /* Excluded:
-point_matches_sector_attributes, form_sector_area,
-generate_sectors_and_face_mesh_from_maps, init_trimmed_face_mesh_for_shadow_mapping,
-frustum_cull_sector_faces_into_gpu_buffer, define_vertex_spec */
+point_matches_sector_attributes, get_end_of_sector_tile, form_sector_area, generate_sectors_and_face_mesh_for_band,
+sector_meshing_band_job, generate_sectors_and_face_mesh_along_axis, compare_sector_origins, compare_sector_origins_x_first,
+reorder_face_mesh_to_match_sectors, generate_sectors_and_face_mesh_from_maps, get_face_capacity_with_spare_room,
+init_x_major_sector_ordering, get_num_shadow_mesh_chunks_across, get_shadow_mesh_chunk_index, init_shadow_mesh_chunks,
+get_trimmed_face_ids, add_trimmed_faces_in_chunks_to_list, check_face_buffer_texture_size,
+init_trimmed_face_mesh, upload_trimmed_face_mesh, init_trimmed_face_mesh_for_shadow_mapping, remesh_shadow_mesh_chunks,
+upload_face_mesh, init_sector_geometry, deinit_sector_geometry, write_sector_geometry_list,
+sector_geometry_reader_has_items, read_sector_geometry_bytes, read_sector_geometry_count, read_sector_geometry_list,
+init_sector_geometry_from_cache,
+sector_overlaps_area, get_removed_sector_indices, upload_remeshed_faces, place_remeshed_sectors_in_ordering,
+aabb_is_within_side_planes, cull_shadow_mesh_chunks_into_draw_list, get_end_of_visible_sector_span,
+copy_visible_sector_run_into_gpu_buffer, frustum_cull_sector_faces_into_gpu_buffer,
+add_visible_sector_run_to_draw_list, frustum_cull_sector_faces_into_draw_list, get_front_to_back_sector_ordering,
+print_sector_depth_prepass_overdraw, define_vertex_spec, init_face_buffer_texture, use_sector_face_buffer_texture */
+
+/* This meshes the points in an area (where `area_end` is exclusive) that aren't set in `traversed_points`, and appends
+the sectors and their faces to the given lists. Sectors are formed along the major axis first (0 = x, and 1 = z),
+and if `tile_size` is nonzero, they don't cross the borders of square tiles with sides that long. */
+void generate_sectors_and_face_mesh_in_area(List* const sectors, List* const face_mesh,
+	const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data,
+	const BitArray traversed_points, const byte major_axis, const map_pos_component_t tile_size,
+	const map_pos_xz_t area_start, const map_pos_xz_t area_end);
+
+SectorGeometryKey get_sector_geometry_key(const Heightmap heightmap,
+	const bool try_both_sector_meshing_axes, const bool use_lod,
+	const DynamicLightConfig* const dynamic_light_config);
 
+// This flattens the face mesh, the sector orderings, and the shadow mesh into bytes, for the level cache
+List serialize_sector_geometry(const SectorContext* const sector_context, const Heightmap heightmap);
+
+/* If `cached_geometry` is nonempty, the sector geometry is read from it (it should come from
+`serialize_sector_geometry`, with a matching key), rather than being meshed from the maps. If it turns out
+to be malformed, the sectors are meshed anyway, and its length is set to zero, so that the caller saves
+the new geometry like it would if the cache had none. */
 SectorContext init_sector_context(
 	const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data,
-	const GLchar* const* const texture_paths, const texture_id_t num_textures,
+	const bool try_both_sector_meshing_axes, const bool use_static_mesh, const bool use_lod,
+	List* const cached_geometry, const GLchar* const* const texture_paths, const texture_id_t num_textures,
 	const MaterialPropertiesPerObjectType* const shared_material_properties,
 	const NormalMapCreator* const normal_map_creator,
 	const DynamicLightConfig* const dynamic_light_config);
 
 void deinit_sector_context(const SectorContext* const sector_context);
 
-void draw_sectors_to_shadow_context(const SectorContext* const sector_context);
+/* This is for after the heightmap or texture id map have been edited in an area. It remeshes only the sectors that
+overlap the area, or that border it (since their side faces depend on it), and it patches their faces into the face
+mesh and the shadow mesh in place, uploading only the changed parts. */
+void remesh_sectors_in_area(SectorContext* const sector_context,
+	const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data,
+	const map_pos_xz_t area_origin, const map_pos_xz_t area_size);
+
+#ifdef BENCHMARK_SECTOR_REMESHING
+void benchmark_sector_remeshing(SectorContext* const sector_context,
+	const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data);
+#endif
+
+void draw_sectors_to_shadow_context(const SectorContext* const sector_context, const CascadedShadowContext* const shadow_context);
 void draw_sectors(const SectorContext* const sector_context, const Camera* const camera);
 
 #endif
@@ -0,0 +1,64 @@
+#ifndef SECTOR_LOD_H
+#define SECTOR_LOD_H
+
+#include "glad/glad.h" // For OpenGL defs
+#include "cglm/cglm.h" // For `vec3`, and `vec4`
+#include "utils/typedefs.h" // For various typedefs
+#include "utils/list.h" // For `List`
+
+/* Far from the camera, sector faces take up very little of the screen, so the sectors there are drawn with coarser
+meshes. For that, the map is split into square tiles, and each frame, each tile gets a level of detail based on how
+far it is from the camera. Level 0 is the regular sector mesh, and sectors never cross tile borders when this is
+used. Each level after that is meshed with the regular sector generator, from a max-heightmap where each square
+block of `2^level` points takes on the height (and texture id) of its highest point; so a coarse level is never
+lower than level 0, and nothing sinks into the ground as the camera moves away from it.
+
+Each tile is meshed on its own for each coarse level, against the level 0 heights right outside of it. That way,
+the walls on a tile's borders reach down to the lowest heights that any level of the neighboring tiles can have,
+and so there are never cracks between neighboring tiles with different levels. */
+
+enum {sector_lod_tile_size = 32, num_sector_lod_levels = 4};
+
+typedef struct {
+	vec3 aabb[2]; // This bounds the tile's faces for every coarse level
+
+	// The tile's faces for each coarse level come one after the other, starting at `first_face`
+	buffer_size_t first_face, max_num_faces, num_faces[num_sector_lod_levels - 1]; // Indexed by the level minus one
+} SectorLODTile;
+
+typedef struct {
+	List mesh_cpu; // Each tile has a range of faces in this, with spare room for remeshing
+	const GLuint face_buffer;
+
+	const buffer_size_t num_tiles_across, num_tiles_down;
+	SectorLODTile* const tiles;
+	byte* const tile_levels; // Each frame, this gets the level of detail of each tile
+
+	// Culling fills these in with the vertex ranges of the visible tiles with a coarse level, for `glMultiDrawArrays`
+	GLint* const run_first_vertices;
+	GLsizei* const run_vertex_counts;
+} SectorLOD;
+
+/* Excluded:
+get_num_sector_lod_tiles_across, init_max_heightmap_for_sector_lod_tile, mesh_sector_lod_tile,
+get_sector_lod_tile_area, set_sector_lod_tile_aabb, mesh_all_sector_lod_tiles, get_distance_to_sector_lod_tile */
+
+SectorLOD init_sector_lod(const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data);
+void deinit_sector_lod(const SectorLOD* const sector_lod);
+
+// This remeshes the tiles that depend on the heights or texture ids in an area, where `area_end` is exclusive
+void remesh_sector_lod_tiles_in_area(SectorLOD* const sector_lod,
+	const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data,
+	const map_pos_xz_t area_start, const map_pos_xz_t area_end);
+
+void update_sector_lod_tile_levels(const SectorLOD* const sector_lod, const vec3 camera_pos);
+
+GLsizei cull_sector_lod_tiles_into_draw_list(const SectorLOD* const sector_lod,
+	const vec3 camera_pos, const vec4* const frustum_planes);
+
+// This gives the level of detail of the tile that a map point is in, as of the last `update_sector_lod_tile_levels`
+static inline byte get_sector_lod_level_at(const SectorLOD* const sector_lod, const map_pos_xz_t pos) {
+	return sector_lod -> tile_levels[(pos.z / sector_lod_tile_size) * sector_lod -> num_tiles_across + pos.x / sector_lod_tile_size];
+}
+
+#endif
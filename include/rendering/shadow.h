@@ -34,6 +34,9 @@ typedef struct {
 		framebuffer, depth_layers,
 		plain_depth_sampler, depth_comparison_sampler;
 
+	// These each have one depth layer attached, for geometry that's culled per cascade on the CPU
+	GLuint* const cascade_framebuffers;
+
 	const uint16_t resolution;
 	const byte num_cascades;
 	const GLfloat sub_frustum_scale;
@@ -53,6 +56,8 @@ void update_shadow_context(const CascadedShadowContext* const shadow_context,
 	const Camera* const camera, const vec3 dir_to_light, const GLfloat aspect_ratio);
 
 void enable_rendering_to_shadow_context(const CascadedShadowContext* const shadow_context);
+void enable_rendering_to_shadow_cascade(const CascadedShadowContext* const shadow_context, const byte cascade_index);
+void enable_rendering_to_all_shadow_cascades(const CascadedShadowContext* const shadow_context);
 void disable_rendering_to_shadow_context(const GLint screen_size[2]);
 
 #endif
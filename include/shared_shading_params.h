@@ -35,6 +35,7 @@ void update_shared_shading_params(SharedShadingParams* const shared_shading_para
 typedef struct {
 	const Drawable* const drawable;
 	const struct {const TextureUnit albedo, normal_map;} texture_units;
+	const bool can_sample_ao_surface_atlas; // Only objects on the heightmap's surfaces can use the surface atlas
 } WorldShadedObject;
 
 void init_shared_textures_for_world_shaded_objects(
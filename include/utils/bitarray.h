@@ -62,6 +62,11 @@ static inline void set_bit_in_bitarray(const BitArray bitarray, const buffer_siz
 	*get_bitarray_chunk(bitarray, bit_index) |= get_mask_for_bit_index_in_chunk(bit_index);
 }
 
+static inline void clear_bit_in_bitarray(const BitArray bitarray, const buffer_size_t bit_index) {
+	// `&`-ing the given chunk by the inverted mask for the given bit index
+	*get_bitarray_chunk(bitarray, bit_index) &= ~get_mask_for_bit_index_in_chunk(bit_index);
+}
+
 // This is inclusive on both ends.
 void set_bit_range_in_bitarray(const BitArray bitarray, const buffer_size_t start, const buffer_size_t end);
 
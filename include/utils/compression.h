@@ -0,0 +1,52 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include "utils/typedefs.h" // For `byte`, and `buffer_size_t`
+#include <stddef.h> // For `size_t`
+#include <stdbool.h> // For `bool`
+
+/* These are two simple byte codecs, which are meant for data with long runs of repeated values, or repeated
+patterns (like the AO volume, which is mostly fully lit above the terrain, and fully occluded inside of it):
+
+- Run-length encoding: each chunk starts with a control byte. Below 128, it's followed by that plus 1 literal
+	bytes; and otherwise, it's followed by one byte, which is repeated that minus 128, plus `min_rle_run_length`, times.
+
+- LZ: this follows the LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md), without its
+	end-of-block restrictions. Each sequence has a token byte, where the high nibble is the number of literals and the
+	low nibble is the match length minus 4 (with a nibble of 15 meaning that more length bytes follow, each one added
+	on until one is below 255). That's followed by the literals, and then by a 16-bit little-endian offset back to the
+	start of the match. The last sequence only has literals.
+
+For decoding in parallel, data is compressed in independent blocks of `compression_block_size` bytes (where the last
+one may be shorter). The compressed data starts with the compressed size of each block as a `uint32_t`, in the
+machine's byte order, and then has the blocks one after the other. A block whose compressed size equals its
+uncompressed size is stored as is, since compressing it didn't make it any smaller. */
+
+typedef enum {
+	CompressionNone,
+	CompressionRLE,
+	CompressionLZ,
+	num_compression_codecs
+} CompressionCodec;
+
+enum {compression_block_size = 1 << 18};
+
+/* Excluded:
+get_num_compression_blocks, get_compression_block_size, read_u32, read_lz_length, write_lz_length,
+write_rle_literals, write_lz_sequence, get_lz_hash_index, compress_block_with_rle, compress_block_with_lz,
+compress_block, compression_job, decompress_block_with_rle, copy_lz_match, decompress_block_with_lz,
+decompress_block, decompression_job */
+
+// The compressed data never takes up more than this
+size_t get_max_num_compressed_bytes(const size_t num_bytes);
+
+/* This compresses the blocks on the worker pool, and returns the number of compressed bytes. `dst` should have
+room for `get_max_num_compressed_bytes`; and with `CompressionNone`, the data is only copied over. */
+size_t compress_in_blocks(const CompressionCodec codec, const byte* const src, const size_t num_bytes, byte* const dst);
+
+/* This decompresses the blocks on the worker pool. It returns false if the compressed data is malformed,
+or if it doesn't decompress to exactly `num_decompressed_bytes`; and in that case, `dst` is undefined. */
+bool decompress_in_blocks(const CompressionCodec codec, const byte* const src,
+	const size_t num_compressed_bytes, byte* const dst, const size_t num_decompressed_bytes);
+
+#endif
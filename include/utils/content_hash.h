@@ -0,0 +1,21 @@
+#ifndef CONTENT_HASH_H
+#define CONTENT_HASH_H
+
+#include "utils/typedefs.h" // For `uint64_t`
+#include <stddef.h> // For `size_t`
+
+/* This is a 64-bit content hash (XXH64, from https://github.com/Cyan4973/xxHash), for checking whether
+cached data is still valid, and whether it's been corrupted. It isn't cryptographic, so it can't catch
+tampering; but it's fast, and any accidental change to the input changes the hash with near certainty.
+
+To hash several pieces of data together, pass the hash of each piece as the seed for the next one. The
+hash depends on the machine's byte order for anything bigger than a byte; so hashes shouldn't be compared
+across machines with different byte orders. */
+
+typedef uint64_t content_hash_t;
+
+// Excluded: rotate_left, read_u64, read_u32, mix_content_hash_lane, merge_content_hash_lane
+
+content_hash_t get_content_hash(const void* const data, const size_t num_bytes, const content_hash_t seed);
+
+#endif
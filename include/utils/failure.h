@@ -21,6 +21,7 @@ typedef enum {
 	CreateAudioBuffer,
 	CreateAudioSource,
 	CreateFormatString,
+	CreateThread,
 
 	ParseJSON,
 	ReadFromJSON,
@@ -0,0 +1,26 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include "utils/typedefs.h" // For `byte`
+#include <stddef.h> // For `size_t`
+#include <stdbool.h> // For `bool`
+
+/* This maps a whole file into memory, read-only. Nothing is read up front; each page is read
+in from the OS's page cache (or from disk, if it isn't cached yet) the first time that it's
+touched, so data can be used straight from the file without being copied onto the heap.
+
+The mapping base is page-aligned, so any part of the file at a page-aligned offset is page-aligned in
+memory too. The mapping stays valid if the file is replaced on disk through a rename, but not if it's
+truncated or rewritten in place; so files that may be mapped should only be replaced with a rename. */
+
+typedef struct {
+	const byte* const data; // This is `NULL` if the file is missing, or empty
+	const size_t num_bytes;
+} MappedFile;
+
+// TODO: support Windows for this too (via `CreateFileMapping`)
+
+MappedFile init_mapped_file(const char* const path);
+void deinit_mapped_file(const MappedFile* const mapped_file);
+
+#endif
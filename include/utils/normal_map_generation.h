@@ -4,26 +4,65 @@
 #include "utils/typedefs.h" // For various typedefs
 #include "glad/glad.h" // For OpenGL defs
 #include "utils/texture.h" // For `TextureType`
+#include "data/constants.h" // For `DEBUG_NORMAL_MAP_GENERATION`, and `BENCHMARK_NORMAL_MAP_GENERATION`
 
 /* Excluded:
-generate_heightmap, int_min, int_max, int_clamp, sobel_sample,
-generate_normal_map, compute_1D_gaussian_kernel,
-do_separable_gaussian_blur_pass, get_texture_metadata */
+get_pixel_channel_shifts, get_heightmap_value, generate_heightmap_row_scalar, compute_1D_gaussian_kernel,
+get_effective_blur_radius, get_fixed_point_blur_weight, get_blurred_pixel, blur_row_scalar, int_min, int_max,
+int_clamp, get_normal_map_pixel, generate_normal_map_row_scalar, get_heightmap_values_sse2,
+generate_heightmap_row_sse2, blur_row_sse2, blur_row_avx2, get_normal_map_pixels_sse2, get_normal_map_pixels_avx2,
+load_8_pixels_as_16_bits_sse2, get_low_16_bits_as_32_sse2, get_high_16_bits_as_32_sse2,
+generate_normal_map_row_sse2, load_8_pixels_as_32_bits_avx2, generate_normal_map_row_avx2, get_row_kernels,
+pad_row, get_box_blur_radii, get_box_blur_reciprocal, divide_box_blur_sum, box_blur_row, box_blur_rows_vertically,
+init_heightmap_blur, deinit_heightmap_blur, blur_heightmap_with_gaussian_kernel, blur_heightmap_with_boxes,
+normal_map_band_job, get_num_bands_per_subtexture, init_normal_map_job_data, upload_normal_map_subtexture,
+get_texture_metadata, make_normal_map_on_cpu, draw_normal_map_pass, make_normal_map_on_gpu, is_software_renderer,
+get_normal_map_differences, init_albedo_surface_for_checking */
 
 typedef struct {
 	const byte blur_radius; // This can be zero. If so, no blurring happens.
 	const GLfloat blur_std_dev, heightmap_scale, rescale_factor;
+
+	/* If this is set, the Gaussian blur is approximated with three box blurs, which take the same time per pixel for
+	any radius (the exact blur takes time proportional to the radius). The boxes never reach past `blur_radius`.
+	Small standard deviations degrade badly, since the boxes shrink to one 3-pixel box or to no blur at all: on the
+	wall textures, a standard deviation of 0.8 puts the normals off by 3 on average (and by up to 104), and 0.25 puts
+	them off by 0.5 on average (and by up to 28). So this only suits blurs with larger standard deviations. */
+	const bool use_box_blur;
 } NormalMapConfig;
 
+// This has a shader for each normal map pass (making a heightmap, blurring it, and the Sobel operator)
 typedef struct {
-	const GLuint shader; // TODO: use this
+	const GLuint heightmap_shader, blur_shader, normal_map_shader, framebuffer;
+
+	const struct {const GLint albedo_layer;} heightmap_uniform_ids;
+	const struct {const GLint blur_direction;} blur_uniform_ids;
 } NormalMapCreator;
 
-// This bakes an inverted heightmap into the alpha channel of the normal map too, for use with parallax mapping
+/* This bakes an inverted heightmap into the alpha channel of the normal map too, for use with parallax mapping.
+`albedo_surface` should have the same pixels as the albedo texture, with each subtexture stacked on top of the
+next one (like the surface that `init_texture_set` can keep); the albedo texture is only used for its size and
+sampling parameters. The albedo surface is left as is, and the caller must still deinit it.
+
+The normal map is rendered on the GPU with the creator's shaders, which do the same math as the CPU generator. With
+the box blur, or on a software renderer (like Mesa's llvmpipe), it's made on the CPU instead. */
 GLuint init_normal_map_from_albedo_texture(
 	const NormalMapCreator* const creator,
 	const NormalMapConfig* const config,
-	const GLuint albedo_texture, const TextureType type);
+	const GLuint albedo_texture, SDL_Surface* const albedo_surface, const TextureType type);
+
+#ifdef DEBUG_NORMAL_MAP_GENERATION
+void check_gpu_normal_map_parity(const NormalMapCreator* const creator,
+	const GLchar* const* const albedo_texture_paths, const GLsizei num_albedo_textures, const GLsizei texture_size);
+
+void check_box_blur_error(const GLchar* const* const albedo_texture_paths,
+	const GLsizei num_albedo_textures, const GLsizei texture_size);
+#endif
+
+#ifdef BENCHMARK_NORMAL_MAP_GENERATION
+void benchmark_normal_map_generation(const NormalMapCreator* const creator, const NormalMapConfig* const config,
+	const GLchar* const* const albedo_texture_paths, const GLsizei num_albedo_textures, const GLsizei texture_size);
+#endif
 
 //////////
 
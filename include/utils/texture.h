@@ -17,6 +17,7 @@ extern GLfloat global_anisotropic_filtering_level;
 #define OPENGL_INPUT_PIXEL_FORMAT GL_BGRA
 
 #define OPENGL_MATERIALS_MAP_INTERNAL_PIXEL_FORMAT GL_RGBA8
+#define OPENGL_SECTOR_FACE_INTERNAL_PIXEL_FORMAT GL_RGBA8UI
 #define OPENGL_NORMAL_MAP_INTERNAL_PIXEL_FORMAT GL_RGBA
 #define OPENGL_AO_MAP_INTERNAL_PIXEL_FORMAT GL_R8
 #define OPENGL_DEFAULT_INTERNAL_PIXEL_FORMAT GL_SRGB8_ALPHA8
@@ -33,11 +34,13 @@ typedef enum {
 
 	TU_Skybox,
 
-	TU_AmbientOcclusionMap,
+	TU_AmbientOcclusionMap, TU_AmbientOcclusionBrickPool, TU_AmbientOcclusionMaxHeights,
+	TU_AmbientOcclusionSurfaceAtlas, TU_AmbientOcclusionWallTiles,
 	TU_CascadedShadowMapPlain,
 	TU_CascadedShadowMapDepthComparison,
 
 	TU_Materials,
+	TU_SectorFaces, TU_SectorShadowFaces,
 	TU_SectorFaceAlbedo, TU_SectorFaceNormalMap,
 	TU_BillboardAlbedo, TU_BillboardNormalMap,
 	TU_WeaponSpriteAlbedo, TU_WeaponSpriteNormalMap,
@@ -47,7 +50,8 @@ typedef enum {
 	TU_TitleScreenScrollingNormalMap
 } TextureUnit;
 
-// Excluded: premultiply_surface_alpha, init_still_subtextures_in_texture_set, init_animated_subtextures_in_texture_set
+/* Excluded: premultiply_surface_alpha, upload_subtexture_to_texture_set,
+init_still_subtextures_in_texture_set, init_animated_subtextures_in_texture_set */
 
 #define WITH_SURFACE_PIXEL_ACCESS(surface, ...) do {\
 	const bool must_lock = SDL_MUSTLOCK((surface));\
@@ -113,12 +117,15 @@ void init_texture_data(const TextureType type, const GLsizei* const size,
 	const GLenum input_format, const GLint internal_format, const GLenum color_channel_type,
 	const void* const pixels);
 
+/* If `subtextures_surface` is not NULL, it's set to a surface with the same pixels as the texture set (so they're
+rescaled, and premultiplied if asked for), with each subtexture stacked on top of the next one. This saves reading
+the texture set back from the GPU, and the caller must deinit it. */
 GLuint init_texture_set(const bool premultiply_alpha,
 	const bool use_anisotropic_filtering, const TextureWrapMode wrap_mode,
 	const TextureFilterMode mag_filter, const TextureFilterMode min_filter,
 	const texture_id_t num_still_subtextures, const texture_id_t num_animation_layouts,
 	const GLsizei rescale_w, const GLsizei rescale_h, const GLchar* const* const still_subtexture_paths,
-	const AnimationLayout* const animation_layouts);
+	const AnimationLayout* const animation_layouts, SDL_Surface** const subtextures_surface);
 
 GLuint init_plain_texture(const GLchar* const path,
 	const TextureWrapMode wrap_mode, const TextureFilterMode mag_filter,
@@ -0,0 +1,48 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include "utils/typedefs.h" // For `byte`, and `buffer_size_t`
+#include "utils/sdl_include.h" // For `SDL_Thread`, and `SDL_atomic_t`
+#include <stdbool.h> // For `bool`
+
+/* A worker pool runs a batch of independent jobs on several threads. Jobs are handed out by index through an
+atomic counter, so they can finish in any order; any output that must be deterministic should be written
+into a per-job slot by the job, and then merged in job index order after `finish_worker_pool` returns.
+
+The thread that starts the pool is free to do other work until it calls `finish_worker_pool`, where it then
+helps with any jobs that are left before waiting for the workers. Note that `TRACK_MEMORY` is not thread-safe. */
+
+typedef void (*worker_pool_job_t) (void* const job_data, const buffer_size_t job_index);
+
+enum {max_num_workers = 16};
+
+typedef struct {
+	worker_pool_job_t job;
+	void* job_data;
+	buffer_size_t num_jobs;
+
+	SDL_atomic_t next_job_index;
+	byte num_workers;
+	SDL_Thread* workers[max_num_workers];
+} WorkerPool;
+
+// Excluded: run_jobs_until_none_left, worker_thread_entry
+
+// The worker pool must stay at the same address until `finish_worker_pool` returns, since the workers reference it.
+void start_worker_pool(WorkerPool* const worker_pool, const worker_pool_job_t job,
+	void* const job_data, const buffer_size_t num_jobs);
+
+/* This runs one of the jobs that are left on the calling thread, and returns false if there were none left.
+It lets the starting thread do its own work in between jobs, before calling `finish_worker_pool`. */
+bool run_worker_pool_job(WorkerPool* const worker_pool);
+
+/* This stops the workers from taking any more jobs, and returns how many jobs were taken. Since jobs are handed out
+in index order, the taken jobs are the first ones, and they're all done once `finish_worker_pool` returns. */
+buffer_size_t stop_worker_pool(WorkerPool* const worker_pool);
+
+void finish_worker_pool(WorkerPool* const worker_pool);
+
+// This starts and finishes a worker pool in one call.
+void run_jobs_on_worker_pool(const worker_pool_job_t job, void* const job_data, const buffer_size_t num_jobs);
+
+#endif
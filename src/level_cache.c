@@ -1,33 +1,53 @@
 #include "level_cache.h"
 #include "utils/safe_io.h" // For `ASSET_PATH_PREFIX`, and `get_temp_asset_path`
 #include "utils/failure.h" // For `FAIL`
-#include <sys/stat.h> // TODO: support Windows for this too
-#include <time.h>
+#include "utils/compression.h" // For `compress_in_blocks`, and `decompress_in_blocks`
+#include <stdio.h> // For `rename`
 
 /* TODO:
-- Do I need to worry about endian-ness here? I should test this on a big-endian machine.
-- Can I compress the cache, to make it take up less space?
-
-- Later on, genericize/generalize each entry in the cache by these properties:
-	- Source file to check for modification
-	- Fn pointer that returns data to caller
-	- Fn pointer that provides disk-writable data to write
-
-- Should that go in its own file, `file_cache.c`? (in `utils`, probably)
-
-- Note: for keeping more cache entries, structure the file like this:
-	1. Each entry starts with the change date for a file
-	2. That then follows by cache data
-
-- That then keeps going until the end of the file
-
-- Someone could definitely tamper with this, but eventually I'll try
-	to find a way to sign the cache files, or compare them against
-	a checksum, or something like that
-
-- Maybe use run-length encoding, or LZ77
+- The content hashes catch corruption, but not tampering; for that, the cache files would have to be signed.
+- Should the section container go in its own file, `file_cache.c`? (in `utils`, probably)
 */
 
+/* The magic number spells out "DDLC" in a little-endian file. The endianness marker is written
+in the machine's byte order, so a file from a machine with a different byte order is rejected;
+and the format version should be bumped whenever the header or the table of contents change.
+
+Each section starts at a multiple of the section alignment, which is the smallest common page size; so when the
+file is mapped, each section starts on its own page, and its pages can be uploaded from without touching any
+other section's. The space between sections is zeroed.
+
+The sector geometry is stored with the codec that makes it the smallest, or uncompressed if none of them make it
+enough smaller (see `compress_level_cache_section`); and the AO map is always stored uncompressed (see
+`update_pending_level_cache`). Compressed sections are decompressed onto the heap, in parallel over their blocks;
+while uncompressed ones are used straight from the mapped file. */
+enum {
+	level_cache_magic_number = 0x434C4444,
+	level_cache_format_version = 3,
+	level_cache_endianness_marker = 0x01020304,
+	max_num_level_cache_sections = 64,
+	level_cache_section_alignment = 4096
+};
+
+typedef struct {
+	uint32_t magic_number, format_version, endianness_marker, num_sections;
+} LevelCacheHeader;
+
+typedef struct {
+	uint32_t type, codec;
+	uint64_t key, offset, num_bytes, num_decompressed_bytes; // `num_bytes` is the number of bytes stored in the file
+	content_hash_t content_hash; // This is the hash of the stored bytes, so that they're checked before decompressing
+} LevelCacheSectionEntry;
+
+// This is a section as it's stored. A section with no bytes is missing, or invalid; and when writing, it's left out.
+typedef struct {
+	const void* data;
+	size_t num_bytes, num_decompressed_bytes;
+	CompressionCodec codec;
+} LevelCacheSection;
+
+////////// Some general utils
+
 // The returned string should be freed with `dealloc`
 static char* get_cache_path_from_level_path(const char* const level_path) {
 	const char* const after_last_slash_pos = strrchr(level_path, '/') + 1;
@@ -37,106 +57,378 @@ static char* get_cache_path_from_level_path(const char* const level_path) {
 	return make_formatted_string("%scache/%.*s.cache", ASSET_PATH_PREFIX, isolated_level_name_length, after_last_slash_pos);
 }
 
-static time_t get_last_file_modification_time(const char* const path) {
-	struct stat level_file_attributes;
-	stat(path, &level_file_attributes); // TODO: check this for failure
-	return level_file_attributes.st_mtime;
-}
-
 // TODO: upon this failure, remove the cache file too
 static void fail_for_cache_operation(const char* const cache_path, const char* const aspect_that_failed) {
 	FAIL(WorkWithLevelCache, "Couldn't %s the level cache file '%s'", aspect_that_failed, cache_path);
 }
 
-//////////
+static void get_level_cache_section_keys(const LevelCacheConfig* const config,
+	content_hash_t keys[num_level_cache_section_types]) {
 
-static LevelCache create_cache(
-	FILE* const cache_file,
-	const char* const cache_path,
-	const LevelCacheConfig* const config,
-	const time_t last_modification_time) {
+	const Heightmap heightmap = config -> ambient_occlusion.heightmap;
 
-	fwrite(&last_modification_time, sizeof(last_modification_time), 1, cache_file);
+	keys[LevelCacheSectionAmbientOcclusion] = get_ao_data_key(heightmap,
+		config -> ambient_occlusion.max_y, config -> ambient_occlusion.compute_config);
 
-	const Heightmap heightmap = config -> ambient_occlusion.heightmap;
-	const map_pos_component_t max_y = config -> ambient_occlusion.max_y;
+	// The settings key has the map size, and has no padding bytes, so it's hashed as a whole
+	const size_t map_area = (size_t) heightmap.size.x * heightmap.size.z;
+	content_hash_t key = get_content_hash(&config -> sector_geometry.key, sizeof(SectorGeometryKey), 0u);
+	key = get_content_hash(heightmap.data, map_area * sizeof(map_pos_component_t), key);
+	key = get_content_hash(config -> sector_geometry.texture_id_map_data, map_area * sizeof(map_texture_id_t), key);
+	keys[LevelCacheSectionSectorGeometry] = key;
+}
+
+static List init_byte_list_copy(const void* const data, const buffer_size_t num_bytes) {
+	List list = init_list((num_bytes == 0) ? 1u : num_bytes, byte);
+	if (num_bytes != 0) memcpy(list.data, data, num_bytes);
+	list.length = num_bytes;
+	return list;
+}
 
-	ao_value_t* cpu_ao_map_data;
+////////// Reading and writing sections
 
-	const AmbientOcclusionMap ao_map = init_ao_map_with_copy_on_cpu(
-		heightmap, max_y, config -> ambient_occlusion.compute_config,
-		&cpu_ao_map_data
-	);
+// This gives back a section with no bytes if the section's key doesn't match, or if it's truncated or corrupt
+static LevelCacheSection find_level_cache_section(const MappedFile* const cache_file,
+	const LevelCacheSectionEntry* const entry, const content_hash_t expected_key) {
 
-	const size_t amt_to_write = heightmap.size.x * heightmap.size.z * max_y;
-	const size_t amt_written = fwrite(cpu_ao_map_data, sizeof(ao_value_t), amt_to_write, cache_file);
+	const LevelCacheSection no_section = {NULL, 0, 0, CompressionNone};
+	const uint64_t file_size = cache_file -> num_bytes;
 
-	if (amt_to_write != amt_written)
-		fail_for_cache_operation(cache_path, "write ambient occlusion data to");
+	if (entry -> key != expected_key
+		|| entry -> codec >= num_compression_codecs
+		|| entry -> num_bytes == 0u
+		|| entry -> num_decompressed_bytes == 0u
+		|| entry -> num_decompressed_bytes > (buffer_size_t) ~0u
+		|| (entry -> codec == CompressionNone && entry -> num_bytes != entry -> num_decompressed_bytes)
+		|| entry -> offset > file_size
+		|| entry -> num_bytes > file_size - entry -> offset) return no_section;
 
-	dealloc(cpu_ao_map_data);
+	// Hashing the section is what pages it in; after this, using it doesn't read anything more from disk
+	const byte* const data = cache_file -> data + entry -> offset;
+	const size_t num_bytes = (size_t) entry -> num_bytes;
+	if (get_content_hash(data, num_bytes, 0u) != entry -> content_hash) return no_section;
 
-	return (LevelCache) {.ao_map = ao_map};
+	return (LevelCacheSection) {data, num_bytes, (size_t) entry -> num_decompressed_bytes, (CompressionCodec) entry -> codec};
 }
 
-static LevelCache parse_cache(FILE* const cache_file,
-	const LevelCacheConfig* const config,
-	const char* const cache_path) {
+/* Each section that's missing, or that has the wrong key, or that's truncated or corrupt, is given back with no bytes;
+and if the cache file is missing, or if its header doesn't match, every section is given back like that. The sections
+point into the mapped file. */
+static void find_level_cache_sections(const MappedFile* const cache_file,
+	const content_hash_t keys[num_level_cache_section_types], LevelCacheSection sections[num_level_cache_section_types]) {
 
-	// Next, moving the file pointer ahead from the last modification time
-	if (fseek(cache_file, sizeof(time_t), SEEK_SET) == -1)
-		fail_for_cache_operation(cache_path, "parse the source file modification date for");
+	for (byte i = 0; i < num_level_cache_section_types; i++) sections[i] = (LevelCacheSection) {NULL, 0, 0, CompressionNone};
 
-	const Heightmap heightmap = config -> ambient_occlusion.heightmap;
-	const map_pos_component_t max_y = config -> ambient_occlusion.max_y;
-	const size_t expected_num_entries = heightmap.size.x * heightmap.size.z * max_y;
+	LevelCacheHeader header;
+	if (cache_file -> num_bytes < sizeof(header)) return;
+	memcpy(&header, cache_file -> data, sizeof(header));
+
+	if (header.magic_number != level_cache_magic_number
+		|| header.format_version != level_cache_format_version
+		|| header.endianness_marker != level_cache_endianness_marker
+		|| header.num_sections > max_num_level_cache_sections
+		|| header.num_sections * sizeof(LevelCacheSectionEntry) > cache_file -> num_bytes - sizeof(header)) return;
+
+	for (uint32_t i = 0; i < header.num_sections; i++) {
+		// This is copied out, since the entries aren't necessarily aligned in an older or corrupt file
+		LevelCacheSectionEntry entry;
+		memcpy(&entry, cache_file -> data + sizeof(header) + i * sizeof(LevelCacheSectionEntry), sizeof(entry));
+
+		// Sections of unknown types are skipped, and so are repeated ones after the first valid one
+		if (entry.type >= num_level_cache_section_types || sections[entry.type].num_bytes != 0) continue;
+		sections[entry.type] = find_level_cache_section(cache_file, &entry, keys[entry.type]);
+	}
+}
+
+/* This gives back the section's decompressed data. If the section isn't compressed, that points into the mapped file;
+and else, it's decompressed into `*decompressed_data`, which should be freed with `dealloc`. If the section can't be
+decompressed, this gives back `NULL`. */
+static const void* decompress_level_cache_section(const LevelCacheSection* const section, void** const decompressed_data) {
+	*decompressed_data = NULL;
+	if (section -> codec == CompressionNone) return section -> data;
+
+	byte* const data = alloc(section -> num_decompressed_bytes, sizeof(byte));
+
+	if (!decompress_in_blocks(section -> codec, section -> data, section -> num_bytes, data, section -> num_decompressed_bytes)) {
+		dealloc(data);
+		return NULL;
+	}
+
+	*decompressed_data = data;
+	return data;
+}
+
+/* This compresses the data with each codec, and keeps whichever result is the smallest, since that depends on
+the data (run-length encoding does best with runs of one repeated value, and LZ with repeated patterns). A codec
+is only used if it makes the data at least a quarter smaller, since otherwise, the time spent decompressing is
+more than what's saved by reading less, and the section can't be used straight from the mapped file anymore.
+
+If the section isn't compressed, it points to the data as is, and `*compressed_data` is `NULL`; and
+else, `*compressed_data` should be freed with `dealloc`. */
+static LevelCacheSection compress_level_cache_section(const void* const data,
+	const size_t num_bytes, void** const compressed_data) {
+
+	LevelCacheSection section = {data, num_bytes, num_bytes, CompressionNone};
+	size_t max_num_compressed_bytes = num_bytes - num_bytes / 4u;
+	*compressed_data = NULL;
+
+	for (CompressionCodec codec = CompressionNone + 1; codec < num_compression_codecs; codec++) {
+		byte* const compressed = alloc(get_max_num_compressed_bytes(num_bytes), sizeof(byte));
+		const size_t num_compressed_bytes = compress_in_blocks(codec, data, num_bytes, compressed);
+
+		if (num_compressed_bytes < max_num_compressed_bytes) {
+			max_num_compressed_bytes = num_compressed_bytes;
+			dealloc(*compressed_data);
+			*compressed_data = compressed;
+			section = (LevelCacheSection) {compressed, num_compressed_bytes, num_bytes, codec};
+		}
+		else dealloc(compressed);
+	}
+
+	return section;
+}
+
+static uint64_t align_level_cache_offset(const uint64_t offset) {
+	return (offset + level_cache_section_alignment - 1u) / level_cache_section_alignment * level_cache_section_alignment;
+}
+
+static void write_zeroes_to_cache(FILE* const cache_file, const char* const cache_path, uint64_t num_bytes) {
+	static const byte zeroes[level_cache_section_alignment];
+
+	while (num_bytes != 0) {
+		const size_t num_bytes_in_chunk = (num_bytes < sizeof(zeroes)) ? (size_t) num_bytes : sizeof(zeroes);
+		if (fwrite(zeroes, 1, num_bytes_in_chunk, cache_file) != num_bytes_in_chunk)
+			fail_for_cache_operation(cache_path, "pad a section in");
+		num_bytes -= num_bytes_in_chunk;
+	}
+}
+
+/* The new file is written next to the old one, and then renamed over it. That way, a mapping of the old file
+(which may be what the sections are written from) stays valid, and an interrupted write never leaves a partial
+file in the cache file's place. */
+static void write_level_cache_sections(const char* const cache_path,
+	const content_hash_t keys[num_level_cache_section_types],
+	const LevelCacheSection sections[num_level_cache_section_types]) {
+
+	LevelCacheHeader header = {
+		.magic_number = level_cache_magic_number,
+		.format_version = level_cache_format_version,
+		.endianness_marker = level_cache_endianness_marker,
+		.num_sections = 0u
+	};
+
+	LevelCacheSectionEntry entries[num_level_cache_section_types];
+	uint64_t offset = sizeof(LevelCacheHeader);
+
+	for (byte i = 0; i < num_level_cache_section_types; i++)
+		if (sections[i].num_bytes != 0) offset += sizeof(LevelCacheSectionEntry);
+
+	const uint64_t end_of_table_of_contents = offset;
+
+	for (byte i = 0; i < num_level_cache_section_types; i++) {
+		const LevelCacheSection section = sections[i];
+		if (section.num_bytes == 0) continue;
+
+		offset = align_level_cache_offset(offset);
+
+		entries[header.num_sections++] = (LevelCacheSectionEntry) {
+			.type = i, .codec = section.codec, .key = keys[i], .offset = offset,
+			.num_bytes = section.num_bytes, .num_decompressed_bytes = section.num_decompressed_bytes,
+			.content_hash = get_content_hash(section.data, section.num_bytes, 0u)
+		};
+
+		offset += section.num_bytes;
+	}
+
+	//////////
+
+	char* const temp_cache_path = make_formatted_string("%s.temp", cache_path);
+	FILE* const cache_file = fopen(temp_cache_path, "wb");
+	if (cache_file == NULL) fail_for_cache_operation(temp_cache_path, "open for writing");
 
-	ao_value_t* const ao_data = alloc(expected_num_entries, sizeof(ao_value_t));
-	const size_t amt_read = fread(ao_data, sizeof(ao_value_t), expected_num_entries, cache_file);
-	if (amt_read != expected_num_entries) fail_for_cache_operation(cache_path, "read the ambient occlusion data for");
+	if (fwrite(&header, sizeof(header), 1, cache_file) != 1
+		|| fwrite(entries, sizeof(LevelCacheSectionEntry), header.num_sections, cache_file) != header.num_sections)
+		fail_for_cache_operation(temp_cache_path, "write the table of contents to");
 
-	const AmbientOcclusionMap ao_map = init_ao_map_from_cpu_copy(heightmap, max_y, ao_data);
-	dealloc(ao_data);
-	return (LevelCache) {.ao_map = ao_map};
+	offset = end_of_table_of_contents;
+
+	for (uint32_t i = 0; i < header.num_sections; i++) {
+		const LevelCacheSectionEntry* const entry = entries + i;
+		const LevelCacheSection section = sections[entry -> type];
+
+		write_zeroes_to_cache(cache_file, temp_cache_path, entry -> offset - offset);
+		if (fwrite(section.data, 1, section.num_bytes, cache_file) != section.num_bytes)
+			fail_for_cache_operation(temp_cache_path, "write a section to");
+
+		offset = entry -> offset + entry -> num_bytes;
+	}
+
+	if (fclose(cache_file) != 0) fail_for_cache_operation(temp_cache_path, "finish writing");
+	if (rename(temp_cache_path, cache_path) != 0) fail_for_cache_operation(cache_path, "replace");
+	dealloc(temp_cache_path);
+}
+
+//////////
+
+/* This takes ownership of the cache path. Nothing is written to the cache file until the AO map is baked.
+Any valid sector geometry from the cache is kept, to be written again along with the new AO data. */
+static PendingLevelCache* init_pending_level_cache(char* const cache_path, const LevelCacheConfig* const config,
+	const content_hash_t keys[num_level_cache_section_types], const List* const sector_geometry,
+	AmbientOcclusionMap* const flat_ao_map) {
+
+	const PendingLevelCache pending_cache = {
+		.ao_bake = init_progressive_ao_bake(config -> ambient_occlusion.heightmap,
+			config -> ambient_occlusion.max_y, config -> ambient_occlusion.compute_config, flat_ao_map),
+
+		.cache_path = cache_path,
+
+		.section_keys = {
+			[LevelCacheSectionAmbientOcclusion] = keys[LevelCacheSectionAmbientOcclusion],
+			[LevelCacheSectionSectorGeometry] = keys[LevelCacheSectionSectorGeometry]
+		},
+
+		.sector_geometry = init_byte_list_copy(sector_geometry -> data, sector_geometry -> length)
+	};
+
+	PendingLevelCache* const pending_cache_on_heap = alloc(1, sizeof(PendingLevelCache));
+	memcpy(pending_cache_on_heap, &pending_cache, sizeof(PendingLevelCache));
+	return pending_cache_on_heap;
 }
 
 LevelCache get_level_cache(const char* const level_path_unprefixed, const LevelCacheConfig* const config) {
 	// TODO: can I move a lot of these file operations into `safe_io.h`?
 
-	const char* const level_path = get_temp_asset_path(level_path_unprefixed);
-	const time_t last_modification_time = get_last_file_modification_time(level_path);
-	char* const cache_path = get_cache_path_from_level_path(level_path);
-	FILE* cache_file = fopen(cache_path, "rb");
+	char* const cache_path = get_cache_path_from_level_path(get_temp_asset_path(level_path_unprefixed));
 
-	LevelCache cache;
+	content_hash_t keys[num_level_cache_section_types];
+	LevelCacheSection sections[num_level_cache_section_types];
+	get_level_cache_section_keys(config, keys);
 
-	if (cache_file == NULL) {
-		// printf("Creating a cache, because the cache '%s' does not exist yet\n", cache_path);
-		cache_file = fopen(cache_path, "wb"); // Only need writing at this point
-		cache = create_cache(cache_file, cache_path, config, last_modification_time);
-	}
-	else {
-		time_t cached_last_modification_time;
-		const size_t modification_time_size = sizeof(cached_last_modification_time);
+	const MappedFile mapped_file = init_mapped_file(cache_path);
+	find_level_cache_sections(&mapped_file, keys, sections);
 
-		const size_t amt_read = fread(&cached_last_modification_time, modification_time_size, 1, cache_file);
-		if (amt_read != 1) fail_for_cache_operation(cache_path, "parse the last modification time for");
+	const LevelCacheSection
+		*const ao_section = sections + LevelCacheSectionAmbientOcclusion,
+		*const sector_geometry_section = sections + LevelCacheSectionSectorGeometry;
 
-		if (last_modification_time == cached_last_modification_time) {
-			// puts("Cache is in-sync");
-			cache = parse_cache(cache_file, config, cache_path);
-		}
-		else {
-			// printf("Cache must be updated. Last = %zu, cached = %zu.\n", last_modification_time, cached_last_modification_time);
+	////////// Getting the sector geometry, which is empty if it's missing, or if it can't be decompressed
 
-			// Clearing the cache by opening it with the `w` mode
-			cache_file = freopen(cache_path, "wb", cache_file);
-			cache = create_cache(cache_file, cache_path, config, last_modification_time);
-		}
+	void *decompressed_ao_map, *decompressed_sector_geometry;
+	const void* const sector_geometry_data = decompress_level_cache_section(sector_geometry_section, &decompressed_sector_geometry);
+	const buffer_size_t num_sector_geometry_bytes = (buffer_size_t) ((sector_geometry_data == NULL) ? 0 : sector_geometry_section -> num_decompressed_bytes);
+
+	// This is a view of the mapped or decompressed section, so it's never resized, or freed on its own
+	const List sector_geometry = {
+		.data = (void*) sector_geometry_data, .item_size = sizeof(byte),
+		.length = num_sector_geometry_bytes, .max_alloc = num_sector_geometry_bytes
+	};
+
+	////////// Making the AO map
+
+	const Heightmap heightmap = config -> ambient_occlusion.heightmap;
+	const map_pos_component_t max_y = config -> ambient_occlusion.max_y;
+	const bool bake_surface_atlas = config -> ambient_occlusion.compute_config -> bake_surface_atlas;
+
+	const AOSurfaceAtlasLayout surface_atlas_layout = bake_surface_atlas
+		? init_ao_surface_atlas_layout(heightmap) : (AOSurfaceAtlasLayout) {0};
+
+	const AOSurfaceAtlasLayout* const baked_surface_atlas_layout = bake_surface_atlas ? &surface_atlas_layout : NULL;
+
+	/* The AO section holds the AO map's cached form, which is stored uncompressed, so the AO map's textures are
+	uploaded straight from the mapped pages. The key covers the map's size, but the cached form is checked against
+	it anyway, since a mismatch would mean reading out of bounds. If the cached form can't be used, the AO map is
+	rebaked progressively, and the cache file is rewritten after. */
+	const byte* const cached_ao_map = decompress_level_cache_section(ao_section, &decompressed_ao_map);
+
+	AmbientOcclusionMap ao_map;
+	PendingLevelCache* pending_cache = NULL;
+
+	if (cached_ao_map != NULL && init_ao_map_from_cached_form(heightmap, max_y,
+		baked_surface_atlas_layout, cached_ao_map, ao_section -> num_decompressed_bytes, &ao_map)) dealloc(cache_path);
+
+	else pending_cache = init_pending_level_cache(cache_path, config, keys, &sector_geometry, &ao_map);
+
+	dealloc(decompressed_ao_map);
+
+	if (bake_surface_atlas) deinit_ao_surface_atlas_layout(&surface_atlas_layout);
+
+	return (LevelCache) {
+		.ao_map = ao_map, .sector_geometry = sector_geometry, .decompressed_sector_geometry = decompressed_sector_geometry,
+		.mapped_file = mapped_file, .pending = pending_cache
+	};
+}
+
+void save_sector_geometry_in_level_cache(const char* const level_path_unprefixed,
+	const LevelCacheConfig* const config, PendingLevelCache* const pending_cache, const List* const sector_geometry) {
+
+	const buffer_size_t num_bytes = sector_geometry -> length * sector_geometry -> item_size;
+
+	if (pending_cache != NULL) {
+		List* const pending_sector_geometry = &pending_cache -> sector_geometry;
+		deinit_list(*pending_sector_geometry);
+		*pending_sector_geometry = init_byte_list_copy(sector_geometry -> data, num_bytes);
+		return;
 	}
 
+	/* The file is rewritten with the valid sections that it already has (as they're stored, so they aren't
+	compressed again), along with the new sector geometry. If the AO data became invalid in the meantime,
+	it's left out, and the next load rebakes it. */
+
+	char* const cache_path = get_cache_path_from_level_path(get_temp_asset_path(level_path_unprefixed));
+
+	content_hash_t keys[num_level_cache_section_types];
+	LevelCacheSection sections[num_level_cache_section_types];
+	get_level_cache_section_keys(config, keys);
+
+	const MappedFile mapped_file = init_mapped_file(cache_path);
+	find_level_cache_sections(&mapped_file, keys, sections);
+
+	void* compressed_sector_geometry;
+	sections[LevelCacheSectionSectorGeometry] = compress_level_cache_section(
+		sector_geometry -> data, num_bytes, &compressed_sector_geometry);
+
+	write_level_cache_sections(cache_path, keys, sections);
+
+	dealloc(compressed_sector_geometry);
+	deinit_mapped_file(&mapped_file);
 	dealloc(cache_path);
-	fclose(cache_file);
+}
+
+bool update_pending_level_cache(PendingLevelCache* const pending_cache, const AmbientOcclusionMap* const ao_map) {
+	const ProgressiveAOBake* const ao_bake = &pending_cache -> ao_bake;
+	if (!update_progressive_ao_bake(&pending_cache -> ao_bake, ao_map)) return false;
+
+	size_t num_cached_ao_map_bytes;
+	byte* const cached_ao_map = init_cached_form_of_ao_bake(ao_bake, &num_cached_ao_map_bytes);
+	const List* const sector_geometry = &pending_cache -> sector_geometry;
+
+	void* compressed_sector_geometry;
+
+	/* The AO map is never compressed, so that its textures can be uploaded straight from the mapped file. The
+	cached form already leaves out the bricks with only one value, and decompressing it takes longer than reading
+	the bytes that compression saves. */
+	write_level_cache_sections(pending_cache -> cache_path, pending_cache -> section_keys,
+		(LevelCacheSection[num_level_cache_section_types]) {
+			[LevelCacheSectionAmbientOcclusion] = {cached_ao_map, num_cached_ao_map_bytes, num_cached_ao_map_bytes, CompressionNone},
+
+			[LevelCacheSectionSectorGeometry] = compress_level_cache_section(
+				sector_geometry -> data, sector_geometry -> length, &compressed_sector_geometry)
+		});
+
+	dealloc(cached_ao_map);
+	dealloc(compressed_sector_geometry);
+
+	return true;
+}
+
+void deinit_level_cache_file(const LevelCache* const cache) {
+	dealloc(cache -> decompressed_sector_geometry);
+	deinit_mapped_file(&cache -> mapped_file);
+}
 
-	return cache;
+void deinit_pending_level_cache(PendingLevelCache* const pending_cache) {
+	deinit_progressive_ao_bake(&pending_cache -> ao_bake);
+	dealloc(pending_cache -> cache_path);
+	deinit_list(pending_cache -> sector_geometry);
+	dealloc(pending_cache);
 }
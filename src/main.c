@@ -136,7 +136,10 @@ static LevelContext level_init(
 			.compute_config = {
 				JSON_TO_FIELD(compute_config, workload_split_factor, u8),
 				JSON_TO_FIELD(compute_config, num_trace_iters, u16),
-				JSON_TO_FIELD(compute_config, max_num_ray_steps, u16)
+				JSON_TO_FIELD(compute_config, max_num_ray_steps, u16),
+				JSON_TO_FIELD(compute_config, bake_on_cpu, bool),
+				JSON_TO_FIELD(compute_config, max_gpu_chunk_megabytes, u16),
+				JSON_TO_FIELD(compute_config, bake_surface_atlas, bool)
 			}
 		},
 
@@ -213,6 +216,9 @@ static LevelContext level_init(
 	}
 
 	const Heightmap heightmap = {heightmap_data, heightmap_size};
+	const bool EXTRACT_FROM_JSON_SUBOBJ(get_bool, non_lighting_data, try_both_sector_meshing_axes,);
+	const bool EXTRACT_FROM_JSON_SUBOBJ(get_bool, non_lighting_data, use_static_sector_mesh,);
+	const bool EXTRACT_FROM_JSON_SUBOBJ(get_bool, non_lighting_data, use_sector_lod,);
 	const map_pos_component_t max_point_height = get_heightmap_max_point_height(heightmap);
 	const GLfloat far_clip_dist = compute_world_far_clip_dist(heightmap.size, max_point_height);
 
@@ -223,6 +229,13 @@ static LevelContext level_init(
 			.heightmap = heightmap,
 			.max_y = max_point_height,
 			.compute_config = &level_rendering_config.ambient_occlusion.compute_config
+		},
+
+		.sector_geometry = {
+			.key = get_sector_geometry_key(heightmap, try_both_sector_meshing_axes,
+				use_sector_lod, &level_rendering_config.dynamic_light_config),
+
+			.texture_id_map_data = texture_id_map_data
 		}
 	};
 
@@ -230,7 +243,8 @@ static LevelContext level_init(
 	const GLuint redundant_vertex_spec = init_vertex_spec();
 	use_vertex_spec(redundant_vertex_spec);
 
-	const LevelCache level_cache = get_level_cache(level_path, &level_cache_config);
+	// This isn't const, since the sector geometry in it is emptied if it turns out to be malformed
+	LevelCache level_cache = get_level_cache(level_path, &level_cache_config);
 
 	////////// Reading in the sector face texture paths
 
@@ -438,7 +452,8 @@ static LevelContext level_init(
 				JSON_TO_FIELD(normal_map, blur_radius, u8),
 				JSON_TO_FIELD(normal_map, blur_std_dev, float),
 				JSON_TO_FIELD(normal_map, heightmap_scale, float),
-				JSON_TO_FIELD(normal_map, rescale_factor, float)
+				JSON_TO_FIELD(normal_map, rescale_factor, float),
+				JSON_TO_FIELD(normal_map, use_box_blur, bool)
 			}
 		},
 
@@ -539,7 +554,8 @@ static LevelContext level_init(
 
 			.normal_map_config = {
 				.blur_radius = 3, .blur_std_dev = 0.8f,
-				.heightmap_scale = 1.0f, .rescale_factor = 2.0f
+				.heightmap_scale = 1.0f, .rescale_factor = 2.0f,
+				.use_box_blur = false
 			}
 		},
 
@@ -549,7 +565,8 @@ static LevelContext level_init(
 
 			.normal_map_config = {
 				.blur_radius = 1, .blur_std_dev = 0.1f,
-				.heightmap_scale = 1.0f, .rescale_factor = 2.0f
+				.heightmap_scale = 1.0f, .rescale_factor = 2.0f,
+				.use_box_blur = false
 			} // This, with 2x scaling, uses about 100mb more memory
 		};
 
@@ -607,8 +624,8 @@ static LevelContext level_init(
 		),
 
 		.sector_context = init_sector_context(
-			heightmap, texture_id_map_data,
-			sector_face_texture_paths, num_sector_face_texture_paths,
+			heightmap, texture_id_map_data, try_both_sector_meshing_axes, use_static_sector_mesh, use_sector_lod,
+			&level_cache.sector_geometry, sector_face_texture_paths, num_sector_face_texture_paths,
 			&sector_face_shared_material_properties,
 			normal_map_creator,
 			&level_rendering_config.dynamic_light_config
@@ -631,12 +648,24 @@ static LevelContext level_init(
 		.shadow_context = init_shadow_context(&level_rendering_config.shadow_mapping.cascaded_shadow_config, far_clip_dist),
 
 		.ao_map = level_cache.ao_map,
+		.pending_level_cache = level_cache.pending,
 
 		.skybox = init_skybox(&level_rendering_config.skybox_config),
 		.title_screen = init_title_screen_from_json("json_data/title_screen.json", normal_map_creator),
-		.heightmap = heightmap
+		.heightmap = heightmap,
+		.texture_id_map_data = texture_id_map_data
 	};
 
+	////////// Saving the sector geometry in the level cache, if it wasn't there already
+
+	if (level_cache.sector_geometry.length == 0) {
+		const List sector_geometry = serialize_sector_geometry(&level_context.sector_context, heightmap);
+		save_sector_geometry_in_level_cache(level_path, &level_cache_config, level_cache.pending, &sector_geometry);
+		deinit_list(sector_geometry);
+	}
+
+	deinit_level_cache_file(&level_cache);
+
 	////////// Audio setup (TODO: put this data in some JSON file; perhaps `default_sounds.json`?)
 
 	AudioContext* const audio_context = &persistent_game_context -> audio_context;
@@ -675,9 +704,9 @@ static LevelContext level_init(
 	////////// Initializing shared textures
 
 	const WorldShadedObject world_shaded_objects[] = {
-		{&level_context.sector_context.drawable, {TU_SectorFaceAlbedo, TU_SectorFaceNormalMap}},
-		{&level_context.billboard_context.drawable, {TU_BillboardAlbedo, TU_BillboardNormalMap}},
-		{&level_context.weapon_sprite.drawable, {TU_WeaponSpriteAlbedo, TU_WeaponSpriteNormalMap}}
+		{&level_context.sector_context.drawable, {TU_SectorFaceAlbedo, TU_SectorFaceNormalMap}, true},
+		{&level_context.billboard_context.drawable, {TU_BillboardAlbedo, TU_BillboardNormalMap}, false},
+		{&level_context.weapon_sprite.drawable, {TU_WeaponSpriteAlbedo, TU_WeaponSpriteNormalMap}, false}
 	};
 
 	init_shared_textures_for_world_shaded_objects(world_shaded_objects,
@@ -712,13 +741,39 @@ static LevelContext level_init(
 	// I am bypassing the type system's const safety checks with this, but it's for the best
 	memcpy(&level_context.shared_shading_params, &shared_shading_params, sizeof(SharedShadingParams));
 
+	#ifdef DEBUG_NORMAL_MAP_GENERATION
+	check_gpu_normal_map_parity(normal_map_creator, sector_face_texture_paths,
+		num_sector_face_texture_paths, sector_face_shared_material_properties.texture_rescale_size);
+
+	// This is checked at the sector faces' normal map size
+	check_box_blur_error(sector_face_texture_paths, num_sector_face_texture_paths,
+		(GLsizei) (sector_face_shared_material_properties.texture_rescale_size
+			* sector_face_shared_material_properties.normal_map_config.rescale_factor));
+	#endif
+
+	#ifdef BENCHMARK_NORMAL_MAP_GENERATION
+	benchmark_normal_map_generation(normal_map_creator, &sector_face_shared_material_properties.normal_map_config,
+		sector_face_texture_paths, num_sector_face_texture_paths, sector_face_shared_material_properties.texture_rescale_size);
+	#endif
+
 	////////// Some random deinit
 
 	deinit_vertex_spec(redundant_vertex_spec);
 	dealloc(billboard_animation_layouts);
 	dealloc(still_billboard_texture_paths);
 	dealloc(sector_face_texture_paths);
-	dealloc(texture_id_map_data);
+
+	#ifdef BENCHMARK_SECTOR_REMESHING
+	benchmark_sector_remeshing(&level_context.sector_context, heightmap, texture_id_map_data);
+	#endif
+
+	#ifdef DEBUG_AO_MAP_GENERATION
+	check_gpu_ao_chunking();
+	#endif
+
+	#ifdef BENCHMARK_AO_BAKING
+	benchmark_ao_baking(heightmap, max_point_height, &level_rendering_config.ambient_occlusion.compute_config);
+	#endif
 
 	//////////
 
@@ -732,6 +787,7 @@ static LevelContext level_init(
 
 static void level_deinit(const LevelContext* const level_context) {
 	dealloc(level_context -> heightmap.data);
+	dealloc((map_texture_id_t*) level_context -> texture_id_map_data);
 
 	deinit_shared_shading_params(&level_context -> shared_shading_params);
 	deinit_materials_texture(&level_context -> materials_texture);
@@ -741,6 +797,10 @@ static void level_deinit(const LevelContext* const level_context) {
 	deinit_billboard_context(&level_context -> billboard_context);
 
 	deinit_ao_map(&level_context -> ao_map);
+
+	// If the level is left before the AO map is baked, the bake is dropped, and nothing is written to the cache
+	if (level_context -> pending_level_cache != NULL) deinit_pending_level_cache(level_context -> pending_level_cache);
+
 	deinit_shadow_context(&level_context -> shadow_context);
 	deinit_title_screen(&level_context -> title_screen);
 	deinit_skybox(&level_context -> skybox);
@@ -768,6 +828,15 @@ static bool level_drawer(LevelContext* const level_context,
 
 	glClear(GL_DEPTH_BUFFER_BIT | (in_wireframe_mode * GL_COLOR_BUFFER_BIT));
 
+	////////// Baking a bit more of the AO map, if it's not done yet
+
+	PendingLevelCache* const pending_level_cache = level_context -> pending_level_cache;
+
+	if (pending_level_cache != NULL && update_pending_level_cache(pending_level_cache, &level_context -> ao_map)) {
+		deinit_pending_level_cache(pending_level_cache);
+		level_context -> pending_level_cache = NULL;
+	}
+
 	//////////
 
 	if (tick_title_screen(&level_context -> title_screen, event))
@@ -800,7 +869,7 @@ static bool level_drawer(LevelContext* const level_context,
 	// TODO: still enable face culling for sectors?
 	WITHOUT_BINARY_RENDER_STATE(GL_CULL_FACE,
 		enable_rendering_to_shadow_context(shadow_context);
-			draw_sectors_to_shadow_context(sector_context);
+			draw_sectors_to_shadow_context(sector_context, shadow_context);
 			draw_billboards_to_shadow_context(billboard_context);
 		disable_rendering_to_shadow_context(event -> screen_size);
 	);
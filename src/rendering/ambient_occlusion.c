@@ -1,15 +1,20 @@
 #include "rendering/ambient_occlusion.h"
 #include "cglm/cglm.h" // For various cglm defs
-#include "data/constants.h" // For `TWO_PI` and `DEBUG_AO_MAP_GENERATION`
+#include "data/constants.h" // For `TWO_PI`, `DEBUG_AO_MAP_GENERATION`, and `BENCHMARK_AO_BAKING`
 #include "utils/uniform_buffer.h" // For various uniform buffer defs
 #include "utils/alloc.h" // For `alloc`, and `dealloc`
 #include "utils/shader.h" // For `init_shader`, and `deinit_shader`
 #include "utils/texture.h" // For various texture creation utils
 #include "utils/opengl_wrappers.h" // For various OpenGL wrappers
-#include <time.h> // For `time`
+#include "utils/map_utils.h" // For `sample_map`, and `get_heightmap_max_point_height`
+#include "utils/worker_pool.h" // For `run_jobs_on_worker_pool`, `start_worker_pool`, `run_worker_pool_job`, `stop_worker_pool`, and `finish_worker_pool`
+#include "utils/sdl_include.h" // For `SDL_GetPerformanceCounter`, and `SDL_GetPerformanceFrequency`
+#include "utils/macro_utils.h" // For `ARRAY_LENGTH`
+#include "utils/content_hash.h" // For `get_content_hash`
+#include <string.h> // For `memcpy`
 
 #ifdef DEBUG_AO_MAP_GENERATION
-#include "utils/map_utils.h" // For `pos_out_of_overhead_map_bounds`, and `sample_map`
+#include "data/maps.h" // For `terrain_heightmap`
 #endif
 
 /* Maximum mipmaps, details:
@@ -59,8 +64,8 @@ Algorithm:
 
 /* TODO:
 Optimization:
-- Spatial hashing for using less space
-- Tracing via maximum mipmaps, or a quadtree/octree/r-tree tracing method
+- (DONE, AS SPARSE BRICKS) Spatial hashing for using less space
+- (DONE, AS EARLY EXITS) Tracing via maximum mipmaps, or a quadtree/octree/r-tree tracing method
 - Result caching: first sort the rays, and if the previous ray collided, test if the current ray collides with the same point (or around that area); if so, skip this tracing step. Only works for densely distributed rays.
 - (DONE) Allow for a workload split factor, to trade more speed for more space used
 - Allow for a batch fraction size factor, to trade less speed for less space used
@@ -70,11 +75,11 @@ Optimization:
 
 Fixes:
 - The aliasing involved in the filtering (perhaps it happens because the world-space position fluctuates so much for larger viewing distances?)
-- Unsampled areas within the hemisphere or sphere (normals are distributed well, but not the rays that are cast, it seems)
+- (DONE) Unsampled areas within the hemisphere or sphere (normals are distributed well, but not the rays that are cast, it seems)
 - Give dual normals two sampling passes, and average the results
 - Figure out a better sampling method for over the map (sampling downwards doesn't make sense, since you should be going towards a light source)
 - Perhaps don’t make the bottom of the map black (oddly enough, giving a maximum-ao value when under makes little difference), maybe average neighboring overhead values iteratively?)
-- Perhaps use cosine weighting, instead of just a straight average (or some type of importance sampling, for less noise with fewer samples). See here: https://alexanderameye.github.io/notes/sampling-the-hemisphere/
+- (DONE) Perhaps use cosine weighting, instead of just a straight average (or some type of importance sampling, for less noise with fewer samples). See here: https://alexanderameye.github.io/notes/sampling-the-hemisphere/
 
 Possible:
 - Output to some target that has byte-size components
@@ -82,124 +87,208 @@ Possible:
 - (DONE, NO DIFFERENCE) See if disabling face culling during transform feedback changes performance at all
 - See if direction sorting could help at all
 - Would ray attenuation make anything look better?
-- Stratified sampling might look better with less samples
+- (DONE, VIA A SCRAMBLED SOBOL SEQUENCE) Stratified sampling might look better with less samples
 - Rendering from each point with a given direction could maybe serve as a raytrace, in a way (may be hard to parallelize)
 
 Miscellaneous:
-- (DONE) Keep a CPU implementation of the algorithm (removed by default by a conditional macro), in order to allow verification of the GPU implementation
+- (DONE) Keep a CPU implementation of the algorithm, in order to allow verification of the GPU implementation (it's now a full backend too)
 - Define the number of trace iters and the max number of ray steps (and the new constants above) as part of the level JSON
 - A Lanzcos filter instead, to fix the tricubic overshoot?
 */
 
 static const GLfloat float_epsilon = GLM_FLT_EPSILON;
+static const ao_value_t max_ao_value = (ao_value_t) ~0u;
 
 ////////// Some general utils
 
-static void generate_rand_dir(vec3 v) {
-	static const GLfloat two_pi_over_rand_max = TWO_PI / (GLfloat) RAND_MAX;
+/* The ray dirs are cosine-weighted around the surface normal (see the link in the TODO above), and they come from
+the 2D points of a Sobol sequence, which is stratified for any power-of-two number of points; so fewer rays are
+needed for the same amount of noise. The points are scrambled with a fixed seed, and nothing else feeds into them,
+so a level always bakes to the same AO map. The dirs are made in a frame where +z is the normal, and each backend
+turns them into world space for each point (see `get_world_space_ao_dir`). */
 
-	const GLfloat // Within a unit sphere
-		hori_angle = rand() * two_pi_over_rand_max,
-		vert_angle = rand() * two_pi_over_rand_max;
+static const uint32_t ao_sampling_seed = 1u;
 
-	const GLfloat cos_vert = cosf(vert_angle);
+// This is the same integer hash as in `dict.c`
+static uint32_t hash_ao_sampling_seed(uint32_t x) {
+	x = ((x >> 16u) ^ x) * 0x45d9f3bu;
+	x = ((x >> 16u) ^ x) * 0x45d9f3bu;
+	return (x >> 16u) ^ x;
+}
 
-	v[0] = cos_vert * sinf(hori_angle);
-	v[1] = sinf(vert_angle);
-	v[2] = cos_vert * cosf(hori_angle);
+// This maps two numbers in [0, 1) to a dir over a hemisphere around +z, with Malley's method
+static void get_cosine_weighted_dir(const GLfloat u, const GLfloat v, vec3 dir) {
+	const GLfloat radius = sqrtf(u), angle = v * TWO_PI;
 
-	// This is to avoid any divisions by zero
-	for (byte i = 0; i < 3; i++) {
-		GLfloat* const component = v + i;
-		if (*component == 0.0f) *component = float_epsilon;
+	dir[0] = radius * cosf(angle);
+	dir[1] = radius * sinf(angle);
+	dir[2] = sqrtf(1.0f - u);
+}
+
+/* The first dimension of the sequence is the base-2 radical inverse, and the second one uses the direction numbers
+for the polynomial x + 1. XORing both with a scramble value keeps their stratification. */
+static void get_cosine_weighted_sobol_dir(const uint32_t index, const uint32_t scramble[2], vec3 dir) {
+	static const GLfloat one_over_two_to_the_24 = 1.0f / 16777216.0f;
+
+	uint32_t dimensions[2] = {0u, 0u};
+
+	for (uint32_t i = index, bit = 1u << 31, direction = 1u << 31; i != 0u; i >>= 1u, bit >>= 1u, direction ^= direction >> 1u) {
+		if (i & 1u) {
+			dimensions[0] ^= bit;
+			dimensions[1] ^= direction;
+		}
 	}
 
-	// Normalizing it, just to make 100% sure that it's a unit vector
-	glm_vec3_normalize(v);
+	// Only the top 24 bits are used, so that the numbers are exact floats under 1
+	get_cosine_weighted_dir(
+		(GLfloat) ((dimensions[0] ^ scramble[0]) >> 8u) * one_over_two_to_the_24,
+		(GLfloat) ((dimensions[1] ^ scramble[1]) >> 8u) * one_over_two_to_the_24,
+		dir
+	);
 }
 
 static ao_value_t get_ao_term_from_collision_count(
 	const trace_count_t num_collisions, const trace_count_t num_trace_iters) {
 
-	static const ao_value_t max_ao_value = (ao_value_t) ~0u;
 	const GLfloat collision_term_scaler = (GLfloat) max_ao_value / num_trace_iters;
 
 	return max_ao_value - (ao_value_t) (num_collisions * collision_term_scaler);
 }
 
-////////// The CPU implementation of the GPU AO algorithm
+// The AO volume has a value for each point on the grid under `max_y`, in the AO map's axis order
+static buffer_size_t get_num_ao_volume_values(const Heightmap heightmap, const map_pos_component_t max_y) {
+	return (buffer_size_t) heightmap.size.x * heightmap.size.z * max_y;
+}
 
-#ifdef DEBUG_AO_MAP_GENERATION
+////////// The maximum height pyramid
 
-static bool ray_collides_with_heightmap(const vec3 dir,
-	const Heightmap heightmap, const map_pos_component_t max_y,
-	const map_pos_component_t origin_x, const map_pos_component_t origin_y,
-	const map_pos_component_t origin_z, const ray_step_count_t max_num_ray_steps,
-	const bool is_dual_normal, const sbvec3 flow) {
-
-	const sbvec3 step_signs = {
-		(signed_byte) glm_signf(dir[0]),
-		(signed_byte) glm_signf(dir[1]),
-		(signed_byte) glm_signf(dir[2])
-	};
+/* Level 0 of `MaxHeightPyramid` is the heightmap, and each level after that has the max height of each 2x2 block of
+the level before it (the blocks on the far edges of a level with an odd size just cover less). With it, the max height
+in any area takes at most four lookups. A ray can't hit anything if it starts out above every height that it could
+reach in its steps, so it isn't traced at all then; and points far enough above the terrain don't trace any rays.
+That gives the same results as stepping through every ray, but it skips most of the work over open ground. The GPU
+reads the pyramid from a buffer texture, and `get_max_height_in_area` in the shader should be kept in sync with the
+one here. */
 
-	const signed_byte* const actual_flow = is_dual_normal ? step_signs : flow;
+// The pyramid should be freed with `deinit_max_height_pyramid`
+static MaxHeightPyramid init_max_height_pyramid(const Heightmap heightmap) {
+	MaxHeightPyramid pyramid = {.num_levels = 0};
 
-	const vec3 floating_origin = {
-		(actual_flow[0] == -1) * -float_epsilon + origin_x,
-		origin_y,
-		(actual_flow[2] == -1) * -float_epsilon + origin_z
-	};
+	buffer_size_t total_size = 0;
 
-	const vec3 start_pos = {floorf(floating_origin[0]), floorf(floating_origin[1]), floorf(floating_origin[2])};
+	for (map_pos_xz_t size = heightmap.size; ; size = (map_pos_xz_t) {
+		(map_pos_component_t) ((size.x + 1u) / 2u), (map_pos_component_t) ((size.z + 1u) / 2u)}) {
 
-	//////////
+		pyramid.level_offsets[pyramid.num_levels] = total_size;
+		pyramid.level_sizes[pyramid.num_levels++] = size;
+		total_size += size.x * size.z;
 
-	vec3 unit_step_size;
-	glm_vec3_div(GLM_VEC3_ONE, (GLfloat*) dir, unit_step_size);
-	glm_vec3_abs(unit_step_size, unit_step_size);
+		if (size.x == 1 && size.z == 1) break;
+	}
 
-	vec3 ray_length_components;
-	glm_vec3_sub((GLfloat*) floating_origin, (GLfloat*) start_pos, ray_length_components);
+	pyramid.data = alloc(total_size, sizeof(map_pos_component_t));
+	memcpy(pyramid.data, heightmap.data, heightmap.size.x * heightmap.size.z * sizeof(map_pos_component_t));
 
-	for (byte i = 0; i < 3; i++) {
-		const GLfloat ray_length_component = ray_length_components[i];
-		ray_length_components[i] = (step_signs[i] == 1) ? (1.0f - ray_length_component) : ray_length_component;
+	for (byte level = 1; level < pyramid.num_levels; level++) {
+		const map_pos_component_t* const prev_level = pyramid.data + pyramid.level_offsets[level - 1];
+		map_pos_component_t* const curr_level = pyramid.data + pyramid.level_offsets[level];
+		const map_pos_xz_t prev_size = pyramid.level_sizes[level - 1], curr_size = pyramid.level_sizes[level];
+
+		for (buffer_size_t z = 0; z < curr_size.z; z++) {
+			for (buffer_size_t x = 0; x < curr_size.x; x++) {
+				map_pos_component_t max_height = 0;
+
+				for (buffer_size_t prev_z = z * 2u; prev_z < z * 2u + 2u && prev_z < prev_size.z; prev_z++) {
+					for (buffer_size_t prev_x = x * 2u; prev_x < x * 2u + 2u && prev_x < prev_size.x; prev_x++) {
+						const map_pos_component_t height = prev_level[prev_z * prev_size.x + prev_x];
+						if (height > max_height) max_height = height;
+					}
+				}
+
+				curr_level[z * curr_size.x + x] = max_height;
+			}
+		}
 	}
 
-	glm_vec3_mul(ray_length_components, unit_step_size, ray_length_components);
+	return pyramid;
+}
 
-	//////////
+static void deinit_max_height_pyramid(const MaxHeightPyramid* const pyramid) {
+	dealloc(pyramid -> data);
+}
 
-	signed_map_pos_component_t curr_tile[3] = {
-		(signed_map_pos_component_t) start_pos[0],
-		(signed_map_pos_component_t) start_pos[1],
-		(signed_map_pos_component_t) start_pos[2]
-	};
+// The area's bounds are inclusive, and they're clamped to the heightmap. An area fully outside of it has a max height of 0.
+static int32_t get_max_height_in_area(const MaxHeightPyramid* const pyramid,
+	int32_t start_x, int32_t start_z, int32_t end_x, int32_t end_z) {
 
-	for (ray_step_count_t i = 0; i < max_num_ray_steps; i++) {
-		// Will yield 1 if x > y, and 0 if x <= y (so this gives the index of the smallest among x and y)
-		const byte x_and_y_min_index = (ray_length_components[0] > ray_length_components[1]);
-		const byte index_of_shortest = (ray_length_components[x_and_y_min_index] > ray_length_components[2]) ? 2 : x_and_y_min_index;
-		const signed_byte step_sign_component = step_signs[index_of_shortest];
+	const map_pos_xz_t map_size = pyramid -> level_sizes[0];
+
+	if (start_x < 0) start_x = 0;
+	if (start_z < 0) start_z = 0;
+	if (end_x >= map_size.x) end_x = map_size.x - 1;
+	if (end_z >= map_size.z) end_z = map_size.z - 1;
+	if (start_x > end_x || start_z > end_z) return 0;
 
-		curr_tile[index_of_shortest] += step_sign_component;
-		ray_length_components[index_of_shortest] += unit_step_size[index_of_shortest];
+	// At the first level where a block is wider than the area's extent, the area spans at most two blocks on each axis
+	const int32_t area_extent = (end_x - start_x > end_z - start_z) ? (end_x - start_x) : (end_z - start_z);
+	byte level = 0;
+	while ((1 << level) <= area_extent) level++;
 
-		//////////
+	const map_pos_component_t* const level_data = pyramid -> data + pyramid -> level_offsets[level];
+	const int32_t level_width = pyramid -> level_sizes[level].x;
 
-		const signed_map_pos_component_t cx = curr_tile[0], cy = curr_tile[1], cz = curr_tile[2]; // `c` = current
+	const int32_t
+		block_start_x = start_x >> level, block_start_z = start_z >> level,
+		block_end_x = end_x >> level, block_end_z = end_z >> level;
+
+	const map_pos_component_t block_heights[4] = {
+		level_data[block_start_z * level_width + block_start_x], level_data[block_start_z * level_width + block_end_x],
+		level_data[block_end_z * level_width + block_start_x], level_data[block_end_z * level_width + block_end_x]
+	};
 
-		if (cy < 0) return true;
-		else if (cy > max_y || pos_out_of_overhead_map_bounds((vec2) {cx, cz}, heightmap.size)) return false;
+	map_pos_component_t max_height = 0;
 
-		else if (cy < (signed_map_pos_component_t) sample_map(heightmap,
-			(map_pos_xz_t) {(map_pos_component_t) cx, (map_pos_component_t) cz})) return true;
+	for (byte i = 0; i < ARRAY_LENGTH(block_heights); i++) {
+		if (block_heights[i] > max_height) max_height = block_heights[i];
 	}
 
-	return false;
+	return max_height;
 }
 
+////////// The CPU implementation of the AO algorithm
+
+/* This bakes the same AO data as the GPU does, for when there's no GPU to bake with (like on machines that only warm
+up level caches). Each y slice of the volume is a job on a worker pool, and each point traces several rays at once,
+as the lanes of vectors (which compile to SSE, AVX, or NEON registers). Each lane steps through the grid on its own,
+and stops once its ray hits the heightmap or leaves the map; and a group of rays is done once all of its lanes have
+stopped. Handing a stopped lane the next ray right away was tried too, but that cost more than the idle lanes did,
+since most rays are short. The float math per lane is the same as in the shader (see `bake_on_cpu` for how closely
+the results match). */
+
+#ifdef __AVX__
+enum {num_ao_ray_lanes = 8};
+#else
+enum {num_ao_ray_lanes = 4}; // Wider vectors than the target's registers are slower than just tracing rays one by one
+#endif
+
+typedef GLfloat ao_ray_lane_float_t __attribute__((vector_size(num_ao_ray_lanes * sizeof(GLfloat))));
+typedef int32_t ao_ray_lane_int_t __attribute__((vector_size(num_ao_ray_lanes * sizeof(int32_t))));
+
+typedef struct {
+	ao_ray_lane_float_t unit_step_size[3], ray_length_components[3];
+	ao_ray_lane_int_t step_signs[3], curr_tile[3];
+} AORayLanes;
+
+typedef struct {
+	const Heightmap heightmap;
+	const map_pos_component_t max_y;
+	const vec3* const rand_dirs;
+	const AmbientOcclusionComputeConfig* const compute_config;
+	const MaxHeightPyramid* const max_height_pyramid;
+	const buffer_size_t first_row;
+	ao_value_t* const ao_data;
+} CPUAOBakingJobData;
+
 //////////
 
 static signed_byte sign_between_map_values(const map_pos_component_t a, const map_pos_component_t b) {
@@ -224,9 +313,7 @@ typedef struct {
 	const NormalLocationStatus location_status;
 } SurfaceNormalData;
 
-//////////
-
-SurfaceNormalData get_normal_data(const Heightmap heightmap,
+static SurfaceNormalData get_normal_data(const Heightmap heightmap,
 	const map_pos_component_t x, const map_pos_component_t y, const map_pos_component_t z) {
 
 	const map_pos_component_t left_x = (x == 0) ? 0 : (x - 1), top_z = (z == 0) ? 0 : (z - 1);
@@ -263,266 +350,1818 @@ SurfaceNormalData get_normal_data(const Heightmap heightmap,
 	return (SurfaceNormalData) {{normal[0], normal[1], normal[2]}, {fx, fy, fz}, OnMap};
 }
 
-#endif
+/* Dirs are turned into world space around a point's normal with the basis from "Building an Orthonormal Basis,
+Revisited" (Duff et al. 2017). Points without a valid normal trace rays in every direction instead, so for those,
+a dir is spread out uniformly over the whole sphere, with +z becoming +y; that maps the z of a cosine-weighted dir
+to 2z^2 - 1, and scales its xy by 2z. This is mirrored in the shader. */
 
-//////////
+static void get_ao_dir_basis(const vec3 normal, vec3 tangent, vec3 bitangent) {
+	const GLfloat
+		normal_sign = (normal[2] < 0.0f) ? -1.0f : 1.0f,
+		a = -1.0f / (normal_sign + normal[2]),
+		b = normal[0] * normal[1] * a;
 
-static void transform_feedback_hook(const GLuint shader) {
-	glTransformFeedbackVaryings(shader, 1, (const GLchar*[]) {"num_collisions"}, GL_INTERLEAVED_ATTRIBS);
-}
+	tangent[0] = 1.0f + normal_sign * normal[0] * normal[0] * a;
+	tangent[1] = normal_sign * b;
+	tangent[2] = -normal_sign * normal[0];
 
-static void set_unpack_alignment(const GLint unpack_alignment) {
-	glPixelStorei(GL_UNPACK_ALIGNMENT, unpack_alignment);
+	bitangent[0] = b;
+	bitangent[1] = normal_sign + normal[1] * normal[1] * a;
+	bitangent[2] = -normal[1];
 }
 
-static GLint save_and_set_unpack_alignment(const GLint new_unpack_alignment) {
-	GLint prev_unpack_alignment;
-	glGetIntegerv(GL_UNPACK_ALIGNMENT, &prev_unpack_alignment);
-	set_unpack_alignment(new_unpack_alignment);
-	return prev_unpack_alignment;
+// The tangent and bitangent are only read if the normal is valid
+static void get_world_space_ao_dir(const vec3 local_dir, const bool has_valid_normal,
+	const vec3 normal, const vec3 tangent, const vec3 bitangent, vec3 world_space_dir) {
+
+	if (has_valid_normal) {
+		for (byte i = 0; i < 3; i++) world_space_dir[i] =
+			local_dir[0] * tangent[i] + local_dir[1] * bitangent[i] + local_dir[2] * normal[i];
+	}
+	else {
+		const GLfloat twice_z = 2.0f * local_dir[2];
+
+		world_space_dir[0] = twice_z * local_dir[0];
+		world_space_dir[1] = twice_z * local_dir[2] - 1.0f;
+		world_space_dir[2] = twice_z * local_dir[1];
+	}
+
+	// This is to avoid any divisions by zero
+	for (byte i = 0; i < 3; i++) {
+		GLfloat* const component = world_space_dir + i;
+		if (*component == 0.0f) *component = float_epsilon;
+	}
 }
 
 //////////
 
-static AmbientOcclusionMap init_ao_map_texture(const Heightmap heightmap,
-	const map_pos_component_t max_y, const vec3* const rand_dirs,
-	const AmbientOcclusionComputeConfig* const compute_config,
-	ao_value_t** const cpu_data) {
+/* This sets up one lane for a ray, in the same way as the start of `ray_collides_with_heightmap` in the shader.
+It returns false if the ray starts out above every height that it can reach, since then, it can't hit anything. */
+static bool init_ao_ray_lane_from_floating_origin(AORayLanes* const lanes, const byte lane, const vec3 dir,
+	const vec3 floating_origin, const MaxHeightPyramid* const max_height_pyramid, const ray_step_count_t max_num_ray_steps) {
 
-	////////// Defining some constants
+	for (byte i = 0; i < 3; i++) {
+		// The dir components are never zero, so each step sign is either 1 or -1
+		const GLfloat dir_component = dir[i];
+		const signed_byte step_sign = (dir_component > 0.0f) ? 1 : -1;
 
-	typedef GLint transform_feedback_output_t;
+		const GLfloat
+			start_pos = floorf(floating_origin[i]),
+			origin_minus_start = floating_origin[i] - start_pos,
+			unit_step_size = fabsf(1.0f / dir_component);
 
-	const TextureType heightmap_texture_type = TexRect;
+		lanes -> unit_step_size[i][lane] = unit_step_size;
+		lanes -> ray_length_components[i][lane] = unit_step_size *
+			((step_sign == 1) ? (1.0f - origin_minus_start) : origin_minus_start);
 
-	const GLenum
-		heightmap_input_format = GL_RED_INTEGER,
-		transform_feedback_buffer_target = GL_TRANSFORM_FEEDBACK_BUFFER,
+		lanes -> step_signs[i][lane] = step_sign;
+		lanes -> curr_tile[i][lane] = (int32_t) start_pos;
+	}
 
-		// TODO: ensure that these usages are optimal
-		transform_feedback_buffer_usage = GL_STATIC_DRAW,
-		rand_dirs_ubo_usage = GL_STATIC_DRAW;
+	////////// Checking if the ray can reach any height above it
 
-	const GLuint transform_feedback_buffer_binding_point = 0;
-	const GLint heightmap_internal_pixel_format = GL_R8UI;
+	// A ray moves one tile per step, and only along its step signs
+	const int32_t
+		start_x = lanes -> curr_tile[0][lane], start_y = lanes -> curr_tile[1][lane], start_z = lanes -> curr_tile[2][lane],
+		reach_end_x = start_x + lanes -> step_signs[0][lane] * max_num_ray_steps,
+		reach_end_z = start_z + lanes -> step_signs[2][lane] * max_num_ray_steps,
+		lowest_reachable_y = (lanes -> step_signs[1][lane] == 1) ? start_y : (start_y - max_num_ray_steps);
 
-	////////// Some variable initialization
+	return lowest_reachable_y < get_max_height_in_area(max_height_pyramid,
+		(start_x < reach_end_x) ? start_x : reach_end_x, (start_z < reach_end_z) ? start_z : reach_end_z,
+		(start_x > reach_end_x) ? start_x : reach_end_x, (start_z > reach_end_z) ? start_z : reach_end_z);
+}
+
+// For a grid point, the origin is first nudged back on the axes where the point's flow (or the ray, for dual normals) goes back
+static bool init_ao_ray_lane(AORayLanes* const lanes, const byte lane, const vec3 dir,
+	const map_pos_component_t origin[3], const sbvec3 flow, const bool is_dual_normal,
+	const MaxHeightPyramid* const max_height_pyramid, const ray_step_count_t max_num_ray_steps) {
+
+	vec3 floating_origin;
+
+	for (byte i = 0; i < 3; i++) {
+		const signed_byte step_sign = (dir[i] > 0.0f) ? 1 : -1;
+		const signed_byte actual_flow = is_dual_normal ? step_sign : flow[i];
+
+		floating_origin[i] = origin[i];
+		if (i != 1 && actual_flow == -1) floating_origin[i] -= float_epsilon;
+	}
+
+	return init_ao_ray_lane_from_floating_origin(lanes, lane, dir, floating_origin, max_height_pyramid, max_num_ray_steps);
+}
+
+// This returns how many of the rays in the active lanes (the ones that are set to -1) collide with the heightmap
+static trace_count_t count_ao_ray_lane_collisions(AORayLanes* const lanes, ao_ray_lane_int_t active,
+	const Heightmap heightmap, const map_pos_component_t max_y, const ray_step_count_t max_num_ray_steps) {
+
+	ao_ray_lane_float_t* const ray_length_components = lanes -> ray_length_components;
+	ao_ray_lane_int_t* const curr_tile = lanes -> curr_tile;
+
+	ao_ray_lane_int_t collided = {0};
+
+	for (ray_step_count_t i = 0; i < max_num_ray_steps; i++) {
+		////////// Stepping each lane along the axis with the shortest ray length
+
+		// Like in the shader, z is stepped along if it's shorter than the shorter one of x and y
+		const ao_ray_lane_int_t
+			x_over_y = ray_length_components[0] > ray_length_components[1],
+
+			z_is_shortest =
+				(x_over_y & (ray_length_components[1] > ray_length_components[2])) |
+				(~x_over_y & (ray_length_components[0] > ray_length_components[2])),
+
+			step_masks[3] = {~x_over_y & ~z_is_shortest, x_over_y & ~z_is_shortest, z_is_shortest};
+
+		for (byte j = 0; j < 3; j++) {
+			curr_tile[j] += lanes -> step_signs[j] & step_masks[j];
+			ray_length_components[j] += (ao_ray_lane_float_t) ((ao_ray_lane_int_t) lanes -> unit_step_size[j] & step_masks[j]);
+		}
+
+		////////// Stopping the lanes that left the map, or that hit the heightmap
 
+		/* The y of a tile is never under -1, since a ray there is always under the heightmap.
+		Lanes that were stopped before sample a height of -1, which nothing is below. */
+		active &=
+			(curr_tile[0] >= 0) & (curr_tile[0] < heightmap.size.x) &
+			(curr_tile[2] >= 0) & (curr_tile[2] < heightmap.size.z) &
+			(curr_tile[1] <= max_y);
+
+		ao_ray_lane_int_t heights;
+
+		for (byte lane = 0; lane < num_ao_ray_lanes; lane++) heights[lane] = active[lane]
+			? sample_map(heightmap, (map_pos_xz_t) {(map_pos_component_t) curr_tile[0][lane], (map_pos_component_t) curr_tile[2][lane]})
+			: -1;
+
+		const ao_ray_lane_int_t hit = active & (curr_tile[1] < heights);
+		collided |= hit;
+		active &= ~hit;
+
+		int32_t any_active = 0;
+		for (byte lane = 0; lane < num_ao_ray_lanes; lane++) any_active |= active[lane];
+		if (!any_active) break;
+	}
+
+	trace_count_t num_collisions = 0;
+	for (byte lane = 0; lane < num_ao_ray_lanes; lane++) num_collisions += (trace_count_t) (collided[lane] & 1);
+	return num_collisions;
+}
+
+static ao_value_t bake_ao_value_on_cpu(const CPUAOBakingJobData* const job_data, const map_pos_component_t origin[3]) {
+	const Heightmap heightmap = job_data -> heightmap;
+	const SurfaceNormalData normal_data = get_normal_data(heightmap, origin[0], origin[1], origin[2]);
+	if (normal_data.location_status == BelowMap) return 0;
+
+	const AmbientOcclusionComputeConfig* const compute_config = job_data -> compute_config;
 	const trace_count_t num_trace_iters = compute_config -> num_trace_iters;
-	const workload_split_factor_t workload_split_factor = compute_config -> workload_split_factor;
+	const ray_step_count_t max_num_ray_steps = compute_config -> max_num_ray_steps;
+	const MaxHeightPyramid* const max_height_pyramid = job_data -> max_height_pyramid;
 
-	const buffer_size_t num_points_on_grid = heightmap.size.x * max_y * heightmap.size.z;
-	const buffer_size_t num_threads = num_points_on_grid * workload_split_factor;
-	const buffer_size_t output_buffer_size = num_threads * sizeof(transform_feedback_output_t);
+	// If the point is above every height that any of its rays can reach, none of them can collide
+	const int32_t reach = max_num_ray_steps;
 
-	const GLuint transform_feedback_gpu_buffer = init_gpu_buffer();
-	use_gpu_buffer(transform_feedback_buffer_target, transform_feedback_gpu_buffer);
-	init_gpu_buffer_data(transform_feedback_buffer_target, 1, output_buffer_size, NULL, transform_feedback_buffer_usage);
-	glBindBufferBase(transform_feedback_buffer_target, transform_feedback_buffer_binding_point, transform_feedback_gpu_buffer);
+	if (origin[1] - reach >= get_max_height_in_area(max_height_pyramid,
+		origin[0] - reach - 1, origin[2] - reach - 1, origin[0] + reach, origin[2] + reach))
+		return get_ao_term_from_collision_count(0, num_trace_iters);
 
-	////////// Making a heightmap texture
+	const bool
+		has_valid_normal = normal_data.location_status == OnMap,
+		is_dual_normal = normal_data.location_status == DualNormal;
 
-	const GLint prev_unpack_alignment = save_and_set_unpack_alignment(sizeof(ao_value_t));
-	const GLuint heightmap_texture = preinit_texture(heightmap_texture_type, TexNonRepeating, TexNearest, TexNearest, false);
+	vec3 tangent, bitangent;
+	if (has_valid_normal) get_ao_dir_basis(normal_data.normal, tangent, bitangent);
 
-	init_texture_data(heightmap_texture_type, (GLsizei[]) {heightmap.size.x, heightmap.size.z},
-		heightmap_input_format, heightmap_internal_pixel_format, MAP_POS_COMPONENT_TYPENAME, heightmap.data);
+	trace_count_t num_collisions = 0;
 
-	set_unpack_alignment(prev_unpack_alignment);
+	for (trace_count_t i = 0; i < num_trace_iters; i += num_ao_ray_lanes) {
+		const trace_count_t num_rays_left = num_trace_iters - i;
+		const byte num_rays = (num_rays_left < num_ao_ray_lanes) ? (byte) num_rays_left : num_ao_ray_lanes;
 
-	////////// Making a shader, and using it
+		AORayLanes lanes = {0};
+		ao_ray_lane_int_t active = {0};
 
-	const GLuint shader = init_shader("shaders/precompute_ambient_occlusion.vert", NULL, NULL, transform_feedback_hook);
-	use_shader(shader);
+		for (byte lane = 0; lane < num_rays; lane++) {
+			vec3 rand_dir;
+			get_world_space_ao_dir(job_data -> rand_dirs[i + lane], has_valid_normal,
+				normal_data.normal, tangent, bitangent, rand_dir);
 
-	////////// Writing the plain uniforms and the heightmap to the shader
+			active[lane] = -init_ao_ray_lane(&lanes, lane, rand_dir, origin, normal_data.flow,
+				is_dual_normal, max_height_pyramid, max_num_ray_steps);
+		}
 
-	const trace_count_t num_traces_per_thread = num_trace_iters / workload_split_factor;
+		num_collisions += count_ao_ray_lane_collisions(&lanes, active, heightmap, job_data -> max_y, max_num_ray_steps);
+	}
 
-	if (num_traces_per_thread * workload_split_factor != num_trace_iters)
-		FAIL(CreateTexture, "Cannot compute an ambient occlusion texture because the %u "
-			"trace iterations per point cannot be split evenly into %u thread groups",
-			num_trace_iters, workload_split_factor);
+	return get_ao_term_from_collision_count(num_collisions, num_trace_iters);
+}
 
-	INIT_UNIFORM_VALUE(workload_split_factor, shader, 1ui, workload_split_factor);
-	INIT_UNIFORM_VALUE(num_traces_per_thread, shader, 1ui, num_traces_per_thread);
-	INIT_UNIFORM_VALUE(max_num_ray_steps, shader, 1ui, compute_config -> max_num_ray_steps);
-	INIT_UNIFORM_VALUE(max_point_height, shader, 1ui, max_y);
-	INIT_UNIFORM_VALUE(float_epsilon, shader, 1f, float_epsilon);
+// Each job bakes one row along x of the AO volume, starting from the job data's first row
+static void cpu_ao_baking_job(void* const job_data, const buffer_size_t job_index) {
+	const CPUAOBakingJobData* const typed_job_data = job_data;
+	const map_pos_xz_t map_size = typed_job_data -> heightmap.size;
 
-	use_texture_in_shader(heightmap_texture, shader, "heightmap_sampler", heightmap_texture_type, TU_Temporary);
+	const buffer_size_t row = typed_job_data -> first_row + job_index;
+	const map_pos_component_t y = (map_pos_component_t) (row / map_size.z), z = (map_pos_component_t) (row % map_size.z);
 
-	////////// Making a uniform buffer, and writing the random dirs to it
+	ao_value_t* ao_value = typed_job_data -> ao_data + row * map_size.x;
 
-	const GLchar* const rand_dirs_uniform_name = "rand_dirs";
+	for (map_pos_component_t x = 0; x < map_size.x; x++, ao_value++)
+		*ao_value = bake_ao_value_on_cpu(typed_job_data, (map_pos_component_t[3]) {x, y, z});
+}
 
-	UniformBuffer rand_dirs_ubo = init_uniform_buffer(rand_dirs_ubo_usage,
-		"RandDirs", shader, (const GLchar*[]) {rand_dirs_uniform_name}, 1);
+// The returned data should be freed with `dealloc`
+static ao_value_t* bake_ao_map_on_cpu(const Heightmap heightmap, const map_pos_component_t max_y,
+	const vec3* const rand_dirs, const AmbientOcclusionComputeConfig* const compute_config,
+	const MaxHeightPyramid* const max_height_pyramid) {
 
-	bind_uniform_buffer_to_shader(&rand_dirs_ubo, shader);
-	enable_uniform_buffer_writing_batch(&rand_dirs_ubo, true);
+	ao_value_t* const ao_data = alloc(get_num_ao_volume_values(heightmap, max_y), sizeof(ao_value_t));
 
-	write_array_of_primitives_to_uniform_buffer(&rand_dirs_ubo,
-		rand_dirs_uniform_name, (List) {
-			.data = (void*) rand_dirs,
-			.item_size = sizeof(vec3),
-			.length = num_trace_iters
+	CPUAOBakingJobData job_data = {heightmap, max_y, rand_dirs, compute_config, max_height_pyramid, 0, ao_data};
+	run_jobs_on_worker_pool(cpu_ao_baking_job, &job_data, (buffer_size_t) (max_y * heightmap.size.z));
+
+	return ao_data;
+}
+
+
+////////// The surface atlas
+
+/* With the surface atlas, sector faces get their AO from a 2D atlas of tiles that are baked right on the heightmap's
+surfaces, instead of from the AO volume. That gives them `ao_surface_atlas_texels_per_unit` texels per unit, where the
+volume has one voxel per unit; and the volume's values are taken at grid points, which can be inside of columns.
+
+The tiles are keyed by the heightmap's surfaces rather than by the sector mesh's faces, since faces are merged
+differently for each level of detail, and they change when the map is remeshed. Each column has a top tile, one unit
+squared; these come first in the atlas, in a block with the map's layout. Each edge between two columns with different
+heights has a wall tile, one unit wide and as tall as the height difference; these are packed next to the top tiles,
+tallest first, with a skyline packer. Since every wall tile is one unit wide, the skyline is kept per tile-wide
+column of the atlas, and each tile goes on the lowest column.
+
+A texture array of wall tile entries gives the wall tile for each edge. Its first layer has the walls facing along x,
+between the columns at x - 1 and x; and its second layer has the walls facing along z, between the columns at z - 1
+and z. Both are indexed by (x, z). Walls on the map's borders are never meshed, so they have no tiles. */
+
+typedef struct {
+	buffer_size_t entry_index;
+	map_pos_component_t height;
+} AOWallTileToPack;
+
+typedef struct {
+	const CPUAOBakingJobData* const tracing; // Only the fields for tracing rays are used from this
+	const AOSurfaceAtlasLayout* const layout;
+	const buffer_size_t first_job;
+	ao_value_t* const texels;
+} AOSurfaceAtlasJobData;
+
+// Rays for the surface atlas start this far off of their surface, so that they can't collide with its own column
+static const GLfloat ao_surface_ray_offset = 1.0f / 64.0f;
+static const buffer_size_t no_ao_surface_atlas_cell_owner = (buffer_size_t) ~0u;
+
+/* Tiles are made of cells of one unit squared, which are aligned to the atlas's texels. A tall wall can have hundreds
+of cells, so a job for baking the atlas covers a span of cells instead of a tile, which keeps the jobs' costs even. */
+enum {num_ao_surface_atlas_cells_per_job = 8};
+
+//////////
+
+static buffer_size_t get_ao_wall_tile_entry_index(const map_pos_xz_t map_size,
+	const byte layer, const buffer_size_t x, const buffer_size_t z) {
+
+	return (layer * (map_size.z + 1u) + z) * (map_size.x + 1u) + x;
+}
+
+// Taller tiles go first, and ties are broken by map order, so that the packing doesn't depend on the `qsort` used
+static int compare_ao_wall_tiles_to_pack(const void* const a, const void* const b) {
+	const AOWallTileToPack* const typed_a = a, * const typed_b = b;
+
+	if (typed_a -> height != typed_b -> height) return (typed_a -> height < typed_b -> height) ? 1 : -1;
+	return (typed_a -> entry_index > typed_b -> entry_index) - (typed_a -> entry_index < typed_b -> entry_index);
+}
+
+AOSurfaceAtlasLayout init_ao_surface_atlas_layout(const Heightmap heightmap) {
+	const map_pos_xz_t map_size = heightmap.size;
+	const buffer_size_t num_wall_tile_entries = 2u * (map_size.x + 1u) * (map_size.z + 1u);
+
+	ao_wall_tile_entry_t* const wall_tile_entries = clearing_alloc(num_wall_tile_entries, sizeof(ao_wall_tile_entry_t));
+	AOWallTileToPack* const wall_tiles_to_pack = alloc(num_wall_tile_entries, sizeof(AOWallTileToPack));
+	buffer_size_t num_wall_tiles = 0;
+
+	////////// Finding the walls
+
+	for (byte layer = 0; layer < 2; layer++) {
+		for (map_pos_component_t z = (layer == 1); z < map_size.z; z++) {
+			for (map_pos_component_t x = (layer == 0); x < map_size.x; x++) {
+				const map_pos_component_t
+					height = sample_map(heightmap, (map_pos_xz_t) {x, z}),
+					behind_height = sample_map(heightmap, (layer == 0)
+						? (map_pos_xz_t) {(map_pos_component_t) (x - 1u), z}
+						: (map_pos_xz_t) {x, (map_pos_component_t) (z - 1u)});
+
+				if (height == behind_height) continue;
+
+				const buffer_size_t entry_index = get_ao_wall_tile_entry_index(map_size, layer, x, z);
+
+				const map_pos_component_t
+					bottom = (height < behind_height) ? height : behind_height,
+					wall_height = (map_pos_component_t) (((height > behind_height) ? height : behind_height) - bottom);
+
+				wall_tile_entries[entry_index][2] = bottom;
+				wall_tile_entries[entry_index][3] = (uint16_t) (wall_height * ao_surface_atlas_texels_per_unit);
+				wall_tiles_to_pack[num_wall_tiles++] = (AOWallTileToPack) {entry_index, wall_height};
+			}
 		}
-	);
+	}
 
-	disable_uniform_buffer_writing_batch(&rand_dirs_ubo);
+	////////// Packing the wall tiles
 
-	////////// Drawing
+	qsort(wall_tiles_to_pack, num_wall_tiles, sizeof(AOWallTileToPack), compare_ao_wall_tiles_to_pack);
 
-	WITH_BINARY_RENDER_STATE(GL_RASTERIZER_DISCARD,
-		glBeginTransformFeedback(GL_POINTS);
-		draw_primitives(GL_POINTS, (GLsizei) num_threads);
-		glEndTransformFeedback();
-	);
+	const buffer_size_t num_columns = 2u * ((map_size.x > map_size.z) ? map_size.x : map_size.z);
+	buffer_size_t* const skyline = alloc(num_columns, sizeof(buffer_size_t));
 
-	////////// Reading back from the feedback GPU buffer
+	// The top tiles take up the first columns, up to the map's depth
+	for (buffer_size_t column = 0; column < num_columns; column++)
+		skyline[column] = (column < map_size.x) ? (map_size.z * ao_surface_atlas_texels_per_unit) : 0;
 
-	transform_feedback_output_t* const raw_transform_feedback_data = init_gpu_buffer_memory_mapping(
-		transform_feedback_gpu_buffer, transform_feedback_buffer_target, output_buffer_size, false);
+	/* The columns are kept in a min-heap ordered by their skyline height, and then by their index, so the lowest column
+	is always at the top of it. The heap starts out sorted, which makes it a valid heap already. */
+	buffer_size_t* const column_heap = alloc(num_columns, sizeof(buffer_size_t));
 
-	ao_value_t* const transform_feedback_data = alloc(num_points_on_grid, sizeof(ao_value_t));
-	*cpu_data = transform_feedback_data;
+	for (buffer_size_t i = 0; i < num_columns; i++)
+		column_heap[i] = (map_size.x + i) % num_columns;
 
-	for (buffer_size_t i = 0; i < num_points_on_grid; i++) {
-		const buffer_size_t raw_transform_feedback_data_index = i * workload_split_factor;
-		const transform_feedback_output_t first_collision_sum = raw_transform_feedback_data[raw_transform_feedback_data_index];
+	#define COLUMN_IS_LOWER(a, b) (skyline[a] < skyline[b] || (skyline[a] == skyline[b] && (a) < (b)))
 
-		/* If the first one is -1, that means that the current span
-		of values for this point's workload is under the map */
-		if (first_collision_sum == -1) transform_feedback_data[i] = 0;
-		else {
-			// This will not overflow, since the total collision sum will be under the max trace count
-			trace_count_t total_collision_sum = (trace_count_t) first_collision_sum;
+	for (buffer_size_t i = 0; i < num_wall_tiles; i++) {
+		const buffer_size_t lowest_column = column_heap[0];
 
-			for (workload_split_factor_t j = 1; j < workload_split_factor; j++)
-				total_collision_sum += raw_transform_feedback_data[raw_transform_feedback_data_index + j];
+		const AOWallTileToPack wall_tile = wall_tiles_to_pack[i];
+		uint16_t* const entry = wall_tile_entries[wall_tile.entry_index];
+
+		entry[0] = (uint16_t) (lowest_column * ao_surface_atlas_texels_per_unit);
+		entry[1] = (uint16_t) skyline[lowest_column];
+		skyline[lowest_column] += wall_tile.height * ao_surface_atlas_texels_per_unit;
+
+		// Sifting the column down, since it only got taller
+		buffer_size_t parent = 0;
+
+		while (true) {
+			const buffer_size_t left = parent * 2u + 1u, right = left + 1u;
+			buffer_size_t lowest = parent;
 
-			transform_feedback_data[i] = get_ao_term_from_collision_count(total_collision_sum, num_trace_iters);
+			if (left < num_columns && COLUMN_IS_LOWER(column_heap[left], column_heap[lowest])) lowest = left;
+			if (right < num_columns && COLUMN_IS_LOWER(column_heap[right], column_heap[lowest])) lowest = right;
+			if (lowest == parent) break;
+
+			const buffer_size_t column = column_heap[parent];
+			column_heap[parent] = column_heap[lowest];
+			column_heap[lowest] = column;
+			parent = lowest;
 		}
 	}
 
-	deinit_gpu_buffer_memory_mapping(transform_feedback_buffer_target);
+	#undef COLUMN_IS_LOWER
+
+	buffer_size_t atlas_height = 0;
+
+	for (buffer_size_t column = 0; column < num_columns; column++) {
+		if (skyline[column] > atlas_height) atlas_height = skyline[column];
+	}
+
+	// Atlas positions are stored as 16-bit values
+	if (atlas_height > UINT16_MAX) FAIL(CreateTexture, "The ambient occlusion surface atlas is too tall, "
+		"with a height of %u texels", atlas_height);
+
+	////////// Finding the owners of the cells
+
+	const buffer_size_t num_cells = num_columns * (atlas_height / ao_surface_atlas_texels_per_unit);
+	buffer_size_t* const cell_owners = alloc(num_cells, sizeof(buffer_size_t));
 
-	////////// Deinit
+	for (buffer_size_t i = 0; i < num_cells; i++) cell_owners[i] = no_ao_surface_atlas_cell_owner;
 
-	deinit_texture(heightmap_texture);
-	deinit_uniform_buffer(&rand_dirs_ubo);
-	deinit_gpu_buffer(transform_feedback_gpu_buffer);
-	deinit_shader(shader);
+	for (buffer_size_t i = 0; i < num_wall_tiles; i++) {
+		const AOWallTileToPack wall_tile = wall_tiles_to_pack[i];
+		const uint16_t* const entry = wall_tile_entries[wall_tile.entry_index];
 
-	return init_ao_map_from_cpu_copy(heightmap, max_y, transform_feedback_data);
+		buffer_size_t* const first_cell_owner = cell_owners
+			+ entry[1] / ao_surface_atlas_texels_per_unit * num_columns + entry[0] / ao_surface_atlas_texels_per_unit;
+
+		for (buffer_size_t cell = 0; cell < wall_tile.height; cell++)
+			first_cell_owner[cell * num_columns] = wall_tile.entry_index;
+	}
+
+	dealloc(column_heap);
+	dealloc(skyline);
+	dealloc(wall_tiles_to_pack);
+
+	return (AOSurfaceAtlasLayout) {
+		.map_size = map_size,
+		.size = {num_columns * ao_surface_atlas_texels_per_unit, atlas_height},
+		.wall_tile_entries = wall_tile_entries,
+		.cell_owners = cell_owners
+	};
 }
 
-AmbientOcclusionMap init_ao_map_with_copy_on_cpu(
-	const Heightmap heightmap, const map_pos_component_t max_y,
-	const AmbientOcclusionComputeConfig* const compute_config,
-	ao_value_t** const cpu_copy) {
+void deinit_ao_surface_atlas_layout(const AOSurfaceAtlasLayout* const layout) {
+	dealloc(layout -> wall_tile_entries);
+	dealloc(layout -> cell_owners);
+}
+
+//////////
 
-	////////// Seeding the random generator, and generating random dirs
+static buffer_size_t get_num_ao_surface_atlas_spans_per_row(const AOSurfaceAtlasLayout* const layout) {
+	const buffer_size_t num_cells_across = layout -> size[0] / ao_surface_atlas_texels_per_unit;
+	return (num_cells_across + num_ao_surface_atlas_cells_per_job - 1u) / num_ao_surface_atlas_cells_per_job;
+}
 
-	/* TODO: fix the possible intersection problems for height
-	values over 255. For example, with seed 1680397591u. */
+// Each row of cells in the atlas is split up into jobs that each cover a span of cells
+static buffer_size_t get_num_ao_surface_atlas_jobs(const AOSurfaceAtlasLayout* const layout) {
+	const buffer_size_t num_cell_rows = layout -> size[1] / ao_surface_atlas_texels_per_unit;
+	return num_cell_rows * get_num_ao_surface_atlas_spans_per_row(layout);
+}
 
-	const unsigned seed = (unsigned) time(NULL);
-	srand(seed);
+/* This bakes the AO for a point on a surface, with a normal along an axis. The rays are spread over the hemisphere
+around the normal, and they start a bit off of the surface; apart from that, this works like `bake_ao_value_on_cpu`. */
+static ao_value_t bake_ao_surface_value_on_cpu(const CPUAOBakingJobData* const job_data,
+	const vec3 surface_pos, const byte normal_axis, const signed_byte normal_sign) {
 
+	const AmbientOcclusionComputeConfig* const compute_config = job_data -> compute_config;
 	const trace_count_t num_trace_iters = compute_config -> num_trace_iters;
+	const ray_step_count_t max_num_ray_steps = compute_config -> max_num_ray_steps;
+	const MaxHeightPyramid* const max_height_pyramid = job_data -> max_height_pyramid;
 
-	vec3* const rand_dirs = alloc(num_trace_iters, sizeof(vec3));
-	for (trace_count_t i = 0; i < num_trace_iters; i++) generate_rand_dir(rand_dirs[i]);
+	vec3 origin, normal = GLM_VEC3_ZERO_INIT, tangent, bitangent;
+	glm_vec3_copy((GLfloat*) surface_pos, origin);
+	origin[normal_axis] += normal_sign * ao_surface_ray_offset;
+	normal[normal_axis] = normal_sign;
 
-	////////// Making an AO map on the GPU
+	// If the point is above every height that any of its rays can reach, none of them can collide
+	const int32_t reach = max_num_ray_steps, x = (int32_t) origin[0], z = (int32_t) origin[2];
 
-	const AmbientOcclusionMap ao_map = init_ao_map_texture(heightmap, max_y,
-		rand_dirs, compute_config, cpu_copy);
+	if ((int32_t) origin[1] - reach >= get_max_height_in_area(max_height_pyramid,
+		x - reach - 1, z - reach - 1, x + reach + 1, z + reach + 1))
+		return get_ao_term_from_collision_count(0, num_trace_iters);
 
-	////////// Verifying that the AO map computed on the GPU is correct
+	get_ao_dir_basis(normal, tangent, bitangent);
 
-	#ifdef DEBUG_AO_MAP_GENERATION
+	trace_count_t num_collisions = 0;
 
-	printf("The seed provided to `srand` = %uu\nStarting the CPU algorithm\n", seed);
+	for (trace_count_t i = 0; i < num_trace_iters; i += num_ao_ray_lanes) {
+		const trace_count_t num_rays_left = num_trace_iters - i;
+		const byte num_rays = (num_rays_left < num_ao_ray_lanes) ? (byte) num_rays_left : num_ao_ray_lanes;
 
-	uint64_t num_correct_with_transform_feedback = 0;
-	const ao_value_t* curr_transform_feedback_datum = *cpu_copy;
-	const trace_count_t max_num_ray_steps = compute_config -> max_num_ray_steps;
+		AORayLanes lanes = {0};
+		ao_ray_lane_int_t active = {0};
 
-	for (map_pos_component_t y = 0; y < max_y; y++) { // For each posible height
-		printf("%g%%\n", (GLdouble) y / max_y * 100.0);
-		for (map_pos_component_t z = 0; z < heightmap.size.z; z++) { // For each map row
-			for (map_pos_component_t x = 0; x < heightmap.size.x; x++, curr_transform_feedback_datum++) { // For each map point
-				const SurfaceNormalData normal_data = get_normal_data(heightmap, x, y, z);
+		for (byte lane = 0; lane < num_rays; lane++) {
+			vec3 rand_dir;
+			get_world_space_ao_dir(job_data -> rand_dirs[i + lane], true, normal, tangent, bitangent, rand_dir);
 
-				const ao_value_t transform_feedback_result = *curr_transform_feedback_datum;
+			active[lane] = -init_ao_ray_lane_from_floating_origin(&lanes, lane, rand_dir,
+				origin, max_height_pyramid, max_num_ray_steps);
+		}
 
-				if (normal_data.location_status == BelowMap) {
-					if (transform_feedback_result == 0) num_correct_with_transform_feedback++;
-					continue;
-				}
+		num_collisions += count_ao_ray_lane_collisions(&lanes, active,
+			job_data -> heightmap, job_data -> max_y, max_num_ray_steps);
+	}
 
-				//////////
+	return get_ao_term_from_collision_count(num_collisions, num_trace_iters);
+}
 
-				const bool
-					has_valid_normal = normal_data.location_status == OnMap,
-					is_dual_normal = normal_data.location_status == DualNormal;
+// This bakes the texels of one cell of the atlas, which is either in a top tile, in a wall tile, or unused
+static void bake_ao_surface_atlas_cell(const CPUAOBakingJobData* const tracing, const AOSurfaceAtlasLayout* const layout,
+	ao_value_t* const texels, const buffer_size_t cell_column, const buffer_size_t cell_row) {
 
-				trace_count_t num_collisions = 0;
+	const map_pos_xz_t map_size = layout -> map_size;
 
-				for (trace_count_t i = 0; i < num_trace_iters; i++) {
-					vec3 rand_dir;
-					glm_vec3_copy(rand_dirs[i], rand_dir);
+	vec3 cell_start; // This is where the cell's first texel starts on its surface
+	byte normal_axis, along_axis; // The first texel axis goes along the along axis, and the second one goes up or along z
+	signed_byte normal_sign;
 
-					// If above the map, no negation based on normal needed, since sampling in a unit circle
-					if (has_valid_normal && glm_vec3_dot((GLfloat*) normal_data.normal, rand_dir) < 0.0f)
-						glm_vec3_negate(rand_dir);
+	if (cell_column < map_size.x && cell_row < map_size.z) {
+		const map_pos_xz_t column = {(map_pos_component_t) cell_column, (map_pos_component_t) cell_row};
+		glm_vec3_copy((vec3) {column.x, sample_map(tracing -> heightmap, column), column.z}, cell_start);
+		normal_axis = 1; along_axis = 0; normal_sign = 1;
+	}
+	else {
+		const buffer_size_t cell_owner = layout -> cell_owners[cell_row * (layout -> size[0] / ao_surface_atlas_texels_per_unit) + cell_column];
+		if (cell_owner == no_ao_surface_atlas_cell_owner) return;
 
-					num_collisions += ray_collides_with_heightmap(rand_dir, heightmap,
-						max_y, x, y, z, max_num_ray_steps, is_dual_normal, normal_data.flow);
-				}
+		const buffer_size_t num_entries_per_layer = (map_size.x + 1u) * (map_size.z + 1u);
 
-				const ao_value_t cpu_result = get_ao_term_from_collision_count(num_collisions, num_trace_iters);
-				if (cpu_result == transform_feedback_result) num_correct_with_transform_feedback++;
+		const byte layer = (byte) (cell_owner / num_entries_per_layer);
+		const map_pos_component_t
+			x = (map_pos_component_t) (cell_owner % num_entries_per_layer % (map_size.x + 1u)),
+			z = (map_pos_component_t) (cell_owner % num_entries_per_layer / (map_size.x + 1u));
 
-				else fprintf(stderr,
-					"Incorrect. pos = {%u, %u, %u}. Results: %u vs %u; num colls = %u\n",
-					x, y, z, cpu_result, transform_feedback_result, num_collisions);
-			}
-		}
+		const uint16_t* const entry = layout -> wall_tile_entries[cell_owner];
+
+		// A wall faces away from the taller of its two columns
+		const map_pos_component_t behind_height = sample_map(tracing -> heightmap, (layer == 0)
+			? (map_pos_xz_t) {(map_pos_component_t) (x - 1u), z}
+			: (map_pos_xz_t) {x, (map_pos_component_t) (z - 1u)});
+
+		normal_axis = (layer == 0) ? 0 : 2;
+		along_axis = 2 - normal_axis;
+		normal_sign = (behind_height > entry[2]) ? 1 : -1;
+
+		cell_start[normal_axis] = (layer == 0) ? x : z;
+		cell_start[along_axis] = (layer == 0) ? z : x;
+		cell_start[1] = entry[2] + cell_row - entry[1] / ao_surface_atlas_texels_per_unit;
 	}
 
-	printf("Finished the CPU algorithm\n%g%% of the CPU results match the GPU results\n",
-		(GLdouble) num_correct_with_transform_feedback / (heightmap.size.x * max_y * heightmap.size.z) * 100.0);
+	//////////
 
-	#endif
+	const byte up_axis = (normal_axis == 1) ? 2 : 1;
+	const buffer_size_t atlas_width = layout -> size[0];
+	const GLfloat texel_size = 1.0f / ao_surface_atlas_texels_per_unit;
 
-	////////// Deinit
+	for (buffer_size_t v = 0; v < ao_surface_atlas_texels_per_unit; v++) {
+		ao_value_t* const texel_row = texels + (cell_row * ao_surface_atlas_texels_per_unit + v) * atlas_width
+			+ cell_column * ao_surface_atlas_texels_per_unit;
 
-	dealloc(rand_dirs);
+		for (buffer_size_t u = 0; u < ao_surface_atlas_texels_per_unit; u++) {
+			vec3 surface_pos;
+			glm_vec3_copy(cell_start, surface_pos);
+			surface_pos[along_axis] += (u + 0.5f) * texel_size;
+			surface_pos[up_axis] += (v + 0.5f) * texel_size;
 
-	return ao_map;
+			texel_row[u] = bake_ao_surface_value_on_cpu(tracing, surface_pos, normal_axis, normal_sign);
+		}
+	}
 }
 
-AmbientOcclusionMap init_ao_map_from_cpu_copy(
-	const Heightmap heightmap,
-	const map_pos_component_t max_y,
-	const ao_value_t* const cpu_data) {
+// Each job bakes a span of cells in the atlas (see `get_num_ao_surface_atlas_jobs`), starting from the job data's first job
+static void ao_surface_atlas_baking_job(void* const job_data, const buffer_size_t job_index) {
+	const AOSurfaceAtlasJobData* const typed_job_data = job_data;
+	const AOSurfaceAtlasLayout* const layout = typed_job_data -> layout;
+
+	const buffer_size_t
+		num_cells_across = layout -> size[0] / ao_surface_atlas_texels_per_unit,
+		num_spans_per_row = get_num_ao_surface_atlas_spans_per_row(layout),
+		atlas_job_index = typed_job_data -> first_job + job_index,
+		cell_row = atlas_job_index / num_spans_per_row,
+		span_start = (atlas_job_index % num_spans_per_row) * num_ao_surface_atlas_cells_per_job,
+		span_end = (span_start + num_ao_surface_atlas_cells_per_job < num_cells_across)
+			? (span_start + num_ao_surface_atlas_cells_per_job) : num_cells_across;
+
+	for (buffer_size_t cell_column = span_start; cell_column < span_end; cell_column++)
+		bake_ao_surface_atlas_cell(typed_job_data -> tracing, layout, typed_job_data -> texels, cell_column, cell_row);
+}
 
-	const GLint prev_unpack_alignment = save_and_set_unpack_alignment(sizeof(ao_value_t));
-	const GLuint texture = preinit_texture(TexVolumetric, TexNonRepeating, TexLinear, TexTrilinear, true);
+// This runs the atlas's jobs from `first_job` up to `end_job`, over the worker pool
+static void bake_ao_surface_atlas_on_cpu(const CPUAOBakingJobData* const tracing,
+	const AOSurfaceAtlasLayout* const layout, ao_value_t* const texels,
+	const buffer_size_t first_job, const buffer_size_t end_job) {
+
+	AOSurfaceAtlasJobData job_data = {tracing, layout, first_job, texels};
+	run_jobs_on_worker_pool(ao_surface_atlas_baking_job, &job_data, end_job - first_job);
+}
 
-	init_texture_data(TexVolumetric, (GLsizei[]) {heightmap.size.x, heightmap.size.z, max_y}, GL_RED,
-		OPENGL_AO_MAP_INTERNAL_PIXEL_FORMAT, OPENGL_AO_MAP_COLOR_CHANNEL_TYPE, cpu_data);
+//////////
 
-	init_texture_mipmap(TexVolumetric);
-	set_unpack_alignment(prev_unpack_alignment);
+static void transform_feedback_hook(const GLuint shader) {
+	glTransformFeedbackVaryings(shader, 1, (const GLchar*[]) {"num_collisions"}, GL_INTERLEAVED_ATTRIBS);
+}
+
+static void set_unpack_alignment(const GLint unpack_alignment) {
+	glPixelStorei(GL_UNPACK_ALIGNMENT, unpack_alignment);
+}
 
-	return (AmbientOcclusionMap) {.texture = texture};
+static GLint save_and_set_unpack_alignment(const GLint new_unpack_alignment) {
+	GLint prev_unpack_alignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &prev_unpack_alignment);
+	set_unpack_alignment(new_unpack_alignment);
+	return prev_unpack_alignment;
 }
 
-void deinit_ao_map(const AmbientOcclusionMap* const ao_map) {
-	deinit_texture(ao_map -> texture);
+//////////
+
+typedef GLint transform_feedback_output_t;
+
+static const GLenum transform_feedback_buffer_target = GL_TRANSFORM_FEEDBACK_BUFFER;
+static const GLuint transform_feedback_buffer_binding_point = 0;
+
+// This keeps any one dispatch short enough to not stall a frame, or to trip a driver's watchdog
+enum {max_num_rays_per_gpu_chunk = 1 << 22};
+
+/* The GPU bakes chunks of rows along x, and each chunk is bounded by its number of rays, and by the size of its
+transform feedback buffer (which is capped by the compute config). That makes the GPU memory used independent
+of the level's size. A chunk always has at least one row, so a cap below the size of one row is rounded up to it.
+
+The ray cap usually binds first: a chunk that it caps has at most `max_num_rays_per_gpu_chunk` / `num_trace_iters`
+points, with `workload_split_factor` outputs each, and the split factor is at most `num_trace_iters`; so its buffer
+never needs more than 16 MB, and a memory cap of 16 MB or more changes nothing. */
+static buffer_size_t get_num_rows_per_gpu_chunk(const map_pos_component_t map_width,
+	const AmbientOcclusionComputeConfig* const compute_config) {
+
+	const size_t
+		num_rays_per_row = (size_t) compute_config -> num_trace_iters * map_width,
+		num_bytes_per_row = (size_t) map_width * compute_config -> workload_split_factor * sizeof(transform_feedback_output_t),
+		max_num_bytes = (size_t) compute_config -> max_gpu_chunk_megabytes * 1024u * 1024u,
+		max_num_rows_for_rays = max_num_rays_per_gpu_chunk / num_rays_per_row,
+		max_num_rows_for_memory = max_num_bytes / num_bytes_per_row;
+
+	const size_t num_rows = (max_num_rows_for_rays < max_num_rows_for_memory) ? max_num_rows_for_rays : max_num_rows_for_memory;
+	return (num_rows == 0) ? 1u : (buffer_size_t) num_rows;
+}
+
+// The context should be freed with `deinit_gpu_ao_baking_context`
+static GPUAOBakingContext init_gpu_ao_baking_context(const Heightmap heightmap,
+	const map_pos_component_t max_y, const vec3* const rand_dirs,
+	const AmbientOcclusionComputeConfig* const compute_config,
+	const MaxHeightPyramid* const max_height_pyramid,
+	const buffer_size_t max_num_points_per_chunk) {
+
+	////////// Defining some constants
+
+	const TextureType heightmap_texture_type = TexRect;
+
+	const GLenum
+		heightmap_input_format = GL_RED_INTEGER,
+
+		// TODO: ensure that these usages are optimal
+		transform_feedback_buffer_usage = GL_STREAM_READ,
+		rand_dirs_ubo_usage = GL_STATIC_DRAW,
+		max_height_buffer_usage = GL_STATIC_DRAW;
+
+	const GLint heightmap_internal_pixel_format = GL_R8UI;
+	const GLenum max_height_internal_pixel_format = GL_R8UI;
+
+	////////// Some variable initialization
+
+	const trace_count_t num_trace_iters = compute_config -> num_trace_iters;
+	const workload_split_factor_t workload_split_factor = compute_config -> workload_split_factor;
+
+	const trace_count_t num_traces_per_thread = num_trace_iters / workload_split_factor;
+
+	if (num_traces_per_thread * workload_split_factor != num_trace_iters)
+		FAIL(CreateTexture, "Cannot compute an ambient occlusion texture because the %u "
+			"trace iterations per point cannot be split evenly into %u thread groups",
+			num_trace_iters, workload_split_factor);
+
+	const GLuint transform_feedback_buffer = init_gpu_buffer();
+	use_gpu_buffer(transform_feedback_buffer_target, transform_feedback_buffer);
+	init_gpu_buffer_data(transform_feedback_buffer_target, max_num_points_per_chunk * workload_split_factor,
+		sizeof(transform_feedback_output_t), NULL, transform_feedback_buffer_usage);
+
+	////////// Making a heightmap texture
+
+	const GLint prev_unpack_alignment = save_and_set_unpack_alignment(sizeof(ao_value_t));
+	const GLuint heightmap_texture = preinit_texture(heightmap_texture_type, TexNonRepeating, TexNearest, TexNearest, false);
+
+	init_texture_data(heightmap_texture_type, (GLsizei[]) {heightmap.size.x, heightmap.size.z},
+		heightmap_input_format, heightmap_internal_pixel_format, MAP_POS_COMPONENT_TYPENAME, heightmap.data);
+
+	set_unpack_alignment(prev_unpack_alignment);
+
+	////////// Making a buffer texture for the max height pyramid
+
+	const byte num_max_height_levels = max_height_pyramid -> num_levels;
+
+	// The last level is 1x1
+	const buffer_size_t max_height_pyramid_size = max_height_pyramid -> level_offsets[num_max_height_levels - 1] + 1u;
+
+	const GLuint max_height_buffer = init_gpu_buffer();
+	use_gpu_buffer(TexBuffer, max_height_buffer);
+	init_gpu_buffer_data(TexBuffer, max_height_pyramid_size, sizeof(map_pos_component_t),
+		max_height_pyramid -> data, max_height_buffer_usage);
+
+	GLuint max_height_texture;
+	glGenTextures(1, &max_height_texture);
+	use_texture(TexBuffer, max_height_texture);
+	glTexBuffer(TexBuffer, max_height_internal_pixel_format, max_height_buffer);
+
+	GLuint max_height_level_widths[max_num_max_height_levels];
+	for (byte level = 0; level < num_max_height_levels; level++)
+		max_height_level_widths[level] = max_height_pyramid -> level_sizes[level].x;
+
+	////////// Making a shader, and using it
+
+	const GLuint shader = init_shader("shaders/precompute_ambient_occlusion.vert", NULL, NULL, transform_feedback_hook);
+	use_shader(shader);
+
+	////////// Writing the plain uniforms and the heightmap to the shader
+
+	INIT_UNIFORM_VALUE(workload_split_factor, shader, 1ui, workload_split_factor);
+	INIT_UNIFORM_VALUE(num_traces_per_thread, shader, 1ui, num_traces_per_thread);
+	INIT_UNIFORM_VALUE(max_num_ray_steps, shader, 1ui, compute_config -> max_num_ray_steps);
+	INIT_UNIFORM_VALUE(max_point_height, shader, 1ui, max_y);
+	INIT_UNIFORM_VALUE(float_epsilon, shader, 1f, float_epsilon);
+
+	INIT_UNIFORM_VALUE(max_height_level_offsets, shader, 1uiv, num_max_height_levels, max_height_pyramid -> level_offsets);
+	INIT_UNIFORM_VALUE(max_height_level_widths, shader, 1uiv, num_max_height_levels, max_height_level_widths);
+
+	use_texture_in_shader(heightmap_texture, shader, "heightmap_sampler", heightmap_texture_type, TU_Temporary);
+	use_texture_in_shader(max_height_texture, shader, "max_heights_sampler", TexBuffer, TU_AmbientOcclusionMaxHeights);
+
+	////////// Making a uniform buffer, and writing the random dirs to it
+
+	const GLchar* const rand_dirs_uniform_name = "rand_dirs";
+
+	UniformBuffer rand_dirs_ubo = init_uniform_buffer(rand_dirs_ubo_usage,
+		"RandDirs", shader, (const GLchar*[]) {rand_dirs_uniform_name}, 1);
+
+	bind_uniform_buffer_to_shader(&rand_dirs_ubo, shader);
+	enable_uniform_buffer_writing_batch(&rand_dirs_ubo, true);
+
+	write_array_of_primitives_to_uniform_buffer(&rand_dirs_ubo,
+		rand_dirs_uniform_name, (List) {
+			.data = (void*) rand_dirs,
+			.item_size = sizeof(vec3),
+			.length = num_trace_iters
+		}
+	);
+
+	disable_uniform_buffer_writing_batch(&rand_dirs_ubo);
+
+	//////////
+
+	return (GPUAOBakingContext) {
+		.shader = shader, .vertex_spec = init_vertex_spec(), .heightmap_texture = heightmap_texture,
+		.max_height_buffer = max_height_buffer, .max_height_texture = max_height_texture,
+		.transform_feedback_buffer = transform_feedback_buffer, .rand_dirs_ubo = rand_dirs_ubo
+	};
+}
+
+static void deinit_gpu_ao_baking_context(const GPUAOBakingContext* const context) {
+	deinit_texture(context -> heightmap_texture);
+	deinit_texture(context -> max_height_texture);
+	deinit_gpu_buffer(context -> max_height_buffer);
+	deinit_uniform_buffer(&context -> rand_dirs_ubo);
+	deinit_gpu_buffer(context -> transform_feedback_buffer);
+	deinit_vertex_spec(context -> vertex_spec);
+	deinit_shader(context -> shader);
+}
+
+/* This starts baking a chunk of points on the GPU, where points are ordered in the same way as in the AO map data.
+Since this may be called between frames, the textures and the transform feedback buffer are bound again here; and
+the context's own vertex spec is used, and the previous one is restored after, since one must always be active. */
+static void dispatch_gpu_ao_baking_chunk(const GPUAOBakingContext* const context,
+	const workload_split_factor_t workload_split_factor, const buffer_size_t first_point, const buffer_size_t num_points) {
+
+	GLint prev_vertex_spec;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &prev_vertex_spec);
+	use_vertex_spec(context -> vertex_spec);
+
+	use_shader(context -> shader);
+
+	glActiveTexture(GL_TEXTURE0 + TU_Temporary);
+	use_texture(TexRect, context -> heightmap_texture);
+	glActiveTexture(GL_TEXTURE0 + TU_AmbientOcclusionMaxHeights);
+	use_texture(TexBuffer, context -> max_height_texture);
+
+	glBindBufferBase(transform_feedback_buffer_target,
+		transform_feedback_buffer_binding_point, context -> transform_feedback_buffer);
+
+	// The vertex ids start at the first thread, and the transform feedback output starts at the buffer's beginning
+	WITH_BINARY_RENDER_STATE(GL_RASTERIZER_DISCARD,
+		glBeginTransformFeedback(GL_POINTS);
+		glDrawArrays(GL_POINTS, (GLint) (first_point * workload_split_factor), (GLsizei) (num_points * workload_split_factor));
+		glEndTransformFeedback();
+	);
+
+	use_vertex_spec((GLuint) prev_vertex_spec);
+}
+
+// This reads back the results of the last dispatched chunk, and writes them to `ao_data`
+static void read_gpu_ao_baking_chunk(const GPUAOBakingContext* const context,
+	const AmbientOcclusionComputeConfig* const compute_config,
+	const buffer_size_t num_points, ao_value_t* const ao_data) {
+
+	const trace_count_t num_trace_iters = compute_config -> num_trace_iters;
+	const workload_split_factor_t workload_split_factor = compute_config -> workload_split_factor;
+
+	use_gpu_buffer(transform_feedback_buffer_target, context -> transform_feedback_buffer);
+
+	const transform_feedback_output_t* const raw_transform_feedback_data = glMapBufferRange(transform_feedback_buffer_target,
+		0, num_points * workload_split_factor * sizeof(transform_feedback_output_t), GL_MAP_READ_BIT);
+
+	for (buffer_size_t i = 0; i < num_points; i++) {
+		const buffer_size_t raw_transform_feedback_data_index = i * workload_split_factor;
+		const transform_feedback_output_t first_collision_sum = raw_transform_feedback_data[raw_transform_feedback_data_index];
+
+		/* If the first one is -1, that means that the current span
+		of values for this point's workload is under the map */
+		if (first_collision_sum == -1) ao_data[i] = 0;
+		else {
+			// This will not overflow, since the total collision sum will be under the max trace count
+			trace_count_t total_collision_sum = (trace_count_t) first_collision_sum;
+
+			for (workload_split_factor_t j = 1; j < workload_split_factor; j++)
+				total_collision_sum += raw_transform_feedback_data[raw_transform_feedback_data_index + j];
+
+			ao_data[i] = get_ao_term_from_collision_count(total_collision_sum, num_trace_iters);
+		}
+	}
+
+	deinit_gpu_buffer_memory_mapping(transform_feedback_buffer_target);
+}
+
+// The returned data should be freed with `dealloc`
+static ao_value_t* bake_ao_map_on_gpu(const Heightmap heightmap,
+	const map_pos_component_t max_y, const vec3* const rand_dirs,
+	const AmbientOcclusionComputeConfig* const compute_config,
+	const MaxHeightPyramid* const max_height_pyramid) {
+
+	const map_pos_component_t map_width = heightmap.size.x;
+
+	const buffer_size_t
+		num_rows = max_y * heightmap.size.z,
+		num_rows_per_chunk = get_num_rows_per_gpu_chunk(map_width, compute_config);
+
+	const GPUAOBakingContext context = init_gpu_ao_baking_context(heightmap,
+		max_y, rand_dirs, compute_config, max_height_pyramid, num_rows_per_chunk * map_width);
+
+	#ifdef DEBUG_AO_MAP_GENERATION
+
+	// The transform feedback buffer should fit one chunk, and it should be under the cap, unless a chunk has just one row
+	const size_t
+		expected_num_buffer_bytes = (size_t) num_rows_per_chunk * map_width
+			* compute_config -> workload_split_factor * sizeof(transform_feedback_output_t),
+		max_num_buffer_bytes = (size_t) compute_config -> max_gpu_chunk_megabytes * 1024u * 1024u;
+
+	GLint num_buffer_bytes;
+	use_gpu_buffer(transform_feedback_buffer_target, context.transform_feedback_buffer);
+	glGetBufferParameteriv(transform_feedback_buffer_target, GL_BUFFER_SIZE, &num_buffer_bytes);
+
+	if ((size_t) num_buffer_bytes != expected_num_buffer_bytes
+		|| (num_rows_per_chunk > 1 && (size_t) num_buffer_bytes > max_num_buffer_bytes))
+		FAIL(CreateTexture, "The transform feedback buffer for baking ambient occlusion on the GPU has %d bytes, when it "
+			"should have %zu bytes, under a cap of %zu bytes", num_buffer_bytes, expected_num_buffer_bytes, max_num_buffer_bytes);
+
+	#endif
+
+	ao_value_t* const ao_data = alloc(num_rows * map_width, sizeof(ao_value_t));
+
+	// Each chunk is read back before the next one is dispatched, since they share one transform feedback buffer
+	for (buffer_size_t first_row = 0; first_row < num_rows; first_row += num_rows_per_chunk) {
+		const buffer_size_t num_rows_left = num_rows - first_row;
+		const buffer_size_t num_rows_in_chunk = (num_rows_left < num_rows_per_chunk) ? num_rows_left : num_rows_per_chunk;
+
+		dispatch_gpu_ao_baking_chunk(&context, compute_config -> workload_split_factor,
+			first_row * map_width, num_rows_in_chunk * map_width);
+
+		read_gpu_ao_baking_chunk(&context, compute_config, num_rows_in_chunk * map_width, ao_data + first_row * map_width);
+	}
+
+	deinit_gpu_ao_baking_context(&context);
+	return ao_data;
+}
+
+
+//////////
+
+// The returned dirs should be freed with `dealloc`
+static vec3* init_rand_dirs(const uint32_t seed, const trace_count_t num_trace_iters) {
+	/* TODO: fix the possible intersection problems for height values over 255
+	(they showed up with the old `rand`-based dirs, with seed 1680397591u). */
+
+	const uint32_t scramble[2] = {hash_ao_sampling_seed(seed), hash_ao_sampling_seed(~seed)};
+
+	vec3* const rand_dirs = alloc(num_trace_iters, sizeof(vec3));
+	for (trace_count_t i = 0; i < num_trace_iters; i++) get_cosine_weighted_sobol_dir(i, scramble, rand_dirs[i]);
+	return rand_dirs;
+}
+
+#if defined(DEBUG_AO_MAP_GENERATION) || defined(BENCHMARK_AO_BAKING)
+
+static void print_ao_map_differences(const ao_value_t* const cpu_data, const ao_value_t* const gpu_data,
+	const Heightmap heightmap, const map_pos_component_t max_y) {
+
+	const buffer_size_t num_points_on_grid = get_num_ao_volume_values(heightmap, max_y);
+	buffer_size_t num_matching = 0;
+	int max_difference = 0;
+
+	for (buffer_size_t i = 0; i < num_points_on_grid; i++) {
+		const int difference = abs(cpu_data[i] - gpu_data[i]);
+		if (difference == 0) num_matching++;
+		else if (difference > max_difference) max_difference = difference;
+	}
+
+	printf("%g%% of the CPU results match the GPU results, and the biggest difference is %d\n",
+		(GLdouble) num_matching / num_points_on_grid * 100.0, max_difference);
+}
+
+#endif
+
+#ifdef DEBUG_AO_MAP_GENERATION
+
+/* This bakes a 255x255 map on the GPU, with its chunks capped at 1 MB, and compares the results with the CPU's.
+The split factor is high enough that the memory cap binds before the ray cap does (see `get_num_rows_per_gpu_chunk`).
+The map needs many chunks, and its last one is only partly full; and `bake_ao_map_on_gpu` checks the size of its
+transform feedback buffer against the cap. */
+void check_gpu_ao_chunking(void) {
+	const Heightmap heightmap = {(map_pos_component_t*) terrain_heightmap, {terrain_width, terrain_height}};
+	const map_pos_component_t max_y = get_heightmap_max_point_height(heightmap);
+
+	const AmbientOcclusionComputeConfig compute_config = {
+		.workload_split_factor = 16, .num_trace_iters = 64, .max_num_ray_steps = 20,
+		.bake_on_cpu = false, .max_gpu_chunk_megabytes = 1, .bake_surface_atlas = false
+	};
+
+	const buffer_size_t
+		num_rows = max_y * heightmap.size.z,
+		num_rows_per_chunk = get_num_rows_per_gpu_chunk(heightmap.size.x, &compute_config),
+
+		num_bytes_per_row = heightmap.size.x * compute_config.workload_split_factor
+			* (buffer_size_t) sizeof(transform_feedback_output_t),
+
+		num_rows_per_chunk_for_memory = compute_config.max_gpu_chunk_megabytes * 1024u * 1024u / num_bytes_per_row;
+
+	if (num_rows_per_chunk != num_rows_per_chunk_for_memory) FAIL(CreateTexture, "Expected the memory cap to bind "
+		"for baking ambient occlusion on the GPU, with %u rows per chunk, but a chunk has %u rows",
+		num_rows_per_chunk_for_memory, num_rows_per_chunk);
+
+	if (num_rows_per_chunk >= num_rows) FAIL(CreateTexture, "Expected the %ux%ux%u ambient occlusion volume to be "
+		"baked in more than one chunk, but a chunk has %u rows", heightmap.size.x, heightmap.size.z, max_y, num_rows_per_chunk);
+
+	printf("Checking ambient occlusion baking on the GPU, with %u chunks of %u rows\n",
+		(num_rows + num_rows_per_chunk - 1u) / num_rows_per_chunk, num_rows_per_chunk);
+
+	vec3* const rand_dirs = init_rand_dirs(ao_sampling_seed, compute_config.num_trace_iters);
+	const MaxHeightPyramid max_height_pyramid = init_max_height_pyramid(heightmap);
+
+	ao_value_t* const gpu_data = bake_ao_map_on_gpu(heightmap, max_y, (const vec3*) rand_dirs, &compute_config, &max_height_pyramid);
+	ao_value_t* const cpu_data = bake_ao_map_on_cpu(heightmap, max_y, (const vec3*) rand_dirs, &compute_config, &max_height_pyramid);
+	print_ao_map_differences(cpu_data, gpu_data, heightmap, max_y);
+
+	dealloc(cpu_data);
+	dealloc(gpu_data);
+	deinit_max_height_pyramid(&max_height_pyramid);
+	dealloc(rand_dirs);
+}
+
+#endif
+
+buffer_size_t get_num_ao_values(const Heightmap heightmap, const map_pos_component_t max_y,
+	const AOSurfaceAtlasLayout* const surface_atlas_layout) {
+
+	const buffer_size_t num_volume_values = get_num_ao_volume_values(heightmap, max_y);
+	if (surface_atlas_layout == NULL) return num_volume_values;
+	return num_volume_values + surface_atlas_layout -> size[0] * surface_atlas_layout -> size[1];
+}
+
+content_hash_t get_ao_data_key(const Heightmap heightmap, const map_pos_component_t max_y,
+	const AmbientOcclusionComputeConfig* const compute_config) {
+
+	/* This should be bumped whenever the baked values change for the same inputs (like when the sampling
+	or the atlas layout changes), or when the cached form changes, so that AO data cached by an older version
+	isn't used. */
+	static const uint16_t ao_data_format_version = 2u;
+
+	/* The workload split factor, the backend, and the GPU chunk size aren't part of this, since they don't change
+	the results (apart from what's noted for `bake_on_cpu`); and the config is hashed field by field, since its
+	padding bytes are undefined. */
+	const struct {
+		const void* const data;
+		const size_t num_bytes;
+	} parts[] = {
+		{&ao_data_format_version, sizeof(ao_data_format_version)},
+		{&ao_sampling_seed, sizeof(ao_sampling_seed)},
+		{&heightmap.size, sizeof(heightmap.size)},
+		{heightmap.data, (size_t) heightmap.size.x * heightmap.size.z * sizeof(map_pos_component_t)},
+		{&max_y, sizeof(max_y)},
+		{&compute_config -> num_trace_iters, sizeof(compute_config -> num_trace_iters)},
+		{&compute_config -> max_num_ray_steps, sizeof(compute_config -> max_num_ray_steps)},
+		{&compute_config -> bake_surface_atlas, sizeof(compute_config -> bake_surface_atlas)}
+	};
+
+	content_hash_t key = 0u;
+	for (byte i = 0; i < ARRAY_LENGTH(parts); i++) key = get_content_hash(parts[i].data, parts[i].num_bytes, key);
+	return key;
+}
+
+ao_value_t* bake_ao_map_data(const Heightmap heightmap, const map_pos_component_t max_y,
+	const AmbientOcclusionComputeConfig* const compute_config, const AOSurfaceAtlasLayout* const surface_atlas_layout) {
+
+	vec3* const rand_dirs = init_rand_dirs(ao_sampling_seed, compute_config -> num_trace_iters);
+
+	const MaxHeightPyramid max_height_pyramid = init_max_height_pyramid(heightmap);
+	const bool bake_on_cpu = compute_config -> bake_on_cpu;
+
+	ao_value_t* ao_data = (bake_on_cpu ? bake_ao_map_on_cpu : bake_ao_map_on_gpu)
+		(heightmap, max_y, (const vec3*) rand_dirs, compute_config, &max_height_pyramid);
+
+	////////// Baking the surface atlas after the volume
+
+	if (surface_atlas_layout != NULL) {
+		const buffer_size_t
+			num_volume_values = get_num_ao_volume_values(heightmap, max_y),
+			num_atlas_texels = surface_atlas_layout -> size[0] * surface_atlas_layout -> size[1];
+
+		ao_data = resizing_alloc(ao_data, (num_volume_values + num_atlas_texels) * sizeof(ao_value_t));
+		ao_value_t* const texels = ao_data + num_volume_values;
+
+		// The parts of the atlas that no tile covers are never read, but they're still written to the level cache
+		memset(texels, get_ao_term_from_collision_count(0, compute_config -> num_trace_iters), num_atlas_texels);
+
+		const CPUAOBakingJobData tracing = {heightmap, max_y, (const vec3*) rand_dirs,
+			compute_config, &max_height_pyramid, 0, NULL};
+
+		bake_ao_surface_atlas_on_cpu(&tracing, surface_atlas_layout, texels,
+			0, get_num_ao_surface_atlas_jobs(surface_atlas_layout));
+	}
+
+	////////// Verifying that the AO map matches for the CPU and the GPU
+
+	#ifdef DEBUG_AO_MAP_GENERATION
+
+	printf("Starting the %s algorithm\n", bake_on_cpu ? "GPU" : "CPU");
+
+	ao_value_t* const other_ao_data = (bake_on_cpu ? bake_ao_map_on_gpu : bake_ao_map_on_cpu)
+		(heightmap, max_y, (const vec3*) rand_dirs, compute_config, &max_height_pyramid);
+
+	if (bake_on_cpu) print_ao_map_differences(ao_data, other_ao_data, heightmap, max_y);
+	else print_ao_map_differences(other_ao_data, ao_data, heightmap, max_y);
+
+	dealloc(other_ao_data);
+
+	#endif
+
+	deinit_max_height_pyramid(&max_height_pyramid);
+	dealloc(rand_dirs);
+	return ao_data;
+}
+
+AmbientOcclusionMap init_ao_map_with_copy_on_cpu(
+	const Heightmap heightmap, const map_pos_component_t max_y,
+	const AmbientOcclusionComputeConfig* const compute_config,
+	ao_value_t** const cpu_copy) {
+
+	const bool bake_surface_atlas = compute_config -> bake_surface_atlas;
+
+	const AOSurfaceAtlasLayout surface_atlas_layout = bake_surface_atlas
+		? init_ao_surface_atlas_layout(heightmap) : (AOSurfaceAtlasLayout) {0};
+
+	const AOSurfaceAtlasLayout* const baked_surface_atlas_layout = bake_surface_atlas ? &surface_atlas_layout : NULL;
+
+	ao_value_t* const ao_data = bake_ao_map_data(heightmap, max_y, compute_config, baked_surface_atlas_layout);
+	*cpu_copy = ao_data;
+
+	const AmbientOcclusionMap ao_map = init_ao_map_from_cpu_copy(heightmap, max_y, baked_surface_atlas_layout, ao_data);
+	if (bake_surface_atlas) deinit_ao_surface_atlas_layout(&surface_atlas_layout);
+	return ao_map;
+}
+
+#ifdef BENCHMARK_AO_BAKING
+
+// This gives dirs from independent random points, to compare the Sobol dirs against
+static vec3* init_independent_rand_dirs(const uint32_t seed, const trace_count_t num_trace_iters) {
+	static const GLfloat one_over_two_to_the_24 = 1.0f / 16777216.0f;
+
+	vec3* const rand_dirs = alloc(num_trace_iters, sizeof(vec3));
+	uint32_t state = hash_ao_sampling_seed(seed) | 1u; // A xorshift state can't be zero
+
+	for (trace_count_t i = 0; i < num_trace_iters; i++) {
+		GLfloat point[2];
+
+		for (byte j = 0; j < 2; j++) {
+			state ^= state << 13u;
+			state ^= state >> 17u;
+			state ^= state << 5u;
+			point[j] = (GLfloat) (state >> 8u) * one_over_two_to_the_24;
+		}
+
+		get_cosine_weighted_dir(point[0], point[1], rand_dirs[i]);
+	}
+
+	return rand_dirs;
+}
+
+/* This bakes the AO map on the CPU with more and more rays per point, and prints the RMS and max error of each
+bake against a reference bake with many Sobol dirs, and a different seed. That's done for both the Sobol dirs and
+independent random dirs. The errors are in AO map units, and points under the map aren't counted for them. */
+static void print_ao_sampling_errors(const Heightmap heightmap, const map_pos_component_t max_y,
+	const AmbientOcclusionComputeConfig* const compute_config, const MaxHeightPyramid* const max_height_pyramid) {
+
+	enum {num_reference_trace_iters = 2048, min_num_trace_iters = 16}; // The first one is the max in the shader
+
+	vec3* const reference_rand_dirs = init_rand_dirs(~ao_sampling_seed, num_reference_trace_iters);
+
+	ao_value_t* const reference_ao_data = bake_ao_map_on_cpu(heightmap, max_y, (const vec3*) reference_rand_dirs,
+		&(AmbientOcclusionComputeConfig) {.workload_split_factor = 1, .num_trace_iters = num_reference_trace_iters,
+			.max_num_ray_steps = compute_config -> max_num_ray_steps, .bake_on_cpu = true},
+		max_height_pyramid);
+
+	for (byte i = 0; i < 2; i++) {
+		const bool use_sobol_dirs = i == 0;
+
+		vec3* (*const init_dirs)(const uint32_t, const trace_count_t) =
+			use_sobol_dirs ? init_rand_dirs : init_independent_rand_dirs;
+
+		for (trace_count_t num_trace_iters = min_num_trace_iters;
+			num_trace_iters < num_reference_trace_iters; num_trace_iters *= 2u) {
+
+			vec3* const rand_dirs = init_dirs(ao_sampling_seed, num_trace_iters);
+
+			ao_value_t* const ao_data = bake_ao_map_on_cpu(heightmap, max_y, (const vec3*) rand_dirs,
+				&(AmbientOcclusionComputeConfig) {.workload_split_factor = 1, .num_trace_iters = num_trace_iters,
+					.max_num_ray_steps = compute_config -> max_num_ray_steps, .bake_on_cpu = true},
+				max_height_pyramid);
+
+			GLdouble squared_error_sum = 0.0;
+			buffer_size_t num_points_above_map = 0, index = 0;
+			int max_error = 0;
+
+			for (map_pos_component_t y = 0; y < max_y; y++) {
+				for (map_pos_component_t z = 0; z < heightmap.size.z; z++) {
+					for (map_pos_component_t x = 0; x < heightmap.size.x; x++, index++) {
+						if (get_normal_data(heightmap, x, y, z).location_status == BelowMap) continue;
+
+						const int error = abs(ao_data[index] - reference_ao_data[index]);
+						squared_error_sum += error * error;
+						if (error > max_error) max_error = error;
+						num_points_above_map++;
+					}
+				}
+			}
+
+			printf("AO sampling error with %u %s dirs: %.3f RMS, and %d at most\n", num_trace_iters,
+				use_sobol_dirs ? "Sobol" : "independent random", sqrt(squared_error_sum / num_points_above_map), max_error);
+
+			dealloc(ao_data);
+			dealloc(rand_dirs);
+		}
+	}
+
+	dealloc(reference_ao_data);
+	dealloc(reference_rand_dirs);
+}
+
+/* This bakes the AO map on the CPU and on the GPU a few times each, and prints how many rays per second each
+one traces, how much their results differ, and how the sampling error goes down with more rays. The GPU timings
+include making the shader, and reading back the results. Points under the map don't trace any rays, so they aren't counted for the rays per second; but rays
+that are skipped because of the max height pyramid are, since they still add to the AO. */
+void benchmark_ao_baking(const Heightmap heightmap, const map_pos_component_t max_y,
+	const AmbientOcclusionComputeConfig* const compute_config) {
+
+	enum {num_bakes_per_backend = 3};
+
+	const trace_count_t num_trace_iters = compute_config -> num_trace_iters;
+	vec3* const rand_dirs = init_rand_dirs(ao_sampling_seed, num_trace_iters);
+	const MaxHeightPyramid max_height_pyramid = init_max_height_pyramid(heightmap);
+
+	uint64_t num_rays_per_bake = 0;
+
+	for (map_pos_component_t y = 0; y < max_y; y++) {
+		for (map_pos_component_t z = 0; z < heightmap.size.z; z++) {
+			for (map_pos_component_t x = 0; x < heightmap.size.x; x++) {
+				if (get_normal_data(heightmap, x, y, z).location_status != BelowMap)
+					num_rays_per_bake += num_trace_iters;
+			}
+		}
+	}
+
+	//////////
+
+	ao_value_t* ao_data_per_backend[2];
+	const GLdouble seconds_per_count = 1.0 / (GLdouble) SDL_GetPerformanceFrequency();
+
+	for (byte on_gpu = 0; on_gpu < 2; on_gpu++) {
+		Uint64 total_counts = 0;
+
+		for (byte i = 0; i < num_bakes_per_backend; i++) {
+			glFinish();
+			const Uint64 start_count = SDL_GetPerformanceCounter();
+
+			ao_value_t* const ao_data = (on_gpu ? bake_ao_map_on_gpu : bake_ao_map_on_cpu)
+				(heightmap, max_y, (const vec3*) rand_dirs, compute_config, &max_height_pyramid);
+
+			total_counts += SDL_GetPerformanceCounter() - start_count;
+
+			if (i == 0) ao_data_per_backend[on_gpu] = ao_data;
+			else dealloc(ao_data);
+		}
+
+		const GLdouble seconds_per_bake = (GLdouble) total_counts * seconds_per_count / num_bakes_per_backend;
+
+		printf("Baking AO on the %s for a %ux%ux%u volume: %.3f s on average, or %.3g rays per second\n",
+			on_gpu ? "GPU" : "CPU", heightmap.size.x, heightmap.size.z, max_y,
+			seconds_per_bake, (GLdouble) num_rays_per_bake / seconds_per_bake);
+	}
+
+	print_ao_map_differences(ao_data_per_backend[0], ao_data_per_backend[1], heightmap, max_y);
+	print_ao_sampling_errors(heightmap, max_y, compute_config, &max_height_pyramid);
+
+	dealloc(ao_data_per_backend[0]);
+	dealloc(ao_data_per_backend[1]);
+	deinit_max_height_pyramid(&max_height_pyramid);
+	dealloc(rand_dirs);
+}
+
+#endif
+
+////////// Sparse brick storage
+
+/* Uniform bricks have this flag set in their indirection entry, with their value in the low byte. Bricks start out with
+it set, and a brick only gets a slot in the pool once it has more than one value; after that, it keeps its slot, even
+if it has only one value later on (which can happen during progressive bakes). This should be in sync with the same
+constant in `sample_ambient_occlusion.frag`. */
+static const ao_brick_entry_t uniform_ao_brick_flag = 1u << 31u;
+
+enum {
+	num_ao_pool_slots_per_slab = num_ao_pool_bricks_across * num_ao_pool_bricks_across,
+	ao_brick_pool_width = num_ao_pool_bricks_across * ao_padded_brick_size,
+	num_voxels_per_ao_pool_slab = ao_brick_pool_width * ao_brick_pool_width * ao_padded_brick_size
+};
+
+static buffer_size_t get_ao_brick_index(const AOBrickVolume* const volume, const buffer_size_t brick[3]) {
+	const buffer_size_t* const num_bricks = volume -> num_bricks;
+	return (brick[2] * num_bricks[1] + brick[1]) * num_bricks[0] + brick[0];
+}
+
+// The position is within the padded brick in the slot
+static ao_value_t* get_ao_brick_pool_voxel(const AOBrickVolume* const volume,
+	const ao_brick_entry_t slot, const buffer_size_t pos_in_brick[3]) {
+
+	const buffer_size_t pool_pos[3] = {
+		slot % num_ao_pool_bricks_across * ao_padded_brick_size + pos_in_brick[0],
+		slot / num_ao_pool_bricks_across % num_ao_pool_bricks_across * ao_padded_brick_size + pos_in_brick[1],
+		slot / num_ao_pool_slots_per_slab * ao_padded_brick_size + pos_in_brick[2]
+	};
+
+	return volume -> brick_pool + (pool_pos[2] * ao_brick_pool_width + pool_pos[1]) * ao_brick_pool_width + pool_pos[0];
+}
+
+/* This rebuilds a brick from the dense AO data. The voxels past the far edges of the data repeat the ones on the edges,
+like with `GL_CLAMP_TO_EDGE`, so that filtering near the edges gives the same results as with a dense texture. */
+static void write_ao_brick(AOBrickVolume* const volume, const ao_value_t* const ao_data, const buffer_size_t brick[3]) {
+	const buffer_size_t* const size = volume -> size;
+
+	ao_value_t padded_brick[ao_padded_brick_size][ao_padded_brick_size][ao_padded_brick_size];
+	bool is_uniform = true;
+
+	buffer_size_t src_end[3];
+	for (byte i = 0; i < 3; i++) src_end[i] = brick[i] * ao_brick_size + ao_padded_brick_size;
+
+	for (buffer_size_t d = 0, src_d = brick[2] * ao_brick_size; src_d < src_end[2]; d++, src_d++) {
+		for (buffer_size_t h = 0, src_h = brick[1] * ao_brick_size; src_h < src_end[1]; h++, src_h++) {
+			ao_value_t* const dest_row = padded_brick[d][h];
+
+			const ao_value_t* const src_row = ao_data + (((src_d < size[2]) ? src_d : (size[2] - 1u))
+				* size[1] + ((src_h < size[1]) ? src_h : (size[1] - 1u))) * size[0];
+
+			for (buffer_size_t w = 0, src_w = brick[0] * ao_brick_size; src_w < src_end[0]; w++, src_w++)
+				dest_row[w] = src_row[(src_w < size[0]) ? src_w : (size[0] - 1u)];
+		}
+	}
+
+	// This is done apart from the copying above, so that it's easy to vectorize
+	const ao_value_t first_value = padded_brick[0][0][0], * const brick_voxels = &padded_brick[0][0][0];
+
+	for (buffer_size_t i = 0; i < ao_padded_brick_size * ao_padded_brick_size * ao_padded_brick_size; i++)
+		is_uniform &= (brick_voxels[i] == first_value);
+
+	////////// Setting the indirection entry, and finding a slot if needed
+
+	ao_brick_entry_t* const entry = volume -> indirection + get_ao_brick_index(volume, brick);
+
+	if (*entry & uniform_ao_brick_flag) {
+		if (is_uniform) {
+			*entry = uniform_ao_brick_flag | first_value;
+			return;
+		}
+
+		/* Growing the pool by one slab at a time keeps it tight, and the pool texture is only resized once
+		per `upload_ao_brick_layers` call, so growing often doesn't lead to many uploads */
+		if (volume -> num_pool_slots_used == volume -> num_pool_slabs * num_ao_pool_slots_per_slab) {
+			const buffer_size_t num_pool_slabs = ++volume -> num_pool_slabs;
+
+			volume -> brick_pool = resizing_alloc(volume -> brick_pool,
+				num_pool_slabs * num_voxels_per_ao_pool_slab * sizeof(ao_value_t));
+
+			memset(volume -> brick_pool + (num_pool_slabs - 1u) * num_voxels_per_ao_pool_slab,
+				0, num_voxels_per_ao_pool_slab * sizeof(ao_value_t));
+		}
+
+		*entry = volume -> num_pool_slots_used++;
+	}
+
+	////////// Copying the brick into its slot
+
+	for (buffer_size_t d = 0; d < ao_padded_brick_size; d++) {
+		for (buffer_size_t h = 0; h < ao_padded_brick_size; h++)
+			memcpy(get_ao_brick_pool_voxel(volume, *entry, (buffer_size_t[]) {0, h, d}), padded_brick[d][h], ao_padded_brick_size);
+	}
+}
+
+// This rebuilds each brick in the layers of bricks along y from `first_layer` up to `end_layer`
+static void write_ao_brick_layers(AOBrickVolume* const volume, const ao_value_t* const ao_data,
+	const buffer_size_t first_layer, const buffer_size_t end_layer) {
+
+	for (buffer_size_t d = first_layer; d < end_layer; d++) {
+		for (buffer_size_t h = 0; h < volume -> num_bricks[1]; h++) {
+			for (buffer_size_t w = 0; w < volume -> num_bricks[0]; w++)
+				write_ao_brick(volume, ao_data, (buffer_size_t[]) {w, h, d});
+		}
+	}
+}
+
+// This gives the size of a brick volume in voxels and in bricks, and returns its number of indirection entries
+static buffer_size_t get_ao_brick_volume_size(const Heightmap heightmap, const map_pos_component_t max_y,
+	buffer_size_t size[3], buffer_size_t num_bricks[3]) {
+
+	size[0] = heightmap.size.x;
+	size[1] = heightmap.size.z;
+	size[2] = max_y;
+
+	for (byte i = 0; i < 3; i++) num_bricks[i] = (size[i] + ao_brick_size - 1u) / ao_brick_size;
+	return num_bricks[0] * num_bricks[1] * num_bricks[2];
+}
+
+AOBrickVolume init_ao_brick_volume(const Heightmap heightmap,
+	const map_pos_component_t max_y, const ao_value_t* const ao_data) {
+
+	buffer_size_t size[3], num_bricks[3];
+	const buffer_size_t num_entries = get_ao_brick_volume_size(heightmap, max_y, size, num_bricks);
+
+	ao_brick_entry_t* const indirection = alloc(num_entries, sizeof(ao_brick_entry_t));
+	for (buffer_size_t i = 0; i < num_entries; i++) indirection[i] = uniform_ao_brick_flag;
+
+	AOBrickVolume volume = {
+		.size = {size[0], size[1], size[2]},
+		.num_bricks = {num_bricks[0], num_bricks[1], num_bricks[2]},
+		.indirection = indirection,
+
+		// The pool always has at least one slab, so that its texture is never empty
+		.brick_pool = clearing_alloc(num_voxels_per_ao_pool_slab, sizeof(ao_value_t)),
+		.num_pool_slabs = 1, .num_pool_slots_used = 0
+	};
+
+	write_ao_brick_layers(&volume, ao_data, 0, num_bricks[2]);
+	return volume;
+}
+
+void deinit_ao_brick_volume(const AOBrickVolume* const volume) {
+	dealloc(volume -> indirection);
+	dealloc(volume -> brick_pool);
+}
+
+//////////
+
+ao_value_t fetch_from_ao_brick_volume(const AOBrickVolume* const volume, const buffer_size_t pos[3]) {
+	buffer_size_t brick[3], pos_in_brick[3];
+
+	for (byte i = 0; i < 3; i++) {
+		brick[i] = pos[i] / ao_brick_size;
+		pos_in_brick[i] = pos[i] % ao_brick_size;
+	}
+
+	const ao_brick_entry_t entry = volume -> indirection[get_ao_brick_index(volume, brick)];
+	if (entry & uniform_ao_brick_flag) return (ao_value_t) entry;
+	return *get_ao_brick_pool_voxel(volume, entry, pos_in_brick);
+}
+
+/* This does linear filtering in the same way as a dense texture with `GL_CLAMP_TO_EDGE` would, with the position in
+voxels (where voxel centers are at .5). The brick is picked from the first voxel that filtering reads, so the second
+one is always in the same padded brick. `sample_ao_brick_volume` in `sample_ambient_occlusion.frag` mirrors this. */
+GLfloat sample_ao_brick_volume(const AOBrickVolume* const volume, const vec3 pos) {
+	buffer_size_t brick[3], first_voxel_in_brick[3];
+	GLfloat weights[3];
+
+	for (byte i = 0; i < 3; i++) {
+		const GLfloat max_pos = (GLfloat) (volume -> num_bricks[i] * ao_brick_size) - 0.5f;
+		const GLfloat filter_pos = fminf(fmaxf(pos[i], 0.5f), max_pos) - 0.5f, first_voxel = floorf(filter_pos);
+
+		brick[i] = (buffer_size_t) first_voxel / ao_brick_size;
+		first_voxel_in_brick[i] = (buffer_size_t) first_voxel % ao_brick_size;
+		weights[i] = filter_pos - first_voxel;
+	}
+
+	const ao_brick_entry_t entry = volume -> indirection[get_ao_brick_index(volume, brick)];
+	if (entry & uniform_ao_brick_flag) return (GLfloat) (ao_value_t) entry / max_ao_value;
+
+	GLfloat value = 0.0f;
+
+	for (byte corner = 0; corner < 8; corner++) {
+		buffer_size_t voxel[3];
+		GLfloat weight = 1.0f;
+
+		for (byte i = 0; i < 3; i++) {
+			const bool is_upper = (corner >> i) & 1u;
+			voxel[i] = first_voxel_in_brick[i] + is_upper;
+			weight *= is_upper ? weights[i] : (1.0f - weights[i]);
+		}
+
+		value += weight * *get_ao_brick_pool_voxel(volume, entry, voxel);
+	}
+
+	return value / max_ao_value;
+}
+
+//////////
+
+static void upload_ao_brick_pool(const AOBrickVolume* const volume) {
+	init_texture_data(TexVolumetric, (GLsizei[]) {ao_brick_pool_width, ao_brick_pool_width,
+		(GLsizei) (volume -> num_pool_slabs * ao_padded_brick_size)}, GL_RED,
+		OPENGL_AO_MAP_INTERNAL_PIXEL_FORMAT, OPENGL_AO_MAP_COLOR_CHANNEL_TYPE, volume -> brick_pool);
+}
+
+static AmbientOcclusionMap init_ao_map_from_brick_volume(const AOBrickVolume* const volume) {
+	const GLint prev_unpack_alignment = save_and_set_unpack_alignment(sizeof(ao_value_t));
+
+	const GLuint indirection_texture = preinit_texture(TexVolumetric, TexNonRepeating, TexNearest, TexNearest, false);
+
+	init_texture_data(TexVolumetric, (GLsizei[]) {(GLsizei) volume -> num_bricks[0], (GLsizei) volume -> num_bricks[1],
+		(GLsizei) volume -> num_bricks[2]}, GL_RED_INTEGER, GL_R32UI, GL_UNSIGNED_INT, volume -> indirection);
+
+	// Lookups never cross bricks, and the bricks are not in any spatial order in the pool, so it has no mipmaps
+	const GLuint brick_pool_texture = preinit_texture(TexVolumetric, TexNonRepeating, TexLinear, TexLinear, false);
+	upload_ao_brick_pool(volume);
+
+	set_unpack_alignment(prev_unpack_alignment);
+	return (AmbientOcclusionMap) {.indirection_texture = indirection_texture, .brick_pool_texture = brick_pool_texture};
+}
+
+/* This writes the layers of bricks from `first_layer` up to `end_layer` to the AO map, after `write_ao_brick_layers`.
+If the pool grew while writing them, the whole pool is written; and otherwise, only the slabs that the layers use are. */
+static void upload_ao_brick_layers(const AOBrickVolume* const volume, const AmbientOcclusionMap* const ao_map,
+	const buffer_size_t first_layer, const buffer_size_t end_layer, const buffer_size_t prev_num_pool_slabs) {
+
+	const buffer_size_t* const num_bricks = volume -> num_bricks;
+	const buffer_size_t num_bricks_per_layer = num_bricks[0] * num_bricks[1];
+	const ao_brick_entry_t* const layer_entries = volume -> indirection + first_layer * num_bricks_per_layer;
+
+	const GLint prev_unpack_alignment = save_and_set_unpack_alignment(sizeof(ao_value_t));
+
+	////////// Writing the indirection entries
+
+	glActiveTexture(GL_TEXTURE0 + TU_AmbientOcclusionMap);
+	use_texture(TexVolumetric, ao_map -> indirection_texture);
+
+	glTexSubImage3D(TexVolumetric, 0, 0, 0, (GLint) first_layer, (GLsizei) num_bricks[0], (GLsizei) num_bricks[1],
+		(GLsizei) (end_layer - first_layer), GL_RED_INTEGER, GL_UNSIGNED_INT, layer_entries);
+
+	////////// Writing the bricks
+
+	glActiveTexture(GL_TEXTURE0 + TU_AmbientOcclusionBrickPool);
+	use_texture(TexVolumetric, ao_map -> brick_pool_texture);
+
+	if (volume -> num_pool_slabs != prev_num_pool_slabs) upload_ao_brick_pool(volume);
+	else {
+		buffer_size_t first_slot = volume -> num_pool_slots_used, last_slot = 0;
+
+		for (buffer_size_t i = 0; i < (end_layer - first_layer) * num_bricks_per_layer; i++) {
+			const ao_brick_entry_t entry = layer_entries[i];
+			if (entry & uniform_ao_brick_flag) continue;
+			if (entry < first_slot) first_slot = entry;
+			if (entry > last_slot) last_slot = entry;
+		}
+
+		if (first_slot <= last_slot) {
+			const buffer_size_t
+				first_slab = first_slot / num_ao_pool_slots_per_slab,
+				end_slab = last_slot / num_ao_pool_slots_per_slab + 1u;
+
+			glTexSubImage3D(TexVolumetric, 0, 0, 0, (GLint) (first_slab * ao_padded_brick_size),
+				ao_brick_pool_width, ao_brick_pool_width, (GLsizei) ((end_slab - first_slab) * ao_padded_brick_size),
+				GL_RED, OPENGL_AO_MAP_COLOR_CHANNEL_TYPE, volume -> brick_pool + first_slab * num_voxels_per_ao_pool_slab);
+		}
+	}
+
+	set_unpack_alignment(prev_unpack_alignment);
+}
+
+////////// Surface atlas textures
+
+static void upload_ao_surface_atlas(const AOSurfaceAtlasLayout* const layout, const ao_value_t* const texels) {
+	init_texture_data(TexPlain, (GLsizei[]) {(GLsizei) layout -> size[0], (GLsizei) layout -> size[1]},
+		GL_RED, OPENGL_AO_MAP_INTERNAL_PIXEL_FORMAT, OPENGL_AO_MAP_COLOR_CHANNEL_TYPE, texels);
+}
+
+static void init_ao_surface_atlas_textures(const AOSurfaceAtlasLayout* const layout,
+	const ao_value_t* const texels, AmbientOcclusionMap* const ao_map) {
+
+	const GLint prev_unpack_alignment = save_and_set_unpack_alignment(sizeof(ao_value_t));
+
+	// Lookups never cross tiles, so the atlas has no mipmaps
+	ao_map -> surface_atlas_texture = preinit_texture(TexPlain, TexNonRepeating, TexLinear, TexLinear, false);
+	upload_ao_surface_atlas(layout, texels);
+
+	const map_pos_xz_t map_size = layout -> map_size;
+	ao_map -> wall_tile_texture = preinit_texture(TexSet, TexNonRepeating, TexNearest, TexNearest, false);
+
+	init_texture_data(TexSet, (GLsizei[]) {map_size.x + 1, map_size.z + 1, 2},
+		GL_RGBA_INTEGER, GL_RGBA16UI, GL_UNSIGNED_SHORT, layout -> wall_tile_entries);
+
+	set_unpack_alignment(prev_unpack_alignment);
+}
+
+//////////
+
+AmbientOcclusionMap init_ao_map_from_cpu_copy(
+	const Heightmap heightmap,
+	const map_pos_component_t max_y,
+	const AOSurfaceAtlasLayout* const surface_atlas_layout,
+	const ao_value_t* const cpu_data) {
+
+	const AOBrickVolume brick_volume = init_ao_brick_volume(heightmap, max_y, cpu_data);
+	AmbientOcclusionMap ao_map = init_ao_map_from_brick_volume(&brick_volume);
+	deinit_ao_brick_volume(&brick_volume);
+
+	if (surface_atlas_layout != NULL) init_ao_surface_atlas_textures(surface_atlas_layout,
+		cpu_data + get_num_ao_volume_values(heightmap, max_y), &ao_map);
+
+	return ao_map;
+}
+
+void deinit_ao_map(const AmbientOcclusionMap* const ao_map) {
+	deinit_texture(ao_map -> indirection_texture);
+	deinit_texture(ao_map -> brick_pool_texture);
+
+	if (ao_map -> surface_atlas_texture != 0) {
+		deinit_texture(ao_map -> surface_atlas_texture);
+		deinit_texture(ao_map -> wall_tile_texture);
+	}
+}
+
+////////// Progressive baking
+
+// These bound how much baking is done in one frame
+enum {
+	max_cpu_baking_milliseconds_per_frame = 8
+};
+
+/* This writes the bricks that the y slices touched by the rows from `first_row` up to `end_row` are in to the AO map.
+The first slice of a layer of bricks is also in the padding of the layer before it. */
+static void write_ao_map_slices(ProgressiveAOBake* const bake, const AmbientOcclusionMap* const ao_map,
+	const buffer_size_t first_row, const buffer_size_t end_row) {
+
+	const map_pos_xz_t map_size = bake -> heightmap.size;
+	const buffer_size_t first_y = first_row / map_size.z, end_y = (end_row + map_size.z - 1u) / map_size.z;
+
+	const buffer_size_t
+		first_layer = ((first_y == 0) ? 0 : (first_y - 1u)) / ao_brick_size,
+		end_layer = (end_y - 1u) / ao_brick_size + 1u,
+		prev_num_pool_slabs = bake -> brick_volume.num_pool_slabs;
+
+	write_ao_brick_layers(&bake -> brick_volume, bake -> ao_data, first_layer, end_layer);
+	upload_ao_brick_layers(&bake -> brick_volume, ao_map, first_layer, end_layer, prev_num_pool_slabs);
+}
+
+/* This starts the worker pool once for the frame, over all of the jobs that are left, and helps out with them on this thread
+until the time budget for CPU baking runs out. The pool is then stopped, and this returns how many jobs were done,
+which are always the first ones. At least one job is run, so that a bake always moves forward. */
+static buffer_size_t run_jobs_on_worker_pool_within_frame_budget(const worker_pool_job_t job,
+	void* const job_data, const buffer_size_t num_jobs) {
+
+	const Uint64
+		start_count = SDL_GetPerformanceCounter(),
+		max_num_counts = SDL_GetPerformanceFrequency() * max_cpu_baking_milliseconds_per_frame / 1000u;
+
+	WorkerPool worker_pool;
+	start_worker_pool(&worker_pool, job, job_data, num_jobs);
+
+	while (run_worker_pool_job(&worker_pool) && SDL_GetPerformanceCounter() - start_count < max_num_counts);
+
+	const buffer_size_t num_jobs_done = stop_worker_pool(&worker_pool);
+	finish_worker_pool(&worker_pool);
+	return num_jobs_done;
+}
+
+ProgressiveAOBake init_progressive_ao_bake(const Heightmap heightmap, const map_pos_component_t max_y,
+	const AmbientOcclusionComputeConfig* const compute_config, AmbientOcclusionMap* const flat_ao_map) {
+
+	const trace_count_t num_trace_iters = compute_config -> num_trace_iters;
+	const bool bake_surface_atlas = compute_config -> bake_surface_atlas;
+
+	////////// Making a flat AO map
+
+	const AOSurfaceAtlasLayout surface_atlas_layout = bake_surface_atlas
+		? init_ao_surface_atlas_layout(heightmap) : (AOSurfaceAtlasLayout) {0};
+
+	const buffer_size_t
+		num_volume_values = get_num_ao_volume_values(heightmap, max_y),
+		num_atlas_texels = surface_atlas_layout.size[0] * surface_atlas_layout.size[1];
+
+	ao_value_t* const ao_data = alloc(num_volume_values + num_atlas_texels, sizeof(ao_value_t));
+	const ao_value_t unoccluded_ao_value = get_ao_term_from_collision_count(0, num_trace_iters);
+	ao_value_t* ao_value = ao_data;
+
+	for (map_pos_component_t y = 0; y < max_y; y++) {
+		for (map_pos_component_t z = 0; z < heightmap.size.z; z++) {
+			for (map_pos_component_t x = 0; x < heightmap.size.x; x++, ao_value++)
+				*ao_value = (get_normal_data(heightmap, x, y, z).location_status == BelowMap) ? 0 : unoccluded_ao_value;
+		}
+	}
+
+	memset(ao_data + num_volume_values, unoccluded_ao_value, num_atlas_texels);
+
+	const AOBrickVolume brick_volume = init_ao_brick_volume(heightmap, max_y, ao_data);
+	*flat_ao_map = init_ao_map_from_brick_volume(&brick_volume);
+
+	if (bake_surface_atlas) init_ao_surface_atlas_textures(&surface_atlas_layout, ao_data + num_volume_values, flat_ao_map);
+
+	////////// Setting up the baking state
+
+	vec3* const rand_dirs = init_rand_dirs(ao_sampling_seed, num_trace_iters);
+	const MaxHeightPyramid max_height_pyramid = init_max_height_pyramid(heightmap);
+
+	const buffer_size_t num_rows_per_gpu_chunk = get_num_rows_per_gpu_chunk(heightmap.size.x, compute_config);
+
+	return (ProgressiveAOBake) {
+		.heightmap = heightmap, .max_y = max_y, .compute_config = *compute_config,
+		.rand_dirs = rand_dirs, .max_height_pyramid = max_height_pyramid, .ao_data = ao_data,
+		.brick_volume = brick_volume,
+		.surface_atlas_layout = surface_atlas_layout, .next_surface_atlas_job = 0,
+
+		.num_rows = max_y * heightmap.size.z, .num_rows_per_gpu_chunk = num_rows_per_gpu_chunk,
+		.next_row = 0, .first_row_in_flight = 0,
+
+		.gpu_context = compute_config -> bake_on_cpu ? (GPUAOBakingContext) {0} : init_gpu_ao_baking_context(
+			heightmap, max_y, (const vec3*) rand_dirs, compute_config, &max_height_pyramid, num_rows_per_gpu_chunk * heightmap.size.x),
+
+		.chunk_in_flight_fence = NULL
+	};
+}
+
+// This returns true once the whole AO volume is baked, and it does nothing after that
+static bool update_progressive_ao_volume_bake(ProgressiveAOBake* const bake, const AmbientOcclusionMap* const ao_map) {
+	const map_pos_component_t map_width = bake -> heightmap.size.x;
+	const AmbientOcclusionComputeConfig* const compute_config = &bake -> compute_config;
+
+	////////// Baking rows on the CPU until the time budget runs out
+
+	if (compute_config -> bake_on_cpu) {
+		if (bake -> next_row == bake -> num_rows) return true;
+
+		const buffer_size_t first_row = bake -> next_row;
+
+		CPUAOBakingJobData job_data = {bake -> heightmap, bake -> max_y, (const vec3*) bake -> rand_dirs,
+			compute_config, &bake -> max_height_pyramid, first_row, bake -> ao_data};
+
+		bake -> next_row += run_jobs_on_worker_pool_within_frame_budget(cpu_ao_baking_job, &job_data, bake -> num_rows - first_row);
+
+		write_ao_map_slices(bake, ao_map, first_row, bake -> next_row);
+		return bake -> next_row == bake -> num_rows;
+	}
+
+	////////// Reading back the chunk in flight on the GPU, if it's done
+
+	GLsync* const fence = &bake -> chunk_in_flight_fence;
+
+	if (*fence != NULL) {
+		const GLenum wait_result = glClientWaitSync(*fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+
+		if (wait_result == GL_TIMEOUT_EXPIRED) return false;
+		else if (wait_result == GL_WAIT_FAILED) FAIL(CreateTexture, "Could not wait for rows %u to %u "
+			"of the ambient occlusion map to be baked", bake -> first_row_in_flight, bake -> next_row);
+
+		glDeleteSync(*fence);
+		*fence = NULL;
+
+		const buffer_size_t first_row = bake -> first_row_in_flight, end_row = bake -> next_row;
+
+		read_gpu_ao_baking_chunk(&bake -> gpu_context, compute_config,
+			(end_row - first_row) * map_width, bake -> ao_data + first_row * map_width);
+
+		write_ao_map_slices(bake, ao_map, first_row, end_row);
+	}
+
+	////////// Dispatching the next chunk on the GPU
+
+	if (bake -> next_row == bake -> num_rows) return true;
+
+	const buffer_size_t num_rows_left = bake -> num_rows - bake -> next_row;
+
+	const buffer_size_t num_rows_in_chunk = (num_rows_left < bake -> num_rows_per_gpu_chunk)
+		? num_rows_left : bake -> num_rows_per_gpu_chunk;
+
+	dispatch_gpu_ao_baking_chunk(&bake -> gpu_context, compute_config -> workload_split_factor,
+		bake -> next_row * map_width, num_rows_in_chunk * map_width);
+
+	*fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	bake -> first_row_in_flight = bake -> next_row;
+	bake -> next_row += num_rows_in_chunk;
+
+	return false;
+}
+
+// Like the volume on the CPU, the atlas's jobs are run until the time budget runs out
+static bool update_progressive_ao_surface_atlas_bake(ProgressiveAOBake* const bake, const AmbientOcclusionMap* const ao_map) {
+	const AOSurfaceAtlasLayout* const layout = &bake -> surface_atlas_layout;
+	const buffer_size_t num_jobs = get_num_ao_surface_atlas_jobs(layout);
+	ao_value_t* const texels = bake -> ao_data + bake -> num_rows * bake -> heightmap.size.x;
+
+	if (bake -> next_surface_atlas_job == num_jobs) return true;
+
+	const CPUAOBakingJobData tracing = {bake -> heightmap, bake -> max_y, (const vec3*) bake -> rand_dirs,
+		&bake -> compute_config, &bake -> max_height_pyramid, 0, NULL};
+
+	AOSurfaceAtlasJobData job_data = {&tracing, layout, bake -> next_surface_atlas_job, texels};
+
+	bake -> next_surface_atlas_job += run_jobs_on_worker_pool_within_frame_budget(
+		ao_surface_atlas_baking_job, &job_data, num_jobs - bake -> next_surface_atlas_job);
+
+	if (bake -> next_surface_atlas_job < num_jobs) return false;
+
+	const GLint prev_unpack_alignment = save_and_set_unpack_alignment(sizeof(ao_value_t));
+
+	glActiveTexture(GL_TEXTURE0 + TU_AmbientOcclusionSurfaceAtlas);
+	use_texture(TexPlain, ao_map -> surface_atlas_texture);
+
+	upload_ao_surface_atlas(layout, texels);
+
+	set_unpack_alignment(prev_unpack_alignment);
+	return true;
+}
+
+bool update_progressive_ao_bake(ProgressiveAOBake* const bake, const AmbientOcclusionMap* const ao_map) {
+	if (!update_progressive_ao_volume_bake(bake, ao_map)) return false;
+	return !bake -> compute_config.bake_surface_atlas || update_progressive_ao_surface_atlas_bake(bake, ao_map);
+}
+
+void deinit_progressive_ao_bake(const ProgressiveAOBake* const bake) {
+	if (bake -> chunk_in_flight_fence != NULL) glDeleteSync(bake -> chunk_in_flight_fence);
+	if (!bake -> compute_config.bake_on_cpu) deinit_gpu_ao_baking_context(&bake -> gpu_context);
+
+	deinit_max_height_pyramid(&bake -> max_height_pyramid);
+	dealloc(bake -> rand_dirs);
+	dealloc(bake -> ao_data);
+	deinit_ao_brick_volume(&bake -> brick_volume);
+	if (bake -> compute_config.bake_surface_atlas) deinit_ao_surface_atlas_layout(&bake -> surface_atlas_layout);
+}
+
+////////// The cached form
+
+/* The cached form of an AO map has the same data as its textures, so that they can be uploaded straight from it: the
+brick volume's indirection entries come first, then the surface atlas's texels (if it's baked), and then the brick pool's
+slabs. The pool goes last, since its size is the only one that doesn't follow from the map's size. */
+
+static size_t get_num_ao_surface_atlas_bytes(const AOSurfaceAtlasLayout* const surface_atlas_layout) {
+	if (surface_atlas_layout == NULL) return 0u;
+	return (size_t) surface_atlas_layout -> size[0] * surface_atlas_layout -> size[1] * sizeof(ao_value_t);
+}
+
+byte* init_cached_form_of_ao_bake(const ProgressiveAOBake* const bake, size_t* const num_bytes) {
+	const AOBrickVolume* const volume = &bake -> brick_volume;
+	const buffer_size_t* const num_bricks = volume -> num_bricks;
+
+	const size_t
+		num_indirection_bytes = (size_t) num_bricks[0] * num_bricks[1] * num_bricks[2] * sizeof(ao_brick_entry_t),
+		num_atlas_bytes = get_num_ao_surface_atlas_bytes(bake -> compute_config.bake_surface_atlas ? &bake -> surface_atlas_layout : NULL),
+		num_pool_bytes = (size_t) volume -> num_pool_slabs * num_voxels_per_ao_pool_slab * sizeof(ao_value_t);
+
+	byte* const cached_form = alloc(num_indirection_bytes + num_atlas_bytes + num_pool_bytes, sizeof(byte));
+
+	memcpy(cached_form, volume -> indirection, num_indirection_bytes);
+	memcpy(cached_form + num_indirection_bytes, bake -> ao_data + bake -> num_rows * bake -> heightmap.size.x, num_atlas_bytes);
+	memcpy(cached_form + num_indirection_bytes + num_atlas_bytes, volume -> brick_pool, num_pool_bytes);
+
+	*num_bytes = num_indirection_bytes + num_atlas_bytes + num_pool_bytes;
+	return cached_form;
+}
+
+bool init_ao_map_from_cached_form(const Heightmap heightmap, const map_pos_component_t max_y,
+	const AOSurfaceAtlasLayout* const surface_atlas_layout, const byte* const cached_form,
+	const size_t num_bytes, AmbientOcclusionMap* const ao_map) {
+
+	buffer_size_t size[3], num_bricks[3];
+	const buffer_size_t num_entries = get_ao_brick_volume_size(heightmap, max_y, size, num_bricks);
+
+	////////// Checking that the cached form fits the map
+
+	const size_t
+		num_indirection_bytes = (size_t) num_entries * sizeof(ao_brick_entry_t),
+		num_atlas_bytes = get_num_ao_surface_atlas_bytes(surface_atlas_layout),
+		num_slab_bytes = num_voxels_per_ao_pool_slab * sizeof(ao_value_t);
+
+	if (num_bytes <= num_indirection_bytes + num_atlas_bytes) return false;
+
+	const size_t num_pool_bytes = num_bytes - num_indirection_bytes - num_atlas_bytes;
+
+	/* The pool always has at least one slab, and it only grows once it's full; and since a brick never gets more
+	than one slot, the pool never has more slabs than it takes to hold a slot for each brick */
+	const size_t
+		num_pool_slabs = num_pool_bytes / num_slab_bytes,
+		num_slabs_for_all_bricks = (num_entries + num_ao_pool_slots_per_slab - 1u) / num_ao_pool_slots_per_slab,
+		max_num_pool_slabs = (num_slabs_for_all_bricks == 0u) ? 1u : num_slabs_for_all_bricks;
+
+	if (num_pool_bytes % num_slab_bytes != 0u || num_pool_slabs > max_num_pool_slabs) return false;
+
+	/* The cached form starts on a page boundary when it's mapped, and at the start of an allocation when it's
+	decompressed, so the entries are aligned. An entry that points past the pool would be read out of bounds. */
+	const ao_brick_entry_t* const indirection = (const ao_brick_entry_t*) cached_form;
+	const ao_brick_entry_t num_pool_slots = (ao_brick_entry_t) (num_pool_slabs * num_ao_pool_slots_per_slab);
+
+	for (buffer_size_t i = 0; i < num_entries; i++) {
+		const ao_brick_entry_t entry = indirection[i];
+		if (!(entry & uniform_ao_brick_flag) && entry >= num_pool_slots) return false;
+	}
+
+	////////// Uploading the textures
+
+	// The volume is only read from when uploading, so it can point into the cached form
+	const AOBrickVolume volume = {
+		.size = {size[0], size[1], size[2]},
+		.num_bricks = {num_bricks[0], num_bricks[1], num_bricks[2]},
+		.indirection = (ao_brick_entry_t*) indirection,
+		.brick_pool = (ao_value_t*) (cached_form + num_indirection_bytes + num_atlas_bytes),
+		.num_pool_slabs = (buffer_size_t) num_pool_slabs
+	};
+
+	*ao_map = init_ao_map_from_brick_volume(&volume);
+
+	if (surface_atlas_layout != NULL) init_ao_surface_atlas_textures(surface_atlas_layout,
+		(const ao_value_t*) (cached_form + num_indirection_bytes), ao_map);
+
+	return true;
 }
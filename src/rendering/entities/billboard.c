@@ -208,11 +208,18 @@ BillboardContext init_billboard_context(
 
 	const GLsizei texture_size = shared_material_properties -> texture_rescale_size;
 
+	SDL_Surface* albedo_surface;
+
 	const GLuint albedo_texture_set = init_texture_set(
-		true, true, TexNonRepeating, OPENGL_LEVEL_MAG_FILTER, OPENGL_LEVEL_MIN_FILTER,
-		num_still_textures, num_animation_layouts, texture_size, texture_size, still_texture_paths, animation_layouts
+		true, true, TexNonRepeating, OPENGL_LEVEL_MAG_FILTER, OPENGL_LEVEL_MIN_FILTER, num_still_textures,
+		num_animation_layouts, texture_size, texture_size, still_texture_paths, animation_layouts, &albedo_surface
 	);
 
+	const GLuint normal_map_set = init_normal_map_from_albedo_texture(normal_map_creator,
+		&shared_material_properties -> normal_map_config, albedo_texture_set, albedo_surface, TexSet);
+
+	deinit_surface(albedo_surface);
+
 	////////// Building the sort refs
 
 	List distance_sort_refs = init_list(num_billboards, BillboardDistanceSortRef);
@@ -249,13 +256,7 @@ BillboardContext init_billboard_context(
 				"shaders/common/world_shading.frag", NULL
 			),
 
-			albedo_texture_set,
-
-			init_normal_map_from_albedo_texture(
-				normal_map_creator,
-				&shared_material_properties -> normal_map_config,
-				albedo_texture_set, TexSet
-			)
+			albedo_texture_set, normal_map_set
 		),
 
 		.shadow_mapping = {.depth_shader = depth_shader},
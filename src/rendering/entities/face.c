@@ -97,74 +97,14 @@ static void add_to_face_mesh(List* const face_mesh,
 
 	const byte face_info = (byte) (texture_id << 3u) | face_id;
 
-	const map_pos_component_t
-		near_x = face.origin[0], near_z = face.origin[1],
-		top_y = sector_max_visible_height;
-
-	switch (face.type) {
-		case Flat: {
-			const map_pos_component_t size_x = face.size[0], size_z = face.size[1];
-			const map_pos_component_t far_x = near_x + size_x, far_z = near_z + size_z;
-
-			push_ptr_to_list(face_mesh,
-				(face_mesh_t) {
-					{near_x, top_y, far_z, face_info},
-					{far_x, top_y, near_z, face_info},
-					{near_x, top_y, near_z, face_info},
-					{near_x, top_y, far_z, face_info},
-					{far_x, top_y, far_z, face_info},
-					{far_x, top_y, near_z, face_info}
-				});
-
-			break;
-		}
-		case Vert_NS: {
-			const map_pos_component_t size_z = face.size[0], size_y = face.size[1];
-			const map_pos_component_t far_z = near_z + size_z, bottom_y = top_y - size_y;
-
-			push_ptr_to_list(face_mesh,
-				side ? (face_mesh_t) {
-					{near_x, bottom_y, near_z, face_info},
-					{near_x, top_y, far_z, face_info},
-					{near_x, top_y, near_z, face_info},
-					{near_x, bottom_y, near_z, face_info},
-					{near_x, bottom_y, far_z, face_info},
-					{near_x, top_y, far_z, face_info}
-				} : (face_mesh_t) {
-					{near_x, top_y, near_z, face_info},
-					{near_x, top_y, far_z, face_info},
-					{near_x, bottom_y, near_z, face_info},
-					{near_x, top_y, far_z, face_info},
-					{near_x, bottom_y, far_z, face_info},
-					{near_x, bottom_y, near_z, face_info}
-				});
-
-			break;
-		}
-		case Vert_EW: {
-			const map_pos_component_t size_x = face.size[0], size_y = face.size[1];
-			const map_pos_component_t far_x = near_x + size_x, bottom_y = top_y - size_y;
-
-			push_ptr_to_list(face_mesh,
-				side ? (face_mesh_t) {
-					{near_x, top_y, near_z, face_info},
-					{far_x, top_y, near_z, face_info},
-					{near_x, bottom_y, near_z, face_info},
-					{far_x, top_y, near_z, face_info},
-					{far_x, bottom_y, near_z, face_info},
-					{near_x, bottom_y, near_z, face_info}
-				} : (face_mesh_t) {
-					{near_x, bottom_y, near_z, face_info},
-					{far_x, top_y, near_z, face_info},
-					{near_x, top_y, near_z, face_info},
-					{near_x, bottom_y, near_z, face_info},
-					{far_x, bottom_y, near_z, face_info},
-					{far_x, top_y, near_z, face_info}
-				});
-
-			break;
-		}
-	}
+	/* Each face is pushed as one compact record, which the sector vertex shaders expand into a quad
+	via `gl_VertexID`. For flat faces, origin and size are top-down; and for vertical faces, size 0 is
+	along the top-down origin axis that varies, and size 1 is the depth. The last two bytes are padding. */
+	push_ptr_to_list(face_mesh,
+		(face_mesh_t) {
+			face.origin[0], sector_max_visible_height, face.origin[1], face_info,
+			face.size[0], face.size[1], 0, 0
+		});
 }
 
 // This initializes `face_mesh` and `biggest_face_height`
@@ -217,6 +157,29 @@ void init_mesh_for_sector(const Sector* const sector,
 	}
 }
 
+// This gets a face's bounding box, in world space. See `sector_face.vert` for how a face's record maps to its corners.
+void get_face_aabb(const face_mesh_t face, vec3 aabb[2]) {
+	const map_pos_component_t x = face[0], top_y = face[1], z = face[2], size[2] = {face[4], face[5]};
+	const byte face_id = face[3] & 7u;
+
+	GLfloat* const min = aabb[0];
+	GLfloat* const max = aabb[1];
+
+	min[0] = max[0] = x;
+	min[1] = max[1] = top_y;
+	min[2] = max[2] = z;
+
+	if (face_id == 0u) { // Flat
+		max[0] += size[0];
+		max[2] += size[1];
+	}
+	else {
+		min[1] -= size[1];
+		if (face_id & 1u) max[2] += size[0]; // NS
+		else max[0] += size[0]; // EW
+	}
+}
+
 List init_map_edge_mesh(const Heightmap heightmap) {
 	// TODO: make this a constant somewhere
 	buffer_size_t submesh_amount_guess = (heightmap.size.x + heightmap.size.z) / 6;
@@ -0,0 +1,308 @@
+#include "rendering/entities/metasector_tree.h"
+#include "rendering/entities/sector.h" // For `Sector`
+#include "utils/alloc.h" // For `alloc`, and `dealloc`
+#include "data/constants.h" // For `planes_per_frustum`
+#include <stdlib.h> // For `qsort`
+#include <float.h> // For `FLT_MAX`
+
+// Leaves with this many sectors or fewer test their sectors one by one.
+static const buffer_size_t max_sectors_per_metasector_leaf = 16u;
+
+typedef enum {OutsideFrustum, IntersectsFrustum, InsideFrustum} FrustumOverlap;
+
+////////// Utils
+
+/* The outside test here is the same as the one in `glm_aabb_frustum`, so a metasector is never
+rejected if one of its sectors would have been accepted by it. For the inside test, the box corner
+furthest against each plane's normal must be in front of that plane. */
+static FrustumOverlap get_aabb_frustum_overlap(const vec3 aabb[2], const vec4* const frustum_planes) {
+	FrustumOverlap overlap = InsideFrustum;
+
+	for (byte i = 0; i < planes_per_frustum; i++) {
+		const GLfloat* const plane = frustum_planes[i];
+
+		const GLfloat
+			farthest_dist = plane[0] * aabb[plane[0] > 0.0f][0]
+				+ plane[1] * aabb[plane[1] > 0.0f][1] + plane[2] * aabb[plane[2] > 0.0f][2],
+
+			nearest_dist = plane[0] * aabb[plane[0] <= 0.0f][0]
+				+ plane[1] * aabb[plane[1] <= 0.0f][1] + plane[2] * aabb[plane[2] <= 0.0f][2];
+
+		if (farthest_dist < -plane[3]) return OutsideFrustum;
+		if (nearest_dist < -plane[3]) overlap = IntersectsFrustum;
+	}
+
+	return overlap;
+}
+
+// Remeshing can leave a sector's list slot empty, and empty sectors have a size of zero
+static bool sector_is_empty(const Sector* const sector) {
+	return sector -> size.x == 0;
+}
+
+static void get_sector_aabb(const Sector* const sector, vec3 aabb[2]) {
+	const map_pos_xz_t origin = sector -> origin, size = sector -> size;
+
+	aabb[0][0] = origin.x;
+	aabb[0][1] = sector -> visible_heights.min;
+	aabb[0][2] = origin.z;
+
+	aabb[1][0] = origin.x + size.x;
+	aabb[1][1] = sector -> visible_heights.max;
+	aabb[1][2] = origin.z + size.z;
+}
+
+////////// Building the tree
+
+// `qsort` has no user data parameter, so these are set before sorting
+static const Sector* sectors_being_sorted;
+static byte sort_axis;
+
+// Sector centers are compared via doubled centers, to keep them integral
+static int compare_sector_centers(const void* const a, const void* const b) {
+	const Sector
+		*const sector_a = sectors_being_sorted + *(const buffer_size_t*) a,
+		*const sector_b = sectors_being_sorted + *(const buffer_size_t*) b;
+
+	const int
+		doubled_center_a = sort_axis
+			? (sector_a -> origin.z * 2 + sector_a -> size.z) : (sector_a -> origin.x * 2 + sector_a -> size.x),
+		doubled_center_b = sort_axis
+			? (sector_b -> origin.z * 2 + sector_b -> size.z) : (sector_b -> origin.x * 2 + sector_b -> size.x);
+
+	return doubled_center_a - doubled_center_b;
+}
+
+// This returns the index of the node after the subtree, which is where the next subtree would go.
+static buffer_size_t build_metasector_subtree(Metasector* const nodes, const buffer_size_t node_index,
+	const Sector* const sectors, buffer_size_t* const sector_indices,
+	const buffer_size_t first_index, const buffer_size_t num_sectors) {
+
+	Metasector* const node = nodes + node_index;
+	vec3* const aabb = node -> aabb;
+
+	node -> first_index = first_index;
+	node -> num_sectors = num_sectors;
+
+	glm_vec3_fill(aabb[0], FLT_MAX);
+	glm_vec3_fill(aabb[1], -FLT_MAX);
+
+	for (buffer_size_t i = first_index; i < first_index + num_sectors; i++) {
+		vec3 sector_aabb[2];
+		get_sector_aabb(sectors + sector_indices[i], sector_aabb);
+		glm_vec3_minv(aabb[0], sector_aabb[0], aabb[0]);
+		glm_vec3_maxv(aabb[1], sector_aabb[1], aabb[1]);
+	}
+
+	if (num_sectors <= max_sectors_per_metasector_leaf) {
+		node -> right_child_index = 0;
+		return node_index + 1u;
+	}
+
+	////////// Splitting the sectors in half along the longer axis of the node's box
+
+	sectors_being_sorted = sectors;
+	sort_axis = (aabb[1][2] - aabb[0][2]) > (aabb[1][0] - aabb[0][0]);
+	qsort(sector_indices + first_index, num_sectors, sizeof(buffer_size_t), compare_sector_centers);
+
+	const buffer_size_t num_left_sectors = num_sectors >> 1u;
+
+	const buffer_size_t right_child_index = build_metasector_subtree(nodes, node_index + 1u,
+		sectors, sector_indices, first_index, num_left_sectors);
+
+	node -> right_child_index = right_child_index;
+
+	return build_metasector_subtree(nodes, right_child_index, sectors, sector_indices,
+		first_index + num_left_sectors, num_sectors - num_left_sectors);
+}
+
+MetasectorTree init_metasector_tree(const List* const sectors, const buffer_size_t max_num_loose_sectors) {
+	const buffer_size_t num_sectors = sectors -> length;
+
+	/* Every internal node has two children, and each leaf has at least half of the
+	max sectors per leaf (unless there's only one leaf), so this bounds the node count. */
+	const buffer_size_t max_num_nodes = (num_sectors / (max_sectors_per_metasector_leaf >> 1u)) * 2u + 1u;
+
+	Metasector* const nodes = alloc(max_num_nodes, sizeof(Metasector));
+	buffer_size_t* const sector_indices = alloc(num_sectors + 1u, sizeof(buffer_size_t));
+
+	for (buffer_size_t i = 0; i < num_sectors; i++) sector_indices[i] = i;
+
+	const buffer_size_t num_nodes = (num_sectors == 0) ? 0u
+		: build_metasector_subtree(nodes, 0, sectors -> data, sector_indices, 0, num_sectors);
+
+	return init_metasector_tree_from_nodes(nodes, num_nodes, sector_indices, num_sectors, max_num_loose_sectors);
+}
+
+MetasectorTree init_metasector_tree_from_nodes(Metasector* const nodes, const buffer_size_t num_nodes,
+	buffer_size_t* const sector_indices, const buffer_size_t num_sectors, const buffer_size_t max_num_loose_sectors) {
+
+	return (MetasectorTree) {
+		nodes, sector_indices, init_bitarray(num_sectors + max_num_loose_sectors + 1u),
+		num_nodes, num_sectors, max_num_loose_sectors
+	};
+}
+
+void deinit_metasector_tree(const MetasectorTree* const metasector_tree) {
+	dealloc(metasector_tree -> nodes);
+	dealloc(metasector_tree -> sector_indices);
+	deinit_bitarray(metasector_tree -> visible_sectors);
+}
+
+////////// Refitting the tree
+
+// An inverted box never overlaps an area
+static bool metasector_overlaps_area(const Metasector* const node,
+	const map_pos_xz_t area_start, const map_pos_xz_t area_end) {
+
+	const vec3* const aabb = node -> aabb;
+
+	return aabb[0][0] < area_end.x && aabb[1][0] > area_start.x
+		&& aabb[0][2] < area_end.z && aabb[1][2] > area_start.z;
+}
+
+/* Empty sectors are left out of the boxes, and a subtree with only empty sectors gets an inverted box, which is never visible.
+Subtrees with a box outside of the area are skipped, since their sectors can't have changed. */
+static void refit_metasector_subtree(Metasector* const nodes, const buffer_size_t node_index,
+	const Sector* const sectors, const buffer_size_t* const sector_indices,
+	const map_pos_xz_t area_start, const map_pos_xz_t area_end) {
+
+	Metasector* const node = nodes + node_index;
+	vec3* const aabb = node -> aabb;
+
+	if (!metasector_overlaps_area(node, area_start, area_end)) return;
+
+	if (node -> right_child_index == 0) {
+		glm_vec3_fill(aabb[0], FLT_MAX);
+		glm_vec3_fill(aabb[1], -FLT_MAX);
+
+		for (buffer_size_t i = node -> first_index; i < node -> first_index + node -> num_sectors; i++) {
+			const Sector* const sector = sectors + sector_indices[i];
+			if (sector_is_empty(sector)) continue;
+
+			vec3 sector_aabb[2];
+			get_sector_aabb(sector, sector_aabb);
+			glm_vec3_minv(aabb[0], sector_aabb[0], aabb[0]);
+			glm_vec3_maxv(aabb[1], sector_aabb[1], aabb[1]);
+		}
+		return;
+	}
+
+	const Metasector
+		*const left_child = nodes + node_index + 1u,
+		*const right_child = nodes + node -> right_child_index;
+
+	refit_metasector_subtree(nodes, node_index + 1u, sectors, sector_indices, area_start, area_end);
+	refit_metasector_subtree(nodes, node -> right_child_index, sectors, sector_indices, area_start, area_end);
+
+	glm_vec3_minv((GLfloat*) left_child -> aabb[0], (GLfloat*) right_child -> aabb[0], aabb[0]);
+	glm_vec3_maxv((GLfloat*) left_child -> aabb[1], (GLfloat*) right_child -> aabb[1], aabb[1]);
+}
+
+/* This is for after remeshing has changed the sectors in an area, where `area_end` is exclusive. The tree's shape stays
+the same, since sectors keep their place in the list; so only the boxes are redone, which is much faster than building
+a new tree. A changed sector is in the area both before and after the change, so the leaf that it's in overlaps the area. */
+void refit_metasector_tree(const MetasectorTree* const metasector_tree, const List* const sectors,
+	const map_pos_xz_t area_start, const map_pos_xz_t area_end) {
+
+	if (metasector_tree -> num_nodes == 0) return;
+
+	refit_metasector_subtree(metasector_tree -> nodes, 0, sectors -> data,
+		metasector_tree -> sector_indices, area_start, area_end);
+}
+
+////////// Culling with the tree
+
+static void mark_visible_sectors_in_subtree(const MetasectorTree* const metasector_tree,
+	const Sector* const sectors, const buffer_size_t node_index, const vec4* const frustum_planes) {
+
+	const Metasector* const node = metasector_tree -> nodes + node_index;
+
+	const FrustumOverlap overlap = get_aabb_frustum_overlap((const vec3*) node -> aabb, frustum_planes);
+	if (overlap == OutsideFrustum) return;
+
+	if (overlap == IntersectsFrustum && node -> right_child_index != 0) {
+		mark_visible_sectors_in_subtree(metasector_tree, sectors, node_index + 1u, frustum_planes);
+		mark_visible_sectors_in_subtree(metasector_tree, sectors, node -> right_child_index, frustum_planes);
+		return;
+	}
+
+	const buffer_size_t* const sector_indices = metasector_tree -> sector_indices;
+	const BitArray visible_sectors = metasector_tree -> visible_sectors;
+
+	for (buffer_size_t i = node -> first_index; i < node -> first_index + node -> num_sectors; i++) {
+		const buffer_size_t sector_index = sector_indices[i];
+
+		if (overlap == IntersectsFrustum) {
+			vec3 aabb[2];
+			get_sector_aabb(sectors + sector_index, aabb);
+			if (!glm_aabb_frustum(aabb, (vec4*) frustum_planes)) continue;
+		}
+
+		set_bit_in_bitarray(visible_sectors, sector_index);
+	}
+}
+
+// Loose sectors come after the sectors in the tree, and they're tested one by one.
+static void mark_visible_loose_sectors(const MetasectorTree* const metasector_tree,
+	const List* const sectors, const vec4* const frustum_planes) {
+
+	const Sector* const sector_data = sectors -> data;
+	const BitArray visible_sectors = metasector_tree -> visible_sectors;
+
+	for (buffer_size_t i = metasector_tree -> num_sectors; i < sectors -> length; i++) {
+		const Sector* const sector = sector_data + i;
+		if (sector_is_empty(sector)) continue;
+
+		vec3 aabb[2];
+		get_sector_aabb(sector, aabb);
+		if (glm_aabb_frustum(aabb, (vec4*) frustum_planes)) set_bit_in_bitarray(visible_sectors, i);
+	}
+}
+
+// This walks the visible sector bitarray one chunk at a time, skipping over chunks that don't start or end a run.
+static void give_visible_sector_runs_to_callback(const MetasectorTree* const metasector_tree,
+	const buffer_size_t num_sectors, const visible_sector_run_callback_t callback, void* const callback_data) {
+
+	const BitArray visible_sectors = metasector_tree -> visible_sectors;
+	const buffer_size_t num_chunks = get_num_chunks_for_bitarray(num_sectors);
+
+	buffer_size_t run_start = 0;
+	bool in_run = false;
+
+	for (buffer_size_t chunk_index = 0; chunk_index < num_chunks; chunk_index++) {
+		const bitarray_chunk_t chunk = visible_sectors.chunks[chunk_index];
+		if (chunk == (in_run ? chunk_with_all_bits_set : 0u)) continue;
+
+		const buffer_size_t first_bit_index = chunk_index << log2_bits_per_chunk;
+
+		for (byte i = 0; i <= bits_per_chunk_minus_one; i++) {
+			const bool is_visible = (chunk >> i) & 1u;
+
+			if (is_visible != in_run) {
+				const buffer_size_t sector_index = first_bit_index + i;
+				if (is_visible) run_start = sector_index;
+				else callback(callback_data, run_start, sector_index - run_start);
+				in_run = is_visible;
+			}
+		}
+	}
+
+	// Bits past the last sector are never set, so a run can only reach the end if it ends on a chunk border
+	if (in_run) callback(callback_data, run_start, num_sectors - run_start);
+
+	clear_bitarray(visible_sectors, num_sectors);
+}
+
+void for_each_visible_sector_run(const MetasectorTree* const metasector_tree,
+	const List* const sectors, const vec4* const frustum_planes,
+	const visible_sector_run_callback_t callback, void* const callback_data) {
+
+	if (sectors -> length == 0) return;
+
+	if (metasector_tree -> num_nodes != 0)
+		mark_visible_sectors_in_subtree(metasector_tree, sectors -> data, 0, frustum_planes);
+
+	mark_visible_loose_sectors(metasector_tree, sectors, frustum_planes);
+	give_visible_sector_runs_to_callback(metasector_tree, sectors -> length, callback, callback_data);
+}
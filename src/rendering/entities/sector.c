@@ -1,11 +1,17 @@
 #include "rendering/entities/sector.h"
-#include "utils/map_utils.h" // For `sample_map`
+#include "utils/map_utils.h" // For `sample_map`, and `get_indexed_map_pos_component`
 #include "utils/bitarray.h" // // For various `BitArray`-related defs
 #include "rendering/entities/face.h" // For `init_mesh_for_sector`, and `init_map_edge_mesh`
 #include "utils/opengl_wrappers.h" // For various OpenGL wrappers
 #include "utils/macro_utils.h" // For `ARRAY_LENGTH`
 #include "utils/shader.h" // For `init_shader`
 #include "data/constants.h" // For `default_depth_func`
+#include <stdlib.h> // For `qsort`
+#include <string.h> // For `memcpy`, and `memset`
+#include <float.h> // For `FLT_MAX`
+#include <math.h> // For `fabsf`
+#include "utils/worker_pool.h" // For `run_jobs_on_worker_pool`
+#include "utils/sdl_include.h" // For `SDL_GetPerformanceCounter`, and `SDL_GetPerformanceFrequency`
 
 /* TODO:
 - For dynamic sectors, perhaps have a 2D floating-point map that represents the displacement
@@ -35,6 +41,26 @@ And the biggest number possible with five bits is 31, so that gives you
 32 different possible texture ids. Also, this is just for wall textures. */
 const map_texture_id_t max_num_sector_subtextures = 32u;
 
+/* Sector meshing is split into bands of this many rows (or columns, for column-first meshing), which are meshed
+on different threads. Sectors can't cross band borders, so a thin band gives more sectors; but this is kept
+fixed, rather than based on the CPU count, so that every machine makes the same mesh for a level. */
+static const map_pos_component_t sector_meshing_band_thickness = 64u;
+
+/* The shadow mesh is split into square chunks with sides this long on the top-down axes. Smaller chunks are culled
+more tightly against the shadow cascades, but give more bounding boxes to test, and more draw ranges. */
+static const map_pos_component_t shadow_mesh_chunk_size = 16u;
+
+/* Each sector ordering's section of the face mesh, and each shadow mesh chunk, have spare room for the faces of
+remeshed sectors. The spare room is an eighth of the faces that they start out with, plus a small minimum. */
+static const buffer_size_t spare_face_capacity_divisor = 8u, min_num_spare_faces = 16u;
+
+/* Remeshed sectors that don't fit in the list slots of the sectors that they replace go after the sectors in the
+metasector tree, where culling tests them one by one; so past this many of them, all sectors are meshed again. */
+static const buffer_size_t max_num_loose_sectors = 256u;
+
+// This goes up whenever the layout of the sector geometry in the level cache changes
+static const byte sector_geometry_format_version = 1u;
+
 ////////// The sector generation code
 
 // Attributes here are height and texture id
@@ -47,27 +73,54 @@ static byte point_matches_sector_attributes(const Sector* const sector,
 		sample_texture_id_map(texture_id_map_data, heightmap.size.x, pos) == texture_id;
 }
 
-// Gets length across, and then adds to area size z until out of map or length across not eq
+/* If `tile_size` is nonzero, sectors can't cross the borders of square tiles with sides that long (which distance-based
+LOD relies on). This returns where the tile that `pos` is in ends on an axis, or `end` if that comes first. */
+static map_pos_component_t get_end_of_sector_tile(const map_pos_component_t pos,
+	const map_pos_component_t tile_size, const map_pos_component_t end) {
+
+	if (tile_size == 0) return end;
+
+	const buffer_size_t tile_end = (pos / tile_size + 1u) * tile_size;
+	return (tile_end < end) ? (map_pos_component_t) tile_end : end;
+}
+
+/* Gets the length across the major axis, and then adds to the area size on the minor axis until the end on that axis,
+or until the length across is not equal. A major axis of 0 means that rows are scanned first, and 1 means columns. */
 static void form_sector_area(Sector* const sector, const BitArray traversed_points,
 	const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data,
-	const map_texture_id_t texture_id) {
+	const map_texture_id_t texture_id, const byte major_axis,
+	const map_pos_component_t major_axis_end, const map_pos_component_t minor_axis_end) {
 
+	const byte minor_axis = !major_axis;
 	const map_pos_xz_t origin = sector -> origin;
 
-	map_pos_xz_t size = sector -> size;
-	map_pos_component_t top_x = origin.x;
+	map_pos_xz_t size = sector -> size, pos = origin;
+
+	map_pos_component_t
+		*const size_on_major_axis = get_indexed_map_pos_component_ref(&size, major_axis),
+		*const size_on_minor_axis = get_indexed_map_pos_component_ref(&size, minor_axis),
+		*const pos_on_major_axis = get_indexed_map_pos_component_ref(&pos, major_axis),
+		*const pos_on_minor_axis = get_indexed_map_pos_component_ref(&pos, minor_axis);
 
-	while (top_x < heightmap.size.x && !bitarray_bit_is_set(traversed_points, origin.z * heightmap.size.x + top_x) &&
-		point_matches_sector_attributes(sector, heightmap, texture_id_map_data, (map_pos_xz_t) {top_x, origin.z}, texture_id)) {
+	const map_pos_component_t origin_on_major_axis = *pos_on_major_axis;
 
-		size.x++;
-		top_x++;
+	while (*pos_on_major_axis < major_axis_end &&
+		!bitarray_bit_is_set(traversed_points, (buffer_size_t) (pos.z * heightmap.size.x + pos.x)) &&
+		point_matches_sector_attributes(sector, heightmap, texture_id_map_data, pos, texture_id)) {
+
+		(*size_on_major_axis)++;
+		(*pos_on_major_axis)++;
 	}
 
-	// Now, `sector.size.x` equals the first horizontal span length where equal attributes were found
-	for (map_pos_component_t z = origin.z; z < heightmap.size.z; z++, size.z++) {
-		for (map_pos_component_t x = origin.x; x < top_x; x++) { // Here, `top_x` equals the top right corner
-			if (!point_matches_sector_attributes(sector, heightmap, texture_id_map_data, (map_pos_xz_t) {x, z}, texture_id))
+	/* Now, the size on the major axis equals the first span length where equal attributes were found.
+	The spans after the first one are checked for traversed points too, since when remeshing, every
+	point outside of the remeshed sectors is marked as traversed before any new sector is formed. */
+	const map_pos_component_t span_end = *pos_on_major_axis;
+
+	for (; *pos_on_minor_axis < minor_axis_end; (*pos_on_minor_axis)++, (*size_on_minor_axis)++) {
+		for (*pos_on_major_axis = origin_on_major_axis; *pos_on_major_axis < span_end; (*pos_on_major_axis)++) {
+			if (bitarray_bit_is_set(traversed_points, (buffer_size_t) (pos.z * heightmap.size.x + pos.x)) ||
+				!point_matches_sector_attributes(sector, heightmap, texture_id_map_data, pos, texture_id))
 				goto done;
 		}
 	}
@@ -75,7 +128,7 @@ static void form_sector_area(Sector* const sector, const BitArray traversed_poin
 	done: {
 		const map_pos_component_t base_x_index_for_map = origin.x, max_x_index_for_map = size.x - 1;
 
-		for (buffer_size_t z = origin.z; z < origin.z + size.z; z++) {
+		for (buffer_size_t z = origin.z; z < (buffer_size_t) (origin.z + size.z); z++) {
 			const buffer_size_t traversed_points_base_index = z * heightmap.size.x + base_x_index_for_map;
 
 			set_bit_range_in_bitarray(traversed_points,
@@ -87,34 +140,31 @@ static void form_sector_area(Sector* const sector, const BitArray traversed_poin
 	}
 }
 
-static void generate_sectors_and_face_mesh_from_maps(List* const sectors, List* const face_mesh,
-	const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data) {
-
-	//////////
-
-	const buffer_size_t num_map_grid_values = heightmap.size.x * heightmap.size.z;
+void generate_sectors_and_face_mesh_in_area(List* const sectors, List* const face_mesh,
+	const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data,
+	const BitArray traversed_points, const byte major_axis, const map_pos_component_t tile_size,
+	const map_pos_xz_t area_start, const map_pos_xz_t area_end) {
 
-	/* `>> 3` = `/ 8`. Works pretty well for my maps. TODO: make to a constant.
-	If the map size is small enough, an incorrect guess of zero can happen. */
-	buffer_size_t sector_amount_guess = num_map_grid_values >> 3;
-	if (sector_amount_guess == 0) sector_amount_guess = 1;
+	const byte minor_axis = !major_axis;
 
-	*sectors = init_list(sector_amount_guess, Sector);
+	const map_pos_component_t
+		map_size_on_major_axis = get_indexed_map_pos_component(heightmap.size, major_axis),
+		major_axis_area_start = get_indexed_map_pos_component(area_start, major_axis),
+		major_axis_area_end = get_indexed_map_pos_component(area_end, major_axis),
+		minor_axis_area_start = get_indexed_map_pos_component(area_start, minor_axis),
+		minor_axis_area_end = get_indexed_map_pos_component(area_end, minor_axis);
 
-	/* This contains the actual data for faces. `num_sectors * 3` gives a good
-	guess for the face/sector ratio. TODO: make this a constant somewhere. */
-	*face_mesh = init_list(sector_amount_guess * 3, face_mesh_t);
+	map_pos_xz_t pos;
 
-	//////////
+	map_pos_component_t
+		*const pos_on_major_axis = get_indexed_map_pos_component_ref(&pos, major_axis),
+		*const pos_on_minor_axis = get_indexed_map_pos_component_ref(&pos, minor_axis);
 
-	/* This is used to keep track of traversed points. To perform some action on a traversed point
-	at position <x, y>, the bit index will be `z * map_width + x`. */
-	const BitArray traversed_points = init_bitarray(num_map_grid_values);
+	for (*pos_on_minor_axis = minor_axis_area_start; *pos_on_minor_axis < minor_axis_area_end; (*pos_on_minor_axis)++) {
+		for (*pos_on_major_axis = major_axis_area_start; *pos_on_major_axis < major_axis_area_end; (*pos_on_major_axis)++) {
+			const map_pos_component_t x = pos.x, z = pos.z;
 
-	for (map_pos_component_t z = 0; z < heightmap.size.z; z++) {
-		const buffer_size_t traversed_points_base_index = z * heightmap.size.x;
-		for (map_pos_component_t x = 0; x < heightmap.size.x; x++) {
-			if (bitarray_bit_is_set(traversed_points, traversed_points_base_index + x)) continue;
+			if (bitarray_bit_is_set(traversed_points, (buffer_size_t) (z * heightmap.size.x + x))) continue;
 
 			////////// Finding a texture id
 
@@ -133,7 +183,9 @@ static void generate_sectors_and_face_mesh_from_maps(List* const sectors, List*
 				.face_range = {.start = 0, .length = 0}
 			};
 
-			form_sector_area(&sector, traversed_points, heightmap, texture_id_map_data, texture_id);
+			form_sector_area(&sector, traversed_points, heightmap, texture_id_map_data, texture_id, major_axis,
+				get_end_of_sector_tile(*pos_on_major_axis, tile_size, map_size_on_major_axis),
+				get_end_of_sector_tile(*pos_on_minor_axis, tile_size, minor_axis_area_end));
 
 			////////// Setting face mesh metadata + initing sector faces
 
@@ -148,335 +200,1745 @@ static void generate_sectors_and_face_mesh_from_maps(List* const sectors, List*
 
 			//////////
 
-			/* This is a simple optimization; the next `sector_width - 1`
+			/* This is a simple optimization; the next `sector_span_length - 1`
 			tiles will already be marked traversed, so this just skips those. */
-			x += sector.size.x - 1;
+			*pos_on_major_axis += get_indexed_map_pos_component(sector.size, major_axis) - 1;
 		}
 	}
+}
+
+// This meshes the band that spans from `band_start` to `band_end` (exclusive) on the minor axis.
+static void generate_sectors_and_face_mesh_for_band(List* const sectors, List* const face_mesh,
+	const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data,
+	const byte major_axis, const map_pos_component_t tile_size,
+	const map_pos_component_t band_start, const map_pos_component_t band_end) {
+
+	//////////
+
+	const buffer_size_t
+		num_map_grid_values = heightmap.size.x * heightmap.size.z,
+		num_band_grid_values = (buffer_size_t) (band_end - band_start) * get_indexed_map_pos_component(heightmap.size, major_axis);
+
+	/* `>> 3` = `/ 8`. Works pretty well for my maps. TODO: make to a constant.
+	If the map size is small enough, an incorrect guess of zero can happen. */
+	buffer_size_t sector_amount_guess = num_band_grid_values >> 3;
+	if (sector_amount_guess == 0) sector_amount_guess = 1;
+
+	*sectors = init_list(sector_amount_guess, Sector);
+
+	/* This contains the actual data for faces. `num_sectors * 3` gives a good
+	guess for the face/sector ratio. TODO: make this a constant somewhere. */
+	*face_mesh = init_list(sector_amount_guess * 3, face_mesh_t);
+
+	//////////
+
+	/* This is used to keep track of traversed points. To perform some action on a traversed point
+	at position <x, y>, the bit index will be `z * map_width + x`. */
+	const BitArray traversed_points = init_bitarray(num_map_grid_values);
+
+	map_pos_xz_t band_area_start = {0, 0}, band_area_end = heightmap.size;
+	*get_indexed_map_pos_component_ref(&band_area_start, !major_axis) = band_start;
+	*get_indexed_map_pos_component_ref(&band_area_end, !major_axis) = band_end;
+
+	generate_sectors_and_face_mesh_in_area(sectors, face_mesh, heightmap, texture_id_map_data,
+		traversed_points, major_axis, tile_size, band_area_start, band_area_end);
 
 	deinit_bitarray(traversed_points);
 }
 
-/* This function generates a modified version of the plain face mesh used
-for rendering sectors. Here's why a separate mesh is used for shadow mapping:
+typedef struct {
+	const Heightmap heightmap;
+	const map_texture_id_t* const texture_id_map_data;
+	const byte major_axis;
+	const map_pos_component_t tile_size, minor_axis_map_size;
+	List *const band_sectors, *const band_face_meshes;
+} SectorMeshingBandJobData;
+
+static void sector_meshing_band_job(void* const job_data, const buffer_size_t band_index) {
+	const SectorMeshingBandJobData* const data = job_data;
+
+	const buffer_size_t band_start = band_index * sector_meshing_band_thickness;
+	buffer_size_t band_end = band_start + sector_meshing_band_thickness;
+	if (band_end > data -> minor_axis_map_size) band_end = data -> minor_axis_map_size;
+
+	generate_sectors_and_face_mesh_for_band(
+		data -> band_sectors + band_index, data -> band_face_meshes + band_index,
+		data -> heightmap, data -> texture_id_map_data, data -> major_axis, data -> tile_size,
+		(map_pos_component_t) band_start, (map_pos_component_t) band_end);
+}
 
-Note that a separate face mesh is used for rendering shadows because the other vertex buffer
-used to store the face mesh changes every frame due to frustum culling, so if I were to use that one,
-not all necessary shadows would be cast. Also,
+/* The bands are meshed in parallel, and then concatenated in band order. Since bands are ordered along the minor
+axis, and sectors within a band are ordered along the minor axis first too, the concatenated sectors keep the
+same ordering that a single pass over the whole map would give. Each band's face ranges are offset by the
+number of faces in the bands before it. */
+static void generate_sectors_and_face_mesh_along_axis(List* const sectors, List* const face_mesh,
+	const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data,
+	const byte major_axis, const map_pos_component_t tile_size) {
 
-1. It includes map edge geometry. Normally, this geometry is not generated
-	because the player will never see it, but this adds that geometry in.
+	const map_pos_component_t minor_axis_map_size = get_indexed_map_pos_component(heightmap.size, !major_axis);
+	const buffer_size_t num_bands = ((minor_axis_map_size - 1u) / sector_meshing_band_thickness) + 1u;
 
-2. It trims the face info bits, so that this version of the mesh used for shadow mapping
-	will only take up 75% of its needed space.
+	List* const band_lists = alloc(num_bands * 2u, sizeof(List));
 
-3. Given the range of possible light directions for the dynamic light,
-	it removes backfacing faces ahead of time, to further reduce the buffer size.
+	SectorMeshingBandJobData job_data = {
+		heightmap, texture_id_map_data, major_axis, tile_size, minor_axis_map_size,
+		band_lists, band_lists + num_bands
+	};
 
-4. Since it never changes, it can stay in high-speed memory.
-*/
-static void init_trimmed_face_mesh_for_shadow_mapping(const Heightmap heightmap,
-	const List* const face_mesh, const DynamicLightConfig* const dynamic_light_config,
-	GLsizei* const num_vertices, GLuint* const vertex_buffer, GLuint* const vertex_spec) {
+	run_jobs_on_worker_pool(sector_meshing_band_job, &job_data, num_bands);
 
-	////////// Getting the dynamic light dirs
+	////////// Merging the bands
 
-	// TODO: avoid repeating this logic in `init_dynamic_light`
-	vec3 light_dir_from, light_dir_to;
-	glm_vec3_normalize_to((GLfloat*) dynamic_light_config -> unnormalized_from, light_dir_from);
-	glm_vec3_normalize_to((GLfloat*) dynamic_light_config -> unnormalized_to, light_dir_to);
+	buffer_size_t num_sectors = 0, num_faces = 0;
 
-	////////// Making a map edge mesh + vertex buffer for it
+	for (buffer_size_t i = 0; i < num_bands; i++) {
+		num_sectors += job_data.band_sectors[i].length;
+		num_faces += job_data.band_face_meshes[i].length;
+	}
 
-	List map_edge_mesh = init_map_edge_mesh(heightmap);
-	const buffer_size_t initial_num_vertices = vertices_per_face * (face_mesh -> length + map_edge_mesh.length);
+	*sectors = init_list(num_sectors, Sector);
+	*face_mesh = init_list(num_faces, face_mesh_t);
 
-	////////// Allocing a buffer to write the trimmed face mesh into
+	for (buffer_size_t i = 0; i < num_bands; i++) {
+		const List *const band_sectors = job_data.band_sectors + i, *const band_face_mesh = job_data.band_face_meshes + i;
+		const buffer_size_t face_offset = face_mesh -> length;
 
-	// This is a trimmed vertex because it has no face info bits
-	typedef map_pos_component_t trimmed_face_vertex_t[components_per_face_vertex_pos];
+		Sector* const merged_sectors = (Sector*) sectors -> data + sectors -> length;
+		memcpy(merged_sectors, band_sectors -> data, band_sectors -> length * sizeof(Sector));
 
-	// Note: not using the map edge mesh buffer for this, because that would require in-place shifting of face meshes
-	map_pos_component_t* const trimmed_vertices_cpu = alloc(initial_num_vertices, sizeof(trimmed_face_vertex_t));
-	map_pos_component_t* trimmed_vertices_cpu_end = trimmed_vertices_cpu;
+		for (buffer_size_t j = 0; j < band_sectors -> length; j++)
+			merged_sectors[j].face_range.start += face_offset;
 
-	//////////
+		sectors -> length += band_sectors -> length;
+		push_array_to_list(face_mesh, band_face_mesh -> data, band_face_mesh -> length);
 
-	const List* const face_mesh_lists[2] = {face_mesh, &map_edge_mesh};
+		deinit_list(*band_sectors);
+		deinit_list(*band_face_mesh);
+	}
 
-	for (byte i = 0; i < ARRAY_LENGTH(face_mesh_lists); i++) {
-		const List* const face_mesh_list = face_mesh_lists[i];
+	dealloc(band_lists);
+}
 
-		LIST_FOR_EACH(face_mesh_list, face_mesh_t, face_submesh,
-			////////// Figuring out if the face is frontfacing for either light direction
+// This orders sectors by their origin on the z axis first, and then on the x axis
+static int compare_sector_origins(const void* const a, const void* const b) {
+	const map_pos_xz_t origin_a = ((const Sector*) a) -> origin, origin_b = ((const Sector*) b) -> origin;
+	if (origin_a.z != origin_b.z) return origin_a.z - origin_b.z;
+	return origin_a.x - origin_b.x;
+}
 
-			const face_vertex_t* const vertices = (face_vertex_t*) face_submesh;
-			const map_pos_component_t *const v0 = vertices[0], *const v1 = vertices[1], *const v2 = vertices[2];
+// This orders sectors by their origin on the x axis first, and then on the z axis
+static int compare_sector_origins_x_first(const void* const a, const void* const b) {
+	const map_pos_xz_t origin_a = ((const Sector*) a) -> origin, origin_b = ((const Sector*) b) -> origin;
+	if (origin_a.x != origin_b.x) return origin_a.x - origin_b.x;
+	return origin_a.z - origin_b.z;
+}
 
-			const signed_byte
-				sign_x = (signed_byte) glm_sign(v0[0] - v1[0]),
-				sign_y = (signed_byte) glm_sign(v2[1] - v0[1]),
-				sign_z = (signed_byte) glm_sign(v0[2] - v1[2]);
+// This rebuilds the face mesh so that each sector's faces follow those of the sector before it in the list
+static void reorder_face_mesh_to_match_sectors(const List* const sectors, List* const face_mesh) {
+	List reordered_face_mesh = init_list(face_mesh -> length, face_mesh_t);
 
-			// Created by reducing a solution involving the cross product
-			const vec3 normal = {sign_y * sign_z, !sign_y, sign_x & sign_y};
+	LIST_FOR_EACH(sectors, Sector, sector,
+		const buffer_size_t prev_start = sector -> face_range.start;
+		sector -> face_range.start = reordered_face_mesh.length;
 
-			//////////
+		push_array_to_list(&reordered_face_mesh,
+			(face_mesh_t*) face_mesh -> data + prev_start,
+			sector -> face_range.length);
+	);
 
-			/* While the zero-height floor could be removed from the shadow map,
-			it's kept because removing it interferes with ESM filtering */
+	deinit_list(*face_mesh);
+	*face_mesh = reordered_face_mesh;
+}
 
-			// If the face is frontfacing for any light dir, keep it
-			if (glm_vec3_dot(light_dir_from, (GLfloat*) normal) > 0.0f ||
-				glm_vec3_dot(light_dir_to, (GLfloat*) normal) > 0.0f) {
+/* Scanning rows first is not always the best choice; for maps where regions of equal attributes are taller than
+they are wide, scanning columns first makes fewer sectors and faces. So if `try_both_meshing_axes` is set, both
+axes are tried, and the mesh with the fewest faces is kept. Frustum culling relies on sectors being sorted by their
+origin on the z axis first, and on neighboring sectors in the list having neighboring face ranges; so sectors from
+a column-first scan are re-sorted, and their faces are then reordered to match. This returns the major axis of the
+scan that was kept, so that remeshing can scan the same way. */
+static byte generate_sectors_and_face_mesh_from_maps(List* const sectors, List* const face_mesh,
+	const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data,
+	const bool try_both_meshing_axes, const map_pos_component_t tile_size) {
 
-				for (byte j = 0; j < vertices_per_face; j++) {
-					const map_pos_component_t* const vertex = ((face_vertex_t*) face_submesh)[j];
+	generate_sectors_and_face_mesh_along_axis(sectors, face_mesh, heightmap, texture_id_map_data, 0, tile_size);
 
-					*(trimmed_vertices_cpu_end++) = vertex[0];
-					*(trimmed_vertices_cpu_end++) = vertex[1];
-					*(trimmed_vertices_cpu_end++) = vertex[2];
-				}
-			}
-		);
-	}
+	#ifdef PRINT_SECTOR_MESHING_STATS
+	printf("Row-first sector meshing: %u sectors and %u faces\n", sectors -> length, face_mesh -> length);
+	#endif
 
-	deinit_list(map_edge_mesh);
+	if (!try_both_meshing_axes) return 0;
 
-	////////// Defining the number of vertices, the vertex buffer, and the vertex spec
+	List column_first_sectors, column_first_face_mesh;
+	generate_sectors_and_face_mesh_along_axis(&column_first_sectors, &column_first_face_mesh,
+		heightmap, texture_id_map_data, 1, tile_size);
 
-	const GLsizei num_components = (GLsizei) (trimmed_vertices_cpu_end - trimmed_vertices_cpu);
-	const GLsizeiptr num_bytes = num_components * (GLsizeiptr) sizeof(map_pos_component_t);
+	#ifdef PRINT_SECTOR_MESHING_STATS
+	printf("Column-first sector meshing: %u sectors and %u faces\n",
+		column_first_sectors.length, column_first_face_mesh.length);
+	#endif
 
-	*num_vertices = num_components / components_per_face_vertex_pos;
+	if (column_first_face_mesh.length < face_mesh -> length) {
+		deinit_list(*sectors);
+		deinit_list(*face_mesh);
 
-	use_vertex_buffer(*vertex_buffer = init_gpu_buffer());
-	init_vertex_buffer_data(num_bytes, 1, trimmed_vertices_cpu, GL_STATIC_DRAW);
+		qsort(column_first_sectors.data, column_first_sectors.length, sizeof(Sector), compare_sector_origins);
+		reorder_face_mesh_to_match_sectors(&column_first_sectors, &column_first_face_mesh);
 
-	dealloc(trimmed_vertices_cpu);
+		*sectors = column_first_sectors;
+		*face_mesh = column_first_face_mesh;
+		return 1;
+	}
+	else {
+		deinit_list(column_first_sectors);
+		deinit_list(column_first_face_mesh);
+		return 0;
+	}
+}
 
-	use_vertex_spec(*vertex_spec = init_vertex_spec());
-	define_vertex_spec_index(false, false, 0, components_per_face_vertex_pos, 0, 0, MAP_POS_COMPONENT_TYPENAME);
+static buffer_size_t get_face_capacity_with_spare_room(const buffer_size_t num_faces) {
+	return num_faces + num_faces / spare_face_capacity_divisor + min_num_spare_faces;
 }
 
-// The output variable indices are in regards to the `glDrawArrays` call.
-static void frustum_cull_sector_faces_into_gpu_buffer(
-	const SectorContext* const sector_context, const Camera* const camera,
-	buffer_size_t* const first_face_index_ref, buffer_size_t* const num_visible_faces_ref) {
+/* This makes a copy of the sectors that's sorted on the x axis first, for drawing front to back when looking
+along the x axis. The face mesh is then rebuilt with a section for each ordering, which has room for
+`face_section_capacity` faces; the faces of the original sectors go in the first section, and the faces
+of the copied sectors go in the second one, in that order. The spare room in each section is zeroed. */
+static List init_x_major_sector_ordering(const List* const z_major_sectors,
+	List* const face_mesh, const buffer_size_t face_section_capacity) {
 
-	/* TODO: perhaps optimize like this:
-	- Every frame: For all sectors that are visible, add their sub-meshes to the GPU buffer
-	- On the reinit event: Clear all sub-meshes from the GPU buffer
-	- That would result in some occasional overdraw, but it would help if the constant rewriting becomes a botteneck */
+	const buffer_size_t num_sectors = z_major_sectors -> length;
 
-	const List* const sectors = &sector_context -> sectors;
-	const Sector* const out_of_bounds_sector = (Sector*) sectors -> data + sectors -> length;
+	List x_major_sectors = init_list(num_sectors, Sector);
+	push_array_to_list(&x_major_sectors, z_major_sectors -> data, num_sectors);
+	qsort(x_major_sectors.data, num_sectors, sizeof(Sector), compare_sector_origins_x_first);
 
-	const List* const face_mesh_cpu = &sector_context -> mesh_cpu;
-	const face_mesh_t* const face_mesh_cpu_data = face_mesh_cpu -> data;
-	const buffer_size_t num_total_faces = face_mesh_cpu -> length;
+	List sectioned_face_mesh = init_list(face_section_capacity * 2u, face_mesh_t);
+	sectioned_face_mesh.length = face_section_capacity * 2u;
 
-	const GLuint vertex_buffer = sector_context -> drawable.vertex_buffer;
+	face_mesh_t* const sectioned_faces = sectioned_face_mesh.data;
+	const face_mesh_t* const faces = face_mesh -> data;
 
-	face_mesh_t* const face_mesh_gpu = init_vertex_buffer_memory_mapping(
-		vertex_buffer, num_total_faces * sizeof(face_mesh_t), true
+	memset(sectioned_faces, 0, sectioned_face_mesh.length * sizeof(face_mesh_t));
+	memcpy(sectioned_faces, faces, face_mesh -> length * sizeof(face_mesh_t));
+
+	buffer_size_t x_major_face_index = face_section_capacity;
+
+	LIST_FOR_EACH(&x_major_sectors, Sector, sector,
+		const buffer_size_t z_major_start = sector -> face_range.start, num_faces = sector -> face_range.length;
+		sector -> face_range.start = x_major_face_index;
+
+		memcpy(sectioned_faces + x_major_face_index, faces + z_major_start, num_faces * sizeof(face_mesh_t));
+		x_major_face_index += num_faces;
 	);
 
-	const vec4* const frustum_planes = camera -> frustum_planes;
-	buffer_size_t num_visible_faces = 0;
+	deinit_list(*face_mesh);
+	*face_mesh = sectioned_face_mesh;
 
-	/* Sectors are stored first sorted by their X coordinate, and then by their Z coordinate
-	(because that's the order of their creation by the heightmap sector mesher). This is then
-	the standard order of the sector sub-meshes in the sector face GPU buffer.
+	return x_major_sectors;
+}
 
-	When looking in the negative Z direction, there's a lot of overdraw. To avoid this, when looking
-	in that direction, face meshes are copied into the back of the GPU buffer (rather than the front),
-	and filled in right-to-left in memory, so that face meshes that have a larger Z coordinate go before those
-	with a smaller Z coordinate in the buffer. This leads to less overdraw, and much better performance overall.
+static buffer_size_t get_num_shadow_mesh_chunks_across(const map_pos_component_t map_size_on_axis) {
+	return (map_size_on_axis + shadow_mesh_chunk_size - 1u) / shadow_mesh_chunk_size;
+}
 
-	TODO: apply this process to the X-axis too, if possible. */
-	const bool order_face_meshes_backwards = camera -> dir[2] < 0.0f;
+static buffer_size_t get_shadow_mesh_chunk_index(const face_mesh_t face,
+	const buffer_size_t num_chunks_across, const buffer_size_t num_chunks_down) {
 
-	LIST_FOR_EACH(sectors, Sector, sector,
-		buffer_size_t num_visible_faces_in_group = 0;
-		const buffer_size_t cpu_buffer_start_index = sector -> face_range.start;
+	buffer_size_t
+		chunk_x = face[0] / shadow_mesh_chunk_size,
+		chunk_z = face[2] / shadow_mesh_chunk_size;
 
-		// Checking to see how many sectors forward are visible
-		while (sector < out_of_bounds_sector) {
-			const map_pos_xz_t origin = sector -> origin, size = sector -> size;
+	// Map edge faces on the far sides have an origin that's one past the map's end, so this clamps those
+	if (chunk_x == num_chunks_across) chunk_x--;
+	if (chunk_z == num_chunks_down) chunk_z--;
 
-			const vec3 aabb[2] = {
-				{origin.x, sector -> visible_heights.min, origin.z},
-				{origin.x + size.x, sector -> visible_heights.max, origin.z + size.z}
-			};
+	return chunk_z * num_chunks_across + chunk_x;
+}
 
-			if (!glm_aabb_frustum((vec3*) aabb, (vec4*) frustum_planes)) break;
+/* This sorts the faces of the shadow mesh into chunks, by which chunk their origin is in, and lays the chunks out one
+after the other, with spare room after each one's faces (which is zeroed). Faces may reach past their chunk's borders,
+so a chunk's bounding box is made from the faces themselves; and an empty chunk gets an inverted box. */
+static void init_shadow_mesh_chunks(const Heightmap heightmap, List* const face_mesh, ShadowMeshChunk* const chunks) {
+	const buffer_size_t
+		num_chunks_across = get_num_shadow_mesh_chunks_across(heightmap.size.x),
+		num_chunks_down = get_num_shadow_mesh_chunks_across(heightmap.size.z),
+		num_chunks = num_chunks_across * num_chunks_down;
 
-			num_visible_faces_in_group += sector++ -> face_range.length;
-		}
+	////////// Counting the faces per chunk, and giving each chunk room for its faces
 
-		if (num_visible_faces_in_group != 0) {
-			face_mesh_t* const gpu_buffer_dest = face_mesh_gpu + (order_face_meshes_backwards
-				? (num_total_faces - num_visible_faces - num_visible_faces_in_group)
-				: num_visible_faces);
+	buffer_size_t* const chunk_indices = alloc(face_mesh -> length + 1u, sizeof(buffer_size_t));
 
-			memcpy(gpu_buffer_dest,
-				face_mesh_cpu_data + cpu_buffer_start_index,
-				num_visible_faces_in_group * sizeof(face_mesh_t));
+	for (buffer_size_t i = 0; i < num_chunks; i++) {
+		ShadowMeshChunk* const chunk = chunks + i;
+		chunk -> num_faces = 0;
+		glm_vec3_fill(chunk -> aabb[0], FLT_MAX);
+		glm_vec3_fill(chunk -> aabb[1], -FLT_MAX);
+	}
 
-			num_visible_faces += num_visible_faces_in_group;
-		}
-	);
+	const face_mesh_t* const faces = face_mesh -> data;
 
-	deinit_vertex_buffer_memory_mapping();
+	for (buffer_size_t i = 0; i < face_mesh -> length; i++) {
+		const buffer_size_t chunk_index = get_shadow_mesh_chunk_index(faces[i], num_chunks_across, num_chunks_down);
+		chunk_indices[i] = chunk_index;
+		chunks[chunk_index].num_faces++;
+	}
+
+	buffer_size_t num_laid_out_faces = 0;
+
+	for (buffer_size_t i = 0; i < num_chunks; i++) {
+		ShadowMeshChunk* const chunk = chunks + i;
+
+		chunk -> first_face = num_laid_out_faces;
+		chunk -> max_num_faces = get_face_capacity_with_spare_room(chunk -> num_faces);
+		chunk -> num_faces = 0; // This is counted up again below, while the faces are moved into the chunk
+
+		num_laid_out_faces += chunk -> max_num_faces;
+	}
+
+	////////// Moving the faces into their chunks, and growing the chunk bounding boxes
 
-	*num_visible_faces_ref = num_visible_faces;
-	*first_face_index_ref = order_face_meshes_backwards ? (face_mesh_cpu -> length - num_visible_faces) : 0u;
+	List laid_out_face_mesh = init_list(num_laid_out_faces, face_mesh_t);
+	laid_out_face_mesh.length = num_laid_out_faces;
+
+	face_mesh_t* const laid_out_faces = laid_out_face_mesh.data;
+	memset(laid_out_faces, 0, num_laid_out_faces * sizeof(face_mesh_t));
+
+	for (buffer_size_t i = 0; i < face_mesh -> length; i++) {
+		ShadowMeshChunk* const chunk = chunks + chunk_indices[i];
+		memcpy(laid_out_faces[chunk -> first_face + chunk -> num_faces++], faces[i], sizeof(face_mesh_t));
+
+		vec3 face_aabb[2];
+		get_face_aabb(faces[i], face_aabb);
+		glm_vec3_minv(chunk -> aabb[0], face_aabb[0], chunk -> aabb[0]);
+		glm_vec3_maxv(chunk -> aabb[1], face_aabb[1], chunk -> aabb[1]);
+	}
+
+	dealloc(chunk_indices);
+
+	deinit_list(*face_mesh);
+	*face_mesh = laid_out_face_mesh;
 }
 
-static void define_vertex_spec(void) {
-	define_vertex_spec_index(false, false, 0, components_per_face_vertex_pos,
-		sizeof(face_vertex_t), 0, MAP_POS_COMPONENT_TYPENAME); // Pos
+/* Given the range of possible light directions for the dynamic light, this gives back a bitmask of the face
+ids that are frontfacing for some light direction. Faces with other face ids are left out of the shadow mesh. */
+static byte get_trimmed_face_ids(const DynamicLightConfig* const dynamic_light_config) {
+	// These are indexed by face id, and they match the normals in `sector.vert`
+	static const vec3 face_normals[] = {
+		{0.0f, 1.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f},
+		{-1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}
+	};
+
+	// TODO: avoid repeating this logic in `init_dynamic_light`
+	vec3 light_dir_from, light_dir_to;
+	glm_vec3_normalize_to((GLfloat*) dynamic_light_config -> unnormalized_from, light_dir_from);
+	glm_vec3_normalize_to((GLfloat*) dynamic_light_config -> unnormalized_to, light_dir_to);
+
+	byte trimmed_face_ids = 0;
+
+	for (byte face_id = 0; face_id < ARRAY_LENGTH(face_normals); face_id++) {
+		GLfloat* const normal = (GLfloat*) face_normals[face_id];
+
+		if (glm_vec3_dot(light_dir_from, normal) > 0.0f || glm_vec3_dot(light_dir_to, normal) > 0.0f)
+			trimmed_face_ids |= (byte) (1u << face_id);
+	}
 
-	define_vertex_spec_index(false, false, 1, 1, sizeof(face_vertex_t), // Face info
-		sizeof(map_pos_component_t[components_per_face_vertex_pos]), MAP_POS_COMPONENT_TYPENAME);
+	return trimmed_face_ids;
 }
 
-////////// Initialization, deinitialization, and rendering
+/* This adds the faces of the shadow mesh that are in the given chunks to a list, or the faces in every chunk if
+`chunks_to_add` is null. Those are the faces of every sector, and the map edge faces, without the faces that are
+backfacing for every light direction. Sectors are gone through in the z-major ordering, which keeps the shadow
+mesh's faces in the same order as the face mesh; and only sectors that can have faces in the chunks are looked at. */
+static void add_trimmed_faces_in_chunks_to_list(const SectorContext* const sector_context,
+	const Heightmap heightmap, const bool* const chunks_to_add, List* const trimmed_face_mesh) {
 
-SectorContext init_sector_context(
-	const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data,
-	const GLchar* const* const texture_paths, const texture_id_t num_textures,
-	const MaterialPropertiesPerObjectType* const shared_material_properties,
-	const NormalMapCreator* const normal_map_creator,
-	const DynamicLightConfig* const dynamic_light_config) {
+	const buffer_size_t
+		num_chunks_across = get_num_shadow_mesh_chunks_across(heightmap.size.x),
+		num_chunks_down = get_num_shadow_mesh_chunks_across(heightmap.size.z);
 
-	////////// Checking that there's not too many sector face textures
+	////////// Finding the box of map points that the chunks to add are in (this includes the points past their ends)
 
-	// TODO: also check that the max texture id in the heightmap doesn't exceed the maximum from here
-	if (num_textures > max_num_sector_subtextures) FAIL(ReadFromJSON, "Number of sector face texture paths "
-		"exceeds the maximum (%u > %u)", num_textures, max_num_sector_subtextures);
+	map_pos_xz_t chunk_area_start = {0, 0}, chunk_area_end = heightmap.size;
 
-	////////// Making a list of sectors, and a face mesh
+	if (chunks_to_add != NULL) {
+		buffer_size_t min_chunk_x = num_chunks_across, min_chunk_z = num_chunks_down, max_chunk_x = 0, max_chunk_z = 0;
 
-	List sectors, face_mesh;
-	generate_sectors_and_face_mesh_from_maps(&sectors, &face_mesh, heightmap, texture_id_map_data);
+		for (buffer_size_t chunk_z = 0; chunk_z < num_chunks_down; chunk_z++) {
+			for (buffer_size_t chunk_x = 0; chunk_x < num_chunks_across; chunk_x++) {
+				if (!chunks_to_add[chunk_z * num_chunks_across + chunk_x]) continue;
+				if (chunk_x < min_chunk_x) min_chunk_x = chunk_x;
+				if (chunk_z < min_chunk_z) min_chunk_z = chunk_z;
+				if (chunk_x > max_chunk_x) max_chunk_x = chunk_x;
+				if (chunk_z > max_chunk_z) max_chunk_z = chunk_z;
+			}
+		}
 
-	////////// Making a trimmed face mesh for shadow mapping
+		if (min_chunk_x == num_chunks_across) return;
 
-	GLsizei num_vertices_for_shadow_mapping;
-	GLuint vertex_buffer_for_shadow_mapping, vertex_spec_for_shadow_mapping;
+		chunk_area_start = (map_pos_xz_t) {
+			(map_pos_component_t) (min_chunk_x * shadow_mesh_chunk_size),
+			(map_pos_component_t) (min_chunk_z * shadow_mesh_chunk_size)
+		};
 
-	init_trimmed_face_mesh_for_shadow_mapping(heightmap, &face_mesh, dynamic_light_config,
-		&num_vertices_for_shadow_mapping, &vertex_buffer_for_shadow_mapping, &vertex_spec_for_shadow_mapping);
+		if (max_chunk_x + 1u < num_chunks_across) chunk_area_end.x = (map_pos_component_t) ((max_chunk_x + 1u) * shadow_mesh_chunk_size);
+		if (max_chunk_z + 1u < num_chunks_down) chunk_area_end.z = (map_pos_component_t) ((max_chunk_z + 1u) * shadow_mesh_chunk_size);
+	}
 
-	////////// Making an albedo texture set
+	////////// Adding the faces
 
-	const GLsizei texture_size = shared_material_properties -> texture_rescale_size;
+	const byte trimmed_face_ids = sector_context -> shadow_mapping.trimmed_face_ids;
+	const face_mesh_t* const faces = sector_context -> mesh_cpu.data;
 
-	const GLuint albedo_texture_set = init_texture_set(
-		false, true, TexRepeating, OPENGL_LEVEL_MAG_FILTER, OPENGL_LEVEL_MIN_FILTER,
-		num_textures, 0, texture_size, texture_size, texture_paths, NULL
+	#define ADD_TRIMMED_FACE_IF_IN_CHUNKS(face) do {\
+		if (((trimmed_face_ids >> ((face)[3] & 7u)) & 1u) && (chunks_to_add == NULL ||\
+			chunks_to_add[get_shadow_mesh_chunk_index((face), num_chunks_across, num_chunks_down)]))\
+			push_ptr_to_list(trimmed_face_mesh, (face));\
+	} while (false)
+
+	LIST_FOR_EACH(&sector_context -> sector_orderings[1].sectors, Sector, sector,
+		const map_pos_xz_t origin = sector -> origin, size = sector -> size;
+
+		// A sector's faces start between its origin and its far edges, inclusive
+		if (origin.x > chunk_area_end.x || origin.x + size.x < chunk_area_start.x ||
+			origin.z > chunk_area_end.z || origin.z + size.z < chunk_area_start.z) continue;
+
+		const face_mesh_t* const sector_faces = faces + sector -> face_range.start;
+
+		for (buffer_size_t i = 0; i < sector -> face_range.length; i++)
+			ADD_TRIMMED_FACE_IF_IN_CHUNKS(sector_faces[i]);
 	);
 
-	////////// Making a sector context
+	const List map_edge_mesh = init_map_edge_mesh(heightmap);
+	LIST_FOR_EACH(&map_edge_mesh, face_mesh_t, face, ADD_TRIMMED_FACE_IF_IN_CHUNKS(*face););
+	deinit_list(map_edge_mesh);
+
+	#undef ADD_TRIMMED_FACE_IF_IN_CHUNKS
+}
 
-	return (SectorContext) {
-		.drawable = init_drawable_with_vertices(
-			define_vertex_spec, NULL, GL_DYNAMIC_DRAW, GL_TRIANGLES,
+// The sector faces are read through buffer textures, so their face buffers can't have more texels than that allows
+static void check_face_buffer_texture_size(const buffer_size_t num_faces) {
+	GLint max_num_texels;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_num_texels);
 
-			(List) {.data = NULL, .item_size = face_mesh.item_size, .length = face_mesh.length},
+	const buffer_size_t texels_per_face = components_per_face / 4u; // Each texel has 4 components
 
-			init_shader("shaders/sector.vert", NULL, "shaders/common/world_shading.frag", NULL),
+	if (num_faces * texels_per_face > (buffer_size_t) max_num_texels) FAIL(CreateTexture,
+		"The number of sector faces exceeds the maximum for a buffer texture (%u > %u)",
+		num_faces, (buffer_size_t) max_num_texels / texels_per_face);
+}
 
-			albedo_texture_set, init_normal_map_from_albedo_texture(
-				normal_map_creator,
-				&shared_material_properties -> normal_map_config,
-				albedo_texture_set, TexSet
-			)
-		),
+/* This function generates a modified version of the plain face mesh used
+for rendering sectors. Here's why a separate mesh is used for shadow mapping:
 
-		.shadow_mapping = {
-			.num_vertices = num_vertices_for_shadow_mapping,
+Note that a separate face mesh is used for rendering shadows because the other vertex buffer
+used to store the face mesh changes every frame due to frustum culling, so if I were to use that one,
+not all necessary shadows would be cast. Also,
 
-			.vertex_buffer = vertex_buffer_for_shadow_mapping,
-			.vertex_spec = vertex_spec_for_shadow_mapping,
+1. It includes map edge geometry. Normally, this geometry is not generated
+	because the player will never see it, but this adds that geometry in.
 
-			.depth_shader = init_shader(
-				"shaders/shadow/sector_depth.vert",
-				"shaders/shadow/sector_depth.geom",
-				"shaders/shadow/sector_depth.frag",
-				NULL
-			)
-		},
+2. Given the range of possible light directions for the dynamic light,
+	it removes backfacing faces ahead of time, to further reduce the buffer size.
 
-		.depth_prepass_shader = init_shader(
-			"shaders/sector_depth_prepass.vert",
-			NULL,
-			"shaders/shadow/sector_depth.frag",
-			NULL
-		),
+3. Since it never changes (except for when remeshing), it can stay in high-speed memory.
 
-		.mesh_cpu = face_mesh, .sectors = sectors
-	};
+4. It's split into chunks, so that each shadow cascade can skip the chunks outside of its bounds;
+	and each chunk has spare room, so that remeshing can rewrite a chunk on its own.
+*/
+static List init_trimmed_face_mesh(const SectorContext* const sector_context,
+	const Heightmap heightmap, ShadowMeshChunk* const chunks) {
+
+	// Note: the z-major face section isn't used for this, since remeshing can leave gaps in it
+	List trimmed_face_mesh = init_list(sector_context -> sector_orderings[1].face_section.num_used + 1u, face_mesh_t);
+	add_trimmed_faces_in_chunks_to_list(sector_context, heightmap, NULL, &trimmed_face_mesh);
+	init_shadow_mesh_chunks(heightmap, &trimmed_face_mesh, chunks);
+
+	return trimmed_face_mesh;
 }
 
-void deinit_sector_context(const SectorContext* const sector_context) {
-	deinit_drawable(sector_context -> drawable);
+static void upload_trimmed_face_mesh(const SectorContext* const sector_context, const List* const trimmed_face_mesh) {
+	check_face_buffer_texture_size(trimmed_face_mesh -> length);
 
-	deinit_gpu_buffer(sector_context -> shadow_mapping.vertex_buffer);
-	deinit_vertex_spec(sector_context -> shadow_mapping.vertex_spec);
-	deinit_shader(sector_context -> shadow_mapping.depth_shader);
+	use_vertex_buffer(sector_context -> shadow_mapping.face_buffer);
+	init_vertex_buffer_data(trimmed_face_mesh -> length, sizeof(face_mesh_t), trimmed_face_mesh -> data, GL_STATIC_DRAW);
+}
 
-	deinit_shader(sector_context -> depth_prepass_shader);
+static void init_trimmed_face_mesh_for_shadow_mapping(const SectorContext* const sector_context, const Heightmap heightmap) {
+	const List trimmed_face_mesh = init_trimmed_face_mesh(sector_context, heightmap, sector_context -> shadow_mapping.chunks);
+	upload_trimmed_face_mesh(sector_context, &trimmed_face_mesh);
+	deinit_list(trimmed_face_mesh);
+}
 
-	deinit_list(sector_context -> mesh_cpu);
-	deinit_list(sector_context -> sectors);
+/* This rewrites the shadow mesh chunks that faces in a remeshed area can be in. Faces can start at the far edges of
+their sectors, so the chunks up to the area's end are rewritten; and map edge faces can stretch along a whole map
+edge, so if the area touches a map edge, every chunk along it is rewritten. This returns false if a chunk doesn't
+have room for its new faces (in which case the chunks may be left half-rewritten). */
+static bool remesh_shadow_mesh_chunks(const SectorContext* const sector_context,
+	const Heightmap heightmap, const map_pos_xz_t area_start, const map_pos_xz_t area_end) {
+
+	const buffer_size_t
+		num_chunks_across = get_num_shadow_mesh_chunks_across(heightmap.size.x),
+		num_chunks_down = get_num_shadow_mesh_chunks_across(heightmap.size.z),
+		num_chunks = sector_context -> shadow_mapping.num_chunks;
+
+	////////// Finding the chunks to rewrite
+
+	bool* const chunks_to_rewrite = clearing_alloc(num_chunks, sizeof(bool));
+
+	const face_mesh_t area_start_face = {area_start.x, 0, area_start.z}, area_end_face = {area_end.x, 0, area_end.z};
+
+	const buffer_size_t
+		first_chunk_index = get_shadow_mesh_chunk_index(area_start_face, num_chunks_across, num_chunks_down),
+		last_chunk_index = get_shadow_mesh_chunk_index(area_end_face, num_chunks_across, num_chunks_down);
+
+	for (buffer_size_t chunk_z = 0; chunk_z < num_chunks_down; chunk_z++) {
+		for (buffer_size_t chunk_x = 0; chunk_x < num_chunks_across; chunk_x++) {
+			const bool
+				in_area_on_x = chunk_x >= first_chunk_index % num_chunks_across && chunk_x <= last_chunk_index % num_chunks_across,
+				in_area_on_z = chunk_z >= first_chunk_index / num_chunks_across && chunk_z <= last_chunk_index / num_chunks_across,
+
+				on_touched_map_edge =
+					(area_start.x == 0 && chunk_x == 0) || (area_end.x == heightmap.size.x && chunk_x == num_chunks_across - 1u) ||
+					(area_start.z == 0 && chunk_z == 0) || (area_end.z == heightmap.size.z && chunk_z == num_chunks_down - 1u);
+
+			chunks_to_rewrite[chunk_z * num_chunks_across + chunk_x] = (in_area_on_x && in_area_on_z) || on_touched_map_edge;
+		}
+	}
+
+	////////// Counting the new faces per chunk, and checking that they fit
+
+	List trimmed_face_mesh = init_list(shadow_mesh_chunk_size * shadow_mesh_chunk_size, face_mesh_t);
+	add_trimmed_faces_in_chunks_to_list(sector_context, heightmap, chunks_to_rewrite, &trimmed_face_mesh);
+
+	ShadowMeshChunk* const chunks = sector_context -> shadow_mapping.chunks;
+	const face_mesh_t* const faces = trimmed_face_mesh.data;
+
+	for (buffer_size_t i = 0; i < num_chunks; i++) {
+		if (!chunks_to_rewrite[i]) continue;
+
+		ShadowMeshChunk* const chunk = chunks + i;
+		chunk -> num_faces = 0;
+		glm_vec3_fill(chunk -> aabb[0], FLT_MAX);
+		glm_vec3_fill(chunk -> aabb[1], -FLT_MAX);
+	}
+
+	for (buffer_size_t i = 0; i < trimmed_face_mesh.length; i++)
+		chunks[get_shadow_mesh_chunk_index(faces[i], num_chunks_across, num_chunks_down)].num_faces++;
+
+	bool chunks_have_room = true;
+
+	for (buffer_size_t i = 0; i < num_chunks; i++) {
+		if (chunks_to_rewrite[i] && chunks[i].num_faces > chunks[i].max_num_faces) chunks_have_room = false;
+	}
+
+	////////// Moving the new faces into a staging area in chunk order, growing the chunk bounding boxes, and uploading them
+
+	if (chunks_have_room) {
+		face_mesh_t* const staged_faces = alloc(trimmed_face_mesh.length + 1u, sizeof(face_mesh_t));
+		buffer_size_t* const staging_offsets = alloc(num_chunks, sizeof(buffer_size_t));
+
+		for (buffer_size_t i = 0, num_staged_faces = 0; i < num_chunks; i++) {
+			staging_offsets[i] = num_staged_faces;
+			if (chunks_to_rewrite[i]) num_staged_faces += chunks[i].num_faces;
+		}
+
+		for (buffer_size_t i = 0; i < trimmed_face_mesh.length; i++) {
+			const buffer_size_t chunk_index = get_shadow_mesh_chunk_index(faces[i], num_chunks_across, num_chunks_down);
+			ShadowMeshChunk* const chunk = chunks + chunk_index;
+
+			memcpy(staged_faces[staging_offsets[chunk_index]++], faces[i], sizeof(face_mesh_t));
+
+			vec3 face_aabb[2];
+			get_face_aabb(faces[i], face_aabb);
+			glm_vec3_minv(chunk -> aabb[0], face_aabb[0], chunk -> aabb[0]);
+			glm_vec3_maxv(chunk -> aabb[1], face_aabb[1], chunk -> aabb[1]);
+		}
+
+		use_vertex_buffer(sector_context -> shadow_mapping.face_buffer);
+
+		for (buffer_size_t i = 0; i < num_chunks; i++) {
+			const ShadowMeshChunk* const chunk = chunks + i;
+			if (!chunks_to_rewrite[i] || chunk -> num_faces == 0) continue;
+
+			// After the loop above, each staging offset is at the end of its chunk's staged faces
+			glBufferSubData(GL_ARRAY_BUFFER,
+				(GLintptr) (chunk -> first_face * sizeof(face_mesh_t)),
+				(GLsizeiptr) (chunk -> num_faces * sizeof(face_mesh_t)),
+				staged_faces + staging_offsets[i] - chunk -> num_faces);
+		}
+
+		dealloc(staging_offsets);
+		dealloc(staged_faces);
+	}
+
+	deinit_list(trimmed_face_mesh);
+	dealloc(chunks_to_rewrite);
+
+	return chunks_have_room;
 }
 
-void draw_sectors_to_shadow_context(const SectorContext* const sector_context) {
-	use_shader(sector_context -> shadow_mapping.depth_shader);
-	use_vertex_spec(sector_context -> shadow_mapping.vertex_spec);
-	draw_primitives(sector_context -> drawable.triangle_mode, sector_context -> shadow_mapping.num_vertices);
+/* Within a sector ordering, sectors are sorted on the major axis first, so a run of visible sectors can span
+several rows of sectors on that axis. Going forwards, those rows are already in front-to-back order; but going
+backwards, each row has to be given out on its own, or else the rows within a run would go from back to front.
+Also, neighboring sectors usually have neighboring face ranges, but remeshed sectors can have their faces elsewhere
+in the face mesh, and sectors that were left empty by remeshing have no faces. So this returns where the span of
+sectors starting at `first_sector_index` ends, where a span stops at the end of a row when going backwards, and
+where its sectors' face ranges stop being neighbors; and it outputs the face range of that span. If `sector_lod` is
+not NULL, sectors in tiles with a coarse level of detail are skipped, since those tiles are drawn from their own mesh
+(and sectors don't cross tile borders then, so a sector's origin says what tile it's in). */
+static buffer_size_t get_end_of_visible_sector_span(const Sector* const sectors, const SectorLOD* const sector_lod,
+	const buffer_size_t first_sector_index, const buffer_size_t end_sector_index,
+	const byte major_axis, const bool order_backwards,
+	buffer_size_t* const first_face_index, buffer_size_t* const num_faces) {
+
+	const map_pos_component_t row_origin = get_indexed_map_pos_component(sectors[first_sector_index].origin, major_axis);
+
+	buffer_size_t sector_index = first_sector_index, span_start = 0, span_end = 0;
+
+	for (; sector_index < end_sector_index; sector_index++) {
+		const Sector* const sector = sectors + sector_index;
+
+		if (order_backwards && get_indexed_map_pos_component(sector -> origin, major_axis) != row_origin) break;
+
+		const buffer_size_t start = sector -> face_range.start, length = sector -> face_range.length;
+		if (length == 0 || (sector_lod != NULL && get_sector_lod_level_at(sector_lod, sector -> origin) != 0)) continue;
+
+		if (span_start == span_end) span_start = start;
+		else if (start != span_end) break;
+
+		span_end = start + length;
+	}
+
+	*first_face_index = span_start;
+	*num_faces = span_end - span_start;
+
+	return sector_index;
 }
 
-void draw_sectors(const SectorContext* const sector_context, const Camera* const camera) {
-	/* TODO: use `glMultiDrawArrays` around here instead, to avoid too much CPU -> GPU copying?
-	When starting this out, just start with some normal `glDrawArrays` calls. */
+typedef struct {
+	const Sector* const sectors;
+	const SectorLOD* const sector_lod;
+	const face_mesh_t* const face_mesh_cpu_data;
+	face_mesh_t* const face_mesh_gpu;
 
-	buffer_size_t first_face_index, num_visible_faces;
-	frustum_cull_sector_faces_into_gpu_buffer(sector_context, camera, &first_face_index, &num_visible_faces);
+	const buffer_size_t num_total_faces;
+	const byte major_axis;
+	const bool order_face_meshes_backwards;
 
-	// If looking out at the distance with no sectors, why do any state switching at all?
-	if (num_visible_faces != 0) {
-		// TODO: call `draw_drawable` here instead
-		const Drawable* const drawable = &sector_context -> drawable;
-		const GLenum triangle_mode = drawable -> triangle_mode;
+	buffer_size_t num_visible_faces;
+} VisibleSectorCopyState;
 
-		const GLint start_vertex = (GLint) (first_face_index * vertices_per_face);
-		const GLsizei num_vertices = (GLsizei) (num_visible_faces * vertices_per_face);
+// This copies the faces for a run of visible sectors into the GPU buffer, one span of neighboring face ranges at a time.
+static void copy_visible_sector_run_into_gpu_buffer(void* const callback_data,
+	const buffer_size_t first_sector_index, const buffer_size_t num_sectors) {
 
-		use_vertex_spec(drawable -> vertex_spec);
+	VisibleSectorCopyState* const state = callback_data;
+	const buffer_size_t end_sector_index = first_sector_index + num_sectors;
 
-		////////// Depth prepass
+	for (buffer_size_t span_start = first_sector_index, span_end; span_start < end_sector_index; span_start = span_end) {
+		buffer_size_t cpu_buffer_start_index, num_visible_faces_in_group;
 
-		// Running a depth prepass
-		use_shader(sector_context -> depth_prepass_shader);
+		span_end = get_end_of_visible_sector_span(state -> sectors, state -> sector_lod, span_start, end_sector_index,
+			state -> major_axis, state -> order_face_meshes_backwards, &cpu_buffer_start_index, &num_visible_faces_in_group);
 
-		// No color buffer writes
-		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
-			glDrawArrays(triangle_mode, start_vertex, num_vertices);
-		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		if (num_visible_faces_in_group == 0) continue;
 
-		////////// Rendering pass
+		face_mesh_t* const gpu_buffer_dest = state -> face_mesh_gpu + (state -> order_face_meshes_backwards
+			? (state -> num_total_faces - state -> num_visible_faces - num_visible_faces_in_group)
+			: state -> num_visible_faces);
 
-		// Only passing fragments with the same depth value
-		WITH_RENDER_STATE(glDepthFunc, GL_EQUAL, constants.default_depth_func,
-			// No depth buffer writes (TODO: stop the redundant state change for this in 'main.c')
-			WITH_RENDER_STATE(glDepthMask, GL_FALSE, GL_TRUE,
-				use_shader(drawable -> shader);
-				glDrawArrays(triangle_mode, start_vertex, num_vertices);
-			);
-		);
+		memcpy(gpu_buffer_dest,
+			state -> face_mesh_cpu_data + cpu_buffer_start_index,
+			num_visible_faces_in_group * sizeof(face_mesh_t));
+
+		state -> num_visible_faces += num_visible_faces_in_group;
 	}
 }
+
+// The output variable indices are in regards to the `glDrawArrays` call.
+static void frustum_cull_sector_faces_into_gpu_buffer(
+	const SectorContext* const sector_context, const Camera* const camera,
+	const SectorOrdering* const sector_ordering, const byte major_axis, const bool order_backwards,
+	buffer_size_t* const first_face_index_ref, buffer_size_t* const num_visible_faces_ref) {
+
+	/* TODO: perhaps optimize like this:
+	- Every frame: For all sectors that are visible, add their sub-meshes to the GPU buffer
+	- On the reinit event: Clear all sub-meshes from the GPU buffer
+	- That would result in some occasional overdraw, but it would help if the constant rewriting becomes a botteneck */
+
+	const List* const sectors = &sector_ordering -> sectors;
+
+	// The GPU buffer only has space for the faces of one sector ordering
+	const List* const face_mesh_cpu = &sector_context -> mesh_cpu;
+	const buffer_size_t num_total_faces = face_mesh_cpu -> length / ARRAY_LENGTH(sector_context -> sector_orderings);
+
+	const GLuint vertex_buffer = sector_context -> drawable.vertex_buffer;
+
+	face_mesh_t* const face_mesh_gpu = init_vertex_buffer_memory_mapping(
+		vertex_buffer, num_total_faces * sizeof(face_mesh_t), true
+	);
+
+	/* When looking in the negative direction of the ordering's major axis, there's a lot of overdraw. To avoid this,
+	when looking in that direction, face meshes are copied into the back of the GPU buffer (rather than the front),
+	and filled in right-to-left in memory, so that face meshes that have a larger coordinate on that axis go before
+	those with a smaller one in the buffer. This leads to less overdraw, and much better performance overall. */
+	VisibleSectorCopyState state = {
+		.sectors = sectors -> data, .sector_lod = sector_context -> lod.enabled ? &sector_context -> lod.tiles : NULL,
+		.face_mesh_cpu_data = face_mesh_cpu -> data, .face_mesh_gpu = face_mesh_gpu,
+		.num_total_faces = num_total_faces, .major_axis = major_axis, .order_face_meshes_backwards = order_backwards,
+		.num_visible_faces = 0
+	};
+
+	/* The metasector tree gives back runs of visible sectors in sector list order, where
+	each run is as long as possible; so each span of sectors is copied with one `memcpy`. */
+	for_each_visible_sector_run(&sector_ordering -> metasector_tree, sectors,
+		camera -> frustum_planes, copy_visible_sector_run_into_gpu_buffer, &state);
+
+	deinit_vertex_buffer_memory_mapping();
+
+	*num_visible_faces_ref = state.num_visible_faces;
+	*first_face_index_ref = state.order_face_meshes_backwards ? (num_total_faces - state.num_visible_faces) : 0u;
+}
+
+typedef struct {
+	const Sector* const sectors;
+	const SectorLOD* const sector_lod;
+	GLint* const run_first_vertices;
+	GLsizei* const run_vertex_counts;
+
+	const buffer_size_t max_num_runs;
+	const byte major_axis;
+	const bool order_runs_backwards;
+
+	buffer_size_t num_runs;
+} VisibleSectorDrawListState;
+
+// This adds the vertex ranges for a run of visible sectors to the draw list, one for each span of neighboring face ranges.
+static void add_visible_sector_run_to_draw_list(void* const callback_data,
+	const buffer_size_t first_sector_index, const buffer_size_t num_sectors) {
+
+	VisibleSectorDrawListState* const state = callback_data;
+	const buffer_size_t end_sector_index = first_sector_index + num_sectors;
+
+	for (buffer_size_t span_start = first_sector_index, span_end; span_start < end_sector_index; span_start = span_end) {
+		buffer_size_t first_face_index, num_faces;
+
+		span_end = get_end_of_visible_sector_span(state -> sectors, state -> sector_lod, span_start, end_sector_index,
+			state -> major_axis, state -> order_runs_backwards, &first_face_index, &num_faces);
+
+		if (num_faces == 0) continue;
+
+		const buffer_size_t run_index = state -> order_runs_backwards
+			? (state -> max_num_runs - 1u - state -> num_runs) : state -> num_runs;
+
+		state -> run_first_vertices[run_index] = (GLint) (first_face_index * vertices_per_face);
+		state -> run_vertex_counts[run_index] = (GLsizei) (num_faces * vertices_per_face);
+		state -> num_runs++;
+	}
+}
+
+/* This is the alternative to `frustum_cull_sector_faces_into_gpu_buffer` for when the face mesh is static on the
+GPU. Nothing is copied here; instead, the vertex ranges of visible sector runs are put in a draw list for
+`glMultiDrawArrays`. When going backwards, the draw list is filled in right-to-left, for the same overdraw
+reason as in the function above. This returns the number of runs, and outputs where they start. A run can't
+be shorter than one sector, so there are never more runs than sectors; and the draw list has room for every
+sector, including loose ones. */
+static GLsizei frustum_cull_sector_faces_into_draw_list(
+	const SectorContext* const sector_context, const Camera* const camera,
+	const SectorOrdering* const sector_ordering, const byte major_axis, const bool order_backwards,
+	const GLint** const run_first_vertices_ref, const GLsizei** const run_vertex_counts_ref) {
+
+	const List* const sectors = &sector_ordering -> sectors;
+	const buffer_size_t max_num_runs = sectors -> length;
+
+	VisibleSectorDrawListState state = {
+		.sectors = sectors -> data, .sector_lod = sector_context -> lod.enabled ? &sector_context -> lod.tiles : NULL,
+		.run_first_vertices = sector_context -> static_mesh_draw_list.run_first_vertices,
+		.run_vertex_counts = sector_context -> static_mesh_draw_list.run_vertex_counts,
+		.max_num_runs = max_num_runs, .major_axis = major_axis, .order_runs_backwards = order_backwards,
+		.num_runs = 0
+	};
+
+	for_each_visible_sector_run(&sector_ordering -> metasector_tree, sectors,
+		camera -> frustum_planes, add_visible_sector_run_to_draw_list, &state);
+
+	const buffer_size_t first_run_index = state.order_runs_backwards ? (max_num_runs - state.num_runs) : 0u;
+
+	*run_first_vertices_ref = state.run_first_vertices + first_run_index;
+	*run_vertex_counts_ref = state.run_vertex_counts + first_run_index;
+
+	return (GLsizei) state.num_runs;
+}
+
+/* This tests a bounding box against the left, right, bottom, and top planes of a frustum. Depth clamping is on when
+drawing to the shadow cascades, so geometry past a cascade's near or far plane still casts shadows into it. */
+static bool aabb_is_within_side_planes(const vec3 aabb[2], const vec4 planes[planes_per_frustum]) {
+	for (byte i = 0; i < 4; i++) {
+		const GLfloat* const plane = planes[i];
+
+		const GLfloat farthest_dist = plane[0] * aabb[plane[0] > 0.0f][0]
+			+ plane[1] * aabb[plane[1] > 0.0f][1] + plane[2] * aabb[plane[2] > 0.0f][2];
+
+		if (farthest_dist < -plane[3]) return false;
+	}
+
+	return true;
+}
+
+/* This culls the shadow mesh chunks against one shadow cascade, and fills in the draw list with the vertex ranges of
+runs of visible chunks. Neighboring chunks only have neighboring face ranges when a chunk has no spare room left,
+so a run is usually one chunk long. Empty chunks are skipped. This returns the number of runs. */
+static GLsizei cull_shadow_mesh_chunks_into_draw_list(const SectorContext* const sector_context,
+	mat4 light_view_projection) {
+
+	vec4 planes[planes_per_frustum];
+	glm_frustum_planes(light_view_projection, planes);
+
+	const ShadowMeshChunk* const chunks = sector_context -> shadow_mapping.chunks;
+	const buffer_size_t num_chunks = sector_context -> shadow_mapping.num_chunks;
+
+	GLint* const run_first_vertices = sector_context -> shadow_mapping.run_first_vertices;
+	GLsizei* const run_vertex_counts = sector_context -> shadow_mapping.run_vertex_counts;
+
+	GLsizei num_runs = 0;
+	buffer_size_t end_of_run = 0; // Faces past the end of the last run
+
+	for (buffer_size_t i = 0; i < num_chunks; i++) {
+		const ShadowMeshChunk* const chunk = chunks + i;
+
+		if (chunk -> num_faces == 0 || !aabb_is_within_side_planes(chunk -> aabb, (const vec4*) planes))
+			continue;
+
+		const GLsizei num_vertices = (GLsizei) (chunk -> num_faces * vertices_per_face);
+
+		if (num_runs != 0 && chunk -> first_face == end_of_run) run_vertex_counts[num_runs - 1] += num_vertices;
+		else {
+			run_first_vertices[num_runs] = (GLint) (chunk -> first_face * vertices_per_face);
+			run_vertex_counts[num_runs] = num_vertices;
+			num_runs++;
+		}
+
+		end_of_run = chunk -> first_face + chunk -> num_faces;
+	}
+
+	return num_runs;
+}
+
+/* This picks the sector ordering with the major axis that's closest to the camera's direction on the XZ plane,
+and says if it should be gone through backwards, so that sectors closer to the camera are drawn first. */
+static const SectorOrdering* get_front_to_back_sector_ordering(const SectorContext* const sector_context,
+	const Camera* const camera, byte* const major_axis, bool* const order_backwards) {
+
+	const GLfloat* const dir = camera -> dir;
+
+	*major_axis = fabsf(dir[2]) > fabsf(dir[0]); // 0 = x, and 1 = z
+	*order_backwards = dir[*major_axis * 2u] < 0.0f;
+
+	return sector_context -> sector_orderings + *major_axis;
+}
+
+#ifdef PRINT_SECTOR_OVERDRAW
+
+/* This prints how many times each screen pixel was written to by the sector depth prepass on average, over a span
+of frames. A value of 1 would mean no overdraw (though pixels with no sectors on them pull that value down).
+Getting the query result waits for the GPU, so this is only for measuring. */
+static void print_sector_depth_prepass_overdraw(const GLuint samples_passed_query) {
+	enum {num_frames_per_print = 100};
+	static GLuint64 num_samples_passed = 0, num_screen_pixels = 0;
+	static GLuint num_frames = 0;
+
+	GLuint query_result;
+	glGetQueryObjectuiv(samples_passed_query, GL_QUERY_RESULT, &query_result);
+
+	GLint viewport_bounds[4];
+	glGetIntegerv(GL_VIEWPORT, viewport_bounds);
+
+	num_samples_passed += query_result;
+	num_screen_pixels += (GLuint64) viewport_bounds[2] * (GLuint64) viewport_bounds[3];
+
+	if (++num_frames == num_frames_per_print) {
+		printf("Sector depth prepass overdraw, over the last %u frames: %.3f\n",
+			num_frames, (double) num_samples_passed / (double) num_screen_pixels);
+
+		num_samples_passed = num_screen_pixels = 0;
+		num_frames = 0;
+	}
+}
+
+#endif
+
+// Faces are fetched from a buffer texture in the vertex shaders, so the vertex spec has no attributes
+static void define_vertex_spec(void) {}
+
+// This makes a buffer texture that views a buffer of faces, so that the sector vertex shaders can fetch each face's record through it
+static GLuint init_face_buffer_texture(const GLuint face_buffer) {
+	GLuint face_buffer_texture;
+	glGenTextures(1, &face_buffer_texture);
+	use_texture(TexBuffer, face_buffer_texture);
+	glTexBuffer(TexBuffer, OPENGL_SECTOR_FACE_INTERNAL_PIXEL_FORMAT, face_buffer);
+
+	return face_buffer_texture;
+}
+
+////////// Making and remaking the sector geometry
+
+/* With a static mesh, the face sections of both sector orderings are uploaded here, and the draw list gets room
+for a run per sector. Otherwise, the vertex buffer is left empty with room for one section's faces, and visible
+faces are copied into it every frame. */
+static void upload_face_mesh(SectorContext* const sector_context) {
+	const List* const face_mesh = &sector_context -> mesh_cpu;
+
+	const bool use_static_mesh = sector_context -> static_mesh_draw_list.enabled;
+	const buffer_size_t num_faces_on_gpu = use_static_mesh
+		? face_mesh -> length : (face_mesh -> length / ARRAY_LENGTH(sector_context -> sector_orderings));
+
+	check_face_buffer_texture_size(num_faces_on_gpu);
+
+	use_vertex_buffer(sector_context -> drawable.vertex_buffer);
+	init_vertex_buffer_data(num_faces_on_gpu, sizeof(face_mesh_t), use_static_mesh ? face_mesh -> data : NULL,
+		use_static_mesh ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
+
+	if (use_static_mesh) {
+		const buffer_size_t max_num_visible_runs = sector_context -> sector_orderings[1].sectors.length + max_num_loose_sectors;
+
+		dealloc(sector_context -> static_mesh_draw_list.run_first_vertices);
+		dealloc(sector_context -> static_mesh_draw_list.run_vertex_counts);
+
+		sector_context -> static_mesh_draw_list.run_first_vertices = alloc(max_num_visible_runs, sizeof(GLint));
+		sector_context -> static_mesh_draw_list.run_vertex_counts = alloc(max_num_visible_runs, sizeof(GLsizei));
+	}
+}
+
+/* This meshes the maps, makes the sector orderings and the face mesh from that, and uploads the face mesh; and then it
+makes the shadow mesh. This is done when initializing a sector context, and when remeshing runs out of spare room. */
+static void init_sector_geometry(SectorContext* const sector_context,
+	const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data) {
+
+	////////// Making a list of sectors, and a face mesh
+
+	List sectors, face_mesh;
+
+	sector_context -> meshing.major_axis = generate_sectors_and_face_mesh_from_maps(&sectors, &face_mesh,
+		heightmap, texture_id_map_data, sector_context -> meshing.try_both_axes, sector_context -> meshing.tile_size);
+
+	////////// Making a second sector ordering, for drawing front to back along the x axis
+
+	const buffer_size_t
+		num_faces_per_ordering = face_mesh.length,
+		face_section_capacity = get_face_capacity_with_spare_room(num_faces_per_ordering);
+
+	const List x_major_sectors = init_x_major_sector_ordering(&sectors, &face_mesh, face_section_capacity);
+
+	const SectorOrdering sector_orderings[2] = {
+		{x_major_sectors, init_metasector_tree(&x_major_sectors, max_num_loose_sectors), {face_section_capacity, num_faces_per_ordering}},
+		{sectors, init_metasector_tree(&sectors, max_num_loose_sectors), {0, num_faces_per_ordering}}
+	};
+
+	// The sector orderings have const members deep down, so they're copied over like this
+	memcpy((void*) sector_context -> sector_orderings, sector_orderings, sizeof(sector_orderings));
+	sector_context -> mesh_cpu = face_mesh;
+
+	////////// Uploading the face mesh, and making a trimmed face mesh for shadow mapping
+
+	upload_face_mesh(sector_context);
+	init_trimmed_face_mesh_for_shadow_mapping(sector_context, heightmap);
+}
+
+static void deinit_sector_geometry(const SectorContext* const sector_context) {
+	deinit_list(sector_context -> mesh_cpu);
+
+	for (byte i = 0; i < ARRAY_LENGTH(sector_context -> sector_orderings); i++) {
+		const SectorOrdering* const sector_ordering = sector_context -> sector_orderings + i;
+		deinit_list(sector_ordering -> sectors);
+		deinit_metasector_tree(&sector_ordering -> metasector_tree);
+	}
+}
+
+////////// Saving and loading the sector geometry (for the level cache)
+
+SectorGeometryKey get_sector_geometry_key(const Heightmap heightmap,
+	const bool try_both_sector_meshing_axes, const bool use_lod,
+	const DynamicLightConfig* const dynamic_light_config) {
+
+	return (SectorGeometryKey) {
+		.format_version = sector_geometry_format_version,
+		.try_both_axes = try_both_sector_meshing_axes,
+		.tile_size = use_lod ? sector_lod_tile_size : 0,
+		.trimmed_face_ids = get_trimmed_face_ids(dynamic_light_config),
+		.map_size = heightmap.size
+	};
+}
+
+static void write_sector_geometry_list(List* const bytes, const List* const list) {
+	push_array_to_list(bytes, &list -> length, sizeof(list -> length));
+	push_array_to_list(bytes, list -> data, list -> length * list -> item_size);
+}
+
+/* The geometry is written as the major axis, the face mesh, each sector ordering (its sectors, face section,
+and metasector tree nodes and sector indices), and then the shadow mesh chunks and the shadow mesh. Lists
+are written as their length, and then their items. The shadow mesh is made again here, rather than read
+back from the GPU, so its chunks are laid out like they are right after meshing. */
+List serialize_sector_geometry(const SectorContext* const sector_context, const Heightmap heightmap) {
+	List bytes = init_list(sector_context -> mesh_cpu.length * sizeof(face_mesh_t) * 2u, byte);
+
+	push_ptr_to_list(&bytes, &sector_context -> meshing.major_axis);
+	write_sector_geometry_list(&bytes, &sector_context -> mesh_cpu);
+
+	for (byte i = 0; i < ARRAY_LENGTH(sector_context -> sector_orderings); i++) {
+		const SectorOrdering* const sector_ordering = sector_context -> sector_orderings + i;
+		const MetasectorTree* const metasector_tree = &sector_ordering -> metasector_tree;
+
+		write_sector_geometry_list(&bytes, &sector_ordering -> sectors);
+		push_array_to_list(&bytes, &sector_ordering -> face_section, sizeof(sector_ordering -> face_section));
+
+		push_array_to_list(&bytes, &metasector_tree -> num_nodes, sizeof(metasector_tree -> num_nodes));
+		push_array_to_list(&bytes, metasector_tree -> nodes, metasector_tree -> num_nodes * sizeof(Metasector));
+		push_array_to_list(&bytes, &metasector_tree -> num_sectors, sizeof(metasector_tree -> num_sectors));
+		push_array_to_list(&bytes, metasector_tree -> sector_indices, metasector_tree -> num_sectors * sizeof(buffer_size_t));
+	}
+
+	const buffer_size_t num_chunks = sector_context -> shadow_mapping.num_chunks;
+	ShadowMeshChunk* const chunks = alloc(num_chunks, sizeof(ShadowMeshChunk));
+	const List trimmed_face_mesh = init_trimmed_face_mesh(sector_context, heightmap, chunks);
+
+	push_array_to_list(&bytes, chunks, num_chunks * sizeof(ShadowMeshChunk));
+	write_sector_geometry_list(&bytes, &trimmed_face_mesh);
+
+	deinit_list(trimmed_face_mesh);
+	dealloc(chunks);
+
+	return bytes;
+}
+
+/* Once a read goes past the end, the reader is marked as failed, and every read after that gives zeroes (and empty
+lists), so that nothing is allocated from a malformed count. The caller checks `failed` once at the end. */
+typedef struct {
+	const byte* pos;
+	const byte* const end;
+	bool failed;
+} SectorGeometryReader;
+
+// This is checked before multiplying, so that a malformed count can't overflow
+static bool sector_geometry_reader_has_items(const SectorGeometryReader* const reader,
+	const buffer_size_t num_items, const buffer_size_t item_size) {
+
+	return !reader -> failed && num_items <= (buffer_size_t) (reader -> end - reader -> pos) / item_size;
+}
+
+static void read_sector_geometry_bytes(SectorGeometryReader* const reader, void* const dest, const buffer_size_t num_bytes) {
+	if (!sector_geometry_reader_has_items(reader, num_bytes, 1u)) {
+		reader -> failed = true;
+		memset(dest, 0, num_bytes);
+		return;
+	}
+
+	memcpy(dest, reader -> pos, num_bytes);
+	reader -> pos += num_bytes;
+}
+
+// This reads a count, and fails the reader if there aren't that many items of the given size left after it
+static buffer_size_t read_sector_geometry_count(SectorGeometryReader* const reader, const buffer_size_t item_size) {
+	buffer_size_t count;
+	read_sector_geometry_bytes(reader, &count, sizeof(count));
+
+	if (sector_geometry_reader_has_items(reader, count, item_size)) return count;
+	reader -> failed = true;
+	return 0;
+}
+
+// The list that's passed in should be empty
+static List read_sector_geometry_list(SectorGeometryReader* const reader, List list) {
+	const buffer_size_t length = read_sector_geometry_count(reader, list.item_size);
+	push_array_to_list(&list, reader -> pos, length);
+	reader -> pos += length * list.item_size;
+	return list;
+}
+
+/* This is the alternative to `init_sector_geometry` for when the level cache has the sector geometry. Its key
+has already been matched by the level cache, so this only fails if the geometry is malformed somehow (like if it's
+cut off, or if a count is too big); and in that case, nothing is kept from it, and false is returned. */
+static bool init_sector_geometry_from_cache(SectorContext* const sector_context, const List* const cached_geometry) {
+	SectorGeometryReader reader = {
+		cached_geometry -> data, (byte*) cached_geometry -> data + cached_geometry -> length, false
+	};
+
+	read_sector_geometry_bytes(&reader, &sector_context -> meshing.major_axis, sizeof(sector_context -> meshing.major_axis));
+	sector_context -> mesh_cpu = read_sector_geometry_list(&reader, init_list(1u, face_mesh_t));
+
+	SectorOrdering sector_orderings[ARRAY_LENGTH(sector_context -> sector_orderings)];
+
+	for (byte i = 0; i < ARRAY_LENGTH(sector_orderings); i++) {
+		const List sectors = read_sector_geometry_list(&reader, init_list(1u, Sector));
+
+		buffer_size_t face_section_start, num_used_faces_in_section, num_nodes, num_sectors;
+		read_sector_geometry_bytes(&reader, &face_section_start, sizeof(face_section_start));
+		read_sector_geometry_bytes(&reader, &num_used_faces_in_section, sizeof(num_used_faces_in_section));
+
+		num_nodes = read_sector_geometry_count(&reader, sizeof(Metasector));
+		Metasector* const nodes = alloc(num_nodes + 1u, sizeof(Metasector));
+		read_sector_geometry_bytes(&reader, nodes, num_nodes * sizeof(Metasector));
+
+		num_sectors = read_sector_geometry_count(&reader, sizeof(buffer_size_t));
+		buffer_size_t* const sector_indices = alloc(num_sectors + 1u, sizeof(buffer_size_t));
+		read_sector_geometry_bytes(&reader, sector_indices, num_sectors * sizeof(buffer_size_t));
+
+		const SectorOrdering sector_ordering = {
+			sectors, init_metasector_tree_from_nodes(nodes, num_nodes, sector_indices, num_sectors, max_num_loose_sectors),
+			{face_section_start, num_used_faces_in_section}
+		};
+
+		memcpy(sector_orderings + i, &sector_ordering, sizeof(sector_ordering));
+	}
+
+	// The sector orderings have const members deep down, so they're copied over like this
+	memcpy((void*) sector_context -> sector_orderings, sector_orderings, sizeof(sector_orderings));
+
+	read_sector_geometry_bytes(&reader, sector_context -> shadow_mapping.chunks,
+		sector_context -> shadow_mapping.num_chunks * sizeof(ShadowMeshChunk));
+
+	const List trimmed_face_mesh = read_sector_geometry_list(&reader, init_list(1u, face_mesh_t));
+
+	if (reader.failed || reader.pos != reader.end) {
+		deinit_sector_geometry(sector_context);
+		deinit_list(trimmed_face_mesh);
+		return false;
+	}
+
+	////////// Uploading the face mesh and the shadow mesh
+
+	upload_face_mesh(sector_context);
+	upload_trimmed_face_mesh(sector_context, &trimmed_face_mesh);
+	deinit_list(trimmed_face_mesh);
+
+	return true;
+}
+
+////////// Remeshing
+
+// Empty sectors (with a size of zero) are never in an area
+static bool sector_overlaps_area(const Sector* const sector, const map_pos_xz_t area_start, const map_pos_xz_t area_end) {
+	const map_pos_xz_t origin = sector -> origin, size = sector -> size;
+
+	return size.x != 0 &&
+		origin.x < area_end.x && origin.x + size.x > area_start.x &&
+		origin.z < area_end.z && origin.z + size.z > area_start.z;
+}
+
+// This gives back the indices of the sectors in an ordering that overlap an area, in list order
+static List get_removed_sector_indices(const SectorOrdering* const sector_ordering,
+	const map_pos_xz_t area_start, const map_pos_xz_t area_end) {
+
+	List removed_sector_indices = init_list(16u, buffer_size_t);
+	const Sector* const sectors = sector_ordering -> sectors.data;
+
+	for (buffer_size_t i = 0; i < sector_ordering -> sectors.length; i++) {
+		if (sector_overlaps_area(sectors + i, area_start, area_end))
+			push_ptr_to_list(&removed_sector_indices, &i);
+	}
+
+	return removed_sector_indices;
+}
+
+// For a static mesh, this uploads the faces from `start` to `end` (exclusive) in a face mesh. The vertex buffer must be bound.
+static void upload_remeshed_faces(const List* const face_mesh, const buffer_size_t start, const buffer_size_t end) {
+	if (start >= end) return;
+
+	glBufferSubData(GL_ARRAY_BUFFER, (GLintptr) (start * sizeof(face_mesh_t)),
+		(GLsizeiptr) ((end - start) * sizeof(face_mesh_t)), (face_mesh_t*) face_mesh -> data + start);
+}
+
+/* This puts the remeshed sectors in the list slots of the removed sectors, in the ordering's order (the remeshed sectors
+cover the same points as the removed ones, so they fit in about the same place in the order). A remeshed sector's faces
+go where the faces of the sector in its slot were, if they fit there; and otherwise, they go in the spare room of the
+ordering's face section. Remeshed sectors without a slot become loose sectors, and slots without a remeshed sector
+are left empty. The changed faces are uploaded for a static mesh, and after that, the metasector tree is refit. This
+returns false, and leaves the ordering as it was, if the ordering doesn't have enough spare room. */
+static bool place_remeshed_sectors_in_ordering(SectorContext* const sector_context, const byte major_axis,
+	const List* const removed_sector_indices, const List* const remeshed_sectors, const List* const remeshed_face_mesh,
+	const map_pos_xz_t remeshed_area_start, const map_pos_xz_t remeshed_area_end) {
+
+	SectorOrdering* const sector_ordering = sector_context -> sector_orderings + major_axis;
+	List* const sectors = &sector_ordering -> sectors;
+
+	const buffer_size_t
+		*const removed_indices = removed_sector_indices -> data,
+		num_removed_sectors = removed_sector_indices -> length,
+		num_remeshed_sectors = remeshed_sectors -> length;
+
+	////////// Sorting the remeshed sectors in the ordering's order
+
+	Sector* const ordered_sectors = alloc(num_remeshed_sectors, sizeof(Sector));
+	memcpy(ordered_sectors, remeshed_sectors -> data, num_remeshed_sectors * sizeof(Sector));
+
+	qsort(ordered_sectors, num_remeshed_sectors, sizeof(Sector),
+		major_axis ? compare_sector_origins : compare_sector_origins_x_first);
+
+	////////// Checking that there's enough spare room
+
+	const buffer_size_t
+		face_section_capacity = sector_context -> mesh_cpu.length / ARRAY_LENGTH(sector_context -> sector_orderings),
+		num_loose_sectors = sectors -> length - sector_ordering -> metasector_tree.num_sectors,
+		num_new_loose_sectors = (num_remeshed_sectors > num_removed_sectors) ? (num_remeshed_sectors - num_removed_sectors) : 0u;
+
+	buffer_size_t num_spare_faces_needed = 0;
+
+	for (buffer_size_t i = 0; i < num_remeshed_sectors; i++) {
+		const buffer_size_t num_faces = ordered_sectors[i].face_range.length;
+
+		if (i >= num_removed_sectors || num_faces > ((Sector*) sectors -> data)[removed_indices[i]].face_range.length)
+			num_spare_faces_needed += num_faces;
+	}
+
+	if (num_loose_sectors + num_new_loose_sectors > sector_ordering -> metasector_tree.max_num_loose_sectors ||
+		sector_ordering -> face_section.num_used + num_spare_faces_needed > face_section_capacity) {
+
+		dealloc(ordered_sectors);
+		return false;
+	}
+
+	////////// Placing the remeshed sectors, and their faces
+
+	/* For a static mesh, the faces put where old faces were are uploaded in runs of neighboring face ranges (since
+	the removed sectors can be far apart in the ordering), and the faces put in the spare room are uploaded at once. */
+
+	face_mesh_t* const faces = sector_context -> mesh_cpu.data;
+	const face_mesh_t* const remeshed_faces = remeshed_face_mesh -> data;
+
+	const bool use_static_mesh = sector_context -> static_mesh_draw_list.enabled;
+	if (use_static_mesh) use_vertex_buffer(sector_context -> drawable.vertex_buffer);
+
+	const buffer_size_t first_spare_face_used = sector_ordering -> face_section.start + sector_ordering -> face_section.num_used;
+	buffer_size_t reused_face_run_start = 0, reused_face_run_end = 0;
+
+	for (buffer_size_t i = 0; i < num_remeshed_sectors; i++) {
+		Sector sector = ordered_sectors[i];
+		Sector* const slot = (i < num_removed_sectors) ? ((Sector*) sectors -> data + removed_indices[i]) : NULL;
+
+		const face_mesh_t* const sector_faces = remeshed_faces + sector.face_range.start;
+		const buffer_size_t num_faces = sector.face_range.length;
+
+		if (slot != NULL && num_faces <= slot -> face_range.length) {
+			sector.face_range.start = slot -> face_range.start;
+
+			if (use_static_mesh && num_faces != 0) {
+				if (sector.face_range.start != reused_face_run_end) {
+					upload_remeshed_faces(&sector_context -> mesh_cpu, reused_face_run_start, reused_face_run_end);
+					reused_face_run_start = sector.face_range.start;
+				}
+				reused_face_run_end = sector.face_range.start + num_faces;
+			}
+		}
+		else {
+			sector.face_range.start = sector_ordering -> face_section.start + sector_ordering -> face_section.num_used;
+			sector_ordering -> face_section.num_used += num_faces;
+		}
+
+		memcpy(faces + sector.face_range.start, sector_faces, num_faces * sizeof(face_mesh_t));
+
+		if (slot != NULL) memcpy((void*) slot, &sector, sizeof(Sector));
+		else push_ptr_to_list(sectors, &sector);
+	}
+
+	if (use_static_mesh) {
+		upload_remeshed_faces(&sector_context -> mesh_cpu, reused_face_run_start, reused_face_run_end);
+		upload_remeshed_faces(&sector_context -> mesh_cpu, first_spare_face_used,
+			sector_ordering -> face_section.start + sector_ordering -> face_section.num_used);
+	}
+
+	for (buffer_size_t i = num_remeshed_sectors; i < num_removed_sectors; i++) {
+		Sector* const slot = (Sector*) sectors -> data + removed_indices[i];
+
+		const Sector empty_sector = {
+			.origin = slot -> origin, .size = {0, 0},
+			.visible_heights = {.min = 0, .max = 0},
+			.face_range = {.start = 0, .length = 0}
+		};
+
+		memcpy((void*) slot, &empty_sector, sizeof(Sector));
+	}
+
+	dealloc(ordered_sectors);
+	refit_metasector_tree(&sector_ordering -> metasector_tree, sectors, remeshed_area_start, remeshed_area_end);
+
+	return true;
+}
+
+/* Remeshing keeps the old sectors outside of the edited area as they are, and only forms new sectors for the
+points of the removed sectors; so the new sectors won't merge with old ones, and their faces leave gaps behind
+in the face mesh. When the spare room for that runs out, all sectors are meshed again from the maps. */
+void remesh_sectors_in_area(SectorContext* const sector_context,
+	const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data,
+	const map_pos_xz_t area_origin, const map_pos_xz_t area_size) {
+
+	if (area_size.x == 0 || area_size.z == 0) return;
+
+	const map_pos_xz_t area_end = {
+		(map_pos_component_t) (area_origin.x + area_size.x),
+		(map_pos_component_t) (area_origin.z + area_size.z)
+	};
+
+	if (area_origin.x + area_size.x > heightmap.size.x || area_origin.z + area_size.z > heightmap.size.z)
+		FAIL(UseLevelHeightmap, "Cannot remesh the sectors in the area at {%u, %u} with a size of {%u, %u}, "
+			"since it reaches past the map's size of {%u, %u}", area_origin.x, area_origin.z,
+			area_size.x, area_size.z, heightmap.size.x, heightmap.size.z);
+
+	////////// Finding the sectors to remove in each ordering
+
+	// Sectors that border the area are removed too, since their side faces depend on the heights in the area
+	const map_pos_xz_t
+		dependent_area_start = {
+			(map_pos_component_t) (area_origin.x - (area_origin.x != 0)),
+			(map_pos_component_t) (area_origin.z - (area_origin.z != 0))
+		},
+		dependent_area_end = {
+			(map_pos_component_t) (area_end.x + (area_end.x != heightmap.size.x)),
+			(map_pos_component_t) (area_end.z + (area_end.z != heightmap.size.z))
+		};
+
+	SectorOrdering* const sector_orderings = sector_context -> sector_orderings;
+	List removed_sector_indices[ARRAY_LENGTH(sector_context -> sector_orderings)];
+
+	for (byte i = 0; i < ARRAY_LENGTH(removed_sector_indices); i++)
+		removed_sector_indices[i] = get_removed_sector_indices(sector_orderings + i, dependent_area_start, dependent_area_end);
+
+	////////// Remeshing the points of the removed sectors
+
+	/* Every point outside of the removed sectors is marked as traversed, so that the new sectors only cover the
+	points of the removed ones. Those are searched for within the box around the removed sectors. */
+
+	const buffer_size_t num_map_grid_values = heightmap.size.x * heightmap.size.z;
+	const BitArray traversed_points = init_bitarray(num_map_grid_values);
+	set_bit_range_in_bitarray(traversed_points, 0, num_map_grid_values - 1u);
+
+	map_pos_xz_t remeshed_area_start = heightmap.size, remeshed_area_end = {0, 0};
+	const List* const z_major_removed_sector_indices = removed_sector_indices + 1;
+	const Sector* const z_major_sectors = sector_orderings[1].sectors.data;
+
+	LIST_FOR_EACH(z_major_removed_sector_indices, buffer_size_t, sector_index,
+		const Sector* const sector = z_major_sectors + *sector_index;
+		const map_pos_xz_t origin = sector -> origin, size = sector -> size;
+
+		if (origin.x < remeshed_area_start.x) remeshed_area_start.x = origin.x;
+		if (origin.z < remeshed_area_start.z) remeshed_area_start.z = origin.z;
+		if (origin.x + size.x > remeshed_area_end.x) remeshed_area_end.x = (map_pos_component_t) (origin.x + size.x);
+		if (origin.z + size.z > remeshed_area_end.z) remeshed_area_end.z = (map_pos_component_t) (origin.z + size.z);
+
+		for (buffer_size_t z = origin.z; z < (buffer_size_t) (origin.z + size.z); z++) {
+			for (buffer_size_t x = origin.x; x < (buffer_size_t) (origin.x + size.x); x++)
+				clear_bit_in_bitarray(traversed_points, z * heightmap.size.x + x);
+		}
+	);
+
+	List
+		remeshed_sectors = init_list(z_major_removed_sector_indices -> length, Sector),
+		remeshed_face_mesh = init_list(z_major_removed_sector_indices -> length * 3u, face_mesh_t);
+
+	generate_sectors_and_face_mesh_in_area(&remeshed_sectors, &remeshed_face_mesh, heightmap, texture_id_map_data,
+		traversed_points, sector_context -> meshing.major_axis, sector_context -> meshing.tile_size,
+		remeshed_area_start, remeshed_area_end);
+
+	deinit_bitarray(traversed_points);
+
+	////////// Placing the remeshed sectors in each ordering, and patching the shadow mesh
+
+	bool remeshed_sectors_fit = true;
+
+	for (byte i = 0; i < ARRAY_LENGTH(removed_sector_indices) && remeshed_sectors_fit; i++)
+		remeshed_sectors_fit = place_remeshed_sectors_in_ordering(sector_context, i,
+			removed_sector_indices + i, &remeshed_sectors, &remeshed_face_mesh, remeshed_area_start, remeshed_area_end);
+
+	if (!remeshed_sectors_fit) {
+		deinit_sector_geometry(sector_context);
+		init_sector_geometry(sector_context, heightmap, texture_id_map_data);
+	}
+	else if (!remesh_shadow_mesh_chunks(sector_context, heightmap, remeshed_area_start, remeshed_area_end))
+		init_trimmed_face_mesh_for_shadow_mapping(sector_context, heightmap);
+
+	if (sector_context -> lod.enabled)
+		remesh_sector_lod_tiles_in_area(&sector_context -> lod.tiles, heightmap, texture_id_map_data, area_origin, area_end);
+
+	////////// Deinit
+
+	for (byte i = 0; i < ARRAY_LENGTH(removed_sector_indices); i++) deinit_list(removed_sector_indices[i]);
+	deinit_list(remeshed_sectors);
+	deinit_list(remeshed_face_mesh);
+}
+
+////////// Initialization, deinitialization, and rendering
+
+SectorContext init_sector_context(
+	const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data,
+	const bool try_both_sector_meshing_axes, const bool use_static_mesh, const bool use_lod,
+	List* const cached_geometry, const GLchar* const* const texture_paths, const texture_id_t num_textures,
+	const MaterialPropertiesPerObjectType* const shared_material_properties,
+	const NormalMapCreator* const normal_map_creator,
+	const DynamicLightConfig* const dynamic_light_config) {
+
+	////////// Checking that there's not too many sector face textures
+
+	// TODO: also check that the max texture id in the heightmap doesn't exceed the maximum from here
+	if (num_textures > max_num_sector_subtextures) FAIL(ReadFromJSON, "Number of sector face texture paths "
+		"exceeds the maximum (%u > %u)", num_textures, max_num_sector_subtextures);
+
+	////////// Making an albedo texture set (and keeping its pixels on the CPU for the normal map)
+
+	const GLsizei texture_size = shared_material_properties -> texture_rescale_size;
+	SDL_Surface* albedo_surface;
+
+	const GLuint albedo_texture_set = init_texture_set(
+		false, true, TexRepeating, OPENGL_LEVEL_MAG_FILTER, OPENGL_LEVEL_MIN_FILTER,
+		num_textures, 0, texture_size, texture_size, texture_paths, NULL, &albedo_surface
+	);
+
+	////////// Making a drawable, and a face buffer for shadow mapping (the geometry is uploaded to them further below)
+
+	const Drawable drawable = init_drawable_with_vertices(
+		define_vertex_spec, NULL, use_static_mesh ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW, GL_TRIANGLES,
+		(List) {.data = NULL, .item_size = sizeof(face_mesh_t), .length = 0},
+
+		init_shader("shaders/sector.vert", NULL, "shaders/common/world_shading.frag", NULL),
+
+		albedo_texture_set, init_normal_map_from_albedo_texture(
+			normal_map_creator,
+			&shared_material_properties -> normal_map_config,
+			albedo_texture_set, albedo_surface, TexSet
+		)
+	);
+
+	deinit_surface(albedo_surface);
+
+	const GLuint face_buffer_for_shadow_mapping = init_gpu_buffer();
+	use_vertex_buffer(face_buffer_for_shadow_mapping);
+
+	////////// Meshing the level of detail tiles (which are drawn with the same shaders, but with their own face buffer texture)
+
+	const SectorLOD sector_lod = use_lod ? init_sector_lod(heightmap, texture_id_map_data) : (SectorLOD) {.face_buffer = 0};
+	const GLuint lod_face_buffer_texture = use_lod ? init_face_buffer_texture(sector_lod.face_buffer) : 0;
+
+	////////// Making depth shaders, and giving each sector shader its face buffer texture
+
+	const GLuint
+		face_buffer_texture = init_face_buffer_texture(drawable.vertex_buffer),
+		face_buffer_texture_for_shadow_mapping = init_face_buffer_texture(face_buffer_for_shadow_mapping),
+
+		shadow_depth_shader = init_shader(
+			"shaders/shadow/sector_depth.vert",
+			NULL,
+			"shaders/shadow/sector_depth.frag",
+			NULL
+		),
+
+		depth_prepass_shader = init_shader(
+			"shaders/sector_depth_prepass.vert",
+			NULL,
+			"shaders/shadow/sector_depth.frag",
+			NULL
+		);
+
+	const struct {const GLuint shader, face_buffer_texture; const TextureUnit texture_unit;} face_buffer_texture_users[] = {
+		{drawable.shader, face_buffer_texture, TU_SectorFaces},
+		{depth_prepass_shader, face_buffer_texture, TU_SectorFaces},
+		{shadow_depth_shader, face_buffer_texture_for_shadow_mapping, TU_SectorShadowFaces}
+	};
+
+	for (byte i = 0; i < ARRAY_LENGTH(face_buffer_texture_users); i++) {
+		const GLuint shader = face_buffer_texture_users[i].shader;
+		use_shader(shader);
+
+		use_texture_in_shader(face_buffer_texture_users[i].face_buffer_texture,
+			shader, "faces_sampler", TexBuffer, face_buffer_texture_users[i].texture_unit);
+	}
+
+	////////// Making a sector context, and its geometry
+
+	// The chunk count only depends on the map size, so it stays the same across remeshing
+	const buffer_size_t num_shadow_mesh_chunks =
+		get_num_shadow_mesh_chunks_across(heightmap.size.x) * get_num_shadow_mesh_chunks_across(heightmap.size.z);
+
+	SectorContext sector_context = {
+		.drawable = drawable,
+		.face_buffer_texture = face_buffer_texture,
+
+		.shadow_mapping = {
+			.face_buffer = face_buffer_for_shadow_mapping,
+			.face_buffer_texture = face_buffer_texture_for_shadow_mapping,
+			.depth_shader = shadow_depth_shader,
+			.depth_uniform_ids = {INIT_UNIFORM_ID(cascade_index, shadow_depth_shader)},
+
+			.trimmed_face_ids = get_trimmed_face_ids(dynamic_light_config),
+
+			.num_chunks = num_shadow_mesh_chunks,
+			.chunks = alloc(num_shadow_mesh_chunks, sizeof(ShadowMeshChunk)),
+
+			// Each run has at least one chunk, so there are never more runs than chunks
+			.run_first_vertices = alloc(num_shadow_mesh_chunks, sizeof(GLint)),
+			.run_vertex_counts = alloc(num_shadow_mesh_chunks, sizeof(GLsizei))
+		},
+
+		.depth_prepass_shader = depth_prepass_shader,
+
+		.meshing = {
+			.try_both_axes = try_both_sector_meshing_axes,
+			.tile_size = use_lod ? sector_lod_tile_size : 0,
+			.major_axis = 0
+		},
+
+		.static_mesh_draw_list = {
+			.enabled = use_static_mesh,
+			.run_first_vertices = NULL,
+			.run_vertex_counts = NULL
+		},
+
+		.lod = {.enabled = use_lod, .tiles = sector_lod, .face_buffer_texture = lod_face_buffer_texture}
+	};
+
+	if (cached_geometry -> length != 0 && !init_sector_geometry_from_cache(&sector_context, cached_geometry)) {
+		puts("The cached sector geometry is malformed, so the sectors are being meshed again");
+		cached_geometry -> length = 0;
+	}
+
+	if (cached_geometry -> length == 0) init_sector_geometry(&sector_context, heightmap, texture_id_map_data);
+
+	return sector_context;
+}
+
+void deinit_sector_context(const SectorContext* const sector_context) {
+	deinit_drawable(sector_context -> drawable);
+	deinit_texture(sector_context -> face_buffer_texture);
+
+	deinit_gpu_buffer(sector_context -> shadow_mapping.face_buffer);
+	deinit_texture(sector_context -> shadow_mapping.face_buffer_texture);
+	deinit_shader(sector_context -> shadow_mapping.depth_shader);
+
+	dealloc(sector_context -> shadow_mapping.chunks);
+	dealloc(sector_context -> shadow_mapping.run_first_vertices);
+	dealloc(sector_context -> shadow_mapping.run_vertex_counts);
+
+	deinit_shader(sector_context -> depth_prepass_shader);
+
+	deinit_sector_geometry(sector_context);
+
+	dealloc(sector_context -> static_mesh_draw_list.run_first_vertices);
+	dealloc(sector_context -> static_mesh_draw_list.run_vertex_counts);
+
+	if (sector_context -> lod.enabled) {
+		deinit_sector_lod(&sector_context -> lod.tiles);
+		deinit_texture(sector_context -> lod.face_buffer_texture);
+	}
+}
+
+/* Rather than copying every triangle into each cascade's depth layer with a geometry shader, the shadow
+mesh chunks are culled against each cascade on the CPU, and then drawn into that cascade's layer alone. */
+void draw_sectors_to_shadow_context(const SectorContext* const sector_context, const CascadedShadowContext* const shadow_context) {
+	use_shader(sector_context -> shadow_mapping.depth_shader);
+	use_vertex_spec(sector_context -> drawable.vertex_spec); // It has no attributes, so it can be shared
+
+	for (byte i = 0; i < shadow_context -> num_cascades; i++) {
+		const GLsizei num_runs = cull_shadow_mesh_chunks_into_draw_list(
+			sector_context, shadow_context -> light_view_projection_matrices[i]);
+
+		if (num_runs == 0) continue;
+
+		enable_rendering_to_shadow_cascade(shadow_context, i);
+		UPDATE_UNIFORM((&sector_context -> shadow_mapping), depth, cascade_index, 1ui, i);
+
+		glMultiDrawArrays(sector_context -> drawable.triangle_mode,
+			sector_context -> shadow_mapping.run_first_vertices,
+			sector_context -> shadow_mapping.run_vertex_counts, num_runs);
+	}
+
+	enable_rendering_to_all_shadow_cascades(shadow_context);
+}
+
+// The sector shaders fetch faces from whichever face buffer texture is bound to the sector face texture unit
+static void use_sector_face_buffer_texture(const GLuint face_buffer_texture) {
+	glActiveTexture(GL_TEXTURE0 + TU_SectorFaces);
+	use_texture(TexBuffer, face_buffer_texture);
+}
+
+void draw_sectors(const SectorContext* const sector_context, const Camera* const camera) {
+	/* For a dynamic mesh, visible faces are copied into the front or back of the vertex buffer, which is then
+	drawn as one range; and for a static mesh, each visible run of sectors is drawn as its own range. With level
+	of detail on, the tiles with a coarse level are culled on their own, and their sectors are skipped here. */
+
+	const SectorLOD* const sector_lod = &sector_context -> lod.tiles;
+	GLsizei num_lod_runs = 0;
+
+	if (sector_context -> lod.enabled) {
+		update_sector_lod_tile_levels(sector_lod, camera -> pos);
+		num_lod_runs = cull_sector_lod_tiles_into_draw_list(sector_lod, camera -> pos, (const vec4*) camera -> frustum_planes);
+	}
+
+	byte major_axis;
+	bool order_backwards;
+
+	const SectorOrdering* const sector_ordering = get_front_to_back_sector_ordering(
+		sector_context, camera, &major_axis, &order_backwards);
+
+	GLint single_first_vertex;
+	GLsizei single_vertex_count;
+
+	const GLint* run_first_vertices = &single_first_vertex;
+	const GLsizei* run_vertex_counts = &single_vertex_count;
+	GLsizei num_runs;
+
+	if (sector_context -> static_mesh_draw_list.enabled)
+		num_runs = frustum_cull_sector_faces_into_draw_list(sector_context, camera,
+			sector_ordering, major_axis, order_backwards, &run_first_vertices, &run_vertex_counts);
+	else {
+		buffer_size_t first_face_index, num_visible_faces;
+
+		frustum_cull_sector_faces_into_gpu_buffer(sector_context, camera,
+			sector_ordering, major_axis, order_backwards, &first_face_index, &num_visible_faces);
+
+		single_first_vertex = (GLint) (first_face_index * vertices_per_face);
+		single_vertex_count = (GLsizei) (num_visible_faces * vertices_per_face);
+		num_runs = num_visible_faces != 0;
+	}
+
+	// If looking out at the distance with no sectors, why do any state switching at all?
+	if (num_runs != 0 || num_lod_runs != 0) {
+		// TODO: call `draw_drawable` here instead
+		const Drawable* const drawable = &sector_context -> drawable;
+		const GLenum triangle_mode = drawable -> triangle_mode;
+
+		use_vertex_spec(drawable -> vertex_spec);
+
+		////////// Depth prepass
+
+		// Running a depth prepass
+		use_shader(sector_context -> depth_prepass_shader);
+
+		#ifdef PRINT_SECTOR_OVERDRAW
+		static GLuint samples_passed_query = 0;
+		if (samples_passed_query == 0) glGenQueries(1, &samples_passed_query);
+		glBeginQuery(GL_SAMPLES_PASSED, samples_passed_query);
+		#endif
+
+		/* No color buffer writes. The nearby sectors go first, and the coarse tiles after them; and the coarse
+		tiles' face buffer texture stays bound for the rendering pass, which draws them first for that reason. */
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			glMultiDrawArrays(triangle_mode, run_first_vertices, run_vertex_counts, num_runs);
+
+			if (num_lod_runs != 0) {
+				use_sector_face_buffer_texture(sector_context -> lod.face_buffer_texture);
+				glMultiDrawArrays(triangle_mode, sector_lod -> run_first_vertices, sector_lod -> run_vertex_counts, num_lod_runs);
+			}
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+		#ifdef PRINT_SECTOR_OVERDRAW
+		glEndQuery(GL_SAMPLES_PASSED);
+		print_sector_depth_prepass_overdraw(samples_passed_query);
+		#endif
+
+		////////// Rendering pass
+
+		// Only passing fragments with the same depth value
+		WITH_RENDER_STATE(glDepthFunc, GL_EQUAL, constants.default_depth_func,
+			// No depth buffer writes (TODO: stop the redundant state change for this in 'main.c')
+			WITH_RENDER_STATE(glDepthMask, GL_FALSE, GL_TRUE,
+				use_shader(drawable -> shader);
+
+				if (num_lod_runs != 0) {
+					glMultiDrawArrays(triangle_mode, sector_lod -> run_first_vertices, sector_lod -> run_vertex_counts, num_lod_runs);
+					use_sector_face_buffer_texture(sector_context -> face_buffer_texture);
+				}
+
+				glMultiDrawArrays(triangle_mode, run_first_vertices, run_vertex_counts, num_runs);
+			);
+		);
+	}
+}
+
+#ifdef BENCHMARK_SECTOR_REMESHING
+
+/* This times remeshing after edits to the heightmap, against meshing all sectors again, and prints the results. Each
+edit raises the heights in a random square area, remeshes, puts the heights back, and remeshes again. The timings
+include uploading, since the GPU is waited on after each remesh. Afterwards, all sectors are meshed again, so that
+the level looks like it did before. Textures and shaders aren't made again when meshing all sectors again, so the
+cost of calling `init_sector_context` again would be even higher than what's printed for that here. */
+void benchmark_sector_remeshing(SectorContext* const sector_context,
+	const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data) {
+
+	enum {num_full_remeshes = 5, num_edits_per_area_size = 200};
+	static const map_pos_component_t edit_area_sizes[] = {1u, 4u, 16u};
+
+	const GLdouble milliseconds_per_count = 1000.0 / (GLdouble) SDL_GetPerformanceFrequency();
+
+	////////// Meshing all sectors again
+
+	Uint64 total_counts = 0;
+
+	for (byte i = 0; i < num_full_remeshes; i++) {
+		glFinish();
+		const Uint64 start_count = SDL_GetPerformanceCounter();
+
+		deinit_sector_geometry(sector_context);
+		init_sector_geometry(sector_context, heightmap, texture_id_map_data);
+
+		glFinish();
+		total_counts += SDL_GetPerformanceCounter() - start_count;
+	}
+
+	printf("Meshing all sectors on a %ux%u map: %.3f ms on average\n", heightmap.size.x, heightmap.size.z,
+		(GLdouble) total_counts * milliseconds_per_count / num_full_remeshes);
+
+	////////// Remeshing after edits
+
+	srand(0);
+
+	for (byte i = 0; i < ARRAY_LENGTH(edit_area_sizes); i++) {
+		const map_pos_xz_t edit_area_size = {
+			(heightmap.size.x < edit_area_sizes[i]) ? heightmap.size.x : edit_area_sizes[i],
+			(heightmap.size.z < edit_area_sizes[i]) ? heightmap.size.z : edit_area_sizes[i]
+		};
+
+		map_pos_component_t prev_heights[256];
+		Uint64 total_edit_counts = 0, max_edit_counts = 0;
+
+		for (buffer_size_t j = 0; j < num_edits_per_area_size; j++) {
+			const map_pos_xz_t edit_area_origin = {
+				(map_pos_component_t) (rand() % (heightmap.size.x - edit_area_size.x + 1)),
+				(map_pos_component_t) (rand() % (heightmap.size.z - edit_area_size.z + 1))
+			};
+
+			for (byte putting_heights_back = 0; putting_heights_back < 2; putting_heights_back++) {
+				for (buffer_size_t z = 0; z < edit_area_size.z; z++) {
+					for (buffer_size_t x = 0; x < edit_area_size.x; x++) {
+						map_pos_component_t* const height = heightmap.data +
+							(edit_area_origin.z + z) * heightmap.size.x + edit_area_origin.x + x;
+
+						map_pos_component_t* const prev_height = prev_heights + z * edit_area_size.x + x;
+
+						if (putting_heights_back) *height = *prev_height;
+						else {
+							*prev_height = *height;
+							*height = (*height == 255u) ? 254u : (map_pos_component_t) (*height + 1u);
+						}
+					}
+				}
+
+				glFinish();
+				const Uint64 start_count = SDL_GetPerformanceCounter();
+
+				remesh_sectors_in_area(sector_context, heightmap, texture_id_map_data, edit_area_origin, edit_area_size);
+
+				glFinish();
+				const Uint64 edit_counts = SDL_GetPerformanceCounter() - start_count;
+
+				total_edit_counts += edit_counts;
+				if (edit_counts > max_edit_counts) max_edit_counts = edit_counts;
+			}
+		}
+
+		printf("Remeshing after editing a %ux%u area: %.3f ms on average, and %.3f ms at most\n",
+			edit_area_size.x, edit_area_size.z,
+			(GLdouble) total_edit_counts * milliseconds_per_count / (num_edits_per_area_size * 2),
+			(GLdouble) max_edit_counts * milliseconds_per_count);
+	}
+
+	deinit_sector_geometry(sector_context);
+	init_sector_geometry(sector_context, heightmap, texture_id_map_data);
+}
+
+#endif
@@ -0,0 +1,400 @@
+#include "rendering/entities/sector_lod.h"
+#include "rendering/entities/sector.h" // For `generate_sectors_and_face_mesh_in_area`, and `face_mesh_t`
+#include "rendering/entities/face.h" // For `get_face_aabb`
+#include "utils/map_utils.h" // For `sample_map`, and `sample_texture_id_map`
+#include "utils/bitarray.h" // For various `BitArray`-related defs
+#include "utils/opengl_wrappers.h" // For various OpenGL wrappers
+#include "utils/alloc.h" // For `alloc`, `clearing_alloc`, and `dealloc`
+#include "data/constants.h" // For `constants`
+#include <string.h> // For `memcpy`, and `memset`
+#include <float.h> // For `FLT_MAX`
+#include <math.h> // For `floorf`, `fminf`, `fmaxf`, and `sqrtf`
+
+////////// Constants
+
+/* A tile at least this far from the camera on the top-down axes gets the level after the one that the distance is
+indexed by. Nearer distances cut more faces per frame on the terrain maps, but then the player can see blocks
+change shape; with these, the first coarse level starts a tile or two away from the nearest sectors. */
+static const GLfloat sector_lod_level_distances[num_sector_lod_levels - 1] = {64.0f, 112.0f, 176.0f};
+
+// Like for the regular face mesh, each tile's face range has spare room for remeshing: an eighth more faces, plus a small minimum
+static const buffer_size_t spare_face_capacity_divisor = 8u, min_num_spare_faces = 16u;
+
+// The local maps that a tile is meshed from have a one-point ring around the tile, for the level 0 heights right outside of it
+enum {local_map_size = sector_lod_tile_size + 2};
+
+////////// Meshing tiles
+
+static buffer_size_t get_num_sector_lod_tiles_across(const map_pos_component_t map_size) {
+	return ((map_pos_component_t) (map_size - 1u) / sector_lod_tile_size) + 1u;
+}
+
+/* This fills in a local max-heightmap and texture id map for a tile at a level, with the ring around it. Inside the tile,
+each block takes on the height of its highest point, and the texture id of the first highest point. The ring gets the
+level 0 heights; and outside of the map, it gets the biggest height possible, so that no walls face out of the map. */
+static void init_max_heightmap_for_sector_lod_tile(
+	map_pos_component_t* const local_heights, map_texture_id_t* const local_texture_ids,
+	const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data,
+	const map_pos_xz_t tile_origin, const map_pos_xz_t tile_size, const byte level) {
+
+	////////// The ring
+
+	for (signed_map_pos_component_t local_z = 0; local_z < local_map_size; local_z++) {
+		for (signed_map_pos_component_t local_x = 0; local_x < local_map_size; local_x++) {
+			const bool in_tile = local_x > 0 && local_z > 0 && local_x <= tile_size.x && local_z <= tile_size.z;
+			if (in_tile) continue;
+
+			const signed_map_pos_component_t x = tile_origin.x + local_x - 1, z = tile_origin.z + local_z - 1;
+			const buffer_size_t local_index = (buffer_size_t) (local_z * local_map_size + local_x);
+
+			local_texture_ids[local_index] = 0;
+
+			if (x < 0 || z < 0 || x >= heightmap.size.x || z >= heightmap.size.z)
+				local_heights[local_index] = constants.max_byte_value;
+			else
+				local_heights[local_index] = sample_map(heightmap, (map_pos_xz_t) {(map_pos_component_t) x, (map_pos_component_t) z});
+		}
+	}
+
+	////////// The blocks inside the tile
+
+	const map_pos_component_t block_size = (map_pos_component_t) (1u << level);
+
+	for (map_pos_component_t block_z = 0; block_z < tile_size.z; block_z += block_size) {
+		for (map_pos_component_t block_x = 0; block_x < tile_size.x; block_x += block_size) {
+			const map_pos_component_t
+				block_end_x = (block_x + block_size < tile_size.x) ? (map_pos_component_t) (block_x + block_size) : tile_size.x,
+				block_end_z = (block_z + block_size < tile_size.z) ? (map_pos_component_t) (block_z + block_size) : tile_size.z;
+
+			map_pos_component_t max_height = 0;
+			map_texture_id_t texture_id = 0;
+			bool found_point = false;
+
+			for (map_pos_component_t z = block_z; z < block_end_z; z++) {
+				for (map_pos_component_t x = block_x; x < block_end_x; x++) {
+					const map_pos_xz_t pos = {(map_pos_component_t) (tile_origin.x + x), (map_pos_component_t) (tile_origin.z + z)};
+					const map_pos_component_t height = sample_map(heightmap, pos);
+
+					if (!found_point || height > max_height) {
+						max_height = height;
+						texture_id = sample_texture_id_map(texture_id_map_data, heightmap.size.x, pos);
+						found_point = true;
+					}
+				}
+			}
+
+			for (map_pos_component_t z = block_z; z < block_end_z; z++) {
+				for (map_pos_component_t x = block_x; x < block_end_x; x++) {
+					const buffer_size_t local_index = (buffer_size_t) ((z + 1u) * local_map_size + x + 1u);
+					local_heights[local_index] = max_height;
+					local_texture_ids[local_index] = texture_id;
+				}
+			}
+		}
+	}
+}
+
+/* This appends the faces of a tile to a face mesh, for each coarse level in order, and sets how many faces
+each level has. The faces are meshed in the tile's local maps, and then moved to where the tile is. */
+static void mesh_sector_lod_tile(SectorLODTile* const tile, List* const face_mesh,
+	const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data,
+	const map_pos_xz_t tile_origin, const map_pos_xz_t tile_size) {
+
+	map_pos_component_t local_heights[local_map_size * local_map_size];
+	map_texture_id_t local_texture_ids[local_map_size * local_map_size];
+
+	const Heightmap local_heightmap = {local_heights, {local_map_size, local_map_size}};
+	const BitArray traversed_points = init_bitarray(local_map_size * local_map_size);
+	List sectors = init_list(64u, Sector);
+
+	for (byte level = 1; level < num_sector_lod_levels; level++) {
+		init_max_heightmap_for_sector_lod_tile(local_heights, local_texture_ids,
+			heightmap, texture_id_map_data, tile_origin, tile_size, level);
+
+		////////// Marking every point outside of the tile as traversed, so that only the tile gets sectors
+
+		clear_bitarray(traversed_points, local_map_size * local_map_size);
+
+		for (buffer_size_t local_z = 0; local_z < local_map_size; local_z++) {
+			for (buffer_size_t local_x = 0; local_x < local_map_size; local_x++) {
+				if (local_x == 0 || local_z == 0 || local_x > tile_size.x || local_z > tile_size.z)
+					set_bit_in_bitarray(traversed_points, local_z * local_map_size + local_x);
+			}
+		}
+
+		////////// Meshing the tile, and moving its faces into place
+
+		const buffer_size_t first_face = face_mesh -> length;
+		clear_list(&sectors);
+
+		generate_sectors_and_face_mesh_in_area(&sectors, face_mesh, local_heightmap, local_texture_ids,
+			traversed_points, 0, 0, (map_pos_xz_t) {1, 1},
+			(map_pos_xz_t) {(map_pos_component_t) (tile_size.x + 1u), (map_pos_component_t) (tile_size.z + 1u)});
+
+		face_mesh_t* const faces = face_mesh -> data;
+
+		for (buffer_size_t i = first_face; i < face_mesh -> length; i++) {
+			faces[i][0] += tile_origin.x - 1u;
+			faces[i][2] += tile_origin.z - 1u;
+		}
+
+		tile -> num_faces[level - 1] = face_mesh -> length - first_face;
+	}
+
+	deinit_list(sectors);
+	deinit_bitarray(traversed_points);
+}
+
+static void get_sector_lod_tile_area(const SectorLOD* const sector_lod, const Heightmap heightmap,
+	const buffer_size_t tile_index, map_pos_xz_t* const tile_origin, map_pos_xz_t* const tile_size) {
+
+	const buffer_size_t
+		origin_x = (tile_index % sector_lod -> num_tiles_across) * sector_lod_tile_size,
+		origin_z = (tile_index / sector_lod -> num_tiles_across) * sector_lod_tile_size,
+		size_x = heightmap.size.x - origin_x, size_z = heightmap.size.z - origin_z;
+
+	*tile_origin = (map_pos_xz_t) {(map_pos_component_t) origin_x, (map_pos_component_t) origin_z};
+
+	*tile_size = (map_pos_xz_t) {
+		(map_pos_component_t) ((size_x < sector_lod_tile_size) ? size_x : sector_lod_tile_size),
+		(map_pos_component_t) ((size_z < sector_lod_tile_size) ? size_z : sector_lod_tile_size)
+	};
+}
+
+// An empty tile gets an inverted box, which is never in the view frustum
+static void set_sector_lod_tile_aabb(SectorLODTile* const tile, face_mesh_t* const faces) {
+	glm_vec3_fill(tile -> aabb[0], FLT_MAX);
+	glm_vec3_fill(tile -> aabb[1], -FLT_MAX);
+
+	buffer_size_t num_faces = 0;
+	for (byte i = 0; i < num_sector_lod_levels - 1; i++) num_faces += tile -> num_faces[i];
+
+	for (buffer_size_t i = 0; i < num_faces; i++) {
+		vec3 face_aabb[2];
+		get_face_aabb(faces[i], face_aabb);
+		glm_vec3_minv(tile -> aabb[0], face_aabb[0], tile -> aabb[0]);
+		glm_vec3_maxv(tile -> aabb[1], face_aabb[1], tile -> aabb[1]);
+	}
+}
+
+// This meshes every tile, lays out their faces with spare room after each one, and uploads them
+static void mesh_all_sector_lod_tiles(SectorLOD* const sector_lod,
+	const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data) {
+
+	const buffer_size_t num_tiles = sector_lod -> num_tiles_across * sector_lod -> num_tiles_down;
+	List unpadded_face_mesh = init_list(num_tiles * 64u, face_mesh_t);
+
+	for (buffer_size_t i = 0; i < num_tiles; i++) {
+		map_pos_xz_t tile_origin, tile_size;
+		get_sector_lod_tile_area(sector_lod, heightmap, i, &tile_origin, &tile_size);
+		mesh_sector_lod_tile(sector_lod -> tiles + i, &unpadded_face_mesh, heightmap, texture_id_map_data, tile_origin, tile_size);
+	}
+
+	////////// Laying out the tiles' faces with spare room
+
+	buffer_size_t total_capacity = 0;
+
+	for (buffer_size_t i = 0; i < num_tiles; i++) {
+		SectorLODTile* const tile = sector_lod -> tiles + i;
+
+		buffer_size_t num_faces = 0;
+		for (byte j = 0; j < num_sector_lod_levels - 1; j++) num_faces += tile -> num_faces[j];
+
+		tile -> first_face = total_capacity;
+		tile -> max_num_faces = num_faces + num_faces / spare_face_capacity_divisor + min_num_spare_faces;
+		total_capacity += tile -> max_num_faces;
+	}
+
+	deinit_list(sector_lod -> mesh_cpu);
+	sector_lod -> mesh_cpu = init_list(total_capacity, face_mesh_t);
+	sector_lod -> mesh_cpu.length = total_capacity;
+
+	face_mesh_t* const faces = sector_lod -> mesh_cpu.data;
+	const face_mesh_t* const unpadded_faces = unpadded_face_mesh.data;
+	memset(faces, 0, total_capacity * sizeof(face_mesh_t));
+
+	for (buffer_size_t i = 0, unpadded_first_face = 0; i < num_tiles; i++) {
+		SectorLODTile* const tile = sector_lod -> tiles + i;
+
+		buffer_size_t num_faces = 0;
+		for (byte j = 0; j < num_sector_lod_levels - 1; j++) num_faces += tile -> num_faces[j];
+
+		memcpy(faces + tile -> first_face, unpadded_faces + unpadded_first_face, num_faces * sizeof(face_mesh_t));
+		set_sector_lod_tile_aabb(tile, faces + tile -> first_face);
+		unpadded_first_face += num_faces;
+	}
+
+	deinit_list(unpadded_face_mesh);
+
+	////////// Uploading the faces
+
+	use_vertex_buffer(sector_lod -> face_buffer);
+	init_vertex_buffer_data(total_capacity, sizeof(face_mesh_t), faces, GL_STATIC_DRAW);
+}
+
+////////// Initialization and deinitialization
+
+SectorLOD init_sector_lod(const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data) {
+	const buffer_size_t
+		num_tiles_across = get_num_sector_lod_tiles_across(heightmap.size.x),
+		num_tiles_down = get_num_sector_lod_tiles_across(heightmap.size.z),
+		num_tiles = num_tiles_across * num_tiles_down;
+
+	SectorLOD sector_lod = {
+		.mesh_cpu = init_list(1u, face_mesh_t),
+		.face_buffer = init_gpu_buffer(),
+
+		.num_tiles_across = num_tiles_across, .num_tiles_down = num_tiles_down,
+		.tiles = alloc(num_tiles, sizeof(SectorLODTile)),
+		.tile_levels = clearing_alloc(num_tiles, sizeof(byte)),
+
+		.run_first_vertices = alloc(num_tiles, sizeof(GLint)),
+		.run_vertex_counts = alloc(num_tiles, sizeof(GLsizei))
+	};
+
+	mesh_all_sector_lod_tiles(&sector_lod, heightmap, texture_id_map_data);
+	return sector_lod;
+}
+
+void deinit_sector_lod(const SectorLOD* const sector_lod) {
+	deinit_list(sector_lod -> mesh_cpu);
+	deinit_gpu_buffer(sector_lod -> face_buffer);
+
+	dealloc(sector_lod -> tiles);
+	dealloc(sector_lod -> tile_levels);
+	dealloc(sector_lod -> run_first_vertices);
+	dealloc(sector_lod -> run_vertex_counts);
+}
+
+////////// Remeshing
+
+/* A tile depends on its own points, and on the ring around it. So the tiles that depend on an area are the ones
+that it overlaps, plus the ones right before or after it, if the area touches their borders. If a remeshed tile
+doesn't fit in its face range, every tile is meshed again. */
+void remesh_sector_lod_tiles_in_area(SectorLOD* const sector_lod,
+	const Heightmap heightmap, const map_texture_id_t* const texture_id_map_data,
+	const map_pos_xz_t area_start, const map_pos_xz_t area_end) {
+
+	const buffer_size_t
+		first_tile_x = (area_start.x == 0) ? 0 : (area_start.x - 1u) / sector_lod_tile_size,
+		first_tile_z = (area_start.z == 0) ? 0 : (area_start.z - 1u) / sector_lod_tile_size,
+		last_tile_x = area_end.x / sector_lod_tile_size, last_tile_z = area_end.z / sector_lod_tile_size,
+		end_tile_x = (last_tile_x < sector_lod -> num_tiles_across) ? last_tile_x + 1u : sector_lod -> num_tiles_across,
+		end_tile_z = (last_tile_z < sector_lod -> num_tiles_down) ? last_tile_z + 1u : sector_lod -> num_tiles_down;
+
+	List tile_face_mesh = init_list(256u, face_mesh_t);
+	face_mesh_t* const faces = sector_lod -> mesh_cpu.data;
+
+	use_vertex_buffer(sector_lod -> face_buffer);
+
+	for (buffer_size_t tile_z = first_tile_z; tile_z < end_tile_z; tile_z++) {
+		for (buffer_size_t tile_x = first_tile_x; tile_x < end_tile_x; tile_x++) {
+			const buffer_size_t tile_index = tile_z * sector_lod -> num_tiles_across + tile_x;
+			SectorLODTile* const tile = sector_lod -> tiles + tile_index;
+			const SectorLODTile prev_tile = *tile;
+
+			map_pos_xz_t tile_origin, tile_size;
+			get_sector_lod_tile_area(sector_lod, heightmap, tile_index, &tile_origin, &tile_size);
+
+			clear_list(&tile_face_mesh);
+			mesh_sector_lod_tile(tile, &tile_face_mesh, heightmap, texture_id_map_data, tile_origin, tile_size);
+
+			if (tile_face_mesh.length > tile -> max_num_faces) {
+				*tile = prev_tile;
+				deinit_list(tile_face_mesh);
+				mesh_all_sector_lod_tiles(sector_lod, heightmap, texture_id_map_data);
+				return;
+			}
+
+			memcpy(faces + tile -> first_face, tile_face_mesh.data, tile_face_mesh.length * sizeof(face_mesh_t));
+			set_sector_lod_tile_aabb(tile, faces + tile -> first_face);
+
+			glBufferSubData(GL_ARRAY_BUFFER, (GLintptr) (tile -> first_face * sizeof(face_mesh_t)),
+				(GLsizeiptr) (tile_face_mesh.length * sizeof(face_mesh_t)), tile_face_mesh.data);
+		}
+	}
+
+	deinit_list(tile_face_mesh);
+}
+
+////////// Choosing levels, and culling
+
+// This is the distance from the camera to the closest point of a tile on the top-down axes
+static GLfloat get_distance_to_sector_lod_tile(const buffer_size_t tile_x, const buffer_size_t tile_z, const vec3 camera_pos) {
+	const GLfloat
+		min_x = (GLfloat) (tile_x * sector_lod_tile_size), max_x = min_x + sector_lod_tile_size,
+		min_z = (GLfloat) (tile_z * sector_lod_tile_size), max_z = min_z + sector_lod_tile_size;
+
+	const GLfloat
+		dx = fmaxf(fmaxf(min_x - camera_pos[0], camera_pos[0] - max_x), 0.0f),
+		dz = fmaxf(fmaxf(min_z - camera_pos[2], camera_pos[2] - max_z), 0.0f);
+
+	return sqrtf(dx * dx + dz * dz);
+}
+
+void update_sector_lod_tile_levels(const SectorLOD* const sector_lod, const vec3 camera_pos) {
+	byte* const tile_levels = sector_lod -> tile_levels;
+
+	for (buffer_size_t tile_z = 0; tile_z < sector_lod -> num_tiles_down; tile_z++) {
+		for (buffer_size_t tile_x = 0; tile_x < sector_lod -> num_tiles_across; tile_x++) {
+			const GLfloat dist = get_distance_to_sector_lod_tile(tile_x, tile_z, camera_pos);
+
+			byte level = 0;
+			while (level < num_sector_lod_levels - 1 && dist >= sector_lod_level_distances[level]) level++;
+			tile_levels[tile_z * sector_lod -> num_tiles_across + tile_x] = level;
+		}
+	}
+}
+
+/* The tiles are visited in square rings around the tile that the camera is over, so that they're drawn
+roughly front to back. Only tiles with a coarse level are drawn here; level 0 tiles are drawn as sectors. */
+GLsizei cull_sector_lod_tiles_into_draw_list(const SectorLOD* const sector_lod,
+	const vec3 camera_pos, const vec4* const frustum_planes) {
+
+	const signed_map_pos_component_t
+		num_tiles_across = (signed_map_pos_component_t) sector_lod -> num_tiles_across,
+		num_tiles_down = (signed_map_pos_component_t) sector_lod -> num_tiles_down,
+		num_rings = (num_tiles_across > num_tiles_down) ? num_tiles_across : num_tiles_down;
+
+	// The camera can be past the map's edges, so the tile that it's over is clamped to the map
+	const GLfloat
+		camera_tile_x = floorf(camera_pos[0] / sector_lod_tile_size),
+		camera_tile_z = floorf(camera_pos[2] / sector_lod_tile_size);
+
+	const signed_map_pos_component_t
+		first_ring_x = (signed_map_pos_component_t) fminf(fmaxf(camera_tile_x, 0.0f), (GLfloat) (num_tiles_across - 1)),
+		first_ring_z = (signed_map_pos_component_t) fminf(fmaxf(camera_tile_z, 0.0f), (GLfloat) (num_tiles_down - 1));
+
+	GLsizei num_runs = 0;
+
+	for (signed_map_pos_component_t ring = 0; ring < num_rings; ring++) {
+		for (signed_map_pos_component_t tile_z = first_ring_z - ring; tile_z <= first_ring_z + ring; tile_z++) {
+			if (tile_z < 0 || tile_z >= num_tiles_down) continue;
+
+			// Rows in the middle of a ring only have a tile on each side
+			const bool on_ring_edge_row = tile_z == first_ring_z - ring || tile_z == first_ring_z + ring;
+			const signed_map_pos_component_t step = (ring == 0 || on_ring_edge_row) ? 1 : ring * 2;
+
+			for (signed_map_pos_component_t tile_x = first_ring_x - ring; tile_x <= first_ring_x + ring; tile_x += step) {
+				if (tile_x < 0 || tile_x >= num_tiles_across) continue;
+
+				const buffer_size_t tile_index = (buffer_size_t) (tile_z * num_tiles_across + tile_x);
+				const byte level = sector_lod -> tile_levels[tile_index];
+				if (level == 0) continue;
+
+				const SectorLODTile* const tile = sector_lod -> tiles + tile_index;
+				const buffer_size_t num_faces = tile -> num_faces[level - 1];
+				if (num_faces == 0 || !glm_aabb_frustum((vec3*) tile -> aabb, (vec4*) frustum_planes)) continue;
+
+				buffer_size_t first_face = tile -> first_face;
+				for (byte i = 0; i < level - 1; i++) first_face += tile -> num_faces[i];
+
+				sector_lod -> run_first_vertices[num_runs] = (GLint) (first_face * vertices_per_face);
+				sector_lod -> run_vertex_counts[num_runs] = (GLsizei) (num_faces * vertices_per_face);
+				num_runs++;
+			}
+		}
+	}
+
+	return num_runs;
+}
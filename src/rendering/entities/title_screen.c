@@ -80,7 +80,8 @@ TitleScreen init_title_screen_from_json(const GLchar* const json_path,
 				JSON_TO_FIELD(normal_map, blur_radius, u8),
 				JSON_TO_FIELD(normal_map, blur_std_dev, float),
 				JSON_TO_FIELD(normal_map, heightmap_scale, float),
-				JSON_TO_FIELD(normal_map, rescale_factor, float)
+				JSON_TO_FIELD(normal_map, rescale_factor, float),
+				JSON_TO_FIELD(normal_map, use_box_blur, bool)
 			},
 		},
 
@@ -145,10 +146,12 @@ TitleScreen init_title_screen(const TitleScreenConfig* const config,
 
 	/* This is only a texture set so that it can work with the shader function
 	`get_albedo_and_normal` (TODO: genericize that one, if possible) */
+	SDL_Surface* scrolling_albedo_surface;
+
 	const GLuint scrolling_albedo_texture = init_texture_set(false, false, TexRepeating,
 		scrolling_layer_config -> use_bilinear_filtering ? TexLinear : TexNearest,
 		min_filter, 1, 0, scrolling_texture_size[0], scrolling_texture_size[1],
-		(const GLchar*[]) {scrolling_texture_path}, NULL
+		(const GLchar*[]) {scrolling_texture_path}, NULL, &scrolling_albedo_surface
 	);
 
 	// Overwriting the vertical wrap through a dumb hack
@@ -157,12 +160,14 @@ TitleScreen init_title_screen(const TitleScreenConfig* const config,
 	const GLuint
 		scrolling_normal_map = init_normal_map_from_albedo_texture(
 			normal_map_creator, &config -> scrolling.normal_map_config,
-			scrolling_albedo_texture, scrolling_texture_type),
+			scrolling_albedo_texture, scrolling_albedo_surface, scrolling_texture_type),
 
 		still_albedo_texture = init_plain_texture(still_layer_config -> texture_path, TexNonRepeating,
 			still_layer_config -> use_bilinear_filtering ? TexLinear : TexNearest,
 			min_filter, OPENGL_DEFAULT_INTERNAL_PIXEL_FORMAT);
 
+	deinit_surface(scrolling_albedo_surface);
+
 	////////// Making a shader, and setting some uniforms
 
 	const GLuint shader = init_shader("shaders/title_screen.vert", NULL, "shaders/title_screen.frag", NULL);
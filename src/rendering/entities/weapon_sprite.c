@@ -240,12 +240,19 @@ WeaponSprite init_weapon_sprite(
 
 	deinit_surface(peek_surface);
 
+	SDL_Surface* albedo_surface;
+
 	const GLuint albedo_texture_set = init_texture_set(
 		true, false, TexNonRepeating,
 		OPENGL_LEVEL_MAG_FILTER, OPENGL_LEVEL_MIN_FILTER, 0, 1,
-		frame_size[0], frame_size[1], NULL, animation_layout
+		frame_size[0], frame_size[1], NULL, animation_layout, &albedo_surface
 	);
 
+	const GLuint normal_map_set = init_normal_map_from_albedo_texture(normal_map_creator,
+		&config -> shared_material_properties.normal_map_config, albedo_texture_set, albedo_surface, TexSet);
+
+	deinit_surface(albedo_surface);
+
 	////////// Making a world shader, and setting the material index uniform
 
 	const GLuint world_shader = init_shader(
@@ -273,13 +280,7 @@ WeaponSprite init_weapon_sprite(
 			define_vertex_spec, (uniform_updater_t) update_uniforms, GL_DYNAMIC_DRAW,
 			GL_TRIANGLE_STRIP, (List) {NULL, sizeof(vec3), corners_per_quad, corners_per_quad},
 
-			world_shader, albedo_texture_set,
-
-			init_normal_map_from_albedo_texture(
-				normal_map_creator,
-				&config -> shared_material_properties.normal_map_config,
-				albedo_texture_set, TexSet
-			)
+			world_shader, albedo_texture_set, normal_map_set
 		),
 
 		.depth_prepass_shader = depth_prepass_shader,
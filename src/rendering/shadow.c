@@ -187,6 +187,18 @@ CascadedShadowContext init_shadow_context(const CascadedShadowContextConfig* con
 	glDrawBuffer(GL_NONE); glReadBuffer(GL_NONE); // Not drawing into or reading from any color buffers
 	check_framebuffer_completeness();
 
+	/* Geometry that's culled per cascade is drawn into one depth layer at a time, so there's one more
+	framebuffer per cascade too. These share the depth layers with the framebuffer above. */
+	GLuint* const cascade_framebuffers = alloc((size_t) num_cascades, sizeof(GLuint));
+
+	for (byte i = 0; i < num_cascades; i++) {
+		use_framebuffer(framebuffer_target, cascade_framebuffers[i] = init_framebuffer());
+
+		glFramebufferTextureLayer(framebuffer_target, GL_DEPTH_ATTACHMENT, depth_layers, 0, i);
+		glDrawBuffer(GL_NONE); glReadBuffer(GL_NONE);
+		check_framebuffer_completeness();
+	}
+
 	use_framebuffer(framebuffer_target, 0);
 
 	////////// Creating the depth samplers
@@ -215,6 +227,7 @@ CascadedShadowContext init_shadow_context(const CascadedShadowContextConfig* con
 		.depth_layers = depth_layers,
 		.plain_depth_sampler = plain_depth_sampler,
 		.depth_comparison_sampler = depth_comparison_sampler,
+		.cascade_framebuffers = cascade_framebuffers,
 
 		.resolution = resolution, .num_cascades = num_cascades,
 		.sub_frustum_scale = config -> sub_frustum_scale,
@@ -229,6 +242,11 @@ void deinit_shadow_context(const CascadedShadowContext* const shadow_context) {
 	dealloc(shadow_context -> light_view_projection_matrices);
 	deinit_texture(shadow_context -> depth_layers);
 	deinit_framebuffer(shadow_context -> framebuffer);
+
+	for (byte i = 0; i < shadow_context -> num_cascades; i++)
+		deinit_framebuffer(shadow_context -> cascade_framebuffers[i]);
+
+	dealloc(shadow_context -> cascade_framebuffers);
 	glDeleteSamplers(2, (GLuint[]) {shadow_context -> plain_depth_sampler, shadow_context -> depth_comparison_sampler});
 }
 
@@ -269,6 +287,16 @@ void enable_rendering_to_shadow_context(const CascadedShadowContext* const shado
 	glClear(GL_DEPTH_BUFFER_BIT);
 }
 
+// This should only be called between `enable_rendering_to_shadow_context` and `disable_rendering_to_shadow_context`
+void enable_rendering_to_shadow_cascade(const CascadedShadowContext* const shadow_context, const byte cascade_index) {
+	use_framebuffer(framebuffer_target, shadow_context -> cascade_framebuffers[cascade_index]);
+}
+
+// This undoes `enable_rendering_to_shadow_cascade`, so that layered rendering goes to every cascade again
+void enable_rendering_to_all_shadow_cascades(const CascadedShadowContext* const shadow_context) {
+	use_framebuffer(framebuffer_target, shadow_context -> framebuffer);
+}
+
 void disable_rendering_to_shadow_context(const GLint screen_size[2]) {
 	use_framebuffer(framebuffer_target, 0);
 	glViewport(0, 0, screen_size[0], screen_size[1]);
@@ -1,6 +1,6 @@
 #include "shared_shading_params.h"
 #include "utils/macro_utils.h" // For `ARRAY_LENGTH`
-#include "utils/opengl_wrappers.h" // For `use_shader`
+#include "utils/opengl_wrappers.h" // For `use_shader`, and `INIT_UNIFORM_VALUE`
 
 static void init_constant_shading_params(UniformBuffer* const shading_params,
 	const LevelRenderingConfig* const level_rendering_config,
@@ -166,7 +166,10 @@ void init_shared_textures_for_world_shaded_objects(
 	const GLuint materials_texture) {
 
 	const GLuint
-		ao_map_texture = ao_map -> texture,
+		ao_indirection_texture = ao_map -> indirection_texture,
+		ao_brick_pool_texture = ao_map -> brick_pool_texture,
+		ao_surface_atlas_texture = ao_map -> surface_atlas_texture,
+		ao_wall_tile_texture = ao_map -> wall_tile_texture,
 		shadow_depth_layers = shadow_context -> depth_layers,
 		shadow_depth_sampler = shadow_context -> plain_depth_sampler,
 		shadow_depth_comparison_sampler = shadow_context -> depth_comparison_sampler;
@@ -180,7 +183,13 @@ void init_shared_textures_for_world_shaded_objects(
 		use_texture_in_shader(materials_texture, shader, "materials_sampler", TexBuffer, TU_Materials);
 		use_texture_in_shader(wso.drawable -> albedo_texture, shader, "albedo_sampler", TexSet, wso.texture_units.albedo);
 		use_texture_in_shader(wso.drawable -> normal_map, shader, "normal_sampler", TexSet, wso.texture_units.normal_map);
-		use_texture_in_shader(ao_map_texture, shader, "ambient_occlusion_sampler", TexVolumetric, TU_AmbientOcclusionMap);
+		use_texture_in_shader(ao_indirection_texture, shader, "ambient_occlusion_indirection_sampler", TexVolumetric, TU_AmbientOcclusionMap);
+		use_texture_in_shader(ao_brick_pool_texture, shader, "ambient_occlusion_brick_pool_sampler", TexVolumetric, TU_AmbientOcclusionBrickPool);
+
+		// The atlas's samplers are set even when it's not sampled, so that no two sampler types share a texture unit
+		use_texture_in_shader(ao_surface_atlas_texture, shader, "ambient_occlusion_surface_atlas_sampler", TexPlain, TU_AmbientOcclusionSurfaceAtlas);
+		use_texture_in_shader(ao_wall_tile_texture, shader, "ambient_occlusion_wall_tile_sampler", TexSet, TU_AmbientOcclusionWallTiles);
+		INIT_UNIFORM_VALUE(samples_ao_surface_atlas, shader, 1i, wso.can_sample_ao_surface_atlas && ao_surface_atlas_texture != 0);
 
 		use_texture_in_shader(shadow_depth_layers, shader, "shadow_cascade_sampler", shadow_map_texture_type, TU_CascadedShadowMapPlain);
 		glBindSampler(TU_CascadedShadowMapPlain, shadow_depth_sampler);
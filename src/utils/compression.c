@@ -0,0 +1,402 @@
+#include "utils/compression.h"
+#include "utils/worker_pool.h" // For `run_jobs_on_worker_pool`
+#include "utils/alloc.h" // For `alloc`, and `dealloc`
+#include <string.h> // For `memcpy`, and `memset`
+
+enum {
+	min_rle_run_length = 3, max_rle_run_length = 127 + min_rle_run_length, max_rle_literal_run_length = 128,
+
+	min_lz_match_length = 4, max_lz_offset = 65535, lz_length_nibble_limit = 15,
+	log2_num_lz_hash_entries = 14, // The hash table has an entry for each 4-byte sequence hash
+
+	// This is more than either codec can take up for a block, since each one adds at most a byte per 128 bytes
+	max_compressed_block_size = compression_block_size + compression_block_size / 64 + 64
+};
+
+typedef uint32_t compressed_block_size_t;
+
+typedef struct {
+	const CompressionCodec codec;
+	const byte* const src;
+	const size_t num_bytes;
+	byte* const compressed_blocks; // Each block is compressed into its own slot of `max_compressed_block_size` bytes
+	compressed_block_size_t* const compressed_block_sizes;
+} CompressionJobData;
+
+typedef struct {
+	const CompressionCodec codec;
+	const byte* const src;
+	byte* const dst;
+	const size_t num_bytes;
+	const size_t* const compressed_block_offsets; // This has an extra offset at the end, for the end of the last block
+	bool* const block_succeeded;
+} DecompressionJobData;
+
+////////// Some general utils
+
+static buffer_size_t get_num_compression_blocks(const size_t num_bytes) {
+	return (buffer_size_t) ((num_bytes + compression_block_size - 1u) / compression_block_size);
+}
+
+static size_t get_compression_block_size(const size_t num_bytes, const buffer_size_t block_index) {
+	const size_t num_bytes_left = num_bytes - (size_t) block_index * compression_block_size;
+	return (num_bytes_left < compression_block_size) ? num_bytes_left : compression_block_size;
+}
+
+static uint32_t read_u32(const byte* const data) {
+	uint32_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+// If the length was at the nibble limit, this adds on the extra length bytes that follow
+static bool read_lz_length(const byte** const in, const byte* const in_end, size_t* const length) {
+	if (*length != lz_length_nibble_limit) return true;
+
+	byte extra_length;
+	do {
+		if (*in == in_end) return false;
+		extra_length = *((*in)++);
+		*length += extra_length;
+	} while (extra_length == 255u);
+
+	return true;
+}
+
+static byte* write_lz_length(byte* out, size_t length) {
+	for (; length >= 255u; length -= 255u) *(out++) = 255u;
+	*(out++) = (byte) length;
+	return out;
+}
+
+////////// Compression
+
+static byte* write_rle_literals(byte* out, const byte* literals, size_t num_literals) {
+	while (num_literals != 0) {
+		const size_t num_in_chunk = (num_literals < max_rle_literal_run_length) ? num_literals : max_rle_literal_run_length;
+
+		*(out++) = (byte) (num_in_chunk - 1u);
+		memcpy(out, literals, num_in_chunk);
+
+		out += num_in_chunk;
+		literals += num_in_chunk;
+		num_literals -= num_in_chunk;
+	}
+
+	return out;
+}
+
+// A match length of 0 means that this is the last sequence, which only has literals
+static byte* write_lz_sequence(byte* out, const byte* const literals, const size_t num_literals,
+	const size_t match_offset, const size_t match_length) {
+
+	const size_t extra_match_length = (match_length == 0) ? 0 : match_length - min_lz_match_length;
+
+	const byte
+		literal_nibble = (byte) ((num_literals < lz_length_nibble_limit) ? num_literals : lz_length_nibble_limit),
+		match_nibble = (byte) ((extra_match_length < lz_length_nibble_limit) ? extra_match_length : lz_length_nibble_limit);
+
+	*(out++) = (byte) (literal_nibble << 4u | match_nibble);
+	if (literal_nibble == lz_length_nibble_limit) out = write_lz_length(out, num_literals - lz_length_nibble_limit);
+
+	memcpy(out, literals, num_literals);
+	out += num_literals;
+
+	if (match_length != 0) {
+		*(out++) = (byte) match_offset;
+		*(out++) = (byte) (match_offset >> 8u);
+		if (match_nibble == lz_length_nibble_limit) out = write_lz_length(out, extra_match_length - lz_length_nibble_limit);
+	}
+
+	return out;
+}
+
+static uint32_t get_lz_hash_index(const uint32_t sequence) {
+	return (sequence * 2654435761u) >> (32u - log2_num_lz_hash_entries); // Knuth's multiplicative hash
+}
+
+static size_t compress_block_with_rle(const byte* const src, const size_t num_bytes, byte* const dst) {
+	byte* out = dst;
+	size_t literal_start = 0, i = 0;
+
+	while (i < num_bytes) {
+		const byte value = src[i];
+		size_t run_length = 1;
+
+		while (i + run_length < num_bytes && run_length < max_rle_run_length && src[i + run_length] == value)
+			run_length++;
+
+		if (run_length >= min_rle_run_length) {
+			out = write_rle_literals(out, src + literal_start, i - literal_start);
+			*(out++) = (byte) (128u + run_length - min_rle_run_length);
+			*(out++) = value;
+			literal_start = i + run_length;
+		}
+
+		i += run_length;
+	}
+
+	out = write_rle_literals(out, src + literal_start, num_bytes - literal_start);
+	return (size_t) (out - dst);
+}
+
+/* This greedily takes the first match that it finds for each 4-byte sequence, through a hash table
+of the last position of each sequence hash. That's fast, and it finds the long runs that matter most.
+The hash table is 64 KB on the stack, and not on the heap, since this runs on the worker pool's threads,
+and `TRACK_MEMORY` isn't thread-safe. */
+static size_t compress_block_with_lz(const byte* const src, const size_t num_bytes, byte* const dst) {
+	// Each entry is a position plus 1, so that 0 means that there's no position for that hash yet
+	uint32_t hash_table[1u << log2_num_lz_hash_entries];
+	memset(hash_table, 0, sizeof(hash_table));
+
+	byte* out = dst;
+	size_t literal_start = 0, i = 0;
+
+	while (i + min_lz_match_length <= num_bytes) {
+		const uint32_t sequence = read_u32(src + i), hash_index = get_lz_hash_index(sequence);
+		const size_t candidate_plus_one = hash_table[hash_index];
+		hash_table[hash_index] = (uint32_t) i + 1u;
+
+		if (candidate_plus_one != 0) {
+			const size_t candidate = candidate_plus_one - 1u;
+
+			if (i - candidate <= max_lz_offset && read_u32(src + candidate) == sequence) {
+				size_t match_length = min_lz_match_length;
+				while (i + match_length < num_bytes && src[candidate + match_length] == src[i + match_length]) match_length++;
+
+				out = write_lz_sequence(out, src + literal_start, i - literal_start, i - candidate, match_length);
+				i += match_length;
+				literal_start = i;
+				continue;
+			}
+		}
+
+		i++;
+	}
+
+	out = write_lz_sequence(out, src + literal_start, num_bytes - literal_start, 0, 0);
+	return (size_t) (out - dst);
+}
+
+static size_t compress_block(const CompressionCodec codec, const byte* const src, const size_t num_bytes, byte* const dst) {
+	switch (codec) {
+		case CompressionRLE: return compress_block_with_rle(src, num_bytes, dst);
+		case CompressionLZ: return compress_block_with_lz(src, num_bytes, dst);
+		default: memcpy(dst, src, num_bytes); return num_bytes;
+	}
+}
+
+static void compression_job(void* const job_data, const buffer_size_t block_index) {
+	const CompressionJobData* const data = job_data;
+
+	const size_t num_bytes_in_block = get_compression_block_size(data -> num_bytes, block_index);
+	const byte* const block = data -> src + (size_t) block_index * compression_block_size;
+
+	const size_t num_compressed_bytes = compress_block(data -> codec, block, num_bytes_in_block,
+		data -> compressed_blocks + (size_t) block_index * max_compressed_block_size);
+
+	// If compressing the block didn't make it smaller, it's stored as is
+	data -> compressed_block_sizes[block_index] = (compressed_block_size_t)
+		((num_compressed_bytes < num_bytes_in_block) ? num_compressed_bytes : num_bytes_in_block);
+}
+
+size_t get_max_num_compressed_bytes(const size_t num_bytes) {
+	return get_num_compression_blocks(num_bytes) * sizeof(compressed_block_size_t) + num_bytes;
+}
+
+size_t compress_in_blocks(const CompressionCodec codec, const byte* const src, const size_t num_bytes, byte* const dst) {
+	if (codec == CompressionNone) {
+		memcpy(dst, src, num_bytes);
+		return num_bytes;
+	}
+
+	const buffer_size_t num_blocks = get_num_compression_blocks(num_bytes);
+
+	CompressionJobData job_data = {
+		codec, src, num_bytes,
+		alloc((size_t) num_blocks, max_compressed_block_size),
+		alloc((size_t) num_blocks, sizeof(compressed_block_size_t))
+	};
+
+	if (num_blocks > 1) run_jobs_on_worker_pool(compression_job, &job_data, num_blocks);
+	else if (num_blocks == 1) compression_job(&job_data, 0);
+
+	////////// Writing the block sizes, and then the blocks
+
+	const size_t num_block_size_bytes = num_blocks * sizeof(compressed_block_size_t);
+	memcpy(dst, job_data.compressed_block_sizes, num_block_size_bytes);
+	byte* out = dst + num_block_size_bytes;
+
+	for (buffer_size_t i = 0; i < num_blocks; i++) {
+		const size_t num_compressed_bytes = job_data.compressed_block_sizes[i];
+
+		const byte* const compressed_block = (num_compressed_bytes == get_compression_block_size(num_bytes, i))
+			? src + (size_t) i * compression_block_size
+			: job_data.compressed_blocks + (size_t) i * max_compressed_block_size;
+
+		memcpy(out, compressed_block, num_compressed_bytes);
+		out += num_compressed_bytes;
+	}
+
+	dealloc(job_data.compressed_blocks);
+	dealloc(job_data.compressed_block_sizes);
+
+	return (size_t) (out - dst);
+}
+
+////////// Decompression
+
+static bool decompress_block_with_rle(const byte* in, const byte* const in_end, byte* out, byte* const out_end) {
+	while (in < in_end) {
+		const byte control = *(in++);
+
+		if (control < 128u) {
+			const size_t num_literals = control + 1u;
+			if (num_literals > (size_t) (in_end - in) || num_literals > (size_t) (out_end - out)) return false;
+
+			memcpy(out, in, num_literals);
+			in += num_literals;
+			out += num_literals;
+		}
+		else {
+			const size_t run_length = control - 128u + min_rle_run_length;
+			if (in == in_end || run_length > (size_t) (out_end - out)) return false;
+
+			memset(out, *(in++), run_length);
+			out += run_length;
+		}
+	}
+
+	return out == out_end;
+}
+
+/* A match may overlap with the bytes that it writes, when its offset is less than its length; and then, it repeats
+the last `offset` bytes. This copies the match in chunks that never overlap with what they read, where each chunk
+is twice as big as the last one, since the repeated part before the output doubles in size each time. */
+static void copy_lz_match(byte* const out, const size_t offset, const size_t match_length) {
+	const byte* const match = out - offset;
+
+	for (size_t num_copied = 0; num_copied < match_length;) {
+		const size_t distance = offset + num_copied, num_left = match_length - num_copied;
+		const size_t num_in_chunk = (distance < num_left) ? distance : num_left;
+
+		memcpy(out + num_copied, match, num_in_chunk);
+		num_copied += num_in_chunk;
+	}
+}
+
+static bool decompress_block_with_lz(const byte* in, const byte* const in_end, byte* out, byte* const out_end) {
+	const byte* const out_start = out;
+
+	while (in < in_end) {
+		const byte token = *(in++);
+
+		size_t num_literals = token >> 4u;
+		if (!read_lz_length(&in, in_end, &num_literals)
+			|| num_literals > (size_t) (in_end - in)
+			|| num_literals > (size_t) (out_end - out)) return false;
+
+		memcpy(out, in, num_literals);
+		in += num_literals;
+		out += num_literals;
+
+		if (in == in_end) break; // The last sequence only has literals
+		if (in_end - in < 2) return false;
+
+		const size_t match_offset = (size_t) in[0] | (size_t) in[1] << 8u;
+		in += 2;
+
+		size_t match_length = token & 15u;
+		if (!read_lz_length(&in, in_end, &match_length)) return false;
+		match_length += min_lz_match_length;
+
+		if (match_offset == 0
+			|| match_offset > (size_t) (out - out_start)
+			|| match_length > (size_t) (out_end - out)) return false;
+
+		copy_lz_match(out, match_offset, match_length);
+		out += match_length;
+	}
+
+	return out == out_end;
+}
+
+static bool decompress_block(const CompressionCodec codec, const byte* const in,
+	const size_t num_compressed_bytes, byte* const out, const size_t num_bytes) {
+
+	// Blocks that didn't get any smaller when compressed are stored as is
+	if (num_compressed_bytes == num_bytes) {
+		memcpy(out, in, num_bytes);
+		return true;
+	}
+
+	const byte* const in_end = in + num_compressed_bytes;
+	byte* const out_end = out + num_bytes;
+
+	switch (codec) {
+		case CompressionRLE: return decompress_block_with_rle(in, in_end, out, out_end);
+		case CompressionLZ: return decompress_block_with_lz(in, in_end, out, out_end);
+		default: return false;
+	}
+}
+
+static void decompression_job(void* const job_data, const buffer_size_t block_index) {
+	const DecompressionJobData* const data = job_data;
+	const size_t compressed_block_offset = data -> compressed_block_offsets[block_index];
+
+	data -> block_succeeded[block_index] = decompress_block(data -> codec,
+		data -> src + compressed_block_offset,
+		data -> compressed_block_offsets[block_index + 1u] - compressed_block_offset,
+		data -> dst + (size_t) block_index * compression_block_size,
+		get_compression_block_size(data -> num_bytes, block_index));
+}
+
+bool decompress_in_blocks(const CompressionCodec codec, const byte* const src,
+	const size_t num_compressed_bytes, byte* const dst, const size_t num_decompressed_bytes) {
+
+	if (codec == CompressionNone) {
+		if (num_compressed_bytes != num_decompressed_bytes) return false;
+		memcpy(dst, src, num_decompressed_bytes);
+		return true;
+	}
+
+	const buffer_size_t num_blocks = get_num_compression_blocks(num_decompressed_bytes);
+	const size_t num_block_size_bytes = num_blocks * sizeof(compressed_block_size_t);
+	if (num_compressed_bytes < num_block_size_bytes) return false;
+
+	////////// Finding where each block starts, and checking that the blocks fill up the compressed data exactly
+
+	size_t* const compressed_block_offsets = alloc((size_t) num_blocks + 1u, sizeof(size_t));
+	size_t compressed_block_offset = num_block_size_bytes;
+	bool succeeded = true;
+
+	for (buffer_size_t i = 0; i < num_blocks; i++) {
+		const size_t num_compressed_bytes_in_block = read_u32(src + i * sizeof(compressed_block_size_t));
+		if (num_compressed_bytes_in_block > get_compression_block_size(num_decompressed_bytes, i)) succeeded = false;
+
+		compressed_block_offsets[i] = compressed_block_offset;
+		compressed_block_offset += num_compressed_bytes_in_block;
+	}
+
+	compressed_block_offsets[num_blocks] = compressed_block_offset;
+	if (compressed_block_offset != num_compressed_bytes) succeeded = false;
+
+	////////// Decompressing the blocks
+
+	if (succeeded) {
+		bool* const block_succeeded = alloc((size_t) num_blocks, sizeof(bool));
+
+		DecompressionJobData job_data = {
+			codec, src, dst, num_decompressed_bytes, compressed_block_offsets, block_succeeded
+		};
+
+		if (num_blocks > 1) run_jobs_on_worker_pool(decompression_job, &job_data, num_blocks);
+		else if (num_blocks == 1) decompression_job(&job_data, 0);
+
+		for (buffer_size_t i = 0; i < num_blocks; i++) succeeded &= block_succeeded[i];
+		dealloc(block_succeeded);
+	}
+
+	dealloc(compressed_block_offsets);
+	return succeeded;
+}
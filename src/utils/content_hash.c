@@ -0,0 +1,95 @@
+#include "utils/content_hash.h"
+#include <string.h> // For `memcpy`
+
+static const content_hash_t
+	prime_1 = 11400714785074694791u, prime_2 = 14029467366897019727u,
+	prime_3 = 1609587929392839161u, prime_4 = 9650029242287828579u,
+	prime_5 = 2870177450012600261u;
+
+enum {content_hash_stripe_size = 32};
+
+////////// Some general utils
+
+static content_hash_t rotate_left(const content_hash_t x, const byte amount) {
+	return (x << amount) | (x >> (64u - amount));
+}
+
+// These use `memcpy`, since the data isn't necessarily aligned
+static uint64_t read_u64(const byte* const data) {
+	uint64_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static uint32_t read_u32(const byte* const data) {
+	uint32_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static content_hash_t mix_content_hash_lane(content_hash_t lane, const uint64_t input) {
+	lane += input * prime_2;
+	lane = rotate_left(lane, 31u);
+	return lane * prime_1;
+}
+
+static content_hash_t merge_content_hash_lane(content_hash_t hash, const content_hash_t lane) {
+	hash ^= mix_content_hash_lane(0u, lane);
+	return hash * prime_1 + prime_4;
+}
+
+//////////
+
+content_hash_t get_content_hash(const void* const data, const size_t num_bytes, const content_hash_t seed) {
+	const byte* input = data;
+	const byte* const input_end = input + num_bytes;
+	content_hash_t hash;
+
+	////////// Mixing 32-byte stripes into 4 lanes, and then merging the lanes
+
+	if (num_bytes >= content_hash_stripe_size) {
+		content_hash_t lanes[4] = {seed + prime_1 + prime_2, seed + prime_2, seed, seed - prime_1};
+		const byte* const last_stripe = input_end - content_hash_stripe_size;
+
+		do {
+			for (byte i = 0; i < 4; i++, input += sizeof(uint64_t))
+				lanes[i] = mix_content_hash_lane(lanes[i], read_u64(input));
+		} while (input <= last_stripe);
+
+		hash = rotate_left(lanes[0], 1u) + rotate_left(lanes[1], 7u)
+			+ rotate_left(lanes[2], 12u) + rotate_left(lanes[3], 18u);
+
+		for (byte i = 0; i < 4; i++) hash = merge_content_hash_lane(hash, lanes[i]);
+	}
+	else hash = seed + prime_5;
+
+	hash += num_bytes;
+
+	////////// Mixing in the remaining bytes
+
+	for (; input + sizeof(uint64_t) <= input_end; input += sizeof(uint64_t)) {
+		hash ^= mix_content_hash_lane(0u, read_u64(input));
+		hash = rotate_left(hash, 27u) * prime_1 + prime_4;
+	}
+
+	if (input + sizeof(uint32_t) <= input_end) {
+		hash ^= read_u32(input) * prime_1;
+		hash = rotate_left(hash, 23u) * prime_2 + prime_3;
+		input += sizeof(uint32_t);
+	}
+
+	for (; input < input_end; input++) {
+		hash ^= *input * prime_5;
+		hash = rotate_left(hash, 11u) * prime_1;
+	}
+
+	////////// The final avalanche, so that every input bit affects every output bit
+
+	hash ^= hash >> 33u;
+	hash *= prime_2;
+	hash ^= hash >> 29u;
+	hash *= prime_3;
+	hash ^= hash >> 32u;
+
+	return hash;
+}
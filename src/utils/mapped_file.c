@@ -0,0 +1,38 @@
+#define _POSIX_C_SOURCE 200112L // For `mmap`, `posix_madvise`, `fstat`, `open`, and `close`
+
+#include "utils/mapped_file.h"
+#include "utils/failure.h" // For `FAIL`
+#include <sys/mman.h> // For `mmap`, `munmap`, and `posix_madvise`
+#include <sys/stat.h> // For `fstat`
+#include <fcntl.h> // For `open`
+#include <unistd.h> // For `close`
+
+MappedFile init_mapped_file(const char* const path) {
+	const MappedFile no_file = {NULL, 0};
+
+	const int file_descriptor = open(path, O_RDONLY);
+	if (file_descriptor == -1) return no_file;
+
+	struct stat file_attributes;
+	if (fstat(file_descriptor, &file_attributes) == -1 || file_attributes.st_size <= 0) {
+		close(file_descriptor);
+		return no_file;
+	}
+
+	const size_t num_bytes = (size_t) file_attributes.st_size;
+	void* const data = mmap(NULL, num_bytes, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+
+	// The mapping keeps its own reference to the file, so the descriptor isn't needed after this
+	close(file_descriptor);
+
+	if (data == MAP_FAILED) FAIL(OpenFile, "Could not map the file '%s' into memory", path);
+
+	// The data is mostly read from front to back, so this lets the OS read ahead further on page faults
+	posix_madvise(data, num_bytes, POSIX_MADV_SEQUENTIAL);
+
+	return (MappedFile) {data, num_bytes};
+}
+
+void deinit_mapped_file(const MappedFile* const mapped_file) {
+	if (mapped_file -> data != NULL) munmap((void*) mapped_file -> data, mapped_file -> num_bytes);
+}
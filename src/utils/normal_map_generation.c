@@ -1,49 +1,155 @@
 #include "utils/normal_map_generation.h"
 #include "cglm/cglm.h" // For various cglm defs
-#include "data/constants.h" // For `one_over_max_byte_value`, and `max_byte_value`
+#include "data/constants.h" // For `one_over_max_byte_value`, `max_byte_value`, `corners_per_quad`, `DEBUG_NORMAL_MAP_GENERATION`, and `BENCHMARK_NORMAL_MAP_GENERATION`
 #include "utils/alloc.h" // For `alloc`, and `dealloc`
 #include "utils/failure.h" // For `FAIL`
 #include "utils/opengl_wrappers.h" // For various OpenGL wrappers
+#include "utils/shader.h" // For `init_shader`
+#include "utils/macro_utils.h" // For `ARRAY_LENGTH`
+#include "utils/worker_pool.h" // For `start_worker_pool`, `run_worker_pool_job`, `finish_worker_pool`, and `run_jobs_on_worker_pool`
+#include <string.h> // For `memcpy`, `memset`, and `strstr`
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define HAS_SIMD_ROW_KERNELS
+#define AVX2_ROW_KERNEL __attribute__((target("avx2")))
+#include <immintrin.h> // For SSE2 and AVX2 intrinsics
+#endif
+
+////////// This code concerns the row kernels.
+
+/* The heightmap, blur, and Sobel steps each work on one row at a time, over plain 8-bit buffers. Instead of clamping
+each sample, the rows are padded at their ends, and the rows above and below are clamped once per row. Each step has a
+scalar kernel, and an SSE2 and AVX2 one for x86 (where AVX2 is only used if the CPU supports it). The SIMD kernels
+give the same results as the scalar ones, and they use the scalar ones for the last few pixels of a row that don't
+fill up a register. */
+
+typedef struct {
+	const byte red, green, blue, alpha;
+} PixelChannelShifts;
+
+typedef struct {
+	const uint16_t length;
+	const GLfloat* const weights;
+	const uint32_t* const fixed_point_weights; // These are only used by the SIMD kernels
+} BlurKernel;
+
+typedef struct {
+	void (*const generate_heightmap_row)(const sdl_pixel_t* const src, byte* const dest,
+		const GLint w, const PixelChannelShifts shifts, const GLfloat heightmap_scale);
+
+	// `tap_rows` has one row per kernel weight, and each output pixel sums up the weighted pixels at its x
+	void (*const blur_row)(const byte* const* const tap_rows,
+		const BlurKernel* const kernel, byte* const dest, const GLint w);
+
+	// The rows above, at, and below the output row have one pixel of padding on both ends
+	void (*const generate_normal_map_row)(const byte* const top, const byte* const middle, const byte* const bottom,
+		sdl_pixel_t* const dest, const GLint w, const PixelChannelShifts shifts);
+} NormalMapRowKernels;
+
+static PixelChannelShifts get_pixel_channel_shifts(const SDL_PixelFormat* const format) {
+	// This assumes that each channel has 8 bits, which is true for `SDL_PIXEL_FORMAT`
+	return (PixelChannelShifts) {format -> Rshift, format -> Gshift, format -> Bshift, format -> Ashift};
+}
+
+// This makes a copy of a row in `dest`, with `padding` copies of the row's first and last pixels on each side
+static void pad_row(const byte* const src, byte* const dest, const GLint w, const byte padding) {
+	memset(dest, src[0], padding);
+	memcpy(dest + padding, src, (size_t) w);
+	memset(dest + padding + w, src[w - 1], padding);
+}
 
 ////////// This code concerns heightmap creation.
 
-static void generate_heightmap(SDL_Surface* const src, SDL_Surface* const dest, const GLfloat heightmap_scale) {
-	////////// Skipping heightmap generation if the heightmap scale is small enough
+static byte get_heightmap_value(const sdl_pixel_t pixel, const PixelChannelShifts shifts, const GLfloat heightmap_scale) {
+	const sdl_pixel_component_t
+		r = (sdl_pixel_component_t) (pixel >> shifts.red),
+		g = (sdl_pixel_component_t) (pixel >> shifts.green),
+		b = (sdl_pixel_component_t) (pixel >> shifts.blue);
 
-	/* Any heightmap scale smaller than this one will result in any
-	pixel component being multiplied by it turning into zero */
-	const GLfloat smallest_possible_heightmap_scale = constants.one_over_max_byte_value;
+	const sdl_pixel_component_t height = (r + g + b) / 3;
+	return (byte) glm_min(height * heightmap_scale, constants.max_byte_value);
+}
+
+static void generate_heightmap_row_scalar(const sdl_pixel_t* const src, byte* const dest,
+	const GLint w, const PixelChannelShifts shifts, const GLfloat heightmap_scale) {
+
+	for (GLint x = 0; x < w; x++) dest[x] = get_heightmap_value(src[x], shifts, heightmap_scale);
+}
+
+////////// This code concerns Gaussian blur (the normal map input is blurred to cut out high frequencies from the Sobel operator).
+
+enum {
+	fixed_point_blur_weight_bits = 16,
+	max_fixed_point_blur_weight = 2 << fixed_point_blur_weight_bits // The weights can be a tiny bit over 1
+};
 
-	if (heightmap_scale < smallest_possible_heightmap_scale) {
-		// Getting the blank pixel color explicitly, because who knows if a blank pixel doesn't map to 0?
-		const sdl_pixel_t blank_pixel = SDL_MapRGB(dest -> format, 0, 0, 0);
-		SDL_FillRect(dest, NULL, blank_pixel);
-		return;
+static const uint32_t no_fixed_point_blur_weight = UINT32_MAX;
+
+static GLfloat* compute_1D_gaussian_kernel(const byte radius, const GLfloat std_dev) {
+	const uint16_t kernel_length = radius * 2 + 1;
+
+	GLfloat* const kernel = alloc((size_t) kernel_length, sizeof(GLfloat)), sum = 0.0f;
+	const GLfloat one_over_two_times_std_dev_squared = 1.0f / (2.0f * std_dev * std_dev);
+
+	for (uint16_t x = 0; x < kernel_length; x++) {
+		const int16_t dx = (int16_t) (x - radius);
+		const GLfloat weight = expf(-(dx * dx) * one_over_two_times_std_dev_squared);
+		kernel[x] = weight;
+		sum += weight;
 	}
 
-	////////// Generating the heightmap
+	const GLfloat one_over_sum = 1.0f / sum;
+	for (uint16_t i = 0; i < kernel_length; i++) kernel[i] *= one_over_sum;
+
+	return kernel;
+}
 
-	const GLint w = dest -> w, h = dest -> h;
+/* Each weighted pixel is truncated to a byte before being summed up, so a weight that makes even the max byte value
+truncate to zero never adds anything. This gives the radius without those weights at the kernel's ends. */
+static byte get_effective_blur_radius(const GLfloat* const kernel, const byte radius) {
+	byte num_zero_weights = 0;
 
-	WITH_SURFACE_PIXEL_ACCESS(src,
-		WITH_SURFACE_PIXEL_ACCESS(dest,
+	while (num_zero_weights < radius
+		&& (sdl_pixel_component_t) (constants.max_byte_value * kernel[num_zero_weights]) == 0)
+		num_zero_weights++;
 
-			for (GLint y = 0; y < h; y++) {
-				sdl_pixel_component_t* const dest_pixel = read_surface_pixel(dest, 0, y);
+	return radius - num_zero_weights;
+}
 
-				for (GLint x = 0; x < w; x++) {
-					const sdl_pixel_t pixel = *(sdl_pixel_t*) read_surface_pixel(src, x, y);
+/* Since there are only 256 pixel values, a fixed-point weight can give the exact same truncated products as a float
+one. Each pixel value bounds the fixed-point weights that truncate to the same product as the float weight does; so
+this returns the smallest weight within all of those bounds, or `no_fixed_point_blur_weight` if there's none. */
+static uint32_t get_fixed_point_blur_weight(const GLfloat weight) {
+	uint32_t min_weight = 0, max_weight = max_fixed_point_blur_weight; // The max is exclusive
 
-					sdl_pixel_component_t r, g, b;
-					SDL_GetRGB(pixel, src -> format, &r, &g, &b);
+	for (uint32_t pixel = 1; pixel <= constants.max_byte_value; pixel++) {
+		const uint32_t weighted_pixel = (sdl_pixel_component_t) (pixel * weight);
 
-					const sdl_pixel_component_t height = (r + g + b) / 3;
-					const GLfloat upscaled_height = glm_min(height * heightmap_scale, constants.max_byte_value);
-					dest_pixel[x] = (sdl_pixel_component_t) upscaled_height;
-				}
-			}
-		);
-	);
+		const uint32_t // These are rounded up
+			lower_bound = ((weighted_pixel << fixed_point_blur_weight_bits) + pixel - 1) / pixel,
+			upper_bound = (((weighted_pixel + 1) << fixed_point_blur_weight_bits) + pixel - 1) / pixel;
+
+		if (lower_bound > min_weight) min_weight = lower_bound;
+		if (upper_bound < max_weight) max_weight = upper_bound;
+	}
+
+	return (min_weight < max_weight) ? min_weight : no_fixed_point_blur_weight;
+}
+
+static byte get_blurred_pixel(const byte* const* const tap_rows, const BlurKernel* const kernel, const GLint x) {
+	const GLfloat* const weights = kernel -> weights;
+	GLuint blurred_pixel = 0;
+
+	for (uint16_t i = 0; i < kernel -> length; i++)
+		blurred_pixel += (sdl_pixel_component_t) (tap_rows[i][x] * weights[i]);
+
+	return (sdl_pixel_component_t) blurred_pixel;
+}
+
+static void blur_row_scalar(const byte* const* const tap_rows,
+	const BlurKernel* const kernel, byte* const dest, const GLint w) {
+
+	for (GLint x = 0; x < w; x++) dest[x] = get_blurred_pixel(tap_rows, kernel, x);
 }
 
 ////////// This code concerns normal map creation.
@@ -60,132 +166,724 @@ static GLint int_clamp(const GLint val, const GLint lower, const GLint upper) {
 	return int_min(int_max(val, lower), upper);
 }
 
-static sdl_pixel_component_t sobel_sample(const SDL_Surface* const surface, const GLint x, const GLint y) {
-	return *(sdl_pixel_component_t*) read_surface_pixel(surface, x, y);
-}
-
 /* This function is based on these sources:
 - https://en.wikipedia.org/wiki/Sobel_operator
-- https://www.shadertoy.com/view/Xtd3DS
-
-It's assumed that `src` has the same size as `dest`. */
-static void generate_normal_map(SDL_Surface* const src, SDL_Surface* const dest, const GLint subtexture_h) {
-	const GLint w = dest -> w, h = dest -> h;
-	const SDL_PixelFormat* const format = dest -> format;
+- https://www.shadertoy.com/view/Xtd3DS */
+static sdl_pixel_t get_normal_map_pixel(const byte* const top, const byte* const middle,
+	const byte* const bottom, const GLint x, const PixelChannelShifts shifts) {
 
 	const GLfloat half_max_byte_value = 0.5f * constants.max_byte_value;
 
-	WITH_SURFACE_PIXEL_ACCESS(src,
-		WITH_SURFACE_PIXEL_ACCESS(dest,
+	const sdl_pixel_component_t // These samples are in a range from 0 to `constants.max_byte_value`
+		tl = top[x - 1],    tm = top[x],    tr = top[x + 1],
+		ml = middle[x - 1],                 mr = middle[x + 1],
+		bl = bottom[x - 1], bm = bottom[x], br = bottom[x + 1];
+
+	/* The x and y components of this are the result of the Sobel operator.
+	Byte overflow will not happen with the components, since they are promoted to ints. */
+
+	vec3 normal = {
+		(-bl - (ml << 1) - tl) + (tr + (mr << 1) + br),
+		(-tr - (tm << 1) - tl) + (bl + (bm << 1) + br)
+	};
 
-			for (GLint y = 0; y < h; y++) {
-				sdl_pixel_t* const dest_pixel = read_surface_pixel(dest, 0, y);
+	const GLfloat // These are in a range of 0 to 1
+		gx = normal[0] * constants.one_over_max_byte_value,
+		gy = normal[1] * constants.one_over_max_byte_value;
 
-				const GLint subtexture_top = (y / subtexture_h) * subtexture_h;
-				const GLint subtexture_bottom = subtexture_top + subtexture_h - 1;
+	normal[2] = sqrtf(fabsf(1.0f - (gx * gx + gy * gy))) * constants.max_byte_value;
 
-				for (GLint x = 0; x < w; x++) {
-					const GLint
-						left_x = int_max(x - 1, 0),             right_x = int_min(x + 1, w - 1),
-						top_y = int_max(y - 1, subtexture_top), bottom_y = int_min(y + 1, subtexture_bottom);
+	glm_vec3_normalize(normal);
+	glm_vec3_scale(normal, half_max_byte_value, normal);
+	glm_vec3_adds(normal, half_max_byte_value, normal);
 
-					const sdl_pixel_component_t // These samples are in a range from 0 to `constants.max_byte_value`
-						tl = sobel_sample(src, left_x, top_y),  tm = sobel_sample(src, x, top_y),
-						tr = sobel_sample(src, right_x, top_y), ml = sobel_sample(src, left_x, y),
-						mr = sobel_sample(src, right_x, y),     bl = sobel_sample(src, left_x, bottom_y),
-						bm = sobel_sample(src, x, bottom_y),    br = sobel_sample(src, right_x, bottom_y);
+	// The inverse height value goes in the alpha channel, for parallax mapping
+	return ((sdl_pixel_t) (sdl_pixel_component_t) normal[0] << shifts.red)
+		| ((sdl_pixel_t) (sdl_pixel_component_t) normal[1] << shifts.green)
+		| ((sdl_pixel_t) (sdl_pixel_component_t) normal[2] << shifts.blue)
+		| ((sdl_pixel_t) (constants.max_byte_value - middle[x]) << shifts.alpha);
+}
 
-					/* The x and y components of this are the result of the Sobel operator.
-					Byte overflow will not happen with the components, since they are promoted to ints. */
+static void generate_normal_map_row_scalar(const byte* const top, const byte* const middle, const byte* const bottom,
+	sdl_pixel_t* const dest, const GLint w, const PixelChannelShifts shifts) {
 
-					vec3 normal = {
-						(-bl - (ml << 1) - tl) + (tr + (mr << 1) + br),
-						(-tr - (tm << 1) - tl) + (bl + (bm << 1) + br)
-					};
+	for (GLint x = 0; x < w; x++) dest[x] = get_normal_map_pixel(top, middle, bottom, x, shifts);
+}
 
-					const GLfloat // These are in a range of 0 to 1
-						gx = normal[0] * constants.one_over_max_byte_value,
-						gy = normal[1] * constants.one_over_max_byte_value;
+////////// These are the SSE2 and AVX2 row kernels
 
-					normal[2] = sqrtf(fabsf(1.0f - (gx * gx + gy * gy))) * constants.max_byte_value;
+#ifdef HAS_SIMD_ROW_KERNELS
 
-					glm_vec3_normalize(normal);
-					glm_vec3_scale(normal, half_max_byte_value, normal);
-					glm_vec3_adds(normal, half_max_byte_value, normal);
+/* Multiplying a sum of 3 bytes by this, and then shifting it right by 17, is the same as dividing it by 3.
+The sums fit in the low 16 bits of each lane, so this can be done with an unsigned 16-bit `mulhi`. */
+enum {one_third_for_byte_sums = 43691};
 
-					dest_pixel[x] = SDL_MapRGBA(format,
-						(sdl_pixel_component_t) normal[0],
-						(sdl_pixel_component_t) normal[1],
-						(sdl_pixel_component_t) normal[2],
+static __m128i get_heightmap_values_sse2(const sdl_pixel_t* const src,
+	const PixelChannelShifts shifts, const GLfloat heightmap_scale) {
 
-						// Inverse height value for parallax mapping
-						constants.max_byte_value - sobel_sample(src, x, y)
-					);
-				}
+	const __m128i pixels = _mm_loadu_si128((const __m128i*) src), byte_mask = _mm_set1_epi32(constants.max_byte_value);
+
+	const __m128i height_sum = _mm_add_epi32(_mm_add_epi32(
+		_mm_and_si128(_mm_srl_epi32(pixels, _mm_cvtsi32_si128(shifts.red)), byte_mask),
+		_mm_and_si128(_mm_srl_epi32(pixels, _mm_cvtsi32_si128(shifts.green)), byte_mask)),
+		_mm_and_si128(_mm_srl_epi32(pixels, _mm_cvtsi32_si128(shifts.blue)), byte_mask));
+
+	const __m128i height = _mm_srli_epi32(_mm_mulhi_epu16(height_sum, _mm_set1_epi32(one_third_for_byte_sums)), 1);
+
+	// `_mm_min_ps` picks its first operand if it's smaller, and its second one otherwise, like `glm_min`
+	return _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(_mm_cvtepi32_ps(height),
+		_mm_set1_ps(heightmap_scale)), _mm_set1_ps(constants.max_byte_value)));
+}
+
+static void generate_heightmap_row_sse2(const sdl_pixel_t* const src, byte* const dest,
+	const GLint w, const PixelChannelShifts shifts, const GLfloat heightmap_scale) {
+
+	GLint x = 0;
+
+	for (; x <= w - 16; x += 16) {
+		const __m128i
+			first_heights = _mm_packs_epi32(
+				get_heightmap_values_sse2(src + x, shifts, heightmap_scale),
+				get_heightmap_values_sse2(src + x + 4, shifts, heightmap_scale)),
+
+			second_heights = _mm_packs_epi32(
+				get_heightmap_values_sse2(src + x + 8, shifts, heightmap_scale),
+				get_heightmap_values_sse2(src + x + 12, shifts, heightmap_scale));
+
+		_mm_storeu_si128((__m128i*) (dest + x), _mm_packus_epi16(first_heights, second_heights));
+	}
+
+	generate_heightmap_row_scalar(src + x, dest + x, w - x, shifts, heightmap_scale);
+}
+
+//////////
+
+/* The blur kernels multiply each 16-bit pixel by the low 16 bits of its fixed-point weight with `mulhi`, and add the
+pixel itself if the weight is 1 or more. The sums never go over a byte by more than rounding error, so they're masked
+to a byte before packing them, which truncates them like the scalar kernel does. */
+
+static void blur_row_sse2(const byte* const* const tap_rows,
+	const BlurKernel* const kernel, byte* const dest, const GLint w) {
+
+	const uint32_t* const fixed_point_weights = kernel -> fixed_point_weights;
+	const __m128i zero = _mm_setzero_si128(), byte_mask = _mm_set1_epi16(constants.max_byte_value);
+
+	GLint x = 0;
+
+	for (; x <= w - 16; x += 16) {
+		__m128i low_sums = zero, high_sums = zero;
+
+		for (uint16_t i = 0; i < kernel -> length; i++) {
+			const __m128i
+				pixels = _mm_loadu_si128((const __m128i*) (tap_rows[i] + x)),
+				low_pixels = _mm_unpacklo_epi8(pixels, zero), high_pixels = _mm_unpackhi_epi8(pixels, zero);
+
+			const uint32_t fixed_point_weight = fixed_point_weights[i];
+			const __m128i weight_fraction = _mm_set1_epi16((int16_t) (uint16_t) fixed_point_weight);
+
+			low_sums = _mm_add_epi16(low_sums, _mm_mulhi_epu16(low_pixels, weight_fraction));
+			high_sums = _mm_add_epi16(high_sums, _mm_mulhi_epu16(high_pixels, weight_fraction));
+
+			if (fixed_point_weight >> fixed_point_blur_weight_bits) {
+				low_sums = _mm_add_epi16(low_sums, low_pixels);
+				high_sums = _mm_add_epi16(high_sums, high_pixels);
 			}
-		);
+		}
+
+		_mm_storeu_si128((__m128i*) (dest + x), _mm_packus_epi16(
+			_mm_and_si128(low_sums, byte_mask), _mm_and_si128(high_sums, byte_mask)));
+	}
+
+	for (; x < w; x++) dest[x] = get_blurred_pixel(tap_rows, kernel, x);
+}
+
+AVX2_ROW_KERNEL static void blur_row_avx2(const byte* const* const tap_rows,
+	const BlurKernel* const kernel, byte* const dest, const GLint w) {
+
+	const uint32_t* const fixed_point_weights = kernel -> fixed_point_weights;
+	const __m256i byte_mask = _mm256_set1_epi16(constants.max_byte_value);
+
+	GLint x = 0;
+
+	for (; x <= w - 16; x += 16) {
+		__m256i sums = _mm256_setzero_si256();
+
+		for (uint16_t i = 0; i < kernel -> length; i++) {
+			const __m256i pixels = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (tap_rows[i] + x)));
+			const uint32_t fixed_point_weight = fixed_point_weights[i];
+
+			sums = _mm256_add_epi16(sums, _mm256_mulhi_epu16(pixels,
+				_mm256_set1_epi16((int16_t) (uint16_t) fixed_point_weight)));
+
+			if (fixed_point_weight >> fixed_point_blur_weight_bits) sums = _mm256_add_epi16(sums, pixels);
+		}
+
+		sums = _mm256_and_si256(sums, byte_mask);
+
+		_mm_storeu_si128((__m128i*) (dest + x), _mm_packus_epi16(
+			_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1)));
+	}
+
+	for (; x < w; x++) dest[x] = get_blurred_pixel(tap_rows, kernel, x);
+}
+
+//////////
+
+/* These follow the same float steps as `get_normal_map_pixel`, in the same order (and `_mm_sqrt_ps` and `_mm_div_ps`
+are exact, like `sqrtf` and `/` are). They take the Sobel x and y sums, and the heights at the output pixels. */
+
+static __m128i get_normal_map_pixels_sse2(const __m128i sobel_x, const __m128i sobel_y,
+	const __m128i heights, const PixelChannelShifts shifts) {
+
+	const __m128
+		one = _mm_set1_ps(1.0f), max_byte_value = _mm_set1_ps(constants.max_byte_value),
+		half_max_byte_value = _mm_set1_ps(0.5f * constants.max_byte_value),
+		one_over_max_byte_value = _mm_set1_ps(constants.one_over_max_byte_value),
+		non_sign_bits = _mm_castsi128_ps(_mm_set1_epi32(INT32_MAX));
+
+	__m128 normal_x = _mm_cvtepi32_ps(sobel_x), normal_y = _mm_cvtepi32_ps(sobel_y);
+
+	const __m128
+		gx = _mm_mul_ps(normal_x, one_over_max_byte_value),
+		gy = _mm_mul_ps(normal_y, one_over_max_byte_value);
+
+	__m128 normal_z = _mm_mul_ps(_mm_sqrt_ps(_mm_and_ps(_mm_sub_ps(one,
+		_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gy, gy))), non_sign_bits)), max_byte_value);
+
+	const __m128 one_over_length = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+		_mm_mul_ps(normal_x, normal_x), _mm_mul_ps(normal_y, normal_y)), _mm_mul_ps(normal_z, normal_z))));
+
+	normal_x = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(normal_x, one_over_length), half_max_byte_value), half_max_byte_value);
+	normal_y = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(normal_y, one_over_length), half_max_byte_value), half_max_byte_value);
+	normal_z = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(normal_z, one_over_length), half_max_byte_value), half_max_byte_value);
+
+	return _mm_or_si128(
+		_mm_or_si128(
+			_mm_sll_epi32(_mm_cvttps_epi32(normal_x), _mm_cvtsi32_si128(shifts.red)),
+			_mm_sll_epi32(_mm_cvttps_epi32(normal_y), _mm_cvtsi32_si128(shifts.green))
+		),
+		_mm_or_si128(
+			_mm_sll_epi32(_mm_cvttps_epi32(normal_z), _mm_cvtsi32_si128(shifts.blue)),
+			_mm_sll_epi32(_mm_sub_epi32(_mm_set1_epi32(constants.max_byte_value), heights), _mm_cvtsi32_si128(shifts.alpha))
+		)
 	);
 }
 
-////////// This code concerns Gaussian blur (the normal map input is blurred to cut out high frequencies from the Sobel operator).
+AVX2_ROW_KERNEL static __m256i get_normal_map_pixels_avx2(const __m256i sobel_x, const __m256i sobel_y,
+	const __m256i heights, const PixelChannelShifts shifts) {
 
-static GLfloat* compute_1D_gaussian_kernel(const byte radius, const GLfloat std_dev) {
+	const __m256
+		one = _mm256_set1_ps(1.0f), max_byte_value = _mm256_set1_ps(constants.max_byte_value),
+		half_max_byte_value = _mm256_set1_ps(0.5f * constants.max_byte_value),
+		one_over_max_byte_value = _mm256_set1_ps(constants.one_over_max_byte_value),
+		non_sign_bits = _mm256_castsi256_ps(_mm256_set1_epi32(INT32_MAX));
+
+	__m256 normal_x = _mm256_cvtepi32_ps(sobel_x), normal_y = _mm256_cvtepi32_ps(sobel_y);
+
+	const __m256
+		gx = _mm256_mul_ps(normal_x, one_over_max_byte_value),
+		gy = _mm256_mul_ps(normal_y, one_over_max_byte_value);
+
+	__m256 normal_z = _mm256_mul_ps(_mm256_sqrt_ps(_mm256_and_ps(_mm256_sub_ps(one,
+		_mm256_add_ps(_mm256_mul_ps(gx, gx), _mm256_mul_ps(gy, gy))), non_sign_bits)), max_byte_value);
+
+	const __m256 one_over_length = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(
+		_mm256_mul_ps(normal_x, normal_x), _mm256_mul_ps(normal_y, normal_y)), _mm256_mul_ps(normal_z, normal_z))));
+
+	normal_x = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(normal_x, one_over_length), half_max_byte_value), half_max_byte_value);
+	normal_y = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(normal_y, one_over_length), half_max_byte_value), half_max_byte_value);
+	normal_z = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(normal_z, one_over_length), half_max_byte_value), half_max_byte_value);
+
+	return _mm256_or_si256(
+		_mm256_or_si256(
+			_mm256_sll_epi32(_mm256_cvttps_epi32(normal_x), _mm_cvtsi32_si128(shifts.red)),
+			_mm256_sll_epi32(_mm256_cvttps_epi32(normal_y), _mm_cvtsi32_si128(shifts.green))
+		),
+		_mm256_or_si256(
+			_mm256_sll_epi32(_mm256_cvttps_epi32(normal_z), _mm_cvtsi32_si128(shifts.blue)),
+			_mm256_sll_epi32(_mm256_sub_epi32(_mm256_set1_epi32(constants.max_byte_value), heights), _mm_cvtsi32_si128(shifts.alpha))
+		)
+	);
+}
+
+static __m128i load_8_pixels_as_16_bits_sse2(const byte* const src) {
+	return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*) src), _mm_setzero_si128());
+}
+
+// These sign-extend the low or high four 16-bit values to 32 bits
+static __m128i get_low_16_bits_as_32_sse2(const __m128i values) {
+	return _mm_srai_epi32(_mm_unpacklo_epi16(values, values), 16);
+}
+
+static __m128i get_high_16_bits_as_32_sse2(const __m128i values) {
+	return _mm_srai_epi32(_mm_unpackhi_epi16(values, values), 16);
+}
+
+static void generate_normal_map_row_sse2(const byte* const top, const byte* const middle, const byte* const bottom,
+	sdl_pixel_t* const dest, const GLint w, const PixelChannelShifts shifts) {
+
+	GLint x = 0;
+
+	for (; x <= w - 8; x += 8) {
+		const __m128i
+			tl = load_8_pixels_as_16_bits_sse2(top + x - 1),    tm = load_8_pixels_as_16_bits_sse2(top + x),
+			tr = load_8_pixels_as_16_bits_sse2(top + x + 1),    ml = load_8_pixels_as_16_bits_sse2(middle + x - 1),
+			mm = load_8_pixels_as_16_bits_sse2(middle + x),     mr = load_8_pixels_as_16_bits_sse2(middle + x + 1),
+			bl = load_8_pixels_as_16_bits_sse2(bottom + x - 1), bm = load_8_pixels_as_16_bits_sse2(bottom + x),
+			br = load_8_pixels_as_16_bits_sse2(bottom + x + 1);
+
+		// These fit in 16 bits, since they're between -4 and 4 times the max byte value
+		const __m128i
+			sobel_x = _mm_sub_epi16(
+				_mm_add_epi16(_mm_add_epi16(tr, _mm_slli_epi16(mr, 1)), br),
+				_mm_add_epi16(_mm_add_epi16(bl, _mm_slli_epi16(ml, 1)), tl)),
+
+			sobel_y = _mm_sub_epi16(
+				_mm_add_epi16(_mm_add_epi16(bl, _mm_slli_epi16(bm, 1)), br),
+				_mm_add_epi16(_mm_add_epi16(tr, _mm_slli_epi16(tm, 1)), tl));
+
+		_mm_storeu_si128((__m128i*) (dest + x), get_normal_map_pixels_sse2(get_low_16_bits_as_32_sse2(sobel_x),
+			get_low_16_bits_as_32_sse2(sobel_y), get_low_16_bits_as_32_sse2(mm), shifts));
+
+		_mm_storeu_si128((__m128i*) (dest + x + 4), get_normal_map_pixels_sse2(get_high_16_bits_as_32_sse2(sobel_x),
+			get_high_16_bits_as_32_sse2(sobel_y), get_high_16_bits_as_32_sse2(mm), shifts));
+	}
+
+	generate_normal_map_row_scalar(top + x, middle + x, bottom + x, dest + x, w - x, shifts);
+}
+
+AVX2_ROW_KERNEL static __m256i load_8_pixels_as_32_bits_avx2(const byte* const src) {
+	return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) src));
+}
+
+AVX2_ROW_KERNEL static void generate_normal_map_row_avx2(const byte* const top, const byte* const middle,
+	const byte* const bottom, sdl_pixel_t* const dest, const GLint w, const PixelChannelShifts shifts) {
+
+	GLint x = 0;
+
+	for (; x <= w - 8; x += 8) {
+		const __m256i
+			tl = load_8_pixels_as_32_bits_avx2(top + x - 1),    tm = load_8_pixels_as_32_bits_avx2(top + x),
+			tr = load_8_pixels_as_32_bits_avx2(top + x + 1),    ml = load_8_pixels_as_32_bits_avx2(middle + x - 1),
+			mm = load_8_pixels_as_32_bits_avx2(middle + x),     mr = load_8_pixels_as_32_bits_avx2(middle + x + 1),
+			bl = load_8_pixels_as_32_bits_avx2(bottom + x - 1), bm = load_8_pixels_as_32_bits_avx2(bottom + x),
+			br = load_8_pixels_as_32_bits_avx2(bottom + x + 1);
+
+		const __m256i
+			sobel_x = _mm256_sub_epi32(
+				_mm256_add_epi32(_mm256_add_epi32(tr, _mm256_slli_epi32(mr, 1)), br),
+				_mm256_add_epi32(_mm256_add_epi32(bl, _mm256_slli_epi32(ml, 1)), tl)),
+
+			sobel_y = _mm256_sub_epi32(
+				_mm256_add_epi32(_mm256_add_epi32(bl, _mm256_slli_epi32(bm, 1)), br),
+				_mm256_add_epi32(_mm256_add_epi32(tr, _mm256_slli_epi32(tm, 1)), tl));
+
+		_mm256_storeu_si256((__m256i*) (dest + x), get_normal_map_pixels_avx2(sobel_x, sobel_y, mm, shifts));
+	}
+
+	generate_normal_map_row_scalar(top + x, middle + x, bottom + x, dest + x, w - x, shifts);
+}
+
+#endif
+
+////////// This code picks the row kernels for the CPU
+
+static const NormalMapRowKernels scalar_row_kernels = {
+	generate_heightmap_row_scalar, blur_row_scalar, generate_normal_map_row_scalar
+};
+
+#ifdef HAS_SIMD_ROW_KERNELS
+
+// The heightmap kernel is mostly bound by memory bandwidth, so it doesn't get an AVX2 version
+static const NormalMapRowKernels
+	sse2_row_kernels = {generate_heightmap_row_sse2, blur_row_sse2, generate_normal_map_row_sse2},
+	avx2_row_kernels = {generate_heightmap_row_sse2, blur_row_avx2, generate_normal_map_row_avx2};
+
+#endif
+
+static const NormalMapRowKernels* get_row_kernels(void) {
+	#ifdef HAS_SIMD_ROW_KERNELS
+	return SDL_HasAVX2() ? &avx2_row_kernels : &sse2_row_kernels;
+	#else
+	return &scalar_row_kernels;
+	#endif
+}
+
+////////// This code concerns the box blur, which approximates the Gaussian blur in the same time per pixel for any radius.
+
+/* Three box blurs in a row are close to a Gaussian blur, if the boxes have the same variance as the Gaussian
+altogether (see http://blog.ivank.net/fastest-gaussian-blur.html for how the box widths are picked). Each box pass
+keeps a running sum of the pixels in its box, so it costs an add and a subtract per pixel, whatever the box width.
+The sums are divided by the box width with a fixed-point reciprocal, which rounds to the nearest byte. */
+
+enum {num_box_blur_passes = 3, box_blur_reciprocal_bits = 24};
+
+/* The box radii add up to at most `max_radius`, so that the boxes never reach further than the Gaussian kernel
+would. The total of the box radii is returned. */
+static byte get_box_blur_radii(const GLfloat std_dev, const byte max_radius, byte radii[num_box_blur_passes]) {
+	const GLfloat twelve_times_variance = 12.0f * std_dev * std_dev;
+	const GLint n = num_box_blur_passes;
+
+	// The box widths are odd so that the boxes are centered, and the narrower boxes come first
+	GLint narrower_width = (GLint) sqrtf(twelve_times_variance / n + 1.0f);
+	if (narrower_width % 2 == 0) narrower_width--;
+
+	const GLint num_narrower_boxes = int_clamp((GLint) roundf(
+		(twelve_times_variance - (GLfloat) (n * narrower_width * narrower_width + 4 * n * narrower_width + 3 * n))
+		/ (GLfloat) (-4 * narrower_width - 4)), 0, n);
+
+	GLint box_radii[num_box_blur_passes], total_radius = 0;
+
+	for (GLint i = 0; i < n; i++) {
+		box_radii[i] = ((i < num_narrower_boxes) ? narrower_width : narrower_width + 2) / 2;
+		total_radius += box_radii[i];
+	}
+
+	while (total_radius > max_radius) { // Shrinking the widest box until the boxes fit
+		GLint widest_box_index = 0;
+
+		for (GLint i = 1; i < n; i++) {
+			if (box_radii[i] > box_radii[widest_box_index]) widest_box_index = i;
+		}
+
+		box_radii[widest_box_index]--;
+		total_radius--;
+	}
+
+	for (GLint i = 0; i < n; i++) radii[i] = (byte) box_radii[i];
+	return (byte) total_radius;
+}
+
+static uint32_t get_box_blur_reciprocal(const byte radius) {
+	const uint32_t width = radius * 2u + 1u;
+	return ((1u << box_blur_reciprocal_bits) + width / 2u) / width;
+}
+
+/* This can't overflow: a box is at most 511 pixels wide, and the reciprocal is at most 2^24 over the box width plus
+a half, so the rounded product is at most 255 * 2^24 + 127.5 * 511 + 2^23, which is less than 2^32 */
+static byte divide_box_blur_sum(const uint32_t sum, const uint32_t reciprocal) {
+	return (byte) ((sum * reciprocal + (1u << (box_blur_reciprocal_bits - 1))) >> box_blur_reciprocal_bits);
+}
+
+/* This box blurs a row to `dest`, which may be the same as `src`. `padded_row` should have room
+for the row, plus `radius` pixels on each side. */
+static void box_blur_row(const byte* const src, byte* const dest,
+	byte* const padded_row, const GLint w, const byte radius) {
+
+	const uint32_t reciprocal = get_box_blur_reciprocal(radius);
+	const GLint box_w = radius * 2 + 1;
+
+	pad_row(src, padded_row, w, radius);
+
+	uint32_t sum = 0;
+	for (GLint x = 0; x < box_w - 1; x++) sum += padded_row[x];
+
+	for (GLint x = 0; x < w; x++) {
+		sum += padded_row[x + box_w - 1];
+		dest[x] = divide_box_blur_sum(sum, reciprocal);
+		sum -= padded_row[x];
+	}
+}
+
+/* This box blurs the rows from `first_dest_y` to `last_dest_y` of `src` vertically to `dest`, with the rows above and
+below clamped to the subtexture. Both buffers start at row `first_y`, and `sums` has room for one sum per column. */
+static void box_blur_rows_vertically(const byte* const src, byte* const dest, uint32_t* const sums,
+	const GLint w, const GLint subtexture_h, const GLint first_y,
+	const GLint first_dest_y, const GLint last_dest_y, const byte radius) {
+
+	#define CLAMPED_SRC_ROW(y) (src + (int_clamp((y), 0, subtexture_h - 1) - first_y) * w)
+
+	const uint32_t reciprocal = get_box_blur_reciprocal(radius);
+
+	// Each sum starts out with all of the box's rows for the first output row, except for its bottom one
+	memset(sums, 0, (size_t) w * sizeof(uint32_t));
+
+	for (GLint y = first_dest_y - radius; y < first_dest_y + radius; y++) {
+		const byte* const src_row = CLAMPED_SRC_ROW(y);
+		for (GLint x = 0; x < w; x++) sums[x] += src_row[x];
+	}
+
+	for (GLint y = first_dest_y; y <= last_dest_y; y++) {
+		const byte *const bottom_row = CLAMPED_SRC_ROW(y + radius), *const top_row = CLAMPED_SRC_ROW(y - radius);
+		byte* const dest_row = dest + (y - first_y) * w;
+
+		for (GLint x = 0; x < w; x++) {
+			const uint32_t sum = sums[x] + bottom_row[x];
+			dest_row[x] = divide_box_blur_sum(sum, reciprocal);
+			sums[x] = sum - top_row[x];
+		}
+	}
+
+	#undef CLAMPED_SRC_ROW
+}
+
+////////// This code runs the row kernels over bands of rows, which are independent jobs for a worker pool
+
+/* Each subtexture is split into bands of rows, and each band is one job. No filter reaches across the edge between
+two subtextures, so a band only needs the heightmap rows that are up to the blur radius plus one rows away from it (for
+the vertical blur, and then the Sobel filter). Each band makes those rows itself, so bands only share their input and
+output, and the rows around a band are the only work that's done twice. */
+
+enum {min_normal_map_band_h = 32, num_normal_map_jobs_per_cpu = 2};
+
+typedef struct {
+	const bool is_enabled, uses_boxes;
+	const byte radius; // This is how far the blur reaches on each side, altogether
+
+	// These are for the Gaussian kernel
+	GLfloat* const weights;
+	const BlurKernel kernel;
+	void (*const blur_row)(const byte* const* const, const BlurKernel* const, byte* const, const GLint);
+
+	// And these are for the box blur, which skips any boxes with a radius of zero
+	const byte num_boxes, box_radii[num_box_blur_passes];
+} HeightmapBlur;
+
+typedef struct {
+	const NormalMapRowKernels* const row_kernels;
+	const HeightmapBlur blur;
+	const GLfloat heightmap_scale;
+	const PixelChannelShifts shifts;
+
+	const SDL_Surface* const albedo_surface; // Each subtexture is stacked on top of the next one
+	sdl_pixel_t* const normal_map_pixels; // These are laid out like `albedo_surface`, without any row padding
+	const GLint subtexture_h, band_h, num_bands_per_subtexture;
+
+	/* If these are not NULL, each band counts down the bands left in its subtexture,
+	and the semaphore is posted when that reaches zero */
+	SDL_atomic_t* const num_bands_left_per_subtexture;
+	SDL_sem* const finished_subtexture_semaphore;
+} NormalMapJobData;
+
+static HeightmapBlur init_heightmap_blur(const NormalMapRowKernels* const row_kernels, const NormalMapConfig* const config) {
+	const byte blur_radius = config -> blur_radius;
+	if (blur_radius == 0 || config -> blur_std_dev == 0.0f) return (HeightmapBlur) {.is_enabled = false};
+
+	if (config -> use_box_blur) {
+		byte box_radii[num_box_blur_passes], nonzero_box_radii[num_box_blur_passes] = {0}, num_boxes = 0;
+		const byte radius = get_box_blur_radii(config -> blur_std_dev, blur_radius, box_radii);
+
+		for (byte i = 0; i < num_box_blur_passes; i++) {
+			if (box_radii[i] != 0) nonzero_box_radii[num_boxes++] = box_radii[i];
+		}
+
+		return (HeightmapBlur) {
+			.is_enabled = radius != 0, .uses_boxes = true, .radius = radius, .num_boxes = num_boxes,
+			.box_radii = {nonzero_box_radii[0], nonzero_box_radii[1], nonzero_box_radii[2]}
+		};
+	}
+
+	GLfloat* const weights = compute_1D_gaussian_kernel(blur_radius, config -> blur_std_dev);
+	const byte radius = get_effective_blur_radius(weights, blur_radius);
 	const uint16_t kernel_length = radius * 2 + 1;
 
-	GLfloat* const kernel = alloc((size_t) kernel_length, sizeof(GLfloat)), sum = 0.0f;
-	const GLfloat one_over_two_times_std_dev_squared = 1.0f / (2.0f * std_dev * std_dev);
+	// Finding fixed-point weights for the SIMD kernels (and using the scalar kernel if some weight has none)
+	uint32_t* const fixed_point_weights = alloc(kernel_length, sizeof(uint32_t));
+	bool has_fixed_point_weights = true;
 
-	for (uint16_t x = 0; x < kernel_length; x++) {
-		const int16_t dx = (int16_t) (x - radius);
-		const GLfloat weight = expf(-(dx * dx) * one_over_two_times_std_dev_squared);
-		kernel[x] = weight;
-		sum += weight;
+	for (uint16_t i = 0; i < kernel_length; i++) {
+		fixed_point_weights[i] = get_fixed_point_blur_weight(weights[blur_radius - radius + i]);
+		if (fixed_point_weights[i] == no_fixed_point_blur_weight) has_fixed_point_weights = false;
 	}
 
-	const GLfloat one_over_sum = 1.0f / sum;
-	for (uint16_t i = 0; i < kernel_length; i++) kernel[i] *= one_over_sum;
+	return (HeightmapBlur) {
+		.is_enabled = true, .uses_boxes = false, .radius = radius, .weights = weights,
+		.kernel = {kernel_length, weights + (blur_radius - radius), fixed_point_weights},
+		.blur_row = has_fixed_point_weights ? row_kernels -> blur_row : blur_row_scalar
+	};
+}
 
-	return kernel;
+static void deinit_heightmap_blur(const HeightmapBlur* const blur) {
+	if (blur -> weights == NULL) return;
+	dealloc(blur -> weights);
+	dealloc((uint32_t*) blur -> kernel.fixed_point_weights);
 }
 
-// It's assumed that `src` has the same size as `dest`, and that they both have the same format.
-static void do_separable_gaussian_blur_pass(
-	SDL_Surface* const src, SDL_Surface* const dest,
-	const GLfloat* const kernel, const GLint subtexture_h,
-	const byte kernel_radius, const bool blur_is_vertical) {
+/* These blur the heightmap rows from `first_y` to `last_y` horizontally to `blurred_heightmap`, and then the rows
+from `first_blurred_y` to `last_blurred_y` vertically back to `heightmap`. Both heightmaps start at `first_y`,
+and the rows above and below the vertically blurred ones are clamped to the subtexture. */
 
-	const GLint w = dest -> w, h = dest -> h;
+static void blur_heightmap_with_gaussian_kernel(const HeightmapBlur* const blur,
+	byte* const heightmap, byte* const blurred_heightmap, const GLint w, const GLint subtexture_h,
+	const GLint first_y, const GLint last_y, const GLint first_blurred_y, const GLint last_blurred_y) {
 
-	WITH_SURFACE_PIXEL_ACCESS(src,
-		WITH_SURFACE_PIXEL_ACCESS(dest,
+	const byte radius = blur -> radius;
+	const BlurKernel* const kernel = &blur -> kernel;
+	const uint16_t kernel_length = kernel -> length;
 
-			for (GLint y = 0; y < h; y++) {
-				sdl_pixel_component_t* const dest_pixel = read_surface_pixel(dest, 0, y);
+	const byte** const tap_rows = alloc(kernel_length, sizeof(byte*));
+	byte* const padded_row = alloc((size_t) (w + radius * 2), sizeof(byte));
 
-				const GLint subtexture_top = (y / subtexture_h) * subtexture_h;
-				const GLint subtexture_bottom = subtexture_top + subtexture_h - 1;
+	for (uint16_t i = 0; i < kernel_length; i++) tap_rows[i] = padded_row + i;
 
-				for (GLint x = 0; x < w; x++) {
-					GLuint blurred_pixel = 0.0f;
+	for (GLint y = first_y; y <= last_y; y++) {
+		const GLint row_offset = (y - first_y) * w;
+		pad_row(heightmap + row_offset, padded_row, w, radius);
+		blur -> blur_row(tap_rows, kernel, blurred_heightmap + row_offset, w);
+	}
 
-					for (int16_t i = -kernel_radius; i <= kernel_radius; i++) {
-						GLint fx = x, fy = y; // `f` = filter
-						if (blur_is_vertical) fy += i; else fx += i;
+	for (GLint y = first_blurred_y; y <= last_blurred_y; y++) {
+		for (uint16_t i = 0; i < kernel_length; i++)
+			tap_rows[i] = blurred_heightmap + (int_clamp(y + i - radius, 0, subtexture_h - 1) - first_y) * w;
 
-						const sdl_pixel_component_t src_pixel = *(sdl_pixel_component_t*)
-							read_surface_pixel(src,
-								int_clamp(fx, 0, w - 1),
-								int_clamp(fy, subtexture_top, subtexture_bottom)
-							);
+		blur -> blur_row(tap_rows, kernel, heightmap + (y - first_y) * w, w);
+	}
 
-						blurred_pixel += (sdl_pixel_component_t) (src_pixel * kernel[i + kernel_radius]);
-					}
+	dealloc(padded_row);
+	dealloc(tap_rows);
+}
 
-					dest_pixel[x] = (sdl_pixel_component_t) blurred_pixel;
-				}
-			}
-		);
-	);
+/* Vertically, the boxes blur back and forth between the two heightmaps, ending up in `heightmap`; and each box blurs
+the rows that the boxes after it need, which are fewer with each box. So horizontally, the boxes blur in place, except
+for the first one blurring to `blurred_heightmap` when there's an odd number of boxes. */
+static void blur_heightmap_with_boxes(const HeightmapBlur* const blur,
+	byte* const heightmap, byte* const blurred_heightmap, const GLint w, const GLint subtexture_h,
+	const GLint first_y, const GLint last_y, const GLint first_blurred_y, const GLint last_blurred_y) {
+
+	const byte num_boxes = blur -> num_boxes, *const box_radii = blur -> box_radii;
+	byte* const horizontally_blurred_heightmap = (num_boxes % 2 == 0) ? heightmap : blurred_heightmap;
+
+	byte* const padded_row = alloc((size_t) (w + blur -> radius * 2), sizeof(byte));
+	uint32_t* const sums = alloc((size_t) w, sizeof(uint32_t));
+
+	for (GLint y = first_y; y <= last_y; y++) {
+		const GLint row_offset = (y - first_y) * w;
+
+		for (byte i = 0; i < num_boxes; i++)
+			box_blur_row(((i == 0) ? heightmap : horizontally_blurred_heightmap) + row_offset,
+				horizontally_blurred_heightmap + row_offset, padded_row, w, box_radii[i]);
+	}
+
+	GLint first_dest_y[num_box_blur_passes], last_dest_y[num_box_blur_passes];
+	first_dest_y[num_boxes - 1] = first_blurred_y;
+	last_dest_y[num_boxes - 1] = last_blurred_y;
+
+	for (byte i = num_boxes - 1; i > 0; i--) {
+		first_dest_y[i - 1] = int_max(first_dest_y[i] - box_radii[i], 0);
+		last_dest_y[i - 1] = int_min(last_dest_y[i] + box_radii[i], subtexture_h - 1);
+	}
+
+	for (byte i = 0; i < num_boxes; i++) {
+		const bool from_blurred_heightmap = ((num_boxes - i) % 2) == 1;
+
+		box_blur_rows_vertically(
+			from_blurred_heightmap ? blurred_heightmap : heightmap,
+			from_blurred_heightmap ? heightmap : blurred_heightmap,
+			sums, w, subtexture_h, first_y, first_dest_y[i], last_dest_y[i], box_radii[i]);
+	}
+
+	dealloc(padded_row);
+	dealloc(sums);
+}
+
+// This turns the albedo pixels of one band into normal map pixels, and the albedo surface must be locked beforehand
+static void normal_map_band_job(void* const job_data, const buffer_size_t job_index) {
+	const NormalMapJobData* const data = job_data;
+
+	const GLint
+		w = data -> albedo_surface -> w, subtexture_h = data -> subtexture_h,
+		subtexture_index = (GLint) job_index / data -> num_bands_per_subtexture,
+		subtexture_top = subtexture_index * subtexture_h;
+
+	// These are relative to the top of the subtexture
+	const GLint
+		band_top = ((GLint) job_index % data -> num_bands_per_subtexture) * data -> band_h,
+		band_bottom = int_min(band_top + data -> band_h, subtexture_h) - 1,
+		num_rows_around_band = data -> blur.radius + 1,
+		first_y = int_max(band_top - num_rows_around_band, 0),
+		last_y = int_min(band_bottom + num_rows_around_band, subtexture_h - 1);
+
+	const size_t num_heightmap_pixels = (size_t) w * (size_t) (last_y - first_y + 1), padded_w = (size_t) w + 2;
+
+	byte
+		*const heightmap = alloc(num_heightmap_pixels, sizeof(byte)),
+		*const blurred_heightmap = alloc(num_heightmap_pixels, sizeof(byte)),
+		*const padded_rows = alloc(padded_w * 3, sizeof(byte)); // The rows above, at, and below a normal map row
+
+	////////// Making a heightmap
+
+	const GLfloat heightmap_scale = data -> heightmap_scale;
+
+	/* Any heightmap scale smaller than this one will result in any
+	pixel component being multiplied by it turning into zero */
+	const GLfloat smallest_possible_heightmap_scale = constants.one_over_max_byte_value;
+
+	if (heightmap_scale < smallest_possible_heightmap_scale) memset(heightmap, 0, num_heightmap_pixels);
+	else {
+		for (GLint y = first_y; y <= last_y; y++)
+			data -> row_kernels -> generate_heightmap_row(read_surface_pixel(data -> albedo_surface, 0, subtexture_top + y),
+				heightmap + (y - first_y) * w, w, data -> shifts, heightmap_scale);
+	}
+
+	////////// Blurring it (if needed), and then making a normal map of it
+
+	const HeightmapBlur* const blur = &data -> blur;
+
+	if (blur -> is_enabled)
+		(blur -> uses_boxes ? blur_heightmap_with_boxes : blur_heightmap_with_gaussian_kernel)(
+			blur, heightmap, blurred_heightmap, w, subtexture_h, first_y, last_y,
+			int_max(band_top - 1, 0), int_min(band_bottom + 1, subtexture_h - 1));
+
+	for (GLint y = band_top; y <= band_bottom; y++) {
+		pad_row(heightmap + (int_max(y - 1, 0) - first_y) * w, padded_rows, w, 1);
+		pad_row(heightmap + (y - first_y) * w, padded_rows + padded_w, w, 1);
+		pad_row(heightmap + (int_min(y + 1, subtexture_h - 1) - first_y) * w, padded_rows + padded_w * 2, w, 1);
+
+		data -> row_kernels -> generate_normal_map_row(padded_rows + 1, padded_rows + padded_w + 1,
+			padded_rows + padded_w * 2 + 1, data -> normal_map_pixels + (subtexture_top + y) * w, w, data -> shifts);
+	}
+
+	dealloc(heightmap);
+	dealloc(blurred_heightmap);
+	dealloc(padded_rows);
+
+	////////// Letting the context thread know if this was the last band of its subtexture
+
+	SDL_atomic_t* const num_bands_left_per_subtexture = data -> num_bands_left_per_subtexture;
+
+	// `SDL_AtomicAdd` returns the value from before the addition
+	if (num_bands_left_per_subtexture != NULL && SDL_AtomicAdd(num_bands_left_per_subtexture + subtexture_index, -1) == 1)
+		SDL_SemPost(data -> finished_subtexture_semaphore);
+}
+
+/* There are a few jobs per CPU, so that no worker is left with a long last job, but subtextures are only split up
+into more than one band when there are too few of them for that, since each band redoes the rows around it */
+static GLint get_num_bands_per_subtexture(const GLint subtexture_h, const GLint num_subtextures) {
+	const GLint
+		num_wanted_jobs = SDL_GetCPUCount() * num_normal_map_jobs_per_cpu,
+		max_num_bands = int_max(subtexture_h / min_normal_map_band_h, 1);
+
+	return int_clamp((num_wanted_jobs + num_subtextures - 1) / num_subtextures, 1, max_num_bands);
+}
+
+// The number of jobs is `num_bands_per_subtexture` times the number of subtextures
+static NormalMapJobData init_normal_map_job_data(const NormalMapRowKernels* const row_kernels,
+	const NormalMapConfig* const config, const SDL_Surface* const albedo_surface,
+	sdl_pixel_t* const normal_map_pixels, const GLint subtexture_h, const GLint num_bands_per_subtexture,
+	SDL_atomic_t* const num_bands_left_per_subtexture, SDL_sem* const finished_subtexture_semaphore) {
+
+	// The band height is rounded up, and then the band count is redone, so that the last band is never empty
+	const GLint band_h = (subtexture_h + num_bands_per_subtexture - 1) / num_bands_per_subtexture;
+
+	return (NormalMapJobData) {
+		row_kernels, init_heightmap_blur(row_kernels, config), config -> heightmap_scale,
+		get_pixel_channel_shifts(albedo_surface -> format), albedo_surface, normal_map_pixels,
+		subtexture_h, band_h, (subtexture_h + band_h - 1) / band_h,
+		num_bands_left_per_subtexture, finished_subtexture_semaphore
+	};
+}
+
+static void upload_normal_map_subtexture(const TextureType type, const sdl_pixel_t* const pixels,
+	const GLint subtexture_w, const GLint subtexture_h, const GLint subtexture_index) {
+
+	const GLint level = 0;
+
+	if (type == TexSet)
+		glTexSubImage3D(type, level, 0, 0, subtexture_index, subtexture_w, subtexture_h, 1,
+			OPENGL_INPUT_PIXEL_FORMAT, OPENGL_COLOR_CHANNEL_TYPE, pixels);
+	else
+		glTexSubImage2D(type, level, 0, 0, subtexture_w, subtexture_h,
+			OPENGL_INPUT_PIXEL_FORMAT, OPENGL_COLOR_CHANNEL_TYPE, pixels);
 }
 
 static void get_texture_metadata(const TextureType type,
@@ -216,24 +914,205 @@ static void get_texture_metadata(const TextureType type,
 	else *uses_anisotropic_filtering = false;
 }
 
-// Note: level init is almost instant when this just returns 0; so GPU parallelization could be great here
+/* This makes the normal map on a worker pool, in bands of rows, and uploads each subtexture to the bound normal map
+texture as soon as all of its bands are done, while the other bands are still being made */
+static void make_normal_map_on_cpu(const NormalMapConfig* const config, SDL_Surface* const rgba_surface,
+	const TextureType type, const GLint subtexture_w, const GLint subtexture_h, const GLint num_subtextures) {
+
+	const size_t num_subtexture_pixels = (size_t) subtexture_w * (size_t) subtexture_h;
+	sdl_pixel_t* const normal_map_pixels = alloc(num_subtexture_pixels * (size_t) num_subtextures, sizeof(sdl_pixel_t));
+
+	const GLint num_bands_per_subtexture = get_num_bands_per_subtexture(subtexture_h, num_subtextures);
+	SDL_atomic_t* const num_bands_left_per_subtexture = alloc((size_t) num_subtextures, sizeof(SDL_atomic_t));
+	SDL_sem* const finished_subtexture_semaphore = SDL_CreateSemaphore(0);
+
+	if (finished_subtexture_semaphore == NULL)
+		FAIL(CreateThread, "Could not create a semaphore for normal map generation: '%s'", SDL_GetError());
+
+	const NormalMapJobData job_data = init_normal_map_job_data(get_row_kernels(), config, rgba_surface,
+		normal_map_pixels, subtexture_h, num_bands_per_subtexture,
+		num_bands_left_per_subtexture, finished_subtexture_semaphore);
+
+	for (GLint i = 0; i < num_subtextures; i++)
+		SDL_AtomicSet(num_bands_left_per_subtexture + i, job_data.num_bands_per_subtexture);
+
+	WITH_SURFACE_PIXEL_ACCESS(rgba_surface,
+		WorkerPool worker_pool;
+
+		start_worker_pool(&worker_pool, normal_map_band_job, (void*) &job_data,
+			(buffer_size_t) (job_data.num_bands_per_subtexture * num_subtextures));
+
+		/* The context thread makes bands too while there are some left, and otherwise waits for the next finished
+		subtexture. Each subtexture is uploaded once its band count reaches zero, and its count is then set to -1. A
+		subtexture may be uploaded before its own semaphore post is waited for, but that only makes a later wait return
+		early, and there's always a post left for each subtexture that isn't uploaded yet. */
+		for (GLint num_uploaded_subtextures = 0; num_uploaded_subtextures < num_subtextures;) {
+			if (!run_worker_pool_job(&worker_pool)) SDL_SemWait(finished_subtexture_semaphore);
+
+			for (GLint i = 0; i < num_subtextures; i++) {
+				if (SDL_AtomicGet(num_bands_left_per_subtexture + i) != 0) continue;
+
+				upload_normal_map_subtexture(type, normal_map_pixels + num_subtexture_pixels * (size_t) i,
+					subtexture_w, subtexture_h, i);
+
+				SDL_AtomicSet(num_bands_left_per_subtexture + i, -1);
+				num_uploaded_subtextures++;
+			}
+		}
+
+		finish_worker_pool(&worker_pool);
+	);
+
+	deinit_heightmap_blur(&job_data.blur);
+	SDL_DestroySemaphore(finished_subtexture_semaphore);
+	dealloc(num_bands_left_per_subtexture);
+	dealloc(normal_map_pixels);
+}
+
+////////// This code makes normal maps on the GPU, with one fragment shader pass per step
+
+/* Each pass draws a quad over its whole output, and reads its input from the temporary texture unit. The heightmap
+pass writes to the first heightmap, the horizontal and vertical blur passes go to the second one and back, and the
+Sobel pass writes to a layer of the normal map. The heightmaps are 8-bit integer textures, and the passes do the same
+math as the CPU row kernels, so that no precision is lost between the passes. */
+
+enum {max_gpu_blur_kernel_length = 512}; // This must equal `MAX_BLUR_KERNEL_LENGTH` in `normal_map_generation/blur.frag`
+
+static void draw_normal_map_pass(const TextureType output_type, const GLuint output_texture, const GLint output_layer) {
+	const GLint level = 0;
+
+	if (output_type == TexSet)
+		glFramebufferTextureLayer(framebuffer_target, GL_COLOR_ATTACHMENT0, output_texture, level, output_layer);
+	else
+		glFramebufferTexture2D(framebuffer_target, GL_COLOR_ATTACHMENT0, output_type, output_texture, level);
+
+	check_framebuffer_completeness();
+	draw_primitives(GL_TRIANGLE_STRIP, corners_per_quad);
+}
+
+// This renders the normal map straight into `normal_map_set`, so nothing is read back from the GPU
+static void make_normal_map_on_gpu(const NormalMapCreator* const creator, const NormalMapConfig* const config,
+	SDL_Surface* const rgba_surface, const TextureType type, const GLuint normal_map_set,
+	const GLint subtexture_w, const GLint subtexture_h, const GLint num_subtextures) {
+
+	const GLuint heightmap_shader = creator -> heightmap_shader, blur_shader = creator -> blur_shader;
+
+	////////// Uploading the albedo pixels as integers, and defining the heightmaps
+
+	GLint prev_active_texture_unit;
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &prev_active_texture_unit);
+	glActiveTexture(GL_TEXTURE0 + TU_Temporary);
+
+	const GLuint albedo_texture = preinit_texture(TexSet, TexNonRepeating, TexNearest, TexNearest, false);
+
+	// `GL_BGRA_INTEGER` is the integer version of `OPENGL_INPUT_PIXEL_FORMAT`
+	WITH_SURFACE_PIXEL_ACCESS(rgba_surface,
+		init_texture_data(TexSet, (GLsizei[]) {subtexture_w, subtexture_h, num_subtextures},
+			GL_BGRA_INTEGER, GL_RGBA8UI, OPENGL_COLOR_CHANNEL_TYPE, rgba_surface -> pixels);
+	);
+
+	GLuint heightmaps[2];
+
+	for (byte i = 0; i < ARRAY_LENGTH(heightmaps); i++) {
+		heightmaps[i] = preinit_texture(TexPlain, TexNonRepeating, TexNearest, TexNearest, false);
+
+		init_texture_data(TexPlain, (GLsizei[]) {subtexture_w, subtexture_h},
+			GL_RED_INTEGER, GL_R8UI, OPENGL_COLOR_CHANNEL_TYPE, NULL);
+	}
+
+	////////// Setting the uniforms that are the same for each layer
+
+	const byte blur_radius = config -> blur_radius;
+	const bool blurs = blur_radius != 0 && config -> blur_std_dev != 0.0f; // The same as for `init_heightmap_blur`
+
+	use_shader(heightmap_shader);
+	INIT_UNIFORM_VALUE(heightmap_scale, heightmap_shader, 1f, config -> heightmap_scale);
+
+	if (blurs) {
+		// Only the float weights are needed here, and not the fixed-point ones that the SIMD kernels use
+		GLfloat* const weights = compute_1D_gaussian_kernel(blur_radius, config -> blur_std_dev);
+		const byte radius = get_effective_blur_radius(weights, blur_radius);
+		const uint16_t kernel_length = radius * 2 + 1;
+
+		// The kernel length is at most 511, since the radius is a byte
+		GLfloat padded_weights[max_gpu_blur_kernel_length] = {0};
+		memcpy(padded_weights, weights + (blur_radius - radius), kernel_length * sizeof(GLfloat));
+		dealloc(weights);
+
+		use_shader(blur_shader);
+		INIT_UNIFORM_VALUE(blur_radius, blur_shader, 1i, radius);
+		INIT_UNIFORM_VALUE(blur_weights, blur_shader, 4fv, (kernel_length + 3) / 4, padded_weights);
+	}
+
+	////////// Drawing each layer
+
+	GLint viewport_bounds[4];
+	glGetIntegerv(GL_VIEWPORT, viewport_bounds);
+
+	glViewport(0, 0, subtexture_w, subtexture_h);
+	use_framebuffer(framebuffer_target, creator -> framebuffer);
+
+	for (GLint i = 0; i < num_subtextures; i++) {
+		use_shader(heightmap_shader);
+		UPDATE_UNIFORM(creator, heightmap, albedo_layer, 1i, i);
+		draw_normal_map_pass(TexPlain, heightmaps[0], 0);
+
+		if (blurs) {
+			use_shader(blur_shader);
+
+			for (byte j = 0; j < 2; j++) { // Blurring horizontally, and then vertically
+				UPDATE_UNIFORM(creator, blur, blur_direction, 2i, j == 0, j == 1);
+				use_texture(TexPlain, heightmaps[j]);
+				draw_normal_map_pass(TexPlain, heightmaps[!j], 0);
+			}
+		}
+
+		use_shader(creator -> normal_map_shader);
+		use_texture(TexPlain, heightmaps[0]);
+		draw_normal_map_pass(type, normal_map_set, i);
+	}
+
+	use_framebuffer(framebuffer_target, 0);
+	glViewport(viewport_bounds[0], viewport_bounds[1], viewport_bounds[2], viewport_bounds[3]);
+
+	////////// Deinitialization
+
+	deinit_texture(albedo_texture);
+	glDeleteTextures(ARRAY_LENGTH(heightmaps), heightmaps);
+	glActiveTexture((GLenum) prev_active_texture_unit);
+}
+
+/* Software renderers run the shaders much slower than the CPU generator runs its SIMD row kernels on a worker pool
+(on Mesa's llvmpipe, the sector faces' normal maps take 38 to 61 ms with the shaders, and 1.3 to 2.8 ms on the CPU),
+so the normal maps are made on the CPU when one of these is the renderer */
+static bool is_software_renderer(void) {
+	const GLchar* const software_renderer_names[] = {
+		"llvmpipe", "softpipe", "SWR", "Software Rasterizer", "Apple Software Renderer", "GDI Generic"
+	};
+
+	const GLchar* const renderer = (const GLchar*) glGetString(GL_RENDERER);
+	if (renderer == NULL) return false;
+
+	for (byte i = 0; i < ARRAY_LENGTH(software_renderer_names); i++) {
+		if (strstr(renderer, software_renderer_names[i]) != NULL) return true;
+	}
+
+	return false;
+}
+
+////////// This code makes normal maps from albedo textures
+
 GLuint init_normal_map_from_albedo_texture(
 	const NormalMapCreator* const creator,
 	const NormalMapConfig* const config,
-	const GLuint albedo_texture, const TextureType type) {
-
-	(void) creator; // TODO: remove
+	const GLuint albedo_texture, SDL_Surface* const albedo_surface, const TextureType type) {
 
 	/* How this function works:
 
 	- First, query OpenGL about information about the texture set, like its dimensions, and its filters used.
-	- Then, define two grayscale surfaces, #1 and #2, and one RGBA surface.
-	- Copy the surface in from disk into the RGBA surface.
-	- Make a heightmap of the RGBA surface to #1.
-	- Blur #1 horizontally to #2.
-	- Blur #2 vertically to #1.
-	- Generate a normal map of #1 to the RGBA surface.
-	- Upload the RGBA surface to the GPU as a texture set of normal maps.
+	- Then, use the albedo surface as the RGBA surface, or scale it to a new RGBA surface if rescaling.
+	- Make a heightmap of the RGBA surface, blur it (if needed), and turn it into a normal map. This is done with
+		fragment shaders on the GPU, or with the box blur or on a software renderer, in bands of rows on a worker pool.
 
 	Note: normal maps are not interleaved with the texture set because if gamma correction is used,
 	the texture set will be in SRGB, and normal maps should be in a linear color space. */
@@ -249,98 +1128,419 @@ GLuint init_normal_map_from_albedo_texture(
 	use_texture(type, albedo_texture);
 	get_texture_metadata(type, &subtexture_w, &subtexture_h, &num_subtextures, &wrap_mode, mag_min_filter, &uses_anisotropic_filtering);
 
-	////////// Uploading the texture to the CPU
+	if (albedo_surface -> w != subtexture_w || albedo_surface -> h != subtexture_h * num_subtextures)
+		FAIL(CreateTexture, "Normal map creation failed: the albedo surface is %dx%d, but the albedo texture "
+			"has %d subtexture(s) of %dx%d", albedo_surface -> w, albedo_surface -> h,
+			num_subtextures, subtexture_w, subtexture_h);
 
+	////////// Getting the albedo pixels at the normal map's size (which needs no reading back from the GPU)
+
+	SDL_Surface* rgba_surface = albedo_surface;
 	const GLfloat rescale_factor = config -> rescale_factor;
-	const bool rescaling = rescale_factor != 1.0f;
-	const GLint unscaled_subtexture_w = subtexture_w, unscaled_subtexture_h = subtexture_h, level = 0;
 
-	if (rescaling) {
+	if (rescale_factor != 1.0f) {
 		subtexture_w = (GLint) (subtexture_w * rescale_factor);
 		subtexture_h = (GLint) (subtexture_h * rescale_factor);
-	}
 
-	const GLint cpu_buffers_h = subtexture_h * num_subtextures;
+		rgba_surface = init_blank_surface(subtexture_w, subtexture_h * num_subtextures);
+		SDL_BlitScaled(albedo_surface, NULL, rgba_surface, NULL);
+	}
 
-	SDL_Surface
-		*const rgba_surface = init_blank_surface(subtexture_w, cpu_buffers_h),
-		*const grayscale_buffer_1 = init_blank_grayscale_surface(subtexture_w, cpu_buffers_h),
-		*const grayscale_buffer_2 = init_blank_grayscale_surface(subtexture_w, cpu_buffers_h);
+	////////// Defining the normal map texture, and making the normal map
 
-	//////////
+	const TextureFilterMode min_filter = (TextureFilterMode) mag_min_filter[1];
 
-	if (rescaling) { // If rescaling, copying the texture on the GPU into a surface with the same size, and then upscaling that surface to `rgba_surface`
-		SDL_Surface* const surface_with_src_size = init_blank_surface(
-			unscaled_subtexture_w, unscaled_subtexture_h * num_subtextures);
+	const GLuint normal_map_set = preinit_texture(type, (TextureWrapMode) wrap_mode,
+		(TextureFilterMode) mag_min_filter[0], min_filter, uses_anisotropic_filtering);
 
-		WITH_SURFACE_PIXEL_ACCESS(surface_with_src_size,
-			glGetTexImage(type, level, OPENGL_INPUT_PIXEL_FORMAT,
-				OPENGL_COLOR_CHANNEL_TYPE, surface_with_src_size -> pixels);
-		);
+	init_texture_data(type, (GLsizei[]) {subtexture_w, subtexture_h, num_subtextures}, OPENGL_INPUT_PIXEL_FORMAT,
+		OPENGL_NORMAL_MAP_INTERNAL_PIXEL_FORMAT, OPENGL_COLOR_CHANNEL_TYPE, NULL);
 
-		SDL_BlitScaled(surface_with_src_size, NULL, rgba_surface, NULL);
-		deinit_surface(surface_with_src_size);
+	// The box blur's running sums don't suit fragment shaders, so that one is only done on the CPU
+	if (config -> use_box_blur || is_software_renderer())
+		make_normal_map_on_cpu(config, rgba_surface, type, subtexture_w, subtexture_h, num_subtextures);
+	else {
+		make_normal_map_on_gpu(creator, config, rgba_surface, type, normal_map_set, subtexture_w, subtexture_h, num_subtextures);
+		use_texture(type, normal_map_set);
 	}
-	else { // Otherwise, copy the texture directly to `rgba_surface`
-		WITH_SURFACE_PIXEL_ACCESS(rgba_surface,
-			glGetTexImage(type, level, OPENGL_INPUT_PIXEL_FORMAT,
-				OPENGL_COLOR_CHANNEL_TYPE, rgba_surface -> pixels);
-		);
+
+	if (min_filter == TexLinearMipmapped || min_filter == TexTrilinear) init_texture_mipmap(type);
+
+	////////// Deinitialization
+
+	if (rgba_surface != albedo_surface) deinit_surface(rgba_surface);
+
+	return normal_map_set;
+}
+
+#if defined(DEBUG_NORMAL_MAP_GENERATION) || defined(BENCHMARK_NORMAL_MAP_GENERATION)
+
+typedef struct {
+	size_t num_matching;
+	int max_difference;
+	GLdouble mean_difference;
+} NormalMapDifferences;
+
+static NormalMapDifferences get_normal_map_differences(const sdl_pixel_t* const expected_normal_map,
+	const sdl_pixel_t* const normal_map, const size_t num_bytes) {
+
+	const byte *const expected_bytes = (const byte*) expected_normal_map, *const bytes = (const byte*) normal_map;
+	NormalMapDifferences differences = {0};
+	size_t total_difference = 0;
+
+	for (size_t i = 0; i < num_bytes; i++) {
+		const int difference = abs(expected_bytes[i] - bytes[i]);
+		total_difference += (size_t) difference;
+
+		if (difference == 0) differences.num_matching++;
+		else if (difference > differences.max_difference) differences.max_difference = difference;
 	}
 
-	////////// Making a heightmap
+	differences.mean_difference = (GLdouble) total_difference / (GLdouble) num_bytes;
+	return differences;
+}
 
-	generate_heightmap(rgba_surface, grayscale_buffer_1, config -> heightmap_scale);
+static SDL_Surface* init_albedo_surface_for_checking(const GLchar* const* const albedo_texture_paths,
+	const GLsizei num_albedo_textures, const GLint subtexture_w, const GLint subtexture_h) {
 
-	////////// Blurring it (if needed), and then making a normal map
+	SDL_Surface* const albedo_surface = init_blank_surface(subtexture_w, subtexture_h * num_albedo_textures);
 
-	const byte blur_radius = config -> blur_radius;
-	const GLfloat blur_std_dev = config -> blur_std_dev;
+	for (GLsizei i = 0; i < num_albedo_textures; i++) {
+		SDL_Surface* const surface = init_surface(albedo_texture_paths[i]);
+		SDL_BlitScaled(surface, NULL, albedo_surface, &(SDL_Rect) {0, subtexture_h * i, subtexture_w, subtexture_h});
+		deinit_surface(surface);
+	}
 
-	if (blur_radius != 0 && blur_std_dev != 0.0f) {
-		GLfloat* const blur_kernel = compute_1D_gaussian_kernel(blur_radius, blur_std_dev);
+	return albedo_surface;
+}
+
+#endif
+
+#ifdef DEBUG_NORMAL_MAP_GENERATION
+
+/* This makes normal maps of the given albedo textures with the creator's shaders and with the CPU generator, for each
+blur that ships with the game and a few wider ones, and fails if any byte differs. The textures are checked as a
+texture set at the given size, and the first one as a plain texture at an odd size, so that the edges are clamped
+differently. Both backends do the same math, so this passes on Mesa's llvmpipe; a driver that rounds `sqrt` or
+division differently may fail it. */
+void check_gpu_normal_map_parity(const NormalMapCreator* const creator,
+	const GLchar* const* const albedo_texture_paths, const GLsizei num_albedo_textures, const GLsizei texture_size) {
+
+	typedef struct {
+		const byte blur_radius;
+		const GLfloat blur_std_dev, heightmap_scale;
+	} BlurToCheck;
+
+	const BlurToCheck blurs_to_check[] = {
+		{0, 0.0f, 1.0f}, {1, 0.1f, 1.0f}, {5, 0.25f, 0.3f}, {3, 0.8f, 1.0f}, // These are the shipped ones
+		{8, 3.0f, 2.5f}, {40, 12.0f, 0.5f}, {255, 9.0f, 1.0f}
+	};
+
+	typedef struct {
+		const TextureType type;
+		const GLint subtexture_w, subtexture_h;
+		const GLsizei num_subtextures;
+	} TextureToCheck;
+
+	const TextureToCheck textures_to_check[] = {
+		{TexSet, texture_size, texture_size, num_albedo_textures},
+		{TexPlain, 61, 37, 1}
+	};
+
+	GLint prev_active_texture_unit;
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &prev_active_texture_unit);
+	glActiveTexture(GL_TEXTURE0 + TU_Temporary);
+
+	for (byte i = 0; i < ARRAY_LENGTH(textures_to_check); i++) {
+		const TextureToCheck* const texture = textures_to_check + i;
+		const TextureType type = texture -> type;
+		const GLint subtexture_w = texture -> subtexture_w, subtexture_h = texture -> subtexture_h;
+		const GLsizei num_subtextures = texture -> num_subtextures;
+
+		SDL_Surface* const albedo_surface = init_albedo_surface_for_checking(
+			albedo_texture_paths, num_subtextures, subtexture_w, subtexture_h);
+
+		const size_t num_bytes = (size_t) subtexture_w * (size_t) albedo_surface -> h * sizeof(sdl_pixel_t);
+		sdl_pixel_t *const gpu_normal_map = alloc(num_bytes, 1), *const cpu_normal_map = alloc(num_bytes, 1);
+		GLuint normal_map_sets[2];
+
+		for (byte j = 0; j < ARRAY_LENGTH(normal_map_sets); j++) {
+			normal_map_sets[j] = preinit_texture(type, TexNonRepeating, TexNearest, TexNearest, false);
+
+			init_texture_data(type, (GLsizei[]) {subtexture_w, subtexture_h, num_subtextures},
+				OPENGL_INPUT_PIXEL_FORMAT, OPENGL_NORMAL_MAP_INTERNAL_PIXEL_FORMAT, OPENGL_COLOR_CHANNEL_TYPE, NULL);
+		}
+
+		for (byte j = 0; j < ARRAY_LENGTH(blurs_to_check); j++) {
+			const BlurToCheck* const blur = blurs_to_check + j;
+
+			const NormalMapConfig config = {
+				.blur_radius = blur -> blur_radius, .blur_std_dev = blur -> blur_std_dev,
+				.heightmap_scale = blur -> heightmap_scale, .rescale_factor = 1.0f, .use_box_blur = false
+			};
+
+			make_normal_map_on_gpu(creator, &config, albedo_surface, type, normal_map_sets[0],
+				subtexture_w, subtexture_h, num_subtextures);
+
+			use_texture(type, normal_map_sets[1]);
+			make_normal_map_on_cpu(&config, albedo_surface, type, subtexture_w, subtexture_h, num_subtextures);
+
+			for (byte k = 0; k < ARRAY_LENGTH(normal_map_sets); k++) {
+				use_texture(type, normal_map_sets[k]);
+				glGetTexImage(type, 0, OPENGL_INPUT_PIXEL_FORMAT, OPENGL_COLOR_CHANNEL_TYPE,
+					(k == 0) ? gpu_normal_map : cpu_normal_map);
+			}
 
-		do_separable_gaussian_blur_pass( // Blurring #1 to #2 horizontally
-			grayscale_buffer_1, grayscale_buffer_2, blur_kernel, subtexture_h, blur_radius, false);
+			const NormalMapDifferences differences = get_normal_map_differences(cpu_normal_map, gpu_normal_map, num_bytes);
 
-		do_separable_gaussian_blur_pass( // Blurring #2 to #1 vertically
-			grayscale_buffer_2, grayscale_buffer_1, blur_kernel, subtexture_h, blur_radius, true);
+			printf("Checking normal maps made on the GPU against the CPU for %d %dx%d textures, with a blur radius "
+				"of %d, a standard deviation of %g, and a heightmap scale of %g: %zu of %zu bytes differ\n",
+				num_subtextures, subtexture_w, subtexture_h, blur -> blur_radius, (GLdouble) blur -> blur_std_dev,
+				(GLdouble) blur -> heightmap_scale, num_bytes - differences.num_matching, num_bytes);
 
-		dealloc(blur_kernel);
+			if (differences.num_matching != num_bytes)
+				FAIL(CreateTexture, "Normal maps made on the GPU differ from the CPU's ones by up to %d, for %d %dx%d "
+					"textures with a blur radius of %d, and a standard deviation of %g", differences.max_difference,
+					num_subtextures, subtexture_w, subtexture_h, blur -> blur_radius, (GLdouble) blur -> blur_std_dev);
+		}
+
+		glDeleteTextures(ARRAY_LENGTH(normal_map_sets), normal_map_sets);
+		dealloc(gpu_normal_map);
+		dealloc(cpu_normal_map);
+		deinit_surface(albedo_surface);
 	}
 
-	// Making a normal map of #1 to `rgba_surface`
-	generate_normal_map(grayscale_buffer_1, rgba_surface, subtexture_h);
+	glActiveTexture((GLenum) prev_active_texture_unit);
+}
 
-	////////// Putting the normal map in GPU memory
+/* This checks how far the box blur's normal maps are from the exact blur's ones, for the shipped blurs that blur at
+all (the weapon sprites' and billboards' blurs are skipped, since their weights don't reach a neighboring pixel,
+so both paths leave the heightmap as is). The bounds are just above what was measured on the palace's and the mountain's sector face
+textures at 256x256. With small standard deviations, the boxes shrink to nothing or to one 3-pixel box, and the Sobel
+operator magnifies each height that rounds differently; so the box blur is only close at larger standard deviations. */
+void check_box_blur_error(const GLchar* const* const albedo_texture_paths,
+	const GLsizei num_albedo_textures, const GLsizei texture_size) {
+
+	typedef struct {
+		const GLchar* const name;
+		const byte blur_radius;
+		const GLfloat blur_std_dev, heightmap_scale;
+		const GLdouble max_mean_difference;
+		const int max_difference;
+	} ShippedBlur;
+
+	const ShippedBlur shipped_blurs[] = {
+		{"title screen", 5, 0.25f, 0.3f, 0.6, 24}, // Measured: a mean of at most 0.53, and at most 23
+		{"sector faces", 3, 0.8f, 1.0f, 3.0, 104} // Measured: a mean of at most 2.83, and at most 102
+	};
+
+	SDL_Surface* const albedo_surface = init_albedo_surface_for_checking(
+		albedo_texture_paths, num_albedo_textures, texture_size, texture_size);
+
+	const size_t num_bytes = (size_t) texture_size * (size_t) albedo_surface -> h * sizeof(sdl_pixel_t);
+	sdl_pixel_t *const exact_normal_map = alloc(num_bytes, 1), *const box_normal_map = alloc(num_bytes, 1);
+
+	WITH_SURFACE_PIXEL_ACCESS(albedo_surface,
+		for (byte i = 0; i < ARRAY_LENGTH(shipped_blurs); i++) {
+			const ShippedBlur* const shipped_blur = shipped_blurs + i;
+
+			for (byte j = 0; j < 2; j++) {
+				const NormalMapConfig config = {
+					.blur_radius = shipped_blur -> blur_radius, .blur_std_dev = shipped_blur -> blur_std_dev,
+					.heightmap_scale = shipped_blur -> heightmap_scale, .rescale_factor = 1.0f, .use_box_blur = j == 1
+				};
+
+				const NormalMapJobData job_data = init_normal_map_job_data(get_row_kernels(), &config, albedo_surface,
+					(j == 0) ? exact_normal_map : box_normal_map, texture_size,
+					get_num_bands_per_subtexture(texture_size, num_albedo_textures), NULL, NULL);
+
+				run_jobs_on_worker_pool(normal_map_band_job, (void*) &job_data,
+					(buffer_size_t) (job_data.num_bands_per_subtexture * num_albedo_textures));
+
+				deinit_heightmap_blur(&job_data.blur);
+			}
 
-	const TextureFilterMode min_filter = (TextureFilterMode) mag_min_filter[1];
+			const NormalMapDifferences differences = get_normal_map_differences(exact_normal_map, box_normal_map, num_bytes);
 
-	const GLuint normal_map_set = preinit_texture(type, (TextureWrapMode) wrap_mode,
-		(TextureFilterMode) mag_min_filter[0], min_filter, uses_anisotropic_filtering);
+			printf("With the blur for the %s (a radius of %d, and a standard deviation of %g), the box blur differs from "
+				"the exact blur by %.3f on average, and by at most %d\n", shipped_blur -> name, shipped_blur -> blur_radius,
+				(GLdouble) shipped_blur -> blur_std_dev, differences.mean_difference, differences.max_difference);
 
-	WITH_SURFACE_PIXEL_ACCESS(rgba_surface, // Copying `rgba_surface` to a new texture on the GPU
-		init_texture_data(type, (GLsizei[]) {subtexture_w, subtexture_h, num_subtextures}, OPENGL_INPUT_PIXEL_FORMAT,
-			OPENGL_NORMAL_MAP_INTERNAL_PIXEL_FORMAT, OPENGL_COLOR_CHANNEL_TYPE, rgba_surface -> pixels);
+			if (differences.mean_difference > shipped_blur -> max_mean_difference
+				|| differences.max_difference > shipped_blur -> max_difference)
+				FAIL(CreateTexture, "The box blur for the %s differs too much from the exact blur: by %.3f on average "
+					"(the bound is %g), and by at most %d (the bound is %d)", shipped_blur -> name,
+					differences.mean_difference, shipped_blur -> max_mean_difference,
+					differences.max_difference, shipped_blur -> max_difference);
+		}
 	);
 
-	if (min_filter == TexLinearMipmapped || min_filter == TexTrilinear) init_texture_mipmap(type);
+	dealloc(exact_normal_map);
+	dealloc(box_normal_map);
+	deinit_surface(albedo_surface);
+}
 
-	////////// Deinitialization
+#endif
 
-	deinit_surface(grayscale_buffer_1);
-	deinit_surface(grayscale_buffer_2);
-	deinit_surface(rgba_surface);
+#ifdef BENCHMARK_NORMAL_MAP_GENERATION
 
-	return normal_map_set;
+/* This makes normal maps for a texture set of the given albedo textures a few times, with each set of row kernels on
+one thread, then with the CPU's best row kernels on a worker pool (with the exact blur and then the box blur), and
+then with the creator's shaders on the GPU. It prints how long each one takes on average, and how much the results
+differ from the scalar ones (which they shouldn't at all for the exact blur, unless the compiler's fast-math flags
+change the scalar float math; though on the GPU, `sqrt` and division may round differently). */
+void benchmark_normal_map_generation(const NormalMapCreator* const creator, const NormalMapConfig* const config,
+	const GLchar* const* const albedo_texture_paths, const GLsizei num_albedo_textures, const GLsizei texture_size) {
+
+	enum {num_runs_per_setup = 5};
+
+	const GLint subtexture_size = (GLint) (texture_size * config -> rescale_factor);
+
+	SDL_Surface* const albedo_surface = init_albedo_surface_for_checking(
+		albedo_texture_paths, num_albedo_textures, subtexture_size, subtexture_size);
+
+	//////////
+
+	typedef struct {
+		const GLchar* const name;
+		const NormalMapRowKernels* const row_kernels;
+		const bool on_worker_pool, use_box_blur, on_gpu;
+	} BenchmarkSetup;
+
+	const BenchmarkSetup setups[] = {
+		{"scalar", &scalar_row_kernels, false, false, false},
+
+		#ifdef HAS_SIMD_ROW_KERNELS
+		{"SSE2", &sse2_row_kernels, false, false, false},
+		{"AVX2", SDL_HasAVX2() ? &avx2_row_kernels : NULL, false, false, false},
+		#endif
+
+		{"CPU's best", get_row_kernels(), true, false, false},
+		{"CPU's best", get_row_kernels(), true, true, false},
+		{"GPU's", get_row_kernels(), false, false, true}
+	};
+
+	const NormalMapConfig box_blur_config = {
+		.blur_radius = config -> blur_radius, .blur_std_dev = config -> blur_std_dev,
+		.heightmap_scale = config -> heightmap_scale, .rescale_factor = config -> rescale_factor,
+		.use_box_blur = true
+	};
+
+	const size_t num_bytes = (size_t) subtexture_size * (size_t) albedo_surface -> h * sizeof(sdl_pixel_t);
+	sdl_pixel_t *const scalar_normal_map = alloc(num_bytes, 1), *const normal_map = alloc(num_bytes, 1);
+	const GLdouble seconds_per_count = 1.0 / (GLdouble) SDL_GetPerformanceFrequency();
+
+	const GLuint gpu_normal_map_set = preinit_texture(TexSet, TexNonRepeating, TexNearest, TexNearest, false);
+
+	init_texture_data(TexSet, (GLsizei[]) {subtexture_size, subtexture_size, num_albedo_textures},
+		OPENGL_INPUT_PIXEL_FORMAT, OPENGL_NORMAL_MAP_INTERNAL_PIXEL_FORMAT, OPENGL_COLOR_CHANNEL_TYPE, NULL);
+
+	WITH_SURFACE_PIXEL_ACCESS(albedo_surface,
+		for (byte i = 0; i < ARRAY_LENGTH(setups); i++) {
+			const BenchmarkSetup* const setup = setups + i;
+			if (setup -> row_kernels == NULL) continue;
+
+			if (setup -> on_gpu) {
+				Uint64 total_counts = 0;
+
+				for (byte j = 0; j < num_runs_per_setup; j++) {
+					const Uint64 start_count = SDL_GetPerformanceCounter();
+
+					make_normal_map_on_gpu(creator, config, albedo_surface, TexSet, gpu_normal_map_set,
+						subtexture_size, subtexture_size, num_albedo_textures);
+
+					glFinish();
+					total_counts += SDL_GetPerformanceCounter() - start_count;
+				}
+
+				// This is only read back for the comparison below
+				use_texture(TexSet, gpu_normal_map_set);
+				glGetTexImage(TexSet, 0, OPENGL_INPUT_PIXEL_FORMAT, OPENGL_COLOR_CHANNEL_TYPE, normal_map);
+
+				printf("Making normal maps with the %s shaders, and the exact blur, for %d %dx%d textures: %.3f ms on average\n",
+					setup -> name, num_albedo_textures, subtexture_size, subtexture_size,
+					(GLdouble) total_counts * seconds_per_count * 1000.0 / num_runs_per_setup);
+			}
+			else {
+				const NormalMapJobData job_data = init_normal_map_job_data(setup -> row_kernels,
+					setup -> use_box_blur ? &box_blur_config : config, albedo_surface,
+					(i == 0) ? scalar_normal_map : normal_map, subtexture_size,
+					setup -> on_worker_pool ? get_num_bands_per_subtexture(subtexture_size, num_albedo_textures) : 1,
+					NULL, NULL);
+
+				const buffer_size_t num_jobs = (buffer_size_t) (job_data.num_bands_per_subtexture * num_albedo_textures);
+				Uint64 total_counts = 0;
+
+				for (byte j = 0; j < num_runs_per_setup; j++) {
+					const Uint64 start_count = SDL_GetPerformanceCounter();
+
+					if (setup -> on_worker_pool) run_jobs_on_worker_pool(normal_map_band_job, (void*) &job_data, num_jobs);
+					else for (buffer_size_t k = 0; k < num_jobs; k++) normal_map_band_job((void*) &job_data, k);
+
+					total_counts += SDL_GetPerformanceCounter() - start_count;
+				}
+
+				deinit_heightmap_blur(&job_data.blur);
+
+				printf("Making normal maps with the %s row kernels %s, and the %s blur, for %d %dx%d textures: %.3f ms on average\n",
+					setup -> name, setup -> on_worker_pool ? "on a worker pool" : "on one thread",
+					setup -> use_box_blur ? "box" : "exact",
+					num_albedo_textures, subtexture_size, subtexture_size,
+					(GLdouble) total_counts * seconds_per_count * 1000.0 / num_runs_per_setup);
+			}
+
+			if (i == 0) continue;
+
+			////////// Comparing the results against the scalar ones
+
+			const NormalMapDifferences differences = get_normal_map_differences(scalar_normal_map, normal_map, num_bytes);
+
+			printf("%g%% of the results match the scalar results, and the biggest difference is %d\n",
+				(GLdouble) differences.num_matching / (GLdouble) num_bytes * 100.0, differences.max_difference);
+		}
+
+	);
+
+	deinit_texture(gpu_normal_map_set);
+	dealloc(scalar_normal_map);
+	dealloc(normal_map);
+	deinit_surface(albedo_surface);
 }
 
+#endif
+
 ////////// These are some normal map creator fns
 
 NormalMapCreator init_normal_map_creator(void) {
-	return (NormalMapCreator) {0};
+	const GLchar* const vertex_shader_path = "shaders/normal_map_generation/full_screen_quad.vert";
+
+	const GLuint
+		heightmap_shader = init_shader(vertex_shader_path, NULL, "shaders/normal_map_generation/heightmap.frag", NULL),
+		blur_shader = init_shader(vertex_shader_path, NULL, "shaders/normal_map_generation/blur.frag", NULL),
+		normal_map_shader = init_shader(vertex_shader_path, NULL, "shaders/normal_map_generation/normal_map.frag", NULL);
+
+	// Each pass reads its input from the temporary texture unit
+	use_shader(heightmap_shader);
+	INIT_UNIFORM_VALUE(albedo_sampler, heightmap_shader, 1i, TU_Temporary);
+
+	use_shader(blur_shader);
+	INIT_UNIFORM_VALUE(heightmap_sampler, blur_shader, 1i, TU_Temporary);
+
+	use_shader(normal_map_shader);
+	INIT_UNIFORM_VALUE(heightmap_sampler, normal_map_shader, 1i, TU_Temporary);
+
+	return (NormalMapCreator) {
+		.heightmap_shader = heightmap_shader, .blur_shader = blur_shader,
+		.normal_map_shader = normal_map_shader, .framebuffer = init_framebuffer(),
+
+		.heightmap_uniform_ids = {INIT_UNIFORM_ID(albedo_layer, heightmap_shader)},
+		.blur_uniform_ids = {INIT_UNIFORM_ID(blur_direction, blur_shader)}
+	};
 }
 
 void deinit_normal_map_creator(const NormalMapCreator* const creator) {
-	(void) creator; // TODO: remove
+	deinit_shader(creator -> heightmap_shader);
+	deinit_shader(creator -> blur_shader);
+	deinit_shader(creator -> normal_map_shader);
+	deinit_framebuffer(creator -> framebuffer);
 }
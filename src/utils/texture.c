@@ -5,6 +5,7 @@
 #include "data/constants.h" // For `engine.enabled.anisotropic_filtering`, and `max_byte_value`
 #include "utils/opengl_wrappers.h" // For various OpenGL wrappers
 #include "utils/safe_io.h" // For `get_temp_asset_path`
+#include <string.h> // For `memcpy`
 
 //////////
 
@@ -207,9 +208,31 @@ void init_texture_data(const TextureType type, const GLsizei* const size,
 	#undef UPLOAD_CALL
 }
 
+/* This uploads a subtexture to a layer of the currently bound texture set, and also copies
+it to that layer's rows in `subtextures_surface`, if that is not NULL */
+static void upload_subtexture_to_texture_set(SDL_Surface* const subtexture,
+	const GLint layer, SDL_Surface* const subtextures_surface) {
+
+	const GLsizei w = subtexture -> w, h = subtexture -> h;
+
+	WITH_SURFACE_PIXEL_ACCESS(subtexture,
+		glTexSubImage3D(TexSet, 0, 0, 0, layer, w, h, 1,
+			OPENGL_INPUT_PIXEL_FORMAT, OPENGL_COLOR_CHANNEL_TYPE, subtexture -> pixels);
+
+		if (subtextures_surface != NULL) {
+			WITH_SURFACE_PIXEL_ACCESS(subtextures_surface,
+				for (GLint y = 0; y < h; y++)
+					memcpy(read_surface_pixel(subtextures_surface, 0, layer * h + y),
+						read_surface_pixel(subtexture, 0, y), (size_t) w * sizeof(sdl_pixel_t));
+			);
+		}
+	);
+}
+
 static void init_still_subtextures_in_texture_set(
 	const bool premultiply_alpha, const texture_id_t num_still_subtextures,
-	const GLchar* const* const still_subtexture_paths, SDL_Surface* const rescaled_surface) {
+	const GLchar* const* const still_subtexture_paths, SDL_Surface* const rescaled_surface,
+	SDL_Surface* const subtextures_surface) {
 
 	const GLsizei correct_w = rescaled_surface -> w, correct_h = rescaled_surface -> h;
 
@@ -225,19 +248,15 @@ static void init_still_subtextures_in_texture_set(
 
 		if (premultiply_alpha) premultiply_surface_alpha(surface_with_right_size);
 
-		WITH_SURFACE_PIXEL_ACCESS(surface_with_right_size,
-			glTexSubImage3D(TexSet, 0, 0, 0, i,
-				correct_w, correct_h, 1, OPENGL_INPUT_PIXEL_FORMAT,
-				OPENGL_COLOR_CHANNEL_TYPE, surface_with_right_size -> pixels);
-		);
-
+		upload_subtexture_to_texture_set(surface_with_right_size, i, subtextures_surface);
 		deinit_surface(surface);
 	}
 }
 
 static void init_animated_subtextures_in_texture_set(const bool premultiply_alpha,
 	const texture_id_t num_animated_frames, const texture_id_t num_still_subtextures,
-	const AnimationLayout* const animation_layouts, SDL_Surface* const rescaled_surface) {
+	const AnimationLayout* const animation_layouts, SDL_Surface* const rescaled_surface,
+	SDL_Surface* const subtextures_surface) {
 
 	for (texture_id_t animation_layout_index = 0, animation_frame_index = num_still_subtextures;
 		animation_frame_index < num_animated_frames; animation_layout_index++) {
@@ -260,12 +279,7 @@ static void init_animated_subtextures_in_texture_set(const bool premultiply_alph
 			spritesheet_frame_area.y = frame_indices_across_and_down.quot * spritesheet_frame_area.h;
 
 			SDL_BlitScaled(spritesheet_surface, &spritesheet_frame_area, rescaled_surface, NULL);
-
-			WITH_SURFACE_PIXEL_ACCESS(rescaled_surface,
-				glTexSubImage3D(TexSet, 0, 0, 0, animation_frame_index,
-					rescaled_surface -> w, rescaled_surface -> h, 1, OPENGL_INPUT_PIXEL_FORMAT,
-					OPENGL_COLOR_CHANNEL_TYPE, rescaled_surface -> pixels);
-			);
+			upload_subtexture_to_texture_set(rescaled_surface, animation_frame_index, subtextures_surface);
 		}
 		deinit_surface(spritesheet_surface);
 	}
@@ -276,24 +290,35 @@ GLuint init_texture_set(const bool premultiply_alpha,
 	const TextureFilterMode mag_filter, const TextureFilterMode min_filter,
 	const texture_id_t num_still_subtextures, const texture_id_t num_animation_layouts,
 	const GLsizei rescale_w, const GLsizei rescale_h, const GLchar* const* const still_subtexture_paths,
-	const AnimationLayout* const animation_layouts) {
+	const AnimationLayout* const animation_layouts, SDL_Surface** const subtextures_surface) {
 
 	texture_id_t num_animated_frames = 0; // A frame is a subtexture
 	for (texture_id_t i = 0; i < num_animation_layouts; i++) num_animated_frames += animation_layouts[i].total_frames;
 
-	////////// Defining the texture set, and a rescaled surface
+	const GLsizei num_subtextures = num_still_subtextures + num_animated_frames;
+
+	////////// Defining the texture set, a rescaled surface, and a surface for all subtextures (if needed)
 
 	const GLuint texture = preinit_texture(TexSet, wrap_mode, mag_filter, min_filter, use_anisotropic_filtering);
 
-	init_texture_data(TexSet, (GLsizei[]) {rescale_w, rescale_h, num_still_subtextures + num_animated_frames},
+	init_texture_data(TexSet, (GLsizei[]) {rescale_w, rescale_h, num_subtextures},
 		OPENGL_INPUT_PIXEL_FORMAT, OPENGL_DEFAULT_INTERNAL_PIXEL_FORMAT, OPENGL_COLOR_CHANNEL_TYPE, NULL);
 
 	SDL_Surface* const rescaled_surface = init_blank_surface(rescale_w, rescale_h);
 
+	SDL_Surface* const kept_subtextures_surface = (subtextures_surface == NULL)
+		? NULL : init_blank_surface(rescale_w, rescale_h * num_subtextures);
+
 	////////// Filling the texture set with the still and animated subtextures, deiniting the rescaled surface, and returning
 
-	init_still_subtextures_in_texture_set(premultiply_alpha, num_still_subtextures, still_subtexture_paths, rescaled_surface);
-	init_animated_subtextures_in_texture_set(premultiply_alpha, num_animated_frames, num_still_subtextures, animation_layouts, rescaled_surface);
+	init_still_subtextures_in_texture_set(premultiply_alpha, num_still_subtextures,
+		still_subtexture_paths, rescaled_surface, kept_subtextures_surface);
+
+	init_animated_subtextures_in_texture_set(premultiply_alpha, num_animated_frames, num_still_subtextures,
+		animation_layouts, rescaled_surface, kept_subtextures_surface);
+
+	if (subtextures_surface != NULL) *subtextures_surface = kept_subtextures_surface;
+
 	init_texture_mipmap(TexSet);
 	deinit_surface(rescaled_surface);
 
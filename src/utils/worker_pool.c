@@ -0,0 +1,67 @@
+#include "utils/worker_pool.h"
+#include "utils/failure.h" // For `FAIL`
+
+bool run_worker_pool_job(WorkerPool* const worker_pool) {
+	// `SDL_AtomicAdd` returns the value from before the addition
+	const buffer_size_t job_index = (buffer_size_t) SDL_AtomicAdd(&worker_pool -> next_job_index, 1);
+	if (job_index >= worker_pool -> num_jobs) return false;
+
+	worker_pool -> job(worker_pool -> job_data, job_index);
+	return true;
+}
+
+static void run_jobs_until_none_left(WorkerPool* const worker_pool) {
+	while (run_worker_pool_job(worker_pool));
+}
+
+static int worker_thread_entry(void* const worker_pool) {
+	run_jobs_until_none_left(worker_pool);
+	return 0;
+}
+
+void start_worker_pool(WorkerPool* const worker_pool, const worker_pool_job_t job,
+	void* const job_data, const buffer_size_t num_jobs) {
+
+	/* One fewer worker than the CPU count is made, since the starting thread helps out in `finish_worker_pool`.
+	There's also no point in making more workers than there are jobs that the starting thread won't take. */
+	const int num_cpus = SDL_GetCPUCount();
+
+	buffer_size_t num_workers = (num_cpus > 1) ? (buffer_size_t) (num_cpus - 1) : 0u;
+	if (num_workers > max_num_workers) num_workers = max_num_workers;
+	if (num_jobs == 0) num_workers = 0;
+	else if (num_workers > num_jobs - 1u) num_workers = num_jobs - 1u;
+
+	worker_pool -> job = job;
+	worker_pool -> job_data = job_data;
+	worker_pool -> num_jobs = num_jobs;
+	worker_pool -> num_workers = (byte) num_workers;
+	SDL_AtomicSet(&worker_pool -> next_job_index, 0);
+
+	for (byte i = 0; i < num_workers; i++) {
+		SDL_Thread* const worker = SDL_CreateThread(worker_thread_entry, "worker", worker_pool);
+		if (worker == NULL) FAIL(CreateThread, "Could not create worker thread #%u: '%s'", i + 1u, SDL_GetError());
+		worker_pool -> workers[i] = worker;
+	}
+}
+
+buffer_size_t stop_worker_pool(WorkerPool* const worker_pool) {
+	// `SDL_AtomicSet` returns the value from before the set, which can be past the last job if the workers ran out
+	const buffer_size_t num_jobs = worker_pool -> num_jobs;
+	const buffer_size_t num_jobs_taken = (buffer_size_t) SDL_AtomicSet(&worker_pool -> next_job_index, (int) num_jobs);
+	return (num_jobs_taken < num_jobs) ? num_jobs_taken : num_jobs;
+}
+
+void finish_worker_pool(WorkerPool* const worker_pool) {
+	run_jobs_until_none_left(worker_pool);
+
+	for (byte i = 0; i < worker_pool -> num_workers; i++)
+		SDL_WaitThread(worker_pool -> workers[i], NULL);
+
+	worker_pool -> num_workers = 0;
+}
+
+void run_jobs_on_worker_pool(const worker_pool_job_t job, void* const job_data, const buffer_size_t num_jobs) {
+	WorkerPool worker_pool;
+	start_worker_pool(&worker_pool, job, job_data, num_jobs);
+	finish_worker_pool(&worker_pool);
+}